@@ -0,0 +1,65 @@
+#pragma once
+/**
+ * @file bench/benchmark.hpp
+ * @brief The benchmark harness
+ * @author Haoran Luo
+ *
+ * Defines the minimal harness of libminecraft_bench, which has no dependency
+ * other than the library itself. Each benchmark case is a function running
+ * its body state.iterations times, and the harness grows the iterations until
+ * the case has run for the minimum time, reporting the time per iteration.
+ *
+ * '''
+ * static void benchSomething(McBenchState& state) {
+ *     for(size_t i = 0; i < state.iterations; ++ i) { ... }
+ *     state.bytesProcessed = state.iterations * bytesPerIteration;
+ * }
+ * static McBenchRegistrar registrar[] = {
+ *     McBenchRegistrar("something", benchSomething),
+ * };
+ * '''
+ *
+ * The one-shot cases run exactly once and report their own counters, which
+ * is suitable for the benchmarks measuring throughput over a fixed duration.
+ */
+#include <string>
+#include <vector>
+#include <utility>
+
+/// The state passed to the benchmark case.
+struct McBenchState {
+	/// The argument the case is registered with.
+	long argument;
+
+	/// The number of iterations the case should run.
+	size_t iterations;
+
+	/// The minimum time the case should run, in unit of second.
+	double minimumTime;
+
+	/// The bytes processed by all iterations, reported as throughput if set.
+	size_t bytesProcessed;
+
+	/// The (name, value) counters reported after the case.
+	std::vector<std::pair<std::string, double>> counters;
+};
+
+/// The function of the benchmark case.
+typedef void (*McBenchFunction)(McBenchState& state);
+
+/// Register the benchmark case at static initialization.
+struct McBenchRegistrar {
+	McBenchRegistrar(const char* name, McBenchFunction function,
+		long argument = 0, bool oneshot = false);
+};
+
+/**
+ * @brief The corpus files passed in the command line, e.g. the uncompressed
+ * (or gzip compressed) nbt files, or the region files.
+ */
+const std::vector<std::string>& McBenchCorpus();
+
+/// Prevent the compiler from optimizing out the computation of the value.
+template<typename T> inline void McBenchDoNotOptimize(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
\ No newline at end of file
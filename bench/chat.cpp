@@ -0,0 +1,80 @@
+/**
+ * @file bench/chat.cpp
+ * @brief The benchmarks of the chat json codec.
+ * @author Haoran Luo
+ *
+ * Measures McIoReadChatCompound() from the streams and in situ, and
+ * McIoWriteChatCompound() of the parsed compounds.
+ */
+#include "benchmark.hpp"
+#include "libminecraft/chat.hpp"
+#include "libminecraft/bufstream.hpp"
+#include <cstring>
+
+/// The chat messages, from a plain message to a decorated nested one.
+static const char* chatMessages[] = {
+	"{\"text\":\"Hello world\"}",
+	"{\"translate\":\"chat.type.text\",\"with\":[{\"text\":\"Steve\",\"clickEvent\":"
+		"{\"action\":\"suggest_command\",\"value\":\"/msg Steve \"},\"hoverEvent\":"
+		"{\"action\":\"show_text\",\"value\":{\"text\":\"Steve\"}}},"
+		"{\"text\":\"Has anyone seen my diamonds?\"}]}",
+	"{\"text\":\"\",\"extra\":[{\"text\":\"[Server] \",\"color\":\"gold\",\"bold\":true},"
+		"{\"text\":\"The world will restart in \",\"color\":\"yellow\"},"
+		"{\"text\":\"5 minutes\",\"color\":\"red\",\"underlined\":true},"
+		"{\"text\":\", visit \",\"color\":\"yellow\"},{\"text\":\"example.com\","
+		"\"clickEvent\":{\"action\":\"open_url\",\"value\":\"https://example.com\"},"
+		"\"italic\":true},{\"text\":\" for details.\",\"color\":\"yellow\"}]}",
+};
+
+static void benchChatReadStream(McBenchState& state) {
+	const char* message = chatMessages[state.argument];
+	size_t size = strlen(message);
+	for(size_t i = 0; i < state.iterations; ++ i) {
+		McIoBufferInputStream inputStream(message, size);
+		McDtChatCompound compound;
+		McIoReadChatCompound(inputStream, compound, size);
+		McBenchDoNotOptimize(compound);
+	}
+	state.bytesProcessed = state.iterations * size;
+}
+
+static void benchChatReadInsitu(McBenchState& state) {
+	const char* message = chatMessages[state.argument];
+	size_t size = strlen(message);
+	std::vector<char> buffer(size);
+	for(size_t i = 0; i < state.iterations; ++ i) {
+		buffer.assign(message, message + size);
+		McDtChatCompound compound;
+		McIoReadChatCompound(buffer.data(), size, compound);
+		McBenchDoNotOptimize(compound);
+	}
+	state.bytesProcessed = state.iterations * size;
+}
+
+static void benchChatWrite(McBenchState& state) {
+	const char* message = chatMessages[state.argument];
+	size_t size = strlen(message);
+	McIoBufferInputStream inputStream(message, size);
+	McDtChatCompound compound;
+	McIoReadChatCompound(inputStream, compound, size);
+
+	McIoBufferOutputStream outputStream(2 * size);
+	for(size_t i = 0; i < state.iterations; ++ i) {
+		outputStream.reset();
+		McIoWriteChatCompound(outputStream, compound);
+		McBenchDoNotOptimize(outputStream.size());
+	}
+	state.bytesProcessed = state.iterations * outputStream.size();
+}
+
+static McBenchRegistrar registrar[] = {
+	McBenchRegistrar("chat/read/stream/plain", benchChatReadStream, 0),
+	McBenchRegistrar("chat/read/stream/translate", benchChatReadStream, 1),
+	McBenchRegistrar("chat/read/stream/decorated", benchChatReadStream, 2),
+	McBenchRegistrar("chat/read/insitu/plain", benchChatReadInsitu, 0),
+	McBenchRegistrar("chat/read/insitu/translate", benchChatReadInsitu, 1),
+	McBenchRegistrar("chat/read/insitu/decorated", benchChatReadInsitu, 2),
+	McBenchRegistrar("chat/write/plain", benchChatWrite, 0),
+	McBenchRegistrar("chat/write/translate", benchChatWrite, 1),
+	McBenchRegistrar("chat/write/decorated", benchChatWrite, 2),
+};
\ No newline at end of file
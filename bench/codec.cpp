@@ -0,0 +1,115 @@
+/**
+ * @file bench/codec.cpp
+ * @brief The benchmarks of the primitive codecs.
+ * @author Haoran Luo
+ *
+ * Measures encoding and decoding mc::var32, mc::var64 and mc::ustring over
+ * the buffer streams, and framing the packets by lengthPrefixedData().
+ */
+#include "benchmark.hpp"
+#include "libminecraft/iobase.hpp"
+#include "libminecraft/bufstream.hpp"
+#include <random>
+
+/// The number of values encoded or decoded per iteration.
+static const size_t valuesPerIteration = 256;
+
+/// Generate the values whose encoded length is evenly distributed.
+template<typename T> static std::vector<T> McBenchVariantValues() {
+	std::mt19937_64 random(0x6d63);
+	std::vector<T> values;
+	for(size_t i = 0; i < valuesPerIteration; ++ i) {
+		size_t bits = 7 * (1 + random() % ((sizeof(T) * 8 + 6) / 7));
+		uint64_t mask = bits >= 64? ~(uint64_t)0 : ((uint64_t)1 << bits) - 1;
+		values.push_back((T)(random() & mask));
+	}
+	return values;
+}
+
+template<typename V, typename T> static void benchVariantWrite(McBenchState& state) {
+	std::vector<T> values = McBenchVariantValues<T>();
+	McIoBufferOutputStream outputStream(valuesPerIteration * 10);
+	for(size_t i = 0; i < state.iterations; ++ i) {
+		outputStream.reset();
+		for(T value : values) outputStream << V(value);
+		McBenchDoNotOptimize(outputStream.size());
+	}
+	state.bytesProcessed = state.iterations * outputStream.size();
+}
+
+template<typename V, typename T> static void benchVariantRead(McBenchState& state) {
+	std::vector<T> values = McBenchVariantValues<T>();
+	McIoBufferOutputStream outputStream;
+	for(T value : values) outputStream << V(value);
+	size_t size; const char* data;
+	std::tie(size, data) = outputStream.rawData();
+
+	for(size_t i = 0; i < state.iterations; ++ i) {
+		McIoBufferInputStream inputStream(data, size);
+		for(size_t j = 0; j < valuesPerIteration; ++ j) {
+			V value; inputStream >> value;
+			McBenchDoNotOptimize((const T&)value);
+		}
+	}
+	state.bytesProcessed = state.iterations * size;
+}
+
+/// Generate the string of the argument's code points, repeated to the length.
+static std::u16string McBenchString(char16_t codePoint, size_t length) {
+	std::u16string result;
+	for(size_t i = 0; i < length; ++ i) result.push_back((char16_t)(codePoint + i % 26));
+	return result;
+}
+
+static void benchUstringWrite(McBenchState& state) {
+	mc::ustring<> value(McBenchString((char16_t)state.argument, 64));
+	McIoBufferOutputStream outputStream(1024);
+	for(size_t i = 0; i < state.iterations; ++ i) {
+		outputStream.reset();
+		for(size_t j = 0; j < 8; ++ j) outputStream << value;
+		McBenchDoNotOptimize(outputStream.size());
+	}
+	state.bytesProcessed = state.iterations * outputStream.size();
+}
+
+static void benchUstringRead(McBenchState& state) {
+	mc::ustring<> value(McBenchString((char16_t)state.argument, 64));
+	McIoBufferOutputStream outputStream;
+	for(size_t j = 0; j < 8; ++ j) outputStream << value;
+	size_t size; const char* data;
+	std::tie(size, data) = outputStream.rawData();
+
+	for(size_t i = 0; i < state.iterations; ++ i) {
+		McIoBufferInputStream inputStream(data, size);
+		for(size_t j = 0; j < 8; ++ j) {
+			mc::ustring<> decoded; inputStream >> decoded;
+			McBenchDoNotOptimize(((const std::u16string&)decoded).size());
+		}
+	}
+	state.bytesProcessed = state.iterations * size;
+}
+
+static void benchLengthPrefixedData(McBenchState& state) {
+	std::vector<char> payload((size_t)state.argument, 'x');
+	McIoBufferOutputStream outputStream(payload.size() + 1);
+	for(size_t i = 0; i < state.iterations; ++ i) {
+		outputStream.reset();
+		outputStream << mc::var32(0x20);
+		outputStream.write(payload.data(), payload.size());
+		McBenchDoNotOptimize(std::get<1>(outputStream.lengthPrefixedData()));
+	}
+	state.bytesProcessed = state.iterations * payload.size();
+}
+
+static McBenchRegistrar registrar[] = {
+	McBenchRegistrar("codec/var32/write", benchVariantWrite<mc::var32, int32_t>),
+	McBenchRegistrar("codec/var32/read", benchVariantRead<mc::var32, int32_t>),
+	McBenchRegistrar("codec/var64/write", benchVariantWrite<mc::var64, int64_t>),
+	McBenchRegistrar("codec/var64/read", benchVariantRead<mc::var64, int64_t>),
+	McBenchRegistrar("codec/ustring/write/ascii", benchUstringWrite, u'a'),
+	McBenchRegistrar("codec/ustring/read/ascii", benchUstringRead, u'a'),
+	McBenchRegistrar("codec/ustring/write/cjk", benchUstringWrite, u'一'),
+	McBenchRegistrar("codec/ustring/read/cjk", benchUstringRead, u'一'),
+	McBenchRegistrar("codec/lengthPrefixedData/64", benchLengthPrefixedData, 64),
+	McBenchRegistrar("codec/lengthPrefixedData/16384", benchLengthPrefixedData, 16384),
+};
\ No newline at end of file
@@ -0,0 +1,113 @@
+/**
+ * @file bench/connection.cpp
+ * @brief The loopback benchmark of the connections.
+ * @author Haoran Luo
+ *
+ * Drives pairs of McIoConnection over socketpair() inside one multiplexer,
+ * where the client connections keep a few timestamped packets in flight and
+ * the server connections echo them back. The throughput and the round trip
+ * latency are reported as the number of connection pairs grows.
+ */
+#include "benchmark.hpp"
+#include "libminecraft/connection.hpp"
+#include "libminecraft/iobase.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+/// The number of packets each client keeps in flight.
+static const size_t packetsInFlight = 4;
+
+/// The current time in unit of nanosecond.
+static int64_t McBenchNow() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Write the timestamped packet to the connection.
+static void McBenchPing(McIoConnection& connection, int64_t timestamp) {
+	McIoBufferOutputStream packet(sizeof(int64_t));
+	packet << mc::s64(timestamp);
+	connection.writePacket(std::move(packet));
+}
+
+/// The server connection echoing the packets back.
+class McBenchEchoConnection : public McIoConnection {
+	virtual void handle(size_t, McIoMarkableStream& inputStream) override {
+		mc::s64 timestamp; inputStream >> timestamp;
+		McBenchPing(*this, timestamp);
+	}
+public:
+	McBenchEchoConnection(int sockfd): McIoConnection(sockfd) {}
+};
+
+/// The client connection measuring the round trip of the echoed packets.
+class McBenchClientConnection : public McIoConnection {
+	std::vector<int64_t>& latencies;
+
+	virtual void handle(size_t, McIoMarkableStream& inputStream) override {
+		mc::s64 timestamp; inputStream >> timestamp;
+		int64_t now = McBenchNow();
+		latencies.push_back(now - (int64_t)timestamp);
+		McBenchPing(*this, now);
+	}
+public:
+	McBenchClientConnection(int sockfd, std::vector<int64_t>& latencies):
+		McIoConnection(sockfd), latencies(latencies) {}
+};
+
+static void benchConnectionLoopback(McBenchState& state) {
+	McIoMultiplexer multiplexer;
+	multiplexer.updateTimeout(10000000);
+	std::vector<int64_t> latencies;
+	latencies.reserve(1 << 20);
+
+	// Create the connection pairs and start the ping-pong.
+	for(long i = 0; i < state.argument; ++ i) {
+		int sockets[2];
+		if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sockets) < 0)
+			throw std::runtime_error("Cannot create the socket pair.");
+		std::unique_ptr<McIoDescriptor> server(new McBenchEchoConnection(sockets[0]));
+		multiplexer.insert(server);
+		McBenchClientConnection* clientConnection =
+			new McBenchClientConnection(sockets[1], latencies);
+		std::unique_ptr<McIoDescriptor> client(clientConnection);
+		multiplexer.insert(client);
+		for(size_t j = 0; j < packetsInFlight; ++ j)
+			McBenchPing(*clientConnection, McBenchNow());
+	}
+
+	// Warm up before measuring, then run for the minimum time.
+	multiplexer.execute();
+	latencies.clear();
+	McIoMultiplexerMetricsSnapshot before = multiplexer.metrics().snapshot();
+	int64_t begin = McBenchNow();
+	int64_t duration = (int64_t)(std::max(state.minimumTime, 1.0) * 1e9);
+	while(McBenchNow() - begin < duration) multiplexer.execute();
+	double elapsed = (McBenchNow() - begin) * 1e-9;
+	if(latencies.empty()) throw std::runtime_error("No packet has been echoed.");
+
+	// Report the throughput and the latency percentiles.
+	auto percentile = [&](double ratio) -> double {
+		auto nth = latencies.begin() + (size_t)(ratio * (latencies.size() - 1));
+		std::nth_element(latencies.begin(), nth, latencies.end());
+		return *nth * 1e-3;
+	};
+	state.counters.emplace_back("packets/s", latencies.size() / elapsed);
+	state.counters.emplace_back("p50_us", percentile(0.50));
+	state.counters.emplace_back("p99_us", percentile(0.99));
+	if(McIoMetricsEnabled) {
+		McIoMultiplexerMetricsSnapshot after = multiplexer.metrics().snapshot();
+		state.counters.emplace_back("syscalls/packet", 
+			(double)(after.syscalls - before.syscalls) / latencies.size());
+	}
+}
+
+static McBenchRegistrar registrar[] = {
+	McBenchRegistrar("connection/loopback/1", benchConnectionLoopback, 1, true),
+	McBenchRegistrar("connection/loopback/8", benchConnectionLoopback, 8, true),
+	McBenchRegistrar("connection/loopback/64", benchConnectionLoopback, 64, true),
+	McBenchRegistrar("connection/loopback/256", benchConnectionLoopback, 256, true),
+};
\ No newline at end of file
@@ -0,0 +1,101 @@
+/**
+ * @file bench/main.cpp
+ * @brief The entry of libminecraft_bench.
+ * @author Haoran Luo
+ *
+ * Runs the registered benchmark cases whose names contain the filter, the
+ * usage is:
+ *
+ * '''
+ * libminecraft_bench [--filter <substring>] [--min-time <seconds>] [corpus...]
+ * '''
+ *
+ * @see bench/benchmark.hpp
+ */
+#include "benchmark.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+
+/// The registered benchmark case.
+struct McBenchCase {
+	std::string name;
+	McBenchFunction function;
+	long argument;
+	bool oneshot;
+};
+
+/// The registry of the benchmark cases, constructed on first use.
+static std::vector<McBenchCase>& McBenchCases() {
+	static std::vector<McBenchCase> cases;
+	return cases;
+}
+
+// Implementation for McBenchRegistrar::McBenchRegistrar().
+McBenchRegistrar::McBenchRegistrar(const char* name,
+	McBenchFunction function, long argument, bool oneshot) {
+	McBenchCases().push_back(McBenchCase{ name, function, argument, oneshot });
+}
+
+/// The corpus passed in the command line.
+static std::vector<std::string> corpus;
+const std::vector<std::string>& McBenchCorpus() { return corpus; }
+
+/// Run the case once with specified iterations, returning the elapsed seconds.
+static double McBenchRunOnce(const McBenchCase& benchCase,
+	McBenchState& state, size_t iterations) {
+	state.iterations = iterations;
+	state.bytesProcessed = 0;
+	state.counters.clear();
+	auto begin = std::chrono::steady_clock::now();
+	benchCase.function(state);
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char** argv) {
+	const char* filter = "";
+	double minimumTime = 0.5;
+	for(int i = 1; i < argc; ++ i) {
+		if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++ i];
+		else if(strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+			minimumTime = atof(argv[++ i]);
+		else corpus.push_back(argv[i]);
+	}
+
+	printf("%-36s %12s %14s %12s\n", "benchmark", "iterations", "ns/iteration", "MiB/s");
+	for(const McBenchCase& benchCase : McBenchCases()) {
+		if(strstr(benchCase.name.c_str(), filter) == nullptr) continue;
+		McBenchState state;
+		state.argument = benchCase.argument;
+		state.minimumTime = minimumTime;
+
+		try {
+			// Grow the iterations until the minimum time has been reached.
+			size_t iterations = 1;
+			double elapsed = McBenchRunOnce(benchCase, state, iterations);
+			while(!benchCase.oneshot && elapsed < minimumTime) {
+				double scale = elapsed > 0? minimumTime * 1.2 / elapsed : 100;
+				if(scale > 100) scale = 100;
+				if(scale < 2) scale = 2;
+				iterations = (size_t)(iterations * scale);
+				elapsed = McBenchRunOnce(benchCase, state, iterations);
+			}
+
+			// Report the result of the case.
+			printf("%-36s %12zu %14.1f", benchCase.name.c_str(),
+				iterations, elapsed * 1e9 / iterations);
+			if(state.bytesProcessed > 0)
+				printf(" %12.1f", state.bytesProcessed / elapsed / (1 << 20));
+			else printf(" %12s", "-");
+			for(const auto& counter : state.counters)
+				printf(" %s=%.1f", counter.first.c_str(), counter.second);
+			printf("\n");
+		} catch(const std::exception& e) {
+			printf("%-36s failed: %s\n", benchCase.name.c_str(), e.what());
+		}
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+/**
+ * @file bench/nbt.cpp
+ * @brief The benchmarks of reading nbt compounds.
+ * @author Haoran Luo
+ *
+ * Measures McIoReadNbtCompound() over the nbt corpus passed in the command
+ * line, where the region files (.mca) contribute all of their chunks and the
+ * other files are read as (optionally gzip compressed) nbt files. Without a
+ * corpus, a synthetic chunk and item are generated instead.
+ */
+#include "benchmark.hpp"
+#include "libminecraft/nbt.hpp"
+#include "libminecraft/bufstream.hpp"
+#ifdef __linux__
+#include "libminecraft/region.hpp"
+#endif
+#include <zlib.h>
+#include <stdexcept>
+#include <cstring>
+
+/// The writer of the raw nbt bytes for the synthetic documents.
+struct McBenchNbtWriter {
+	std::vector<char> bytes;
+
+	void integer(uint64_t value, size_t size) {
+		for(size_t i = size; i > 0; -- i) bytes.push_back((char)(value >> (8 * (i - 1))));
+	}
+
+	void string(const char* value) {
+		integer(strlen(value), 2);
+		bytes.insert(bytes.end(), value, value + strlen(value));
+	}
+
+	void tag(int type, const char* name) {
+		bytes.push_back((char)type);
+		string(name);
+	}
+
+	void end() { bytes.push_back(0); }
+};
+
+/// Generate a chunk of 16 sections, with block states and palettes.
+static std::vector<char> McBenchSyntheticChunk() {
+	McBenchNbtWriter writer;
+	writer.tag(10, "");
+	writer.tag(3, "DataVersion"); writer.integer(3465, 4);
+	writer.tag(3, "xPos"); writer.integer(12, 4);
+	writer.tag(3, "zPos"); writer.integer(-7, 4);
+	writer.tag(8, "Status"); writer.string("minecraft:full");
+	writer.tag(4, "LastUpdate"); writer.integer(1234567, 8);
+	writer.tag(9, "sections"); writer.bytes.push_back(10); writer.integer(16, 4);
+	for(int section = 0; section < 16; ++ section) {
+		writer.tag(1, "Y"); writer.bytes.push_back((char)(section - 4));
+		writer.tag(10, "block_states");
+		writer.tag(9, "palette"); writer.bytes.push_back(10); writer.integer(8, 4);
+		for(int block = 0; block < 8; ++ block) {
+			writer.tag(8, "Name"); writer.string(block % 2? "minecraft:stone" : "minecraft:deepslate");
+			writer.tag(10, "Properties");
+			writer.tag(8, "axis"); writer.string("y");
+			writer.end();
+			writer.end();
+		}
+		writer.tag(12, "data"); writer.integer(256, 4);
+		for(int i = 0; i < 256; ++ i) writer.integer(0x0123456789abcdefull * (i + 1), 8);
+		writer.end();
+		writer.tag(7, "BlockLight"); writer.integer(2048, 4);
+		writer.bytes.insert(writer.bytes.end(), 2048, (char)0x11);
+		writer.end();
+	}
+	writer.tag(12, "Heightmaps"); writer.integer(37, 4);
+	for(int i = 0; i < 37; ++ i) writer.integer(i, 8);
+	writer.end();
+	return writer.bytes;
+}
+
+/// Generate an enchanted item with display name and lore.
+static std::vector<char> McBenchSyntheticItem() {
+	McBenchNbtWriter writer;
+	writer.tag(10, "");
+	writer.tag(8, "id"); writer.string("minecraft:diamond_sword");
+	writer.tag(1, "Count"); writer.bytes.push_back(1);
+	writer.tag(10, "tag");
+	writer.tag(3, "Damage"); writer.integer(12, 4);
+	writer.tag(10, "display");
+	writer.tag(8, "Name"); writer.string("{\"text\":\"Excalibur\",\"color\":\"gold\"}");
+	writer.tag(9, "Lore"); writer.bytes.push_back(8); writer.integer(2, 4);
+	writer.string("{\"text\":\"Forged in the dragon fire\"}");
+	writer.string("{\"text\":\"Bound to its wielder\"}");
+	writer.end();
+	writer.tag(9, "Enchantments"); writer.bytes.push_back(10); writer.integer(3, 4);
+	for(const char* id : { "minecraft:sharpness", "minecraft:unbreaking", "minecraft:looting" }) {
+		writer.tag(8, "id"); writer.string(id);
+		writer.tag(2, "lvl"); writer.integer(3, 2);
+		writer.end();
+	}
+	writer.end();
+	writer.end();
+	return writer.bytes;
+}
+
+/// Read the whole (optionally gzip compressed) file.
+static std::vector<char> McBenchReadFile(const std::string& path) {
+	gzFile file = gzopen(path.c_str(), "rb");
+	if(file == nullptr) throw std::runtime_error("Cannot open the corpus " + path + ".");
+	std::vector<char> content;
+	char buffer[65536]; int size;
+	while((size = gzread(file, buffer, sizeof(buffer))) > 0)
+		content.insert(content.end(), buffer, buffer + size);
+	gzclose(file);
+	if(size < 0) throw std::runtime_error("Cannot read the corpus " + path + ".");
+	return content;
+}
+
+/// Retrieve the documents of the corpus, or the synthetic documents.
+static const std::vector<std::vector<char>>& McBenchNbtDocuments(bool item) {
+	static std::vector<std::vector<char>> documents[2];
+	static bool loaded = false;
+	if(!loaded) {
+		loaded = true;
+		for(const std::string& path : McBenchCorpus()) {
+#ifdef __linux__
+			if(path.size() > 4 && path.compare(path.size() - 4, 4, ".mca") == 0) {
+				McIoRegionFile region(path.c_str());
+				for(int z = 0; z < (int)McIoRegionFile::regionWidth; ++ z)
+					for(int x = 0; x < (int)McIoRegionFile::regionWidth; ++ x) {
+						if(!region.hasChunk(x, z)) continue;
+						documents[0].emplace_back();
+						region.inflateChunk(x, z, documents[0].back());
+					}
+				continue;
+			}
+#endif
+			// The small documents are considered as the items.
+			std::vector<char> document = McBenchReadFile(path);
+			documents[document.size() < 4096? 1 : 0].push_back(std::move(document));
+		}
+		if(documents[0].empty()) documents[0].push_back(McBenchSyntheticChunk());
+		if(documents[1].empty()) documents[1].push_back(McBenchSyntheticItem());
+	}
+	return documents[item? 1 : 0];
+}
+
+/// Skip the tag type and name of the root compound.
+static void McBenchSkipRoot(McIoInputStream& inputStream) {
+	mc::s8 tagType; inputStream >> tagType;
+	if((int8_t)tagType != 10) throw std::runtime_error("The corpus is not an nbt compound.");
+	mc::u16 nameLength; inputStream >> nameLength;
+	inputStream.skip(nameLength);
+}
+
+static void benchNbtRead(McBenchState& state) {
+	const std::vector<std::vector<char>>& documents = McBenchNbtDocuments(state.argument != 0);
+	for(size_t i = 0; i < state.iterations; ++ i)
+		for(const std::vector<char>& document : documents) {
+			McIoBufferInputStream inputStream(document.data(), document.size());
+			McBenchSkipRoot(inputStream);
+			mc::nbtcompound compound;
+			McIoReadNbtCompound(inputStream, compound);
+			McBenchDoNotOptimize(compound);
+		}
+	for(const std::vector<char>& document : documents)
+		state.bytesProcessed += state.iterations * document.size();
+}
+
+static void benchNbtReadArena(McBenchState& state) {
+	const std::vector<std::vector<char>>& documents = McBenchNbtDocuments(state.argument != 0);
+	McDtNbtArena arena;
+	for(size_t i = 0; i < state.iterations; ++ i)
+		for(const std::vector<char>& document : documents) {
+			McIoBufferInputStream inputStream(document.data(), document.size());
+			McBenchSkipRoot(inputStream);
+			{
+				mc::nbtcompound compound(&arena);
+				McIoReadNbtCompound(inputStream, compound);
+				McBenchDoNotOptimize(compound);
+			}
+			arena.reset();
+		}
+	for(const std::vector<char>& document : documents)
+		state.bytesProcessed += state.iterations * document.size();
+}
+
+static McBenchRegistrar registrar[] = {
+	McBenchRegistrar("nbt/read/chunk", benchNbtRead, 0),
+	McBenchRegistrar("nbt/read/chunk/arena", benchNbtReadArena, 0),
+	McBenchRegistrar("nbt/read/item", benchNbtRead, 1),
+	McBenchRegistrar("nbt/read/item/arena", benchNbtReadArena, 1),
+};
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+/**
+ * @file libminecraft/broadcast.hpp
+ * @brief I/O Broadcast Packet
+ * @author Haoran Luo
+ *
+ * Defines the broadcast packet, which is a packet serialized only once
+ * and then sent to many writables. The framed bytes are stored in a
+ * reference counted buffer, and every writable enqueues the buffer by
+ * reference, so neither enqueuing nor partial writes cause copying.
+ *
+ * As the framing depends on the compression threshold, a broadcast
+ * packet could only be sent to connections with the same threshold it
+ * is built with.
+ */
+#include "libminecraft/bufstream.hpp"
+#include <memory>
+#include <cstddef>
+
+/**
+ * @brief The immutable broadcast packet, which could be copied and
+ * shared freely among connections on the same thread.
+ */
+class McIoBroadcastPacket {
+	/// The framed packet data, never modified after construction.
+	std::shared_ptr<char> buffer;
+	
+	/// The size of the framed packet data.
+	size_t size;
+	
+	/// The compression threshold the packet is framed with.
+	int compressionThreshold;
+	
+	// The writable needs to enqueue the buffer.
+	friend class McIoWritable;
+public:
+	/**
+	 * @brief Frame the packet prepared in the buffer output stream.
+	 *
+	 * @param[in] packet the buffer storing the packet id and packet data.
+	 * @param[in] compressionThreshold the compression threshold of the 
+	 * receiving connections, negative for uncompressed framing.
+	 * @throw std::runtime_error when the packet cannot be compressed.
+	 */
+	McIoBroadcastPacket(const McIoBufferOutputStream& packet, 
+			int compressionThreshold = -1);
+	
+	/// @brief Retrieve the framed packet data.
+	const char* data() const noexcept { return buffer.get(); }
+	
+	/// @brief Retrieve the size of the framed packet data.
+	size_t length() const noexcept { return size; }
+	
+	/// @brief Retrieve the compression threshold the packet is framed with.
+	int getCompressionThreshold() const noexcept { return compressionThreshold; }
+};
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+/**
+ * @file libminecraft/bufpool.hpp
+ * @brief I/O Buffer Pool
+ * @author Haoran Luo
+ *
+ * Defines the size-classed buffer pool, which recycles the buffers for
+ * large or fragmented inbound packets. Each multiplexer owns a pool, and
+ * the pool is shared among descriptors managed by that multiplexer.
+ *
+ * The buffers are handed out uninitialized, and are rounded up to the
+ * power of two size classes. Buffers larger than the largest size class
+ * are directly allocated and freed.
+ *
+ * This class is NOT multi-thread safe, and never share instances of this
+ * class among threads.
+ */
+#include <cstddef>
+
+class McIoBufferPool {
+public:
+	/// The size of the smallest size class is 1 << minSizeClassShift.
+	static const size_t minSizeClassShift = 8;
+
+	/// The size of the largest size class is 1 << maxSizeClassShift.
+	static const size_t maxSizeClassShift = 21;
+
+	/// The number of size classes in the pool.
+	static const size_t numSizeClasses = maxSizeClassShift - minSizeClassShift + 1;
+
+	/// The default maximum number of bytes retained in free lists.
+	static const size_t defaultMaximumRetainedSize = 16 << 20;
+
+	/// The statistics of the buffer pool.
+	struct McIoBufferPoolStats {
+		size_t acquired;            ///< Number of buffers acquired.
+		size_t hit;                 ///< Number of acquisitions served by free lists.
+		size_t inUseSize;           ///< Bytes currently handed out.
+		size_t inUseHighWater;      ///< The high-water mark of the inUseSize.
+		size_t retainedSize;        ///< Bytes currently kept in free lists.
+	};
+
+	/// Construct an empty buffer pool.
+	McIoBufferPool();
+
+	/// Free all retained buffers. Buffers still handed out must not be
+	/// released after the pool has been destructed.
+	~McIoBufferPool() noexcept;
+
+	// Copy sematics and move sematics are not allowed.
+	McIoBufferPool(const McIoBufferPool&) = delete;
+	McIoBufferPool& operator=(const McIoBufferPool&) = delete;
+	McIoBufferPool(McIoBufferPool&&) = delete;
+	McIoBufferPool& operator=(McIoBufferPool&&) = delete;
+
+	/**
+	 * @brief Acquire an uninitialized buffer of at least the given size.
+	 *
+	 * @param[in] size the requested size of the buffer, in unit of byte.
+	 * @return the acquired buffer, which must be released with the same size.
+	 * @throw std::bad_alloc when the buffer cannot be allocated.
+	 */
+	char* acquire(size_t size);
+
+	/**
+	 * @brief Return the buffer to the pool.
+	 *
+	 * @param[in] buffer the buffer returned by acquire().
+	 * @param[in] size the size that has been passed to acquire().
+	 */
+	void release(char* buffer, size_t size) noexcept;
+
+	/**
+	 * @brief Set the maximum number of bytes kept in free lists, buffers
+	 * released beyond this limit are freed directly.
+	 *
+	 * @param[in] newSize the new retained size limit.
+	 */
+	void setMaximumRetainedSize(size_t newSize) noexcept;
+
+	/// @brief Retrieve current retained size limit.
+	size_t getMaximumRetainedSize() const noexcept;
+
+	/// @brief Retrieve a snapshot of the statistics.
+	McIoBufferPoolStats stats() const noexcept;
+private:
+	/// The heads of intrusive free lists, one for each size class.
+	char* freeLists[numSizeClasses];
+
+	/// The retained size limit.
+	size_t maxRetainedSize;
+
+	/// The statistics.
+	McIoBufferPoolStats statistics;
+};
\ No newline at end of file
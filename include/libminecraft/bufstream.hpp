@@ -10,24 +10,23 @@
 #include "libminecraft/markable.hpp"
 #include <vector>
 #include <tuple>
+#include <memory>
 
 /**
  * @brief Defines buffer input stream which wraps an immutable 
  * buffer. The buffer is not managed by the stream.
  *
  * The stream offers boundary check, and exception will be 
- * thrown if boundary has exceeds.
+ * thrown if boundary has exceeds. The whole remaining buffer is
+ * exposed as the window of the stream.
  */
 class McIoBufferInputStream : public McIoMarkableStream {
-	/// The underlying buffer to read data from.
-	const char* buffer;
-	
-	/// The remaining size of the buffer.
-	size_t size;
 public:
 	/// The constructor of the input stream.
-	McIoBufferInputStream(const char* initBuffer, size_t initSize):
-		buffer(initBuffer), size(initSize) {}
+	McIoBufferInputStream(const char* initBuffer, size_t initSize) {
+		windowBegin = initBuffer;
+		windowEnd = initBuffer + initSize;
+	}
 	
 	/// The implemented read method.
 	virtual void read(char* buffer, size_t receiveLength) override;
@@ -48,17 +47,38 @@ public:
  * The data in the buffer should not exceeds the variant int length 
  * (if such data is packet, it won't be received by the client),
  * and exception would be thrown this case.
+ *
+ * The stream could be reused by reset(), which keeps the capacity of the
+ * buffer, or the buffer could be released as a shared pointer to be
+ * written by McIoWritable without copying.
  */
 class McIoBufferOutputStream : public McIoOutputStream {
 	/// The buffer to store the written data.
 	mutable std::vector<char> buffer;
 public:
-	/// The constructor of the output stream.
-	McIoBufferOutputStream(): buffer(5) { }
+	/// The constructor of the output stream, reserving the capacity for
+	/// the expected size of data to write.
+	explicit McIoBufferOutputStream(size_t capacityHint = 0): buffer(5) 
+		{	if(capacityHint > 0) buffer.reserve(capacityHint + 5);	}
 	
 	/// The implemented write method.
 	virtual void write(const char* buffer, size_t sendLength) override;
 	
+	/// Reserve the capacity for writing more data of the size.
+	void reserve(size_t additional) { buffer.reserve(buffer.size() + additional); }
+	
+	/// Discard the written data, keeping the capacity for reuse.
+	void reset() noexcept { buffer.resize(5); }
+	
+	/**
+	 * @brief Release the length-prefixed data as a shared pointer, leaving
+	 * the stream empty as newly constructed.
+	 *
+	 * @return the (buffer, offset, length) tuple of the data, which could
+	 * be passed to McIoWritable::write() directly.
+	 */
+	std::tuple<std::shared_ptr<char>, size_t, size_t> releaseLengthPrefixedData();
+	
 	/// Retrieve the raw data, and the size will be the raw data size.
 	virtual std::tuple<size_t, const char*> rawData() const 
 		{ return std::make_tuple(buffer.size() - 5, buffer.data() + 5); }
@@ -66,4 +86,7 @@ public:
 	/// Retrieve the length-prefixed data, where the size returned will 
 	/// be the length of that prefixed data.
 	virtual std::tuple<size_t, const char*> lengthPrefixedData() const;
+	
+	/// Retrieve the number of bytes written.
+	size_t size() const noexcept { return buffer.size() - 5; }
 };
\ No newline at end of file
@@ -36,6 +36,7 @@
  */
 #include <string>
 #include <list>
+#include <vector>
 #include "libminecraft/union.hpp"
 #include "libminecraft/iobase.hpp"
 
@@ -192,6 +193,17 @@ enum McDtChatDecorationFlag {
 	dcDisable = 2		///< When false is specified to the decoration.
 };
 
+/// The siblings of the chat compound. The siblings are stored in the doubly
+/// linked list by default, and they could be stored contiguously in the vector 
+/// for better cache locality while walking the tree by defining the macro
+/// LIBMC_CHAT_FLAT_LAYOUT (the library and its users must agree on it).
+struct McDtChatCompound;
+#ifdef LIBMC_CHAT_FLAT_LAYOUT
+typedef std::vector<McDtChatCompound> McDtChatCompoundList;
+#else
+typedef std::list<McDtChatCompound> McDtChatCompoundList;
+#endif
+
 /// Making up the final chat compound class.
 struct McDtChatCompound {
 	McDtChatDecorationFlag bold          : 2;	///< Whether modified by bold decoration.
@@ -218,12 +230,12 @@ struct McDtChatCompound {
 	/// The siblings of the current chat compond. Siblings will inherit the 
 	/// decoration and colors of their parents. 
 	/// The size of extra is always unknown while serializing, so for efficiently
-	/// implementation of I/O method, extra is designed to be a doubly-linked list.
-	/// (So is the translate's with array).
-	std::list<McDtChatCompound> extra;
+	/// implementation of I/O method, extra is designed to be a doubly-linked list
+	/// unless the flat layout is enabled. (So is the translate's with array).
+	McDtChatCompoundList extra;
 	
 	/// Only useful when chat trait is with, storing the translation data.
-	std::list<McDtChatCompound> with;
+	McDtChatCompoundList with;
 };
 
 // The I/O methods for reading and writing an McDtChatCompound. Please notice 
@@ -239,9 +251,81 @@ struct McDtChatCompound {
  */
 void McIoReadChatCompound(McIoInputStream& inputStream, McDtChatCompound& compound, 
 			size_t expectedSize, bool tolerant = false, bool autoCompact = true);
+
+/**
+ * Read the chat compound data in situ from the contiguous buffer, the json
+ * inside the buffer will be overwritten while parsing.
+ *
+ * @param[inout] buffer the buffer holding the json.
+ * @param[in] size the size of the json portion in the buffer.
+ * @param[out] compound the output compound data.
+ * @param[in] tolerant whether the parsing mode is tolerants.
+ * @param[in] autoCompact whether performing compact in place is enabled.
+ */
+void McIoReadChatCompound(char* buffer, size_t size, McDtChatCompound& compound,
+			bool tolerant = false, bool autoCompact = true);
 void McIoWriteChatCompound(McIoOutputStream& outputStream,
 			const McDtChatCompound& compound);
 
+/// Serialize the chat compound as json, appending to the string.
+void McIoWriteChatCompound(std::string& json, const McDtChatCompound& compound);
+
+/**
+ * @brief The frozen chat component, which caches its serialized json.
+ *
+ * The chat component sent repeatedly (e.g. broadcast chat, scoreboard and
+ * boss bar) could be frozen once, and writing the frozen component only
+ * copies the cached json without walking and escaping the tree again. The
+ * output is identical to writing the mc::chat.
+ */
+class McDtChatFrozen {
+	/// The serialized json of the component.
+	std::string serialized;
+	friend class McDtChatTemplate;
+public:
+	/// Freeze the empty text component.
+	McDtChatFrozen();
+	
+	/// Freeze the chat compound by serializing it.
+	McDtChatFrozen(const McDtChatCompound& compound);
+	
+	/// Retrieve the serialized json.
+	const std::string& json() const noexcept { return serialized; }
+	
+	/// Write the length prefixed json to the stream, as mc::chat does.
+	McIoOutputStream& write(McIoOutputStream& outputStream) const;
+};
+
+/**
+ * @brief The chat template, which is the serialized chat component with
+ * placeholder slots to patch in.
+ *
+ * The slots are placed in the strings of the chat compound by slot(), and 
+ * rendering the template fills the slots with the arguments, escaping only
+ * the arguments while the rest of the json is copied as is.
+ */
+class McDtChatTemplate {
+	/// The json segments between the slots.
+	std::vector<std::string> segments;
+	
+	/// The argument index of the slots.
+	std::vector<size_t> slots;
+public:
+	/// The maximum number of slots.
+	static const size_t maxSlots = 32;
+	
+	/// Retrieve the placeholder of the slot filled by the index-th argument,
+	/// which could be placed in any string or concatenated with other strings.
+	static std::u16string slot(size_t index);
+	
+	/// Compile the chat compound containing the slot placeholders.
+	McDtChatTemplate(const McDtChatCompound& compound);
+	
+	/// Fill the slots with the arguments, throwing std::runtime_error when 
+	/// an argument is not specified.
+	McDtChatFrozen render(const std::vector<std::u16string>& arguments) const;
+};
+
 // Forward namespace definitions for mc::chat and mc::chatcolor.
 class McDtFlavourChatCompound;
 namespace mc {
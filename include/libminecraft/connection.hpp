@@ -12,6 +12,7 @@
 #include "libminecraft/stream.hpp"
 #include "libminecraft/markable.hpp"
 #include "libminecraft/writable.hpp"
+#include "libminecraft/bufstream.hpp"
 
 class McIoConnection : public McIoDescriptor, public McIoWritable {
 public:
@@ -36,13 +37,121 @@ public:
 	 * which intends to cause the server to allocate a great chunk of data.
 	 *
 	 * @param[in] newSize the newly updated maximum packet size. When the 
-	 * size is set to 0, it means no packet size checking is performed.
+	 * size is set to 0, it means no packet size checking is performed, 
+	 * except that the compressed packets are still limited to inflate
+	 * into no more than 2^23 bytes, as the vanilla protocol does.
 	 */
 	void setMaximumPacketSize(size_t newSize);
 	
 	/// @brief Retrieve current packet size restriction.
 	size_t getMaximumPacketSize() const;
 	
+	/**
+	 * @brief Set the size of data that will be read from the socket at once.
+	 * The read chunk size is initially set to defaultReadChunkSize, so the
+	 * bulk reading is disabled until it is opted in.
+	 *
+	 * With a positive chunk size, the connection reads up to that many bytes
+	 * in one read() call, and handles every complete packet inside in one
+	 * handle() invocation of the descriptor. The chunk buffer is shared by 
+	 * all connections on the same thread.
+	 *
+	 * @param[in] newSize the newly updated read chunk size. When the size is
+	 * set to 0, the length prefix and data of each packet are read separately.
+	 */
+	void setReadChunkSize(size_t newSize);
+	
+	/// @brief Retrieve current read chunk size.
+	size_t getReadChunkSize() const;
+	
+	/// The default read chunk size of the connection, 0 for disabled.
+	static const size_t defaultReadChunkSize = 0;
+	
+	/**
+	 * @brief Set the compression threshold of the connection, which should
+	 * be invoked right after the "Set Compression" packet is sent or received.
+	 * The compression is initially disabled.
+	 *
+	 * When compression is enabled, inbound packets are inflated before being
+	 * passed to the handle() method, and outbound packets written through
+	 * writePacket() are deflated if their size is not less than the threshold.
+	 * The underlying zlib streams are kept and reused by the connection.
+	 *
+	 * @param[in] newThreshold the newly updated compression threshold. When 
+	 * the threshold is negative, compression is disabled.
+	 * @throw std::runtime_error when the zlib streams cannot be initialized.
+	 */
+	void setCompressionThreshold(int newThreshold);
+	
+	/// @brief Retrieve current compression threshold, negative if disabled.
+	int getCompressionThreshold() const;
+	
+	/**
+	 * @brief Enable the AES/CFB8 encryption of the connection, which should
+	 * be invoked right after the "Encryption Response" packet is received
+	 * (or sent), and could not be disabled then.
+	 *
+	 * When encryption is enabled, inbound data is decrypted right after 
+	 * being read, before the packets are framed and inflated, and outbound 
+	 * packets written through writePacket() are encrypted after being framed
+	 * and deflated. The packets taken over are encrypted in place, and the 
+	 * other data (including the broadcast packets and the data passed to
+	 * write() directly) is encrypted into a scratch buffer shared by all 
+	 * connections on the same thread, see McIoWritable::setWriteCipher(). 
+	 * The sendfile() throws since then, as the file could not be encrypted.
+	 *
+	 * @param[in] sharedSecret the shared secret, used as both the key and 
+	 * the initial vector.
+	 * @param[in] size the size of the shared secret, which must be 16.
+	 * @throw std::runtime_error when the shared secret is malformed, or the
+	 * encryption has already been enabled.
+	 */
+	void enableEncryption(const char* sharedSecret, size_t size);
+	
+	/// @brief Retrieve whether the encryption has been enabled.
+	bool isEncryptionEnabled() const;
+	
+	/**
+	 * @brief Write a packet prepared in the buffer output stream, the packet
+	 * will be length prefixed (and compressed, depending on the compression 
+	 * threshold) before being sent.
+	 *
+	 * @param[in] packet the buffer storing the packet id and packet data.
+	 */
+	void writePacket(const McIoBufferOutputStream& packet);
+	
+	/**
+	 * @brief Write a packet prepared in the buffer output stream, taking
+	 * over its buffer so that the packet is queued without being copied
+	 * when compression is disabled. The stream is left empty.
+	 *
+	 * @param[in] packet the buffer storing the packet id and packet data.
+	 */
+	void writePacket(McIoBufferOutputStream&& packet);
+	
+	/**
+	 * @brief Write a packet that has been framed as broadcast packet.
+	 *
+	 * @param[in] packet the broadcast packet, which must be framed with
+	 * the compression threshold of this connection.
+	 * @throw std::runtime_error when the compression threshold mismatches.
+	 */
+	void writePacket(const McIoBroadcastPacket& packet);
+	
+	/// The statistics of the connection.
+	struct McIoConnectionStats {
+		uint64_t bytesRead;         ///< Bytes read from the socket.
+		uint64_t packetsRead;       ///< Packets dispatched to handle().
+		uint64_t packetsWritten;    ///< Packets written by writePacket().
+	};
+	
+	/**
+	 * @brief Retrieve the statistics of the connection, which must be called 
+	 * on the thread of its multiplexer. The statistics are always zero when 
+	 * the metrics are disabled. See also writableStats() for the bytes written.
+	 */
+	McIoConnectionStats connectionStats() const noexcept;
+	
 	/// The control block size of the underlying data.
 	static const size_t socketControlBlockSize = 128;
 private:
@@ -52,6 +161,9 @@ private:
 	/// @brief Implementation for the handling method.
 	virtual McIoNextStatus handle(McIoEvent& events) override;
 	
+	/// @brief Flush the staged data under corked modes.
+	virtual void handleFlush() override;
+	
 	/**
 	 * @brief When the packet data is prepared, recast the prepared
 	 * data to the concrete handling method.
@@ -36,6 +36,24 @@ struct McOsFutureTask {
 	virtual bool advance() = 0;
 };
 
+/**
+ * @brief The priority classes of the future tasks, the executor services 
+ * regarding the priorities run the tasks of the higher class first.
+ */
+enum McOsFuturePriority {
+	/// The tasks whose results are awaited, e.g. parsing a requested chunk.
+	fpForeground = 0,
+	
+	/// The tasks enqueued without priority.
+	fpNormal,
+	
+	/// The tasks that only soak up the idle time, e.g. destroying an nbt tree.
+	fpBackground,
+	
+	/// The number of priority classes.
+	fpNumPriorities
+};
+
 /**
  * @brief The executor service for executing future tasks.
  *
@@ -50,4 +68,9 @@ struct McOsExecutorService {
 	/// will the task be done and when will the task be done 
 	/// depends purely on underlying implementation.
 	virtual void enqueue(std::unique_ptr<McOsFutureTask>& task) = 0;
+	
+	/// Enqueue a task of certain priority into the executor service.
+	/// The default implementation ignores the priority.
+	virtual void enqueue(std::unique_ptr<McOsFutureTask>& task, 
+			McOsFuturePriority) { enqueue(task); }
 };
\ No newline at end of file
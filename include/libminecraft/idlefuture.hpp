@@ -13,26 +13,161 @@
 #include "libminecraft/future.hpp"
 #include "libminecraft/multiplexer.hpp"
 #include <queue>
+#include <atomic>
+
+/**
+ * @brief The future task queued in the idle executors, with the time it
+ * has been enqueued, so that the delay to its first run could be recorded
+ * into the multiplexer's task latency metrics.
+ */
+struct McIoQueuedFutureTask {
+	std::unique_ptr<McOsFutureTask> task;
+	
+	/// The McIoMetricsClock() when enqueued, zero after the first run.
+	uint64_t enqueued;
+	
+	/// The time spent in advancing the task, in nanoseconds.
+	uint64_t runTime;
+	
+	McIoQueuedFutureTask(std::unique_ptr<McOsFutureTask> task) noexcept:
+		task(std::move(task)), enqueued(McIoMetricsClock()), runTime(0) {}
+	
+	/// Advance the task, recording its latency if it is the first run.
+	bool advance(McIoMultiplexerMetrics* metrics) /*mayThrow*/ {
+		if(enqueued != 0) {
+			if(metrics != nullptr) metrics -> taskLatency.record(
+				(McIoMetricsClock() - enqueued) / 1000);
+			enqueued = 0;
+		}
+		return task -> advance();
+	}
+};
 
 /**
  * @brief Defines the idle future executor service.
  *
+ * The tasks are run by the priority classes, where the tasks in the same
+ * class are advanced in round-robin manner. Each handle() runs the tasks 
+ * for no longer than the time slice, and yields to the other descriptors.
+ * When the time left in the tick of the multiplexer drops below the time
+ * reserve, the tasks are deferred to the next tick, except that the
+ * foreground task still advances once per handle().
+ *
  * This interface is not designed to run under multithread condition, 
  * do not invoke the class from multiple threads.
  */
 class McIoIdleFuture : public McOsExecutorService, public McIoDescriptor {
-	std::queue<std::unique_ptr<McOsFutureTask>> taskQueue;
+	/// The tasks of each priority class.
+	std::queue<McIoQueuedFutureTask> taskQueues[fpNumPriorities];
+	
+	/// The number of tasks in all the classes.
+	size_t numTasks;
+	
+	/// The longest time to run the tasks in one handle(), in nanoseconds.
+	unsigned long timeSlice;
+	
+	/// The time to leave for the other descriptors before the tick ends.
+	unsigned long timeReserve;
+	
+	/// Whether the tasks have been deferred to the next tick.
+	bool deferred;
+	
+	/// Notify the multiplexer to handle the executor.
+	void notify();
+	
+	// Resume the deferred tasks in the next tick.
+	virtual void handleTimeout() override;
 public:
 	McIoIdleFuture();
 	~McIoIdleFuture() noexcept;
 	
-	// The inherited idle interface.
+	// The inherited idle interface, the task is of normal priority.
 	virtual void enqueue(std::unique_ptr<McOsFutureTask>& task) override;
 	
+	// The inherited idle interface with priority.
+	virtual void enqueue(std::unique_ptr<McOsFutureTask>& task, 
+			McOsFuturePriority priority) override;
+	
+	// Handle the event polling when it becomes available.
+	virtual McIoNextStatus handle(McIoEvent& eventFlag) override;
+	
+	// How many tasks's advance() method used to be called each handle cycle,
+	// which is kept for the source compatibility. The tasks are now run 
+	// within the time slice instead, see setTimeSlice().
+	[[deprecated("The tasks are run within the time slice, see setTimeSlice().")]]
+	static const size_t numHandleExecute = 16;
+	
+	/// @brief Retrieve the number of tasks that have not finished.
+	size_t size() const noexcept { return numTasks; }
+	
+	/// @brief Set the longest time to run the tasks in one handle(), in nanoseconds.
+	void setTimeSlice(unsigned long newTimeSlice) noexcept { timeSlice = newTimeSlice; }
+	
+	/// @brief Retrieve the longest time to run the tasks in one handle().
+	unsigned long getTimeSlice() const noexcept { return timeSlice; }
+	
+	/// @brief Set the time left for the other descriptors in each tick, in nanoseconds.
+	void setTimeReserve(unsigned long newTimeReserve) noexcept { timeReserve = newTimeReserve; }
+	
+	/// @brief Retrieve the time left for the other descriptors in each tick.
+	unsigned long getTimeReserve() const noexcept { return timeReserve; }
+	
+	/// The default time slice, which is 1 ms.
+	static const unsigned long defaultTimeSlice = 1000000;
+	
+	/// The default time reserve, which is 5 ms, a tenth of the default tick.
+	static const unsigned long defaultTimeReserve = 5000000;
+};
+
+/**
+ * @brief Defines the concurrent idle future executor service.
+ *
+ * Unlike the McIoIdleFuture, tasks could be enqueued from any threads,
+ * while they are still executed on the multiplexer's thread. The tasks 
+ * are passed through a lock-free multi-producer single-consumer queue,
+ * and the multiplexer is notified only when the consumer has run out 
+ * of tasks, so producers do not contend on the descriptor. The tasks
+ * taken by the consumer are advanced in round-robin manner.
+ */
+class McIoConcurrentFuture : public McOsExecutorService, public McIoDescriptor {
+	/// The node of the multi-producer single-consumer queue.
+	struct node {
+		std::atomic<node*> next;
+		std::unique_ptr<McOsFutureTask> task;
+		uint64_t enqueued;
+	};
+	
+	/// The node most recently enqueued by producers.
+	std::atomic<node*> head;
+	
+	/// The node before the first unconsumed node, only used by consumer.
+	node* tail;
+	
+	/// Whether the consumer is waiting for notification.
+	std::atomic<bool> sleeping;
+	
+	/// The number of producers linking their nodes, which is increased
+	/// before they notify, so the consumer does not wait for the nodes.
+	std::atomic<size_t> enqueuing;
+	
+	/// The tasks taken by the consumer but unfinished.
+	std::queue<McIoQueuedFutureTask> taskQueue;
+	
+	/// Take the tasks enqueued by producers into the task queue.
+	void take();
+public:
+	McIoConcurrentFuture();
+	~McIoConcurrentFuture() noexcept;
+	
+	// The inherited idle interface, which is MT-Safe.
+	virtual void enqueue(std::unique_ptr<McOsFutureTask>& task) override;
+	
+	// The tasks are run in FIFO order, so the priority is ignored.
+	using McOsExecutorService::enqueue;
+	
 	// Handle the event polling when it becomes available.
 	virtual McIoNextStatus handle(McIoEvent& eventFlag) override;
 	
 	// How many tasks's advance() method will be called each handle cycle.
-	// The number is set to avoid too much system call to the multiplexing method.
 	static const size_t numHandleExecute = 16;
 };
\ No newline at end of file
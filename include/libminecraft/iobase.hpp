@@ -25,6 +25,8 @@
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include <cstring>
+#include <type_traits>
 
 /// Data type template placeholder, indicating the underlying 
 /// type should be a fixed length one, usually big endian.
@@ -125,6 +127,58 @@ McIoInputStream& McIoReadUtf16String(McIoInputStream& inputStream,
  */
 McIoOutputStream& McIoWriteUtf16String(McIoOutputStream& outputStream,
 		const std::u16string& outputString);
+
+/**
+ * @brief Retrieve the length of the utf-16 string once encoded as utf-8.
+ * @param[in] source the utf-16 code units.
+ * @param[in] length the number of code units.
+ * @return the number of bytes in utf-8.
+ */
+size_t McIoUtf8Length(const char16_t* source, size_t length) noexcept;
+
+/**
+ * @brief Encode the utf-16 string as utf-8 into the buffer.
+ * @param[in] source the utf-16 code units.
+ * @param[in] length the number of code units.
+ * @param[out] destination the buffer of at least 3 * length bytes.
+ * @return the number of bytes encoded.
+ * @throw std::runtime_error when the utf-16 string is malformed.
+ */
+size_t McIoEncodeUtf8(const char16_t* source, size_t length, char* destination);
+
+/**
+ * @brief Read utf-8 string from the stream (whose byte length is known) and
+ * decode it into the buffer, for strings not stored as std::u16string.
+ * @param[in] inputStream the input stream instance.
+ * @param[in] byteLength the length of byte in the string.
+ * @param[out] destination the buffer of at least byteLength code units.
+ * @return the number of code units decoded.
+ * @throw std::runtime_error when the utf-8 string is malformed.
+ */
+size_t McIoReadUtf16Units(McIoInputStream& inputStream, 
+		size_t byteLength, char16_t* destination);
+
+/**
+ * @brief Read an array of big endian fixed length elements, with a single
+ * read call, and convert them to host endian.
+ * @param[in] inputStream the input stream instance.
+ * @param[out] elements the buffer to hold count elements.
+ * @param[in] count the number of elements to read.
+ * @note U must be one of uint8_t, uint16_t, uint32_t and uint64_t.
+ */
+template<typename U> void McIoReadFixedArray(
+		McIoInputStream& inputStream, U* elements, size_t count);
+
+/**
+ * @brief Write an array of host endian fixed length elements as big
+ * endian, with a few large write calls.
+ * @param[in] outputStream the output stream instance.
+ * @param[in] elements the elements to write.
+ * @param[in] count the number of elements to write.
+ * @note U must be one of uint8_t, uint16_t, uint32_t and uint64_t.
+ */
+template<typename U> void McIoWriteFixedArray(
+		McIoOutputStream& outputStream, const U* elements, size_t count);
 		
 /**
  * @brief Convert from a string with locale imbued to an utf-16 string.
@@ -229,18 +283,71 @@ public:
 };
 
 /**
- * Template partial specialization for std::vector<V> as internal data, and L
- * as prefixed length. which is the storage form of mc::array<V, L>.
+ * @brief Whether the vector of V could be read and written as a whole, 
+ * which is true for the fixed length primitives, whose only member is the
+ * underlying data. The wordType is the unsigned integer of the same size.
+ */
+template<typename V> struct McDtBulkTraits : std::false_type {};
+
+template<typename T> struct McDtBulkTraits<McDtDataType<T, McDtFlavourFixed>> 
+	: std::true_type {
+	typedef typename std::conditional<sizeof(T) == 1, uint8_t,
+		typename std::conditional<sizeof(T) == 2, uint16_t,
+		typename std::conditional<sizeof(T) == 4, uint32_t,
+		uint64_t>::type>::type>::type wordType;
+	static_assert(sizeof(McDtDataType<T, McDtFlavourFixed>) == sizeof(wordType),
+		"The fixed length data type must have the size of its data.");
+};
+
+/// Read length elements into the vector one by one.
+template<typename V, typename A> inline void McIoReadElements(McIoInputStream& inputStream,
+		std::vector<V, A>& elements, size_t length, std::false_type) {
+	elements.reserve(length);
+	for(size_t i = 0; i < length; ++ i) {
+		V value;
+		value.read(inputStream);
+		elements.push_back(std::move(value));
+	}
+}
+
+/// Read length elements into the vector in bulk.
+template<typename V, typename A> inline void McIoReadElements(McIoInputStream& inputStream,
+		std::vector<V, A>& elements, size_t length, std::true_type) {
+	typedef typename McDtBulkTraits<V>::wordType wordType;
+	elements.resize(length);
+	if(length > 0) McIoReadFixedArray<wordType>(inputStream,
+		reinterpret_cast<wordType*>(elements.data()), length);
+}
+
+/// Write elements of the vector one by one.
+template<typename V, typename A> inline void McIoWriteElements(McIoOutputStream& outputStream,
+		const std::vector<V, A>& elements, std::false_type) {
+	for(auto iter = elements.begin(); iter != elements.end(); ++ iter) 
+		iter -> write(outputStream);
+}
+
+/// Write elements of the vector in bulk.
+template<typename V, typename A> inline void McIoWriteElements(McIoOutputStream& outputStream,
+		const std::vector<V, A>& elements, std::true_type) {
+	typedef typename McDtBulkTraits<V>::wordType wordType;
+	if(elements.size() > 0) McIoWriteFixedArray<wordType>(outputStream, 
+		reinterpret_cast<const wordType*>(elements.data()), elements.size());
+}
+
+/**
+ * Template partial specialization for std::vector<V, A> as internal data, and L
+ * as prefixed length. which is the storage form of mc::array<V, L>. The read
+ * elements are allocated by the allocator of the array.
  *
  * Documents are omitted, see the most general McDtDataType for interface
  * description.
  */
-template<typename V, typename L>
-class McDtDataType<std::vector<V>, McDtFlavourArray<L>> {
-	std::vector<V> data;
+template<typename V, typename A, typename L>
+class McDtDataType<std::vector<V, A>, McDtFlavourArray<L>> {
+	std::vector<V, A> data;
 public:
 	// The helper type definitions.
-	typedef std::vector<V> type;
+	typedef std::vector<V, A> type;
 	typedef V componentType;
 	typedef McDtFlavourArray<L> flavour;
 	typedef typename L::type lengthType;
@@ -249,16 +356,16 @@ public:
 
 	// The specialization functions.
 	McDtDataType(): data() {}
-	McDtDataType(const std::vector<V>& data): data(data) {}
-	McDtDataType(std::vector<V>&& data) noexcept: data(std::move(data)) {}
-	inline operator const std::vector<V>&() const { return data; }
-	inline operator std::vector<V>&&() { return std::move(data); }
+	McDtDataType(const type& data): data(data) {}
+	McDtDataType(type&& data) noexcept: data(std::move(data)) {}
+	inline operator const type&() const { return data; }
+	inline operator type&&() { return std::move(data); }
 	template<typename U>
-	inline McDtDataType& operator=(const McDtDataType<std::vector<V>, U>& a) 
-			{	data = (const std::vector<V>&)a; return *this; }
+	inline McDtDataType& operator=(const McDtDataType<type, U>& a) 
+			{	data = (const type&)a; return *this; }
 	template<typename U>
-	inline McDtDataType& operator=(McDtDataType<std::vector<V>, U>&& a) noexcept
-			{	data = (std::vector<V>&&)a; return *this; }
+	inline McDtDataType& operator=(McDtDataType<type, U>&& a) noexcept
+			{	data = (type&&)a; return *this; }
 	
 	// The array operator.
 	inline V& operator[](size_t idx) { return data[idx]; }
@@ -273,19 +380,16 @@ public:
 		if(lengthValue < 0) throw std::runtime_error(
 			"The array length has negative length.");
 		
-		// Read the elements inside the array.
+		// Read the elements inside the array, the fixed length elements
+		// are read in bulk.
 		size_t length =	(size_t)lengthValue;
-		std::vector<V> readData(0);
-		readData.reserve(length);
-		for(size_t i = 0; i < length; ++ i) {
-			V value;
-			value.read(inputStream);
-			readData.push_back(std::move(value));
-		}
+		type readData(data.get_allocator());
+		McIoReadElements(inputStream, readData, length, McDtBulkTraits<V>());
 		
 		// Swap with the internal data.
 		using std::swap;
 		swap(data, readData);
+		return inputStream;
 	}
 	
 	/// The output method that writes data to the output stream.
@@ -298,8 +402,8 @@ public:
 		writeArrayLength.write(outputStream);
 		
 		// Write the elements inside the array.
-		for(auto iter = data.begin(); iter != data.end(); ++ iter) 
-			iter -> write(outputStream);
+		McIoWriteElements(outputStream, data, McDtBulkTraits<V>());
+		return outputStream;
 	}
 };
 	
@@ -377,6 +481,147 @@ using array = McDtDataType<std::vector<V>, McDtFlavourArray<L> >;
 
 };	// End of namespace mc.
 
+/**
+ * @brief Decode the big endian unsigned integer from the bytes.
+ *
+ * The loop is fully unrolled and usually compiled into single load and
+ * byte swap, so it is not required to include platform specific headers.
+ */
+template<typename U> inline U McIoLoadBigEndian(const char* bytes) {
+	U value = 0;
+	for(size_t i = 0; i < sizeof(U); ++ i) 
+		value = (U)((value << 8) | (unsigned char)bytes[i]);
+	return value;
+}
+
+/// Encode the unsigned integer as big endian, returning the end of bytes.
+template<typename U> inline char* McIoStoreBigEndian(char* bytes, U value) {
+	for(size_t i = sizeof(U); i > 0; -- i) {
+		bytes[i - 1] = (char)(value & 0x0ff);
+		value = (U)(value >> 4 >> 4);
+	}
+	return bytes + sizeof(U);
+}
+
+/// Retrieve the number of bytes of the variant length integer.
+template<typename U> inline size_t McIoVariantSize(U value) {
+	size_t size = 1;
+	while(value >= 0x080) { value = (U)(value >> 7); ++ size; }
+	return size;
+}
+
+/// Encode the variant length integer, returning the end of bytes. The
+/// bytes are identical to the mc::var32 and mc::var64 write methods.
+template<typename U> inline char* McIoStoreVariant(char* bytes, U value) {
+	while(value >= 0x080) {
+		*bytes ++ = (char)((value & 0x07f) | 0x080);
+		value = (U)(value >> 7);
+	}
+	*bytes ++ = (char)value;
+	return bytes;
+}
+
+/**
+ * @brief Read the fixed length big endian data, where T is the data type and 
+ * U is the unsigned integer type of the same size.
+ *
+ * The data is decoded from the window of the stream when the window holds
+ * the complete data, with only one boundary check.
+ */
+template<typename T, typename U> inline T McIoReadFixed(McIoInputStream& inputStream) {
+	static_assert(sizeof(T) == sizeof(U), "The data type and integer size mismatch.");
+	char bytes[sizeof(U)];
+	const char* source = bytes;
+	if(inputStream.windowSize() >= sizeof(U)) {
+		source = inputStream.window();
+		inputStream.consume(sizeof(U));
+	}
+	else inputStream.read(bytes, sizeof(U));
+	
+	U value = McIoLoadBigEndian<U>(source);
+	T result; memcpy(&result, &value, sizeof(U));
+	return result;
+}
+
+/**
+ * @brief Read the variant length integer of at most maxLength bytes, whose 
+ * last byte must not exceed msbmax.
+ *
+ * When there're at least 8 bytes in the window, the integer is decoded 
+ * from a single word: the terminating byte is located by the cleared most
+ * significant bits, and the 7-bit groups are packed by three shift-masks. 
+ * Otherwise the integer is read byte by byte.
+ *
+ * @throw std::runtime_error when the integer is malformed.
+ */
+template<typename T, size_t maxLength, unsigned msbmax>
+inline T McIoReadVariant(McIoInputStream& inputStream) {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if(inputStream.windowSize() >= sizeof(uint64_t)) {
+		uint64_t word; memcpy(&word, inputStream.window(), sizeof(word));
+		uint64_t stops = ~word & 0x8080808080808080ull;
+		size_t length = (__builtin_ctzll(stops | (1ull << 63)) >> 3) + 1;
+		if(stops != 0 && length <= maxLength && (length < maxLength ||
+			(unsigned char)inputStream.window()[maxLength - 1] <= msbmax)) {
+			
+			// Keep the bytes until the terminating one, then pack the groups.
+			uint64_t lowest = stops & (~stops + 1);
+			uint64_t value = word & ((lowest << 1) - 1) & 0x7f7f7f7f7f7f7f7full;
+			value = (value & 0x007f007f007f007full) | ((value & 0x7f007f007f007f00ull) >> 1);
+			value = (value & 0x00003fff00003fffull) | ((value & 0x3fff00003fff0000ull) >> 2);
+			value = (value & 0x000000000fffffffull) | ((value & 0x0fffffff00000000ull) >> 4);
+			inputStream.consume(length);
+			return (T)value;
+		}
+	}
+#endif
+	uint64_t value = 0;
+	for(size_t i = 0; i < maxLength; ++ i) {
+		// Retrieve current byte.
+		unsigned char current;
+		inputStream.readFast((char*)&current, 1);
+		value |= ((uint64_t)current & 0x07f) << (i * 7);
+		
+		// Analyze and determine whether to continue.
+		if(i == maxLength - 1) {
+			if(current > msbmax) throw std::runtime_error(
+				"Malformed variant integer value.");
+		}
+		else if((current & 0x80) == 0) break;
+	}
+	return (T)value;
+}
+
+// Inline instantiation of the primitive data types' input methods.
+#define McDtDataTypeReadFixed(dataType, T, U)\
+template<> inline McIoInputStream& dataType::read(McIoInputStream& inputStream) {\
+	data = McIoReadFixed<T, U>(inputStream);\
+	return inputStream;\
+}
+McDtDataTypeReadFixed(mc::s8,  int8_t,   uint8_t)
+McDtDataTypeReadFixed(mc::u8,  uint8_t,  uint8_t)
+McDtDataTypeReadFixed(mc::s16, int16_t,  uint16_t)
+McDtDataTypeReadFixed(mc::u16, uint16_t, uint16_t)
+McDtDataTypeReadFixed(mc::s32, int32_t,  uint32_t)
+McDtDataTypeReadFixed(mc::u32, uint32_t, uint32_t)
+McDtDataTypeReadFixed(mc::s64, int64_t,  uint64_t)
+McDtDataTypeReadFixed(mc::u64, uint64_t, uint64_t)
+McDtDataTypeReadFixed(mc::f32, float,    uint32_t)
+McDtDataTypeReadFixed(mc::f64, double,   uint64_t)
+#undef McDtDataTypeReadFixed
+
+/// The inline implementation of reading mc::var32.
+template<> inline McIoInputStream& mc::var32::read(McIoInputStream& inputStream) {
+	data = McIoReadVariant<int32_t, 5, 15>(inputStream);
+	return inputStream;
+}
+
+/// The inline implementation of reading mc::var64.
+template<> inline McIoInputStream& mc::var64::read(McIoInputStream& inputStream) {
+	data = McIoReadVariant<int64_t, 10, 1>(inputStream);
+	return inputStream;
+}
+
 /// The implementation of reading mc::ustring with max length constrain.
 template<size_t maxLength> inline McIoInputStream& 
 mc::ustring<maxLength>::read(McIoInputStream& inputStream) {
@@ -0,0 +1,152 @@
+#pragma once
+/**
+ * @file libminecraft/metrics.hpp
+ * @brief I/O Metrics
+ * @author Haoran Luo
+ *
+ * Defines the counters and histograms updated on the hot paths of the
+ * multiplexer, the connections and the writables, and their snapshots.
+ *
+ * Each multiplexer owns its metrics, which are only updated on the thread
+ * of the multiplexer. So an update is a relaxed atomic load and store rather
+ * than a locked read-modify-write, while the snapshot could be taken from
+ * any thread (e.g. the thread serving the scraper) without locking the loop.
+ *
+ * The metrics are compiled in by default, when LIBMC_NO_METRICS is defined
+ * (by turning off the LIBMC_METRICS CMake option), the updates are no-ops
+ * and the snapshots are always zero.
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+/// Whether the metrics are compiled in.
+#ifdef LIBMC_NO_METRICS
+static constexpr bool McIoMetricsEnabled = false;
+#else
+static constexpr bool McIoMetricsEnabled = true;
+#endif
+
+/// Retrieve the monotonic timestamp in nanoseconds, or 0 if metrics are disabled.
+inline uint64_t McIoMetricsClock() noexcept {
+	if(!McIoMetricsEnabled) return 0;
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// @brief The counter or gauge updated by one thread and read by any thread.
+class McIoMetricCounter {
+	std::atomic<uint64_t> value;
+public:
+	McIoMetricCounter() noexcept: value(0) {}
+
+	/// Increase the counter.
+	void add(uint64_t delta = 1) noexcept {
+		if(McIoMetricsEnabled) value.store(value.load(
+			std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+	}
+
+	/// Set the gauge.
+	void set(uint64_t newValue) noexcept {
+		if(McIoMetricsEnabled) value.store(newValue, std::memory_order_relaxed);
+	}
+
+	/// Raise the high-water mark to the value if it is higher.
+	void raise(uint64_t newValue) noexcept {
+		if(McIoMetricsEnabled && newValue > value.load(std::memory_order_relaxed))
+			value.store(newValue, std::memory_order_relaxed);
+	}
+
+	/// Retrieve the value, from any thread.
+	uint64_t load() const noexcept { return value.load(std::memory_order_relaxed); }
+};
+
+/// The number of buckets in the histograms.
+static const size_t McIoMetricHistogramBuckets = 24;
+
+/// @brief The snapshot of the histogram.
+struct McIoMetricHistogramSnapshot {
+	uint64_t count;                                 ///< Number of values recorded.
+	uint64_t sum;                                   ///< Sum of values recorded.
+	uint64_t buckets[McIoMetricHistogramBuckets];   ///< Non-cumulative bucket counts.
+
+	/**
+	 * @brief Retrieve the inclusive upper bound of the bucket. The bucket i
+	 * counts the values from 2^(i-1) to 2^i - 1, and the last bucket also
+	 * counts all the larger values.
+	 */
+	static uint64_t upperBound(size_t bucket) noexcept {
+		return bucket + 1 < McIoMetricHistogramBuckets?
+			((uint64_t)1 << bucket) - 1 : UINT64_MAX;
+	}
+
+	/// Merge the other snapshot into this one.
+	void merge(const McIoMetricHistogramSnapshot& other) noexcept;
+};
+
+/// @brief The histogram with power of two buckets, see McIoMetricCounter.
+class McIoMetricHistogram {
+	McIoMetricCounter count, sum;
+	McIoMetricCounter buckets[McIoMetricHistogramBuckets];
+public:
+	/// Record the value into the histogram.
+	void record(uint64_t value) noexcept {
+		if(!McIoMetricsEnabled) return;
+		size_t bucket = value == 0? 0 : 64 - __builtin_clzll(value);
+		if(bucket >= McIoMetricHistogramBuckets) bucket = McIoMetricHistogramBuckets - 1;
+		buckets[bucket].add();
+		count.add();
+		sum.add(value);
+	}
+
+	/// Retrieve the snapshot of the histogram, from any thread.
+	McIoMetricHistogramSnapshot snapshot() const noexcept;
+};
+
+/// @brief The snapshot of the multiplexer metrics, see McIoMultiplexerMetrics.
+struct McIoMultiplexerMetricsSnapshot {
+	uint64_t ticks, tickOverruns, missedTicks;
+	McIoMetricHistogramSnapshot tickBusyTime, tickSyscalls;
+	uint64_t rounds, syscalls, events, handles, flushes, timeouts;
+	uint64_t descriptors, activeDescriptors;
+	uint64_t bytesIn, bytesOut, packetsIn, packetsOut;
+	uint64_t writeQueueHighWater;
+	McIoMetricHistogramSnapshot taskLatency, taskRunTime;
+	uint64_t taskDeferrals;
+
+	/// Merge the snapshot of another multiplexer, where the counters and
+	/// gauges are summed and the high-water marks are maximized.
+	void merge(const McIoMultiplexerMetricsSnapshot& other) noexcept;
+};
+
+/**
+ * @brief The metrics of a multiplexer and the descriptors it manages, see
+ * McIoMultiplexer::metrics().
+ */
+struct McIoMultiplexerMetrics {
+	McIoMetricCounter ticks;                ///< Number of execute() completed.
+	McIoMetricCounter tickOverruns;         ///< Ticks busy for longer than the timeout.
+	McIoMetricCounter missedTicks;          ///< Timer expirations missed by late ticks.
+	McIoMetricHistogram tickBusyTime;       ///< Time not waiting for events per tick, in us.
+	McIoMetricHistogram tickSyscalls;       ///< System calls per tick.
+	McIoMetricCounter rounds;               ///< Number of polling rounds.
+	McIoMetricCounter syscalls;             ///< System calls made inside the loop.
+	McIoMetricCounter events;               ///< Events received from polling.
+	McIoMetricCounter handles;              ///< Invocations of the descriptors' handle().
+	McIoMetricCounter flushes;              ///< Invocations of the descriptors' handleFlush().
+	McIoMetricCounter timeouts;             ///< Invocations of the descriptors' handleTimeout().
+	McIoMetricCounter descriptors;          ///< Gauge of the managed descriptors.
+	McIoMetricCounter activeDescriptors;    ///< Gauge of descriptors left active by a round.
+	McIoMetricCounter bytesIn;              ///< Bytes read by the connections.
+	McIoMetricCounter bytesOut;             ///< Bytes written by the writables.
+	McIoMetricCounter packetsIn;            ///< Packets dispatched by the connections.
+	McIoMetricCounter packetsOut;           ///< Packets written by the connections.
+	McIoMetricCounter writeQueueHighWater;  ///< High-water of bytes queued in a writable.
+	McIoMetricHistogram taskLatency;        ///< Future tasks' delay to first run, in us.
+	McIoMetricHistogram taskRunTime;        ///< Idle future tasks' total run time, in us.
+	McIoMetricCounter taskDeferrals;        ///< Idle future tasks deferred to next tick.
+
+	/// Retrieve the snapshot of the metrics, from any thread.
+	McIoMultiplexerMetricsSnapshot snapshot() const noexcept;
+};
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+/**
+ * @file libminecraft/mpxgroup.hpp
+ * @brief I/O Multiplexer Group
+ * @author Haoran Luo
+ *
+ * Defines the multiplexer group, which runs a number of multiplexers, each
+ * on its own thread. Each multiplexer still owns its descriptors, and the
+ * descriptors are only handled on the thread of that multiplexer, so the 
+ * threading contract of the McIoDescriptor stays the same.
+ *
+ * New descriptors are handed off to the loops by insert(), which could be
+ * called from any thread. To distribute sockets by the kernel instead, run
+ * a task on every loop with execute(), which creates a listener with 
+ * createReusePortListener() and inserts its acceptor into that loop.
+ */
+#include "libminecraft/multiplexer.hpp"
+#include <functional>
+#include <cstddef>
+
+// For pointer reference in createReusePortListener().
+struct sockaddr;
+
+class McIoMultiplexerGroup {
+public:
+	/// The callback invoked on the loop thread after each tick.
+	typedef std::function<void(size_t index, McIoMultiplexer& multiplexer)> tickHandlerType;
+	
+	/// The task that runs on certain loop thread.
+	typedef std::function<void(McIoMultiplexer& multiplexer)> loopTaskType;
+	
+	/// The group's pimpl block size.
+	static const size_t groupControlBlockSize = 128;
+	
+	/**
+	 * @brief Construct the group of multiplexers, the loops are not 
+	 * running until start() is called.
+	 *
+	 * @param[in] numLoops the number of loops, 0 for one loop per core.
+	 * @param[in] onTick the callback run on the loop after each tick.
+	 */
+	McIoMultiplexerGroup(size_t numLoops = 0, tickHandlerType onTick = tickHandlerType());
+	
+	/// Stop the loops and destroy all multiplexers.
+	~McIoMultiplexerGroup() noexcept;
+	
+	// Copy sematics and move sematics are not allowed.
+	McIoMultiplexerGroup(const McIoMultiplexerGroup&) = delete;
+	McIoMultiplexerGroup& operator=(const McIoMultiplexerGroup&) = delete;
+	McIoMultiplexerGroup(McIoMultiplexerGroup&&) = delete;
+	McIoMultiplexerGroup& operator=(McIoMultiplexerGroup&&) = delete;
+	
+	/// @brief Retrieve the number of loops in the group.
+	size_t size() const noexcept;
+	
+	/**
+	 * @brief Retrieve the multiplexer of certain loop. The multiplexer must
+	 * be used either on its loop thread, or when the group is not running.
+	 */
+	McIoMultiplexer& multiplexer(size_t index);
+	
+	/**
+	 * @brief Retrieve the metrics summed over all loops. This method is 
+	 * MT-Safe, as the metrics of each loop could be read from any thread.
+	 */
+	McIoMultiplexerMetricsSnapshot metrics() const noexcept;
+	
+	/**
+	 * @brief Start running a thread for each loop.
+	 * @throw std::runtime_error when the group is already running.
+	 */
+	void start();
+	
+	/**
+	 * @brief Stop and join the loop threads. Each loop stops after its
+	 * current tick.
+	 *
+	 * @throw the first exception that has stopped a loop, if any.
+	 */
+	void stop();
+	
+	/**
+	 * @brief Hand off a descriptor to the loops in round-robin manner. 
+	 * This method is MT-Safe.
+	 *
+	 * The descriptor will be inserted on the loop thread, and it will be 
+	 * destroyed if it cannot be inserted.
+	 *
+	 * @param[inout] descriptor the descriptor, which is moved once handed off.
+	 * @throw std::runtime_error when the loop cannot be notified, and the
+	 * descriptor continues to manage the object then.
+	 */
+	void insert(std::unique_ptr<McIoDescriptor>& descriptor);
+	
+	/// @brief Hand off a descriptor to certain loop. This method is MT-Safe.
+	void insert(size_t index, std::unique_ptr<McIoDescriptor>& descriptor);
+	
+	/**
+	 * @brief Run the task on the thread of certain loop. This method is
+	 * MT-Safe, and exceptions thrown by the task are ignored.
+	 *
+	 * @param[in] index the loop to run the task.
+	 * @param[in] task the task to run.
+	 */
+	void execute(size_t index, loopTaskType task);
+	
+	/**
+	 * @brief Create a non-blocking listening socket with SO_REUSEPORT set, 
+	 * so that each loop could listen on the same address and the kernel 
+	 * distributes the connections among them.
+	 *
+	 * @param[in] address the address to bind.
+	 * @param[in] addressLength the length of the address.
+	 * @param[in] backlog the backlog of the listening socket.
+	 * @return the listening socket.
+	 * @throw std::runtime_error when the socket cannot be created.
+	 */
+	static int createReusePortListener(const struct sockaddr* address, 
+			size_t addressLength, int backlog = 128);
+private:
+	/// The pointer-to-impl of the group.
+	char control[groupControlBlockSize];
+};
\ No newline at end of file
@@ -12,10 +12,17 @@
  * which encapsulates logic related to the descriptor, and manages resource for the
  * descriptor.
  *
- * @warning Neither multiplexer nor file descriptor is thread-safe, and there's no 
- * need for multi-threading in minecraft.
+ * @warning Neither multiplexer nor file descriptor is thread-safe. To run I/O on 
+ * multiple threads, use one multiplexer per thread, see libminecraft/mpxgroup.hpp.
  */
+#include "libminecraft/bufpool.hpp"
+#include "libminecraft/metrics.hpp"
 #include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
 
 /**
  * @brief Defines event flags for I/O events that might be registered to and 
@@ -90,6 +97,31 @@ public:
 	/// The class should be pure virtual and so is destructor.
 	virtual ~McIoDescriptor() noexcept;
 	
+	/**
+	 * @brief The allocation functions of the descriptors, which are inherited
+	 * by every derived class not defining its own.
+	 *
+	 * The descriptors small enough for the slab of a multiplexer (see 
+	 * McIoMultiplexer::emplace()) are allocated with a header recording 
+	 * whether they come from the heap or the slab, so that they are deleted
+	 * in the same way. The larger and the over-aligned descriptors never
+	 * come from the slab, and are allocated by the global operator new()
+	 * without the header. The sized deallocation tells them apart, so the
+	 * descriptors must be deleted through their virtual destructor.
+	 */
+	static void* operator new(size_t size);
+	static void operator delete(void* descriptor, size_t size) noexcept;
+#ifdef __cpp_aligned_new
+	static void* operator new(size_t size, std::align_val_t alignment)
+		{	return ::operator new(size, alignment);	}
+	static void operator delete(void* descriptor, size_t, std::align_val_t alignment) noexcept
+		{	::operator delete(descriptor, alignment);	}
+#endif
+	
+	/// The placement allocation functions, which are hidden otherwise.
+	static void* operator new(size_t, void* place) noexcept { return place; }
+	static void operator delete(void*, void*) noexcept {}
+	
 	/// @brief Retrieve the multiplexer managing this file descriptor.
 	McIoMultiplexer& getMultiplexer() const;
 	
@@ -107,9 +139,45 @@ public:
 	 * @param newFlag the I/O flag to update.
 	 */
 	void updateEventFlag(McIoEvent newFlag);
+	
+	/**
+	 * @brief Request the multiplexer to invoke handleFlush() on this descriptor
+	 * at the end of current dispatch round, before the multiplexer polls again.
+	 *
+	 * Requesting more than once in a round causes handleFlush() to be invoked
+	 * only once. This method is NOT MT-Safe, just like updateEventFlag().
+	 */
+	void requestFlush() noexcept;
+	
+	/**
+	 * @brief Schedule handleTimeout() to be invoked after certain number of 
+	 * ticks of the multiplexer, replacing the previously scheduled timeout.
+	 *
+	 * The timeouts are held in the timer wheel of the multiplexer, which is
+	 * driven by its timer, so scheduling, rescheduling and cancelling costs
+	 * neither descriptors nor system calls. The timeout scheduled before the
+	 * descriptor is inserted starts counting when it is inserted. This method
+	 * is NOT MT-Safe, just like updateEventFlag().
+	 *
+	 * @param[in] ticks the number of ticks, in unit of currentTimeout(), where
+	 * 0 is regarded as 1, the end of next tick.
+	 */
+	void scheduleTimeout(uint64_t ticks) noexcept;
+	
+	/// @brief Cancel the scheduled timeout, if there's one.
+	void cancelTimeout() noexcept;
+	
+	/// @brief Retrieve whether a timeout has been scheduled and not expired.
+	bool hasTimeout() const noexcept;
+	
+	/**
+	 * @brief Retrieve the metrics of the multiplexer managing this descriptor,
+	 * or null if the descriptor has not been inserted into a multiplexer.
+	 */
+	McIoMultiplexerMetrics* metrics() const noexcept;
 
 	/// The descriptor control block size.
-	static const size_t descriptorControlBlockSize = 64;
+	static const size_t descriptorControlBlockSize = 128;
 private:
 	/// @brief The control field used by the I/O multiplexer.
 	/// The control field that is platform dependent and whose details should 
@@ -148,6 +216,28 @@ private:
 	 * @return the new status for the descriptor.
 	 */
 	virtual McIoNextStatus handle(McIoEvent& eventFlag) = 0;
+	
+	/**
+	 * @brief Handles the flush request made by requestFlush().
+	 *
+	 * The descriptor might be either polling or active while this method is
+	 * invoked. If an exception is thrown from this method, the descriptor
+	 * will be removed from the multiplexer. The default implementation does
+	 * nothing.
+	 */
+	virtual void handleFlush() {}
+	
+	/**
+	 * @brief Handles the timeout scheduled by scheduleTimeout().
+	 *
+	 * The expired timeouts are handled at the end of the tick, after the 
+	 * descriptors have been handled and before they are flushed, and the 
+	 * descriptor might be either polling or active. The timeout could be 
+	 * scheduled again inside this method. If an exception is thrown from 
+	 * this method, the descriptor will be removed from the multiplexer. The
+	 * default implementation does nothing.
+	 */
+	virtual void handleTimeout() {}
 };
 
 /**
@@ -156,11 +246,17 @@ private:
 class McIoMultiplexer {
 public:
 	/// The multiplexer's pimpl block size.
-	static const size_t multiplexerControlBlockSize = 128;
+	static const size_t multiplexerControlBlockSize = 640;
 
 	/// The default timeout value for the multiplexer, which is one default tick in minecraft.
 	static const int defaultMinecraftTick = 5e7;
 	
+	/// The minimum (and initial) number of events received by one poll.
+	static const size_t minimumEventBatch = 16;
+	
+	/// The default maximum number of events received by one poll.
+	static const size_t defaultMaximumEventBatch = 1024;
+	
 	// Constructor for the multiplexer.
 	McIoMultiplexer();
 
@@ -189,6 +285,38 @@ public:
 	 */
 	void insert(std::unique_ptr<McIoDescriptor>& descriptor);
 	
+	/**
+	 * @brief Construct the descriptor in the slab of the multiplexer, and
+	 * make the multiplexer manages it.
+	 *
+	 * The slab keeps the blocks freed by the removed descriptors for the 
+	 * later ones of similar size, so the connections accepted and closed in
+	 * a burst cost no heap allocation. The descriptor is destroyed if it 
+	 * cannot be inserted, and the exception is rethrown.
+	 *
+	 * @param[in] args the arguments to construct the descriptor.
+	 * @return the descriptor, which is managed by the multiplexer.
+	 */
+	template<typename descriptorType, typename... argumentsType>
+	descriptorType& emplace(argumentsType&&... args) {
+		static_assert(std::is_base_of<McIoDescriptor, descriptorType>::value,
+			"The emplaced object must be a descriptor.");
+		static_assert(alignof(descriptorType) <= alignof(std::max_align_t),
+			"The emplaced descriptor is over-aligned.");
+		void* block = allocateDescriptor(sizeof(descriptorType));
+		descriptorType* descriptor;
+		try {
+			descriptor = ::new (block) descriptorType(
+				std::forward<argumentsType>(args)...);
+		} catch(...) {
+			McIoDescriptor::operator delete(block, sizeof(descriptorType));
+			throw;
+		}
+		std::unique_ptr<McIoDescriptor> managed(descriptor);
+		insert(managed);
+		return *descriptor;
+	}
+	
 	/**
 	 * @brief Instantly remove and destroy the descriptor.
 	 *
@@ -218,11 +346,74 @@ public:
 	 */
 	void updateTimeout(unsigned long timeout);
 	
+	/**
+	 * @brief Retrieve the time left before the current tick ends, which 
+	 * could be used as the time budget of the work done inside the tick.
+	 *
+	 * The end of the tick is tracked along with the timer, so only the 
+	 * monotonic clock is read, without system call.
+	 *
+	 * @return the time left, in the unit of nanoseconds, or 0 if the tick
+	 * should have ended.
+	 */
+	unsigned long remainingTime() const noexcept;
+	
+	/**
+	 * @brief Set the maximum number of events received by one poll.
+	 *
+	 * The number of events received by one poll starts from minimumEventBatch,
+	 * doubles when the poll is filled up and halves when the poll is mostly
+	 * empty, but never exceeds the maximum.
+	 *
+	 * @param[in] newSize the new maximum, no less than minimumEventBatch.
+	 */
+	void setMaximumEventBatch(size_t newSize);
+	
+	/// @brief Retrieve the maximum number of events received by one poll.
+	size_t getMaximumEventBatch() const;
+	
+	/**
+	 * @brief Set whether descriptors are registered persistently.
+	 *
+	 * Descriptors are registered in one-shot manner by default, and must 
+	 * be re-armed after each handle() that returns nstPoll. Persistently 
+	 * registered descriptors are only re-armed when their event flags have
+	 * changed, which saves a system call per handle(). However, they must 
+	 * strictly exhaust their events (reaching EAGAIN or EWOULDBLOCK, or a
+	 * short read or write) before returning nstPoll, or the edge-triggered 
+	 * event will never come again.
+	 *
+	 * The setting only affects descriptors inserted afterwards.
+	 *
+	 * @param[in] persistent whether to register persistently.
+	 */
+	void setPersistentRegistration(bool persistent);
+	
+	/// @brief Retrieve whether descriptors are registered persistently.
+	bool getPersistentRegistration() const;
+	
 	/**
 	 * @brief Run the multiplexer's polling loop, until the timeout is reached.
 	 */
 	void execute();
+	
+	/**
+	 * @brief Retrieve the buffer pool of the multiplexer, which is shared by 
+	 * descriptors managed by this multiplexer.
+	 */
+	McIoBufferPool& bufferPool();
+	
+	/**
+	 * @brief Retrieve the metrics of the multiplexer, which are updated by
+	 * the multiplexer and the descriptors it manages. The snapshot of the
+	 * metrics could be taken from any thread while the multiplexer is alive.
+	 */
+	McIoMultiplexerMetrics& metrics() noexcept;
+	const McIoMultiplexerMetrics& metrics() const noexcept;
 private:
 	/// The pointer-to-impl of the multiplexer.
 	char control[multiplexerControlBlockSize];
+	
+	/// Allocate the block of the emplaced descriptor from the slab.
+	void* allocateDescriptor(size_t size);
 };
\ No newline at end of file
@@ -11,7 +11,9 @@
 #include "libminecraft/iobase.hpp"
 #include "libminecraft/markable.hpp"
 #include "libminecraft/member.hpp"
+#include "libminecraft/nbtarena.hpp"
 #include <unordered_map>
+#include <scoped_allocator>
 #include <memory>
 #include <cstring>
  
@@ -20,10 +22,119 @@
 class McDtNbtCompound;
 class McDtNbtList;
 
+/// @brief The string of the nbt tag names and the string payloads of the 
+/// trees inside an arena, which is allocated inside the arena of its tree, 
+/// see McDtNbtArena.
+typedef std::basic_string<char16_t, std::char_traits<char16_t>, 
+	McDtNbtAllocator<char16_t>> McDtNbtString;
+
+/**
+ * @brief The tag name of the entries in mc::nbtcompound, whose characters 
+ * are owned by the tag name and allocated inside the arena of the compound.
+ *
+ * A tag name could also borrow the characters from the caller without 
+ * copying, which is only used for looking up the entries. The tag names
+ * are hashed and compared over their characters, so a borrowed tag name
+ * finds the entry of the owned tag name with the same characters.
+ */
+class McDtNbtTagName {
+	McDtNbtString storage;			///< The owned characters.
+	const char16_t* borrowedData;	///< The borrowed characters, or null.
+	size_t borrowedSize;			///< The length of the borrowed characters.
+	
+	// Construct a tag name borrowing the characters, see borrow().
+	McDtNbtTagName(const char16_t* data, size_t size) noexcept: 
+		storage(), borrowedData(data), borrowedSize(size) {}
+public:
+	// Tells the scoped allocator to construct the tag name inside the arena.
+	typedef McDtNbtAllocator<char16_t> allocator_type;
+	
+	// Construct a tag name owning a copy of the characters.
+	McDtNbtTagName(const char16_t* data, size_t size, const allocator_type& alloc):
+		storage(data, size, alloc), borrowedData(nullptr), borrowedSize(0) {}
+	McDtNbtTagName(McDtNbtString&& name, const allocator_type& alloc):
+		storage(std::move(name), alloc), borrowedData(nullptr), borrowedSize(0) {}
+	
+	// The copies always own their characters.
+	McDtNbtTagName(const McDtNbtTagName& a): 
+		storage(a.data(), a.size()), borrowedData(nullptr), borrowedSize(0) {}
+	McDtNbtTagName(const McDtNbtTagName& a, const allocator_type& alloc): 
+		storage(a.data(), a.size(), alloc), borrowedData(nullptr), borrowedSize(0) {}
+	McDtNbtTagName(McDtNbtTagName&& a, const allocator_type& alloc):
+		McDtNbtTagName(a, alloc) {}
+	McDtNbtTagName(McDtNbtTagName&& a) noexcept: storage(std::move(a.storage)), 
+		borrowedData(a.borrowedData), borrowedSize(a.borrowedSize) {}
+	
+	/// Borrow the characters for looking up, which must outlive the tag name.
+	static McDtNbtTagName borrow(const char16_t* data, size_t size) noexcept 
+		{	return McDtNbtTagName(data, size);	}
+	
+	// The std::basic_string like accessors of the characters.
+	const char16_t* data() const noexcept 
+		{	return borrowedData != nullptr? borrowedData : storage.data();	}
+	size_t size() const noexcept 
+		{	return borrowedData != nullptr? borrowedSize : storage.size();	}
+	
+	/// Convert to the string of the global heap, for the heap trees.
+	operator std::u16string() const { return std::u16string(data(), size()); }
+	
+	// The comparison over the characters of the tag names.
+	bool operator==(const McDtNbtTagName& a) const noexcept {
+		return size() == a.size() && std::char_traits<char16_t>
+			::compare(data(), a.data(), size()) == 0;
+	}
+	bool operator!=(const McDtNbtTagName& a) const noexcept 
+		{	return !(*this == a);	}
+	bool operator==(const std::u16string& a) const noexcept 
+		{	return *this == borrow(a.data(), a.size());	}
+	bool operator!=(const std::u16string& a) const noexcept 
+		{	return !(*this == a);	}
+};
+
+/// @brief The FNV-1a hash of McDtNbtTagName, over the characters of either
+/// the owned or the borrowed tag names.
+struct McDtNbtTagNameHash {
+	size_t operator()(const McDtNbtTagName& key) const noexcept {
+		const char16_t* data = key.data();
+		size_t hash = (size_t)14695981039346656037ull;
+		for(size_t i = 0; i < key.size(); ++ i) 
+			hash = (hash ^ (size_t)data[i]) * (size_t)1099511628211ull;
+		return hash;
+	}
+};
+
+namespace mc {		// Forward of the minecraft namespace.
+/// The arena variant of mc::jstring, which the string payloads of the trees 
+/// inside an arena are read into, and allocated inside the arena.
+typedef McDtDataType<McDtNbtString, McDtFlavourJavaString> nbtarenastring;
+
+/// The arena variant of mc::nbtintarray<I>, which the array payloads of the 
+/// trees inside an arena are read into, and allocated inside the arena.
+template<typename I>
+using nbtarenaintarray = McDtDataType<std::vector<I, McDtNbtAllocator<I>>, 
+	McDtFlavourArray<mc::s32>>;
+};					// End of forwarded minecraft namespace.
+
+/// @brief Create the string payload from the characters, where the arena 
+/// variant is allocated inside the arena of its tree.
+template<typename V> struct McDtNbtStringCreate;
+template<> struct McDtNbtStringCreate<mc::jstring> {
+	static inline mc::jstring create(const char16_t* v, McDtNbtArena*) 
+	{	return mc::jstring(v);	}
+};
+template<> struct McDtNbtStringCreate<mc::nbtarenastring> {
+	static inline mc::nbtarenastring create(const char16_t* v, McDtNbtArena* arena) 
+	{	return mc::nbtarenastring(McDtNbtString(v, McDtNbtAllocator<char16_t>(arena)));	}
+};
+
 /**
  * @brief Defines types that could be stored as an nbt payload, for
  * further usage of nbt payload in mc::nbtcompound and mc::nbtlist,
  * see also mc::cunion.
+ *
+ * The ordinals of the former twelve types are the nbt tags minus one. The
+ * trees inside an arena hold the arena variants of strings and arrays 
+ * instead, which are appended after them, see McDtNbtArena.
  */
 typedef mc::cuinfo<
 	// The signed integer types.
@@ -43,7 +154,11 @@ typedef mc::cuinfo<
 	McDtNbtList, McDtNbtCompound,
 
 	// Special integer arrays with mc::s32 prefix.
-	mc::array<mc::s32, mc::s32>, mc::array<mc::s64, mc::s32>
+	mc::array<mc::s32, mc::s32>, mc::array<mc::s64, mc::s32>,
+	
+	// The arena variants of the strings and arrays.
+	mc::nbtarenaintarray<mc::s8>, mc::nbtarenastring,
+	mc::nbtarenaintarray<mc::s32>, mc::nbtarenaintarray<mc::s64>
 > McDtNbtTagEnum;
 
 // Declare the mc::nbtinfo (constexpr) into the mc namespace.
@@ -55,6 +170,54 @@ static constexpr McDtNbtTagEnum nbtinfo = McDtNbtTagEnum();
 /// the tag index before the nbt's tag name. 
 typedef McDtUnion<McDtNbtTagEnum> McDtNbtPayload;
 
+/// @brief The payload type that a payload of type U is copied into, where
+/// the arena variants are copied into their heap types, so that the copy of
+/// a tree inside an arena is just like a tree read without arena.
+template<typename U> struct McDtNbtHeapType {
+	typedef U type;
+	static inline const U& copy(const U& v) { return v; }
+};
+template<> struct McDtNbtHeapType<mc::nbtarenastring> {
+	typedef mc::jstring type;
+	static inline type copy(const mc::nbtarenastring& v) {
+		const McDtNbtString& data = v;
+		return type(std::u16string(data.data(), data.size()));
+	}
+};
+template<typename I> struct McDtNbtHeapType<mc::nbtarenaintarray<I>> {
+	typedef mc::array<I, mc::s32> type;
+	static inline type copy(const mc::nbtarenaintarray<I>& v) {
+		const std::vector<I, McDtNbtAllocator<I>>& data = v;
+		return type(std::vector<I>(data.begin(), data.end()));
+	}
+};
+
+/// @brief Copy the nbt payloads into the global heap, see McDtNbtHeapType.
+/// The methods are defined after the payload types are complete.
+struct McDtNbtHeapCopy {
+	/// The ordinal of the heap type of the payloads of the ordinal.
+	static uint32_t ordinal(uint32_t ordinal) noexcept;
+	
+	/// The size of the heap type of the payloads of the ordinal.
+	static uint32_t stride(uint32_t ordinal, uint32_t stride) noexcept;
+	
+	/// The union action copy constructing the heap type of U.
+	struct copyConstruct {
+		template<typename U> static inline void 
+		perform(bool& valueValid, char* dstBuffer, char* srcBuffer) {
+			new (dstBuffer) typename McDtNbtHeapType<U>::type(
+				McDtNbtHeapType<U>::copy(*reinterpret_cast<const U*>(srcBuffer)));
+			valueValid = true;
+		}
+	};
+	
+	/// The user action assigning the heap type of U to the result.
+	struct assign;
+	
+	/// Copy the payload into the global heap.
+	static McDtNbtPayload payload(const McDtNbtPayload& a);
+};
+
 /// @brief The nbt compound storing key-value data in nbt format.
 class McDtNbtCompound {
 public:	
@@ -70,8 +233,8 @@ public:
 		// This class cannot be constructed by user, and it could be only
 		// constructed by its container classes.
 		friend class McDtNbtCompound;
-		friend class std::pair<std::u16string, McDtNbtCompoundData>;
-		friend class std::pair<const std::u16string, McDtNbtCompoundData>;
+		friend class std::pair<McDtNbtTagName, McDtNbtCompoundData>;
+		friend class std::pair<const McDtNbtTagName, McDtNbtCompoundData>;
 	public:
 		// The methods reflecting the underlying payload instance.
 		operator McDtNbtPayload&();
@@ -87,15 +250,58 @@ public:
 		static constexpr size_t payloadDataBlockSize = 64;
 	private:
 		char payloadData[payloadDataBlockSize];
+		
+		/// The arena of the owning compound, updated by its operator[].
+		McDtNbtArena* payloadArena;
 	};
 private:
-	typedef std::unordered_map<std::u16string, McDtNbtCompoundData> nbtMapType;
-	std::unique_ptr<nbtMapType> entries;
+	// The scoped allocator places the keys into the arena of the map.
+	typedef std::scoped_allocator_adaptor<McDtNbtAllocator<std::pair<
+		const McDtNbtTagName, McDtNbtCompoundData>>> nbtAllocatorType;
+	typedef std::unordered_map<McDtNbtTagName, McDtNbtCompoundData, 
+		McDtNbtTagNameHash, std::equal_to<McDtNbtTagName>, 
+		nbtAllocatorType> nbtMapType;
+	
+	// Destroy the entries inside the heap, while the entries inside the 
+	// arena are abandoned as they are reclaimed with the arena.
+	struct nbtMapDeleter {
+		void operator()(nbtMapType* map) const noexcept {
+			if(map -> get_allocator().arena == nullptr) delete map;
+		}
+	};
+	std::unique_ptr<nbtMapType, nbtMapDeleter> entries;
+	
+	// Create the entries inside the arena, or the heap if arena is null.
+	static nbtMapType* createEntries(McDtNbtArena* arena) {
+		if(arena == nullptr) return new nbtMapType(nbtAllocatorType());
+		return new (arena -> allocate(sizeof(nbtMapType), alignof(nbtMapType)))
+				nbtMapType(nbtAllocatorType(McDtNbtAllocator<char>(arena)));
+	}
+	
+	// Find the entry by the borrowed tag name, or insert the entry whose tag
+	// name is constructed from the arguments inside the arena.
+	template<typename... K>
+	McDtNbtCompoundData& insert(const char16_t* data, size_t size, K&&... key) {
+		auto entry = entries -> find(McDtNbtTagName::borrow(data, size));
+		if(entry == entries -> end()) entry = entries -> emplace(
+			std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)...),
+			std::forward_as_tuple()).first;
+		entry -> second.payloadArena = arena();
+		return entry -> second;
+	}
 public:
 	typedef McDtNbtCompound type;
 
 	// Constructors for an NbtCompound.
-	McDtNbtCompound(): entries(new nbtMapType) {}
+	McDtNbtCompound(): entries(createEntries(nullptr)) {}
+	
+	/// Construct an empty compound whose entries are inside the arena, so 
+	/// are the compounds and lists read into it by McIoReadNbtCompound().
+	explicit McDtNbtCompound(McDtNbtArena* arena): entries(createEntries(arena)) {}
+	
+	/// Copy the compound, the copy is always inside the global heap, with
+	/// the arena variants copied into their heap types. Moving the compound
+	/// keeps its entries inside the arena instead.
 	McDtNbtCompound(const McDtNbtCompound& a): 
 			entries(new nbtMapType(*a.entries)) {}
 	McDtNbtCompound(McDtNbtCompound&& a) noexcept: entries() {
@@ -116,19 +322,38 @@ public:
 	McDtNbtCompound& operator=(McDtNbtCompound&& a) {
 		using std::swap;
 		swap(entries, a.entries);
+		return *this;
 	}
 	
-	// Delegates the indexed-by-key method.
+	/// Retrieve the arena that the compound is inside, or null for heap.
+	McDtNbtArena* arena() const noexcept {
+		return entries != nullptr? entries -> get_allocator().arena : nullptr;
+	}
+	
+	// Delegates the indexed-by-key method, the key is looked up without 
+	// copying, and the key of inserted entry is copied into the arena of 
+	// the compound, or moved when it is inside the same arena.
 	McDtNbtCompoundData& operator[](const std::u16string& key) 
-		{	return (*entries)[key];	}
+		{	return insert(key.data(), key.size(), key.data(), key.size());	}
+	McDtNbtCompoundData& operator[](const char16_t* key) {
+		size_t size = std::char_traits<char16_t>::length(key);
+		return insert(key, size, key, size);
+	}
+	McDtNbtCompoundData& operator[](McDtNbtString&& key) 
+		{	return insert(key.data(), key.size(), std::move(key));	}
 	const McDtNbtCompoundData& operator[](const std::u16string& key) const 
-		{	return (*entries)[key];	}
+		{	return const_cast<McDtNbtCompound&>(*this)[key];	}
 		
 	// Delegate the erase() and count() method.
-	bool erase(const std::u16string& key) { return entries -> erase(key); }
-	size_t count(const std::u16string& key) { return entries -> count(key); }
+	bool erase(const std::u16string& key) {	
+		return entries -> erase(McDtNbtTagName::borrow(key.data(), key.size())) > 0;	
+	}
+	size_t count(const std::u16string& key) {
+		return entries -> count(McDtNbtTagName::borrow(key.data(), key.size()));
+	}
 	
-	// The iterator and const iterator methods.
+	// The iterator and const iterator methods, whose keys are converted to 
+	// std::u16string implicitly.
 	typedef nbtMapType::iterator iterator;
 	typedef nbtMapType::const_iterator const_iterator;
 	iterator begin()				{	return entries -> begin();		}
@@ -148,20 +373,57 @@ static_assert(	std::is_copy_constructible<McDtNbtCompound>::value &&
  * The std::vector cannot be used because it is allocator aware and does not 
  * allow variant length element in it. It may wrong memory allocation or deallocation 
  * when resizing vector content.
+ *
+ * The items could be allocated inside an arena, see McDtNbtArena, and the
+ * element destructors are not run for such list.
  */
 class McDtNbtList {
-	std::unique_ptr<char[]> items; ///< The actual data storage in the list.
+	char* items;                   ///< The actual data storage in the list.
 	size_t m_length;               ///< The effective elements in the list.
 	size_t m_capacity;             ///< The reserved memory (in number of elements).
-	const size_t ordinal;          ///< Which type is the nbt list holding.
-	const size_t stride;           ///< The size of every nbt element in the list.
+	const uint32_t ordinal;        ///< Which type is the nbt list holding.
+	const uint32_t stride;         ///< The size of every nbt element in the list.
 	const bool isTrivial;          ///< Is the nbt element primitives.
+	McDtNbtArena* listArena;       ///< The arena of the items, or null for heap.
 	
 	// Find the i-th nbt element in the list.
 	inline const char* indexBlock(size_t index) const 
-		{	return items.get() + index * stride;	}
+		{	return items + index * stride;	}
 	inline char* indexBlock(size_t index) 
-		{	return items.get() + index * stride;	}
+		{	return items + index * stride;	}
+	
+	// Allocate the storage for the items, inside the arena or the heap.
+	inline char* allocateItems(size_t capacity) {
+		if(listArena == nullptr) return new char[capacity * stride];
+		return static_cast<char*>(listArena -> allocate(
+			capacity * stride, alignof(std::max_align_t)));
+	}
+	
+	// Release the storage of the items.
+	inline void releaseItems(char* buffer) noexcept {
+		if(listArena == nullptr) delete[] buffer;
+	}
+	
+	// Copy the items of the arena variants into their heap types, whose
+	// strides differ from the source list.
+	inline void copyItems(const McDtNbtList& a) {
+		size_t i; try {
+			for(i = 0; i < m_length; ++ i) {
+				bool valueValid = false;
+				mc::nbtinfo.template byOrdinal<McDtNbtHeapCopy::copyConstruct>(
+					(int32_t)a.ordinal, valueValid, 
+					indexBlock(i), a.items + i * a.stride);
+			}
+		} catch(...) {
+			for(; i > 0; -- i) {
+				bool valueValid = true;
+				mc::nbtinfo.template byOrdinal<McDtUnionAction::destruct>(
+					(int32_t)ordinal, valueValid, indexBlock(i - 1), nullptr);
+			}
+			releaseItems(items);
+			throw;
+		}
+	}
 	
 	// Perform std::vector style allocation.
 	template<typename allocateAction, typename 
@@ -177,13 +439,13 @@ class McDtNbtList {
 			}
 		} catch(std::exception& ex) {
 			// Destroy already allocated elements.
-			for(i = i - 1; i >= 0; ++ i) {
+			for(; i > 0; -- i) {
 				bool valueValid = true;
 				mc::nbtinfo.template byOrdinal<fallbackAction>(
 					(int32_t)ordinal, valueValid, 
-					dstBuffer + i * stride, srcBuffer + i * stride);
+					dstBuffer + (i - 1) * stride, srcBuffer + (i - 1) * stride);
 			}
-			throw ex;
+			throw;
 		}
 	}
 public:
@@ -200,15 +462,22 @@ public:
 		if(capacity() >= newCapacity) return;
 		
 		// Allocate more space for the new items.
-		std::unique_ptr<char[]> newBuffer(new char[newCapacity * stride]);
-		if(!isTrivial) allocate<
-			McDtUnionAction::moveConstruct, 
-			McDtUnionAction::reverseMoveAssign>
-				(m_length, newBuffer.get(), items.get());
-		else memcpy(newBuffer.get(), items.get(), m_length * stride);
+		char* newBuffer = allocateItems(newCapacity);
+		if(!isTrivial) {
+			try {
+				allocate<McDtUnionAction::moveConstruct, 
+					McDtUnionAction::reverseMoveAssign>
+						(m_length, newBuffer, items);
+			} catch(...) {
+				releaseItems(newBuffer);
+				throw;
+			}
+		}
+		else if(m_length > 0) memcpy(newBuffer, items, m_length * stride);
 		
 		// Safely swap and update the capacity.
-		std::swap(newBuffer, items);
+		releaseItems(items);
+		items = newBuffer;
 		m_capacity = newCapacity;
 	}
 	
@@ -236,75 +505,120 @@ public:
 	}
 	
 	// Don't construct through this method if you do want some useful data type.
-	McDtNbtList(): items(), m_length(0), m_capacity(0), 
-		ordinal(SIZE_MAX), stride(1), isTrivial(true) {}
+	McDtNbtList(): items(nullptr), m_length(0), m_capacity(0), 
+		ordinal(UINT32_MAX), stride(1), isTrivial(true), listArena(nullptr) {}
+	
+	/// Construct an empty list, whose items will be allocated inside the 
+	/// arena after read by McIoReadNbtList().
+	explicit McDtNbtList(McDtNbtArena* arena): items(nullptr), m_length(0), 
+		m_capacity(0), ordinal(UINT32_MAX), stride(1), isTrivial(true), 
+		listArena(arena) {}
 	
-	// Copy status of other another nbt list.
-	McDtNbtList(const McDtNbtList& a): items(new char[a.m_capacity * a.stride]), 
+	// Copy status of other another nbt list, the copy is always inside the
+	// global heap, with the arena variants copied into their heap types.
+	McDtNbtList(const McDtNbtList& a): items(nullptr), 
 		m_length(a.m_length), m_capacity(a.m_capacity),
-		ordinal(a.ordinal), stride(a.stride), isTrivial(a.isTrivial) {
+		ordinal(McDtNbtHeapCopy::ordinal(a.ordinal)), 
+		stride(McDtNbtHeapCopy::stride(a.ordinal, a.stride)), 
+		isTrivial(a.isTrivial), listArena(nullptr) {
 		
-		if(isTrivial) memcpy(items.get(), a.items.get(), a.size() * stride);
-		else allocate<McDtUnionAction::copyConstruct>(m_length, items.get(), 
-				const_cast<char*>(a.items.get()));
+		items = allocateItems(m_capacity);
+		if(isTrivial) { 
+			if(m_length > 0) memcpy(items, a.items, a.size() * stride);
+		}
+		else if(ordinal == a.ordinal) try {
+			allocate<McDtUnionAction::copyConstruct>(m_length, items, a.items);
+		} catch(...) {
+			releaseItems(items);
+			throw;
+		}
+		else copyItems(a);
 	}
 	
 	// Move status of another nbt list, because the union's object is newed just
 	// on another object's vector, you can safely swap them.
-	McDtNbtList(McDtNbtList&& a) noexcept: items(), ordinal(a.ordinal), 
-			m_length(a.m_length), m_capacity(a.m_capacity),
-			stride(a.stride), isTrivial(a.isTrivial) {
+	McDtNbtList(McDtNbtList&& a) noexcept: items(a.items), 
+			m_length(a.m_length), m_capacity(a.m_capacity), ordinal(a.ordinal), 
+			stride(a.stride), isTrivial(a.isTrivial), listArena(a.listArena) {
 			
-			std::swap(items, a.items);
-			a.items = NULL;
+			a.items = nullptr;
 			a.m_length = 0;
 			a.m_capacity = 0;
 	}
 	
-	// Destroy the object, based on the data stored.
+	// Destroy the object, based on the data stored. The items inside the 
+	// arena are abandoned as they are reclaimed with the arena.
 	~McDtNbtList() {
-		if(items != NULL && !isTrivial) for(size_t i = 0; i < size(); ++ i) {
+		if(listArena != nullptr) return;
+		if(items != nullptr && !isTrivial) for(size_t i = 0; i < size(); ++ i) {
 			bool valueValid = true;
 			mc::nbtinfo.template byOrdinal<McDtUnionAction::destruct>(
 				(int32_t)ordinal, valueValid, indexBlock(i), nullptr);
 			valueValid = false;
 		}
+		releaseItems(items);
 	}
 	
-	// Copy construct from the generic type.
+	// Copy construct from the generic type, with items inside the arena.
 	template<typename V>
-	McDtNbtList(const std::vector<V>& v): 
-		items(new char[v.capacity() * sizeof(V)]), 
-		m_length(v.size()), m_capacity(v.capacity()),
+	McDtNbtList(const std::vector<V>& v, McDtNbtArena* arena = nullptr): 
+		items(nullptr), m_length(v.size()), m_capacity(v.capacity()),
 		ordinal(mc::nbtinfo.ordinalOf<V>()), stride(sizeof(V)), 
-		isTrivial(std::is_fundamental<typename V::type>::value) {
+		isTrivial(std::is_fundamental<typename V::type>::value), listArena(arena) {
 		
-		if(isTrivial) memcpy(items.get(), reinterpret_cast<const char*>(v.data()), m_length * stride);
-		else allocate<McDtUnionAction::copyConstruct>(m_length, items.get(), 
+		items = allocateItems(m_capacity);
+		if(isTrivial) { 
+			if(m_length > 0) memcpy(items, v.data(), m_length * stride);
+		}
+		else try {
+			allocate<McDtUnionAction::copyConstruct>(m_length, items, 
 				const_cast<char*>(reinterpret_cast<const char*>(v.data())));
+		} catch(...) {
+			releaseItems(items);
+			throw;
+		}
 	}
 	
-	// Move construct for the generic type.
-	template<typename V> McDtNbtList(std::vector<V>&& v):
-		items(new char[v.capacity() * sizeof(V)]), 
-		m_length(v.size()), m_capacity(v.capacity()),
+	// Move construct for the generic type, with items inside the arena.
+	template<typename V> 
+	McDtNbtList(std::vector<V>&& v, McDtNbtArena* arena = nullptr):
+		items(nullptr), m_length(v.size()), m_capacity(v.capacity()),
 		ordinal(mc::nbtinfo.ordinalOf<V>()), stride(sizeof(V)), 
-		isTrivial(std::is_fundamental<typename V::type>::value) {
+		isTrivial(std::is_fundamental<typename V::type>::value), listArena(arena) {
 		
-		if(isTrivial) memcpy(items.get(), reinterpret_cast<const char*>(v.data()), m_length * stride);
-		else allocate<McDtUnionAction::moveConstruct>(m_length, items.get(), 
+		items = allocateItems(m_capacity);
+		if(isTrivial) { 
+			if(m_length > 0) memcpy(items, v.data(), m_length * stride);
+		}
+		else try {
+			allocate<McDtUnionAction::moveConstruct>(m_length, items, 
 				const_cast<char*>(reinterpret_cast<const char*>(v.data())));
+		} catch(...) {
+			releaseItems(items);
+			throw;
+		}
+	}
+	
+	/// Construct an empty list of V, whose items are inside the arena, which
+	/// could be filled by mc::nbttypedlist<V>.
+	template<typename V> 
+	static McDtNbtList of(McDtNbtArena* arena = nullptr) {
+		return McDtNbtList(std::vector<V>(), arena);
 	}
 	
+	/// Retrieve the arena that the items are inside, or null for heap.
+	McDtNbtArena* arena() const noexcept { return listArena; }
+	
 	/// Swap with another nbt list.
 	void swap(McDtNbtList& rlist) noexcept {
 		using std::swap;
 		swap(items, rlist.items);
 		swap(m_length, rlist.m_length);
 		swap(m_capacity, rlist.m_capacity);
-		swap(const_cast<size_t&>(ordinal), const_cast<size_t&>(rlist.ordinal));
-		swap(const_cast<size_t&>(stride), const_cast<size_t&>(rlist.stride));
+		swap(const_cast<uint32_t&>(ordinal), const_cast<uint32_t&>(rlist.ordinal));
+		swap(const_cast<uint32_t&>(stride), const_cast<uint32_t&>(rlist.stride));
 		swap(const_cast<bool&>(isTrivial), const_cast<bool&>(rlist.isTrivial));
+		swap(listArena, rlist.listArena);
 	}
 	
 	/// @brief Providing typed control to the nbt list's internal data. Please 
@@ -333,8 +647,8 @@ public:
 		/// Shadowed operations from the list.
 		size_t size() const { return list.size(); }
 		size_t capacity() const { return list.capacity(); }
-		size_t reserve(size_t newCapacity) { list.reserve(newCapacity); }
-		size_t resize(size_t newSize) { list.resize(newSize); }
+		void reserve(size_t newCapacity) { list.reserve(newCapacity); }
+		void resize(size_t newSize) { list.resize(newSize); }
 		
 		// The modification method.
 		void push_back(const V& v) {
@@ -359,12 +673,22 @@ public:
 			}
 		}
 		
-		// Special overload for mc::jstring.
+		// The moving modification method, which keeps the allocation of 
+		// the element. So the element moved into a list inside the arena 
+		// must be inside the same arena.
+		void push_back(V&& v) {
+			// Reserve more memory for the element.
+			reserve(size() + 1);
+			
+			// Move construct the element, which never throws.
+			new (list.indexBlock(list.m_length)) V(std::move(v));
+			list.m_length ++;
+		}
+		
+		// Special overload for mc::jstring and mc::nbtarenastring, the 
+		// string of the arena variant is inside the arena of the list.
 		void push_back(const char16_t* v) {
-			if(mc::nbtinfo.template ordinalOf<mc::jstring>() != list.ordinal) 
-				throw std::runtime_error("The element type of the "
-					"list is not of specified type.");
-			else push_back(mc::jstring(v));
+			push_back(McDtNbtStringCreate<V>::create(v, list.listArena));
 		}
 		
 		// Iterator methods and const iterator methods.
@@ -420,12 +744,12 @@ using nbtintarray = mc::array<I, mc::s32>;
 // This block are defined after the size of payload data could be determined.
 static_assert(sizeof(McDtNbtPayload) <= McDtNbtCompound::McDtNbtCompoundData
 	::payloadDataBlockSize, "The payload data block is not big to hold payload content.");
-inline McDtNbtCompound::McDtNbtCompoundData::McDtNbtCompoundData() 
+inline McDtNbtCompound::McDtNbtCompoundData::McDtNbtCompoundData(): payloadArena(nullptr)
 	{	new (payloadData) McDtNbtPayload;		}
-inline McDtNbtCompound::McDtNbtCompoundData::McDtNbtCompoundData(const McDtNbtCompoundData& block) 
-	{	new (payloadData) McDtNbtPayload((const McDtNbtPayload&)block);	};
-inline McDtNbtCompound::McDtNbtCompoundData::McDtNbtCompoundData(McDtNbtCompoundData&& block) 
-	{	new (payloadData) McDtNbtPayload(std::move((McDtNbtPayload&&)block));	};
+inline McDtNbtCompound::McDtNbtCompoundData::McDtNbtCompoundData(const McDtNbtCompoundData& block): 
+	payloadArena(nullptr) {	new (payloadData) McDtNbtPayload(McDtNbtHeapCopy::payload(block));	};
+inline McDtNbtCompound::McDtNbtCompoundData::McDtNbtCompoundData(McDtNbtCompoundData&& block): 
+	payloadArena(block.payloadArena) {	new (payloadData) McDtNbtPayload(std::move((McDtNbtPayload&&)block));	};
 inline McDtNbtCompound::McDtNbtCompoundData::~McDtNbtCompoundData() 
 	{	((McDtNbtPayload*)payloadData) -> ~McDtNbtPayload();	}
 inline McDtNbtCompound::McDtNbtCompoundData::operator McDtNbtPayload&() 
@@ -437,6 +761,45 @@ inline McDtNbtPayload* McDtNbtCompound::McDtNbtCompoundData::operator->()
 inline const McDtNbtPayload* McDtNbtCompound::McDtNbtCompoundData::operator->() const
 	{	return reinterpret_cast<const McDtNbtPayload*>(payloadData);	}
 	
+// Copying the payloads into the global heap, see McDtNbtHeapType.
+inline uint32_t McDtNbtHeapCopy::ordinal(uint32_t ordinal) noexcept {
+	if(ordinal == mc::nbtinfo.ordinalOf<mc::nbtarenaintarray<mc::s8>>())
+		return mc::nbtinfo.ordinalOf<mc::array<mc::s8, mc::s32>>();
+	if(ordinal == mc::nbtinfo.ordinalOf<mc::nbtarenastring>())
+		return mc::nbtinfo.ordinalOf<mc::jstring>();
+	if(ordinal == mc::nbtinfo.ordinalOf<mc::nbtarenaintarray<mc::s32>>())
+		return mc::nbtinfo.ordinalOf<mc::array<mc::s32, mc::s32>>();
+	if(ordinal == mc::nbtinfo.ordinalOf<mc::nbtarenaintarray<mc::s64>>())
+		return mc::nbtinfo.ordinalOf<mc::array<mc::s64, mc::s32>>();
+	return ordinal;
+}
+
+inline uint32_t McDtNbtHeapCopy::stride(uint32_t ordinal, uint32_t stride) noexcept {
+	if(ordinal == mc::nbtinfo.ordinalOf<mc::nbtarenaintarray<mc::s8>>())
+		return sizeof(mc::array<mc::s8, mc::s32>);
+	if(ordinal == mc::nbtinfo.ordinalOf<mc::nbtarenastring>())
+		return sizeof(mc::jstring);
+	if(ordinal == mc::nbtinfo.ordinalOf<mc::nbtarenaintarray<mc::s32>>())
+		return sizeof(mc::array<mc::s32, mc::s32>);
+	if(ordinal == mc::nbtinfo.ordinalOf<mc::nbtarenaintarray<mc::s64>>())
+		return sizeof(mc::array<mc::s64, mc::s32>);
+	return stride;
+}
+
+struct McDtNbtHeapCopy::assign {
+	template<typename U> static inline void 
+	perform(McDtNbtPayload& result, const McDtNbtPayload& a)
+	{	result = McDtNbtHeapType<U>::copy(a.template asType<U>());	}
+};
+
+inline McDtNbtPayload McDtNbtHeapCopy::payload(const McDtNbtPayload& a) {
+	if(a.isNull() || ordinal((uint32_t)a.ordinal()) == a.ordinal()) return a;
+	McDtNbtPayload result;
+	mc::nbtinfo.userByOrdinal<assign, McDtNbtPayload&, const McDtNbtPayload&>(
+		(int32_t)a.ordinal(), result, a);
+	return result;
+}
+
 // Special assignment methods to make it just like its payload counter part.
 template<typename U> McDtNbtCompound::McDtNbtCompoundData& 
 McDtNbtCompound::McDtNbtCompoundData::operator=(const U& v) {
@@ -446,7 +809,10 @@ McDtNbtCompound::McDtNbtCompoundData::operator=(const U& v) {
 
 inline McDtNbtCompound::McDtNbtCompoundData& 
 McDtNbtCompound::McDtNbtCompoundData::operator=(const char16_t* v) {
-	((McDtNbtPayload&)*this) = mc::jstring(v);
+	if(payloadArena == nullptr) ((McDtNbtPayload&)*this) = 
+		McDtNbtStringCreate<mc::jstring>::create(v, nullptr);
+	else ((McDtNbtPayload&)*this) = McDtNbtStringCreate<mc::nbtarenastring>
+		::create(v, payloadArena);
 	return *this;
 }
 
@@ -688,6 +1054,24 @@ void McIoSaxNbtCompound(McIoMarkableStream& inputStream, void* data, void* ud,
 	size_t numSaxActions, const McIoNbtCompoundSaxAction* const saxActions,
 	McDtNbtCompound* ignoredTag = nullptr);
 
+/**
+ * @brief Perform SAX-style reading of an nbt compound from a forward-only 
+ * stream, e.g. the inflating stream of a compressed file.
+ *
+ * The semantics are the same as the markable variant, except that the tags 
+ * whose prerequisites are not met are spilled into side buffers instead of
+ * being marked, and are presented from the side buffers once resolved. So
+ * only the deferred tags are kept in memory rather than the whole compound.
+ *
+ * The stream passed to tagPresent supports marking by recording the bytes
+ * read since the earliest living mark, but nested compounds could also be 
+ * read by this variant to keep the memory bounded.
+ */
+void McIoSaxNbtCompound(McIoInputStream& inputStream, void* data, void* ud,
+	int (*dictionary)(size_t tagLength, const char* tagName),
+	size_t numSaxActions, const McIoNbtCompoundSaxAction* const saxActions,
+	McDtNbtCompound* ignoredTag = nullptr);
+
 // Forward the nbt sax action as mc::nbtsax.
 namespace mc {
 typedef McIoNbtCompoundSaxAction nbtsax;
@@ -0,0 +1,140 @@
+#pragma once
+/**
+ * @file libminecraft/nbtarena.hpp
+ * @brief The nbt tree arena
+ * @author Haoran Luo
+ *
+ * Defines the monotonic arena that an nbt tree could be allocated in,
+ * and the allocator that adapts the arena to the standard containers.
+ *
+ * Allocating inside the arena is a pointer bump, and deallocating is a
+ * no-op, the memory is only reclaimed when the arena is reset or
+ * destructed. A tree read into an arena places its map nodes, tag names
+ * and list items there, and reads its strings and arrays into the arena
+ * variants mc::nbtarenastring and mc::nbtarenaintarray<I> instead of the
+ * mc::jstring and mc::nbtintarray<I> of the heap trees, so reading it does
+ * not hit the heap. The entries inside an arena are never destructed, so
+ * destroying or abandoning such tree is O(1).
+ *
+ * Consequently, the payloads placed into a tree inside an arena must be
+ * allocated inside the same arena, otherwise their heap storage leaks. The
+ * tag names, and the strings assigned from char16_t* through the compound
+ * entries or the list accessors, are always allocated inside the arena of
+ * their container. Other payloads could be created with a McDtNbtAllocator 
+ * of the container's arena(), or moved from another tree read into it.
+ *
+ * The arena must outlive every tree allocated in it. Copying a tree
+ * always copies it into the global heap, converting the arena variants
+ * into mc::jstring and mc::nbtintarray<I>, so a tree that should outlive
+ * the arena could be copied out before resetting the arena. Moving a tree
+ * never does, the moved tree and its payloads are still inside the arena.
+ *
+ * This class is NOT multi-thread safe, and never share instances of this
+ * class among threads.
+ */
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+class McDtNbtArena {
+public:
+	/// The default size of the chunks that are allocated from the heap.
+	static const size_t defaultChunkSize = 64 << 10;
+
+	/// Construct an empty arena with the specified chunk size.
+	McDtNbtArena(size_t chunkSize = defaultChunkSize) noexcept;
+
+	/// Free all chunks, trees inside the arena must have been destroyed.
+	~McDtNbtArena() noexcept;
+
+	// Copy sematics and move sematics are not allowed.
+	McDtNbtArena(const McDtNbtArena&) = delete;
+	McDtNbtArena& operator=(const McDtNbtArena&) = delete;
+	McDtNbtArena(McDtNbtArena&&) = delete;
+	McDtNbtArena& operator=(McDtNbtArena&&) = delete;
+
+	/**
+	 * @brief Allocate uninitialized memory inside the arena.
+	 *
+	 * @param[in] size the size of the memory, in unit of byte.
+	 * @param[in] alignment the alignment of the memory, must be power of 2.
+	 * @throw std::bad_alloc when a new chunk cannot be allocated.
+	 */
+	void* allocate(size_t size, size_t alignment) {
+		size_t offset = (alignment - ((size_t)current & (alignment - 1))) & (alignment - 1);
+		if(offset + size > (size_t)(limit - current)) return allocateSlow(size, alignment);
+		void* result = current + offset;
+		current += offset + size;
+		allocatedSize += size;
+		return result;
+	}
+
+	/**
+	 * @brief Reclaim all memory inside the arena at once, keeping a chunk
+	 * for further allocation. Trees inside the arena must have been
+	 * destroyed or abandoned.
+	 */
+	void reset() noexcept;
+
+	/// @brief Retrieve the number of bytes handed out since last reset.
+	size_t allocated() const noexcept { return allocatedSize; }
+private:
+	/// The header of the chunks, the newest chunk is at the head.
+	struct McDtNbtArenaChunk {
+		McDtNbtArenaChunk* next;
+		size_t size;
+	};
+	McDtNbtArenaChunk* chunks;
+
+	/// The free range inside the newest chunk.
+	char *current, *limit;
+
+	/// The size of the chunks to allocate.
+	size_t chunkSize;
+
+	/// The bytes that has been handed out.
+	size_t allocatedSize;
+
+	/// Allocate from a new chunk.
+	void* allocateSlow(size_t size, size_t alignment);
+};
+
+/**
+ * @brief The standard allocator that allocates inside the arena, or from
+ * the global heap when the arena is null.
+ *
+ * Copy constructed containers always select the global heap, while
+ * swapped and move assigned containers carry their arena with them.
+ */
+template<typename T> struct McDtNbtAllocator {
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	/// The arena to allocate inside, or null for the global heap.
+	McDtNbtArena* arena;
+
+	McDtNbtAllocator(McDtNbtArena* arena = nullptr) noexcept: arena(arena) {}
+	template<typename U> McDtNbtAllocator(const McDtNbtAllocator<U>& a) noexcept:
+		arena(a.arena) {}
+
+	T* allocate(size_t n) {
+		if(arena == nullptr) return static_cast<T*>(::operator new(n * sizeof(T)));
+		return static_cast<T*>(arena -> allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* p, size_t) noexcept {
+		if(arena == nullptr) ::operator delete(p);
+	}
+
+	McDtNbtAllocator select_on_container_copy_construction() const noexcept
+		{	return McDtNbtAllocator();	}
+};
+
+template<typename T, typename U> inline bool operator==(
+	const McDtNbtAllocator<T>& a, const McDtNbtAllocator<U>& b) noexcept
+	{	return a.arena == b.arena;	}
+
+template<typename T, typename U> inline bool operator!=(
+	const McDtNbtAllocator<T>& a, const McDtNbtAllocator<U>& b) noexcept
+	{	return a.arena != b.arena;	}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+/**
+ * @file libminecraft/nbtview.hpp
+ * @brief The read-only nbt view
+ * @author Haoran Luo
+ *
+ * Defines the lazy view over raw nbt data, as the third way to access
+ * nbt data besides the materialized mc::nbtcompound and the SAX style
+ * McIoSaxNbtCompound(), for handlers that only peek at a few tags.
+ *
+ * The view never copies the buffer, nor validates it ahead of time. The
+ * tags inside a compound (or the elements inside a list) are scanned and
+ * validated only as far as an access needs, bounded by the enclosing
+ * buffer, so the malformed data is reported by the access reaching it. The
+ * offsets of the scanned tags are cached in the index of the compound or
+ * list, and the index of a nested compound or list is shared by the views
+ * of it, so no tag is scanned twice. The tag names are compared as raw
+ * utf-8 bytes without converting to utf-16.
+ *
+ * The buffer must outlive every view created on it. The copies of a view,
+ * and the views of the same nested payload, share the index. As the index
+ * is scanned inside const methods, the views are NOT multi-thread safe.
+ */
+#include "libminecraft/nbt.hpp"
+#include <memory>
+#include <string>
+#include <tuple>
+#include <cstdint>
+
+/// The index of the tags inside a compound or a list, see nbtview.cpp.
+struct McDtNbtViewIndex;
+
+/// @brief The read-only view of an nbt payload inside a raw buffer.
+class McDtNbtView {
+	/// The nbt tag type of the payload, 0 for the null view.
+	int8_t tagType;
+
+	/// The range of the payload inside the buffer, where the end is the
+	/// bound of the enclosing buffer for the compounds and lists of
+	/// variable length elements, whose end is known by the index.
+	const char *payloadBegin, *payloadEnd;
+
+	/// The lazily scanned index of the compound or list of variable length
+	/// elements, or null for the payloads of known length.
+	std::shared_ptr<McDtNbtViewIndex> index;
+
+	/// Construct the view of a bounded payload.
+	McDtNbtView(int8_t tagType, const char* begin, const char* end,
+		std::shared_ptr<McDtNbtViewIndex> index) noexcept;
+
+	/// Scan the index until the i-th entry, returning false when absent.
+	bool scanned(size_t i) const;
+
+	/// Retrieve the view of the scanned i-th entry of the index.
+	McDtNbtView entryView(size_t i) const;
+
+	/// Ensure the type of the view, or throw std::runtime_error.
+	void ensureType(int8_t expectedType) const;
+public:
+	/// Construct a null view.
+	McDtNbtView() noexcept;
+
+	/**
+	 * @brief Create the view of the root nbt tag, which is made up of the
+	 * tag type, the tag name and the payload.
+	 *
+	 * @param[in] buffer the buffer beginning with the root tag.
+	 * @param[in] size the size of the buffer, may be larger than the tag.
+	 * @return the view of the root payload, or null view for tag end.
+	 * @throw std::runtime_error when the root tag header is malformed, while
+	 * the compounds and lists are validated on access.
+	 */
+	static McDtNbtView fromRoot(const char* buffer, size_t size);
+
+	/**
+	 * @brief Create the view of an nbt payload of known type.
+	 *
+	 * @param[in] tagType the nbt tag type (1 to 12) of the payload.
+	 * @param[in] buffer the buffer beginning with the payload.
+	 * @param[in] size the size of the buffer, may be larger than the payload.
+	 * @throw std::runtime_error when the payload header is malformed, while
+	 * the compounds and lists are validated on access.
+	 */
+	static McDtNbtView fromPayload(int8_t tagType, const char* buffer, size_t size);
+
+	/// Retrieve the nbt tag type, 0 for the null view.
+	int8_t type() const noexcept { return tagType; }
+
+	/// Whether this is a null view, e.g. the tag is absent.
+	bool isNull() const noexcept { return tagType == 0; }
+
+	/// Retrieve the (size, data) pair of the raw payload, scanning the
+	/// compound or list completely, throwing std::runtime_error when it
+	/// is malformed.
+	std::tuple<size_t, const char*> rawPayload() const;
+
+	/// Retrieve the number of tags for compound, the number of elements
+	/// for lists and arrays, or 0 for other types.
+	size_t size() const;
+
+	/// Retrieve the nbt tag type of the elements inside lists and arrays.
+	int8_t elementType() const;
+
+	/**
+	 * @brief Find the tag inside the compound.
+	 *
+	 * @param[in] key the utf-8 name of the tag.
+	 * @param[in] keyLength the length of the name, in unit of byte.
+	 * @return the view of the payload, or null view if it is absent.
+	 * @throw std::runtime_error when the view is not a compound.
+	 */
+	McDtNbtView find(const char* key, size_t keyLength) const;
+
+	/// Find the tag with null-terminated utf-8 name inside the compound.
+	McDtNbtView find(const char* key) const { return find(key, strlen(key)); }
+
+	/// Find the tag with utf-8 name inside the compound.
+	McDtNbtView operator[](const char* key) const { return find(key); }
+
+	/// Retrieve the (size, data) pair of the utf-8 name of the i-th tag.
+	std::tuple<size_t, const char*> keyAt(size_t i) const;
+
+	/// Retrieve the i-th tag of compounds, or the i-th element of lists
+	/// and arrays, throwing std::runtime_error when out of range.
+	McDtNbtView valueAt(size_t i) const;
+
+	// The primitive accessors, throwing std::runtime_error on type mismatch.
+	int8_t asByte() const;
+	int16_t asShort() const;
+	int32_t asInt() const;
+	int64_t asLong() const;
+	float asFloat() const;
+	double asDouble() const;
+
+	/// Retrieve the (size, data) pair of the raw utf-8 string.
+	std::tuple<size_t, const char*> asRawString() const;
+
+	/// Retrieve the string converted to utf-16.
+	std::u16string asString() const;
+
+	/// Materialize the viewed compound.
+	void materialize(mc::nbtcompound& compound) const;
+
+	/// Materialize the viewed list.
+	void materialize(mc::nbtlist& list) const;
+};
\ No newline at end of file
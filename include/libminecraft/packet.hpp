@@ -0,0 +1,386 @@
+#pragma once
+/**
+ * @file libminecraft/packet.hpp
+ * @brief The compile time packet dispatch
+ * @author Haoran Luo
+ *
+ * Defines the packet registry, which routes the inbound packets to their
+ * typed handlers by the protocol state and the packet id. The routes are
+ * listed per protocol state, and a dense jump table indexed by the packet
+ * id is generated from the list at compile time, so dispatching a packet
+ * costs a bounds check and an indirect call, without any hashing or map
+ * lookup. The packets are decoded straight into the packet struct by the
+ * schema (see schema.hpp) before the handler is called.
+ *
+ * A connection could be declared like:
+ *
+ * class Server : public McIoProtocolConnection<Server> {
+ *     void handshake(Handshake& packet);
+ *     void statusRequest(size_t size, McIoMarkableStream& inputStream);
+ * public:
+ *     typedef McIoPacketRegistry<Server, pdServerbound,
+ *         McIoPacketTable<psHandshake, pdServerbound,
+ *             __mc_packet(0x00, HandshakeSchema, Server, handshake)>,
+ *         McIoPacketTable<psStatus, pdServerbound,
+ *             __mc_packet_stream(0x00, Server, statusRequest)>
+ *     > packetRegistry;
+ *
+ *     Server(int sockfd): McIoProtocolConnection<Server>(sockfd) {}
+ * };
+ *
+ * Where the handshake() could switch the protocol state of the connection
+ * by setProtocolState(), which takes effect from the next packet.
+ */
+#include "libminecraft/connection.hpp"
+#include "libminecraft/schema.hpp"
+#include <utility>
+#include <type_traits>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+
+/// The protocol states of the connection.
+enum McIoProtocolState {
+	psHandshake = 0,
+	psStatus,
+	psLogin,
+	psPlay,
+
+	/// The number of protocol states.
+	psNumStates
+};
+
+/// The directions in which the packets are sent.
+enum McIoPacketDirection {
+	/// The packets sent from the clients to the server.
+	pdServerbound = 0,
+
+	/// The packets sent from the server to the clients.
+	pdClientbound
+};
+
+/// The packet ids in the jump tables must be less than this bound, so that
+/// the tables stay dense.
+static constexpr int32_t McIoPacketIdBound = 1024;
+
+/// The entry of the jump table, which decodes and handles the packet after
+/// the packet id, where the size is of the rest of the packet.
+template<typename handlerType>
+using McIoPacketEntry = void (*)(handlerType& handler,
+		size_t packetSize, McIoMarkableStream& inputStream);
+
+/**
+ * @brief The route of the packet id, which decodes the packet by the schema
+ * and calls the handler method with the packet.
+ */
+template<int32_t PacketId, typename SchemaType, typename HandlerClass,
+	void (HandlerClass::*HandlerMethod)(typename SchemaType::classType&)>
+struct McIoPacketRoute {
+	static_assert(PacketId >= 0 && PacketId < McIoPacketIdBound,
+		"The packet id is out of the bound of the jump table.");
+
+	/// The routed packet id.
+	static constexpr int32_t packetId = PacketId;
+
+	/// Decode the packet and call the handler method.
+	template<typename handlerType>
+	static void dispatch(handlerType& handler, size_t, McIoMarkableStream& inputStream) {
+		typename SchemaType::classType packet;
+		SchemaType::read(inputStream, packet);
+		(handler.*HandlerMethod)(packet);
+	}
+};
+
+/**
+ * @brief The route of the packet id, which passes the rest of the packet
+ * as the stream to the handler method, for the packets without fields or
+ * with their own decoding (e.g. plugin messages).
+ */
+template<int32_t PacketId, typename HandlerClass,
+	void (HandlerClass::*HandlerMethod)(size_t, McIoMarkableStream&)>
+struct McIoPacketStreamRoute {
+	static_assert(PacketId >= 0 && PacketId < McIoPacketIdBound,
+		"The packet id is out of the bound of the jump table.");
+
+	/// The routed packet id.
+	static constexpr int32_t packetId = PacketId;
+
+	/// Call the handler method with the stream.
+	template<typename handlerType>
+	static void dispatch(handlerType& handler, size_t packetSize, McIoMarkableStream& inputStream) {
+		(handler.*HandlerMethod)(packetSize, inputStream);
+	}
+};
+
+/// The macros which convert the (id, schema, class, method) into the routes,
+/// like the __mc_member does for the members.
+#ifdef __mc_packet
+#ifndef __mc_packet_override
+static_assert(false, "The __mc_packet has already been defined, specify "
+"__mc_packet_override if you know what could happend and still decide to "
+"override it.");
+#endif
+#else
+#define __mc_packet(id, schema, type, method)\
+	McIoPacketRoute<id, schema, type, &type::method>
+#define __mc_packet_stream(id, type, method)\
+	McIoPacketStreamRoute<id, type, &type::method>
+#endif
+
+/// The maximum packet id among the routes, -1 if there's none.
+template<typename... routeTypes> struct McIoPacketMaxId {
+	static constexpr int32_t value = -1;
+};
+
+template<typename routeType, typename... routeTypes>
+struct McIoPacketMaxId<routeType, routeTypes...> {
+	static constexpr int32_t value = routeType::packetId >
+		McIoPacketMaxId<routeTypes...>::value? routeType::packetId :
+		McIoPacketMaxId<routeTypes...>::value;
+};
+
+/// The number of routes of the packet id.
+template<int32_t packetId, typename... routeTypes> struct McIoPacketIdCount {
+	static constexpr size_t value = 0;
+};
+
+template<int32_t packetId, typename routeType, typename... routeTypes>
+struct McIoPacketIdCount<packetId, routeType, routeTypes...> {
+	static constexpr size_t value = (routeType::packetId == packetId? 1 : 0)
+		+ McIoPacketIdCount<packetId, routeTypes...>::value;
+};
+
+/// Whether the packet ids of the routes are unique.
+template<typename... routeTypes> struct McIoPacketIdUnique {
+	static constexpr bool value = true;
+};
+
+template<typename routeType, typename... routeTypes>
+struct McIoPacketIdUnique<routeType, routeTypes...> {
+	static constexpr bool value = McIoPacketIdCount<routeType::packetId,
+		routeTypes...>::value == 0 && McIoPacketIdUnique<routeTypes...>::value;
+};
+
+/**
+ * @brief The routes of the packets of a protocol state, sent in a direction.
+ * The routes could be listed in any order, as long as their ids are unique.
+ */
+template<McIoProtocolState State, McIoPacketDirection Direction, typename... routeTypes>
+struct McIoPacketTable {
+	static_assert(McIoPacketIdUnique<routeTypes...>::value,
+		"The packet ids of a protocol state must be unique.");
+
+	/// The protocol state of the packets.
+	static constexpr McIoProtocolState state = State;
+
+	/// The direction of the packets.
+	static constexpr McIoPacketDirection direction = Direction;
+
+	/// The number of entries of the jump table, which is never empty.
+	static constexpr size_t size = McIoPacketMaxId<routeTypes...>::value < 0? 1 :
+		(size_t)McIoPacketMaxId<routeTypes...>::value + 1;
+};
+
+/// Find the entry of the packet id among the routes, null if there's none.
+template<typename handlerType, int32_t packetId, typename... routeTypes>
+struct McIoPacketEntryOf {
+	static constexpr McIoPacketEntry<handlerType> value = nullptr;
+};
+
+template<typename handlerType, int32_t packetId, typename routeType, typename... routeTypes>
+struct McIoPacketEntryOf<handlerType, packetId, routeType, routeTypes...> {
+	static constexpr McIoPacketEntry<handlerType> value =
+		routeType::packetId == packetId?
+			&routeType::template dispatch<handlerType> :
+			McIoPacketEntryOf<handlerType, packetId, routeTypes...>::value;
+};
+
+/// The jump table of the protocol state generated for the handler.
+template<typename handlerType, typename tableType,
+	typename indexType = std::make_index_sequence<tableType::size>>
+struct McIoPacketJumpTable;
+
+template<typename handlerType, McIoProtocolState State, McIoPacketDirection Direction,
+	typename... routeTypes, size_t... packetIds>
+struct McIoPacketJumpTable<handlerType, McIoPacketTable<State, Direction, routeTypes...>,
+	std::index_sequence<packetIds...>> {
+
+	/// The entries indexed by the packet id.
+	static constexpr McIoPacketEntry<handlerType> entries[sizeof...(packetIds)] = {
+		McIoPacketEntryOf<handlerType, (int32_t)packetIds, routeTypes...>::value... };
+};
+
+template<typename handlerType, McIoProtocolState State, McIoPacketDirection Direction,
+	typename... routeTypes, size_t... packetIds>
+constexpr McIoPacketEntry<handlerType> McIoPacketJumpTable<handlerType,
+	McIoPacketTable<State, Direction, routeTypes...>, std::index_sequence<packetIds...>>
+	::entries[sizeof...(packetIds)];
+
+/// The jump table of a protocol state inside the registry.
+template<typename handlerType> struct McIoPacketStateTable {
+	/// The entries indexed by the packet id, null if no packet is routed.
+	const McIoPacketEntry<handlerType>* entries;
+
+	/// The number of entries.
+	size_t size;
+};
+
+/// Find the jump table of the protocol state among the tables.
+template<typename handlerType, McIoProtocolState state, typename... tableTypes>
+struct McIoPacketStateOf {
+	static constexpr size_t count = 0;
+	static constexpr McIoPacketStateTable<handlerType> value() { return { nullptr, 0 }; }
+};
+
+template<typename handlerType, McIoProtocolState state, typename tableType, typename... tableTypes>
+struct McIoPacketStateOf<handlerType, state, tableType, tableTypes...> {
+	typedef McIoPacketStateOf<handlerType, state, tableTypes...> nextType;
+	static constexpr size_t count = (tableType::state == state? 1 : 0) + nextType::count;
+	static constexpr McIoPacketStateTable<handlerType> value() {
+		return tableType::state == state? McIoPacketStateTable<handlerType> {
+			McIoPacketJumpTable<handlerType, tableType>::entries, tableType::size } :
+			nextType::value();
+	}
+};
+
+/// Whether the tables are all in the direction.
+template<McIoPacketDirection direction, typename... tableTypes> struct McIoPacketDirectionOf {
+	static constexpr bool value = true;
+};
+
+template<McIoPacketDirection direction, typename tableType, typename... tableTypes>
+struct McIoPacketDirectionOf<direction, tableType, tableTypes...> {
+	static constexpr bool value = tableType::direction == direction
+		&& McIoPacketDirectionOf<direction, tableTypes...>::value;
+};
+
+/**
+ * @brief The registry of the packets received by the handler, made up of
+ * the tables (McIoPacketTable) of the protocol states.
+ *
+ * The states without table have no packet routed, and each state could
+ * have at most one table.
+ */
+template<typename HandlerType, McIoPacketDirection Direction, typename... tableTypes>
+struct McIoPacketRegistry {
+	static_assert(McIoPacketDirectionOf<Direction, tableTypes...>::value,
+		"The tables of the registry must be in the same direction.");
+	static_assert(McIoPacketStateOf<HandlerType, psHandshake, tableTypes...>::count <= 1
+		&& McIoPacketStateOf<HandlerType, psStatus, tableTypes...>::count <= 1
+		&& McIoPacketStateOf<HandlerType, psLogin, tableTypes...>::count <= 1
+		&& McIoPacketStateOf<HandlerType, psPlay, tableTypes...>::count <= 1,
+		"The registry could have at most one table of each protocol state.");
+
+	/// The handler receiving the packets.
+	typedef HandlerType handlerType;
+
+	/// The direction of the packets received.
+	static constexpr McIoPacketDirection direction = Direction;
+
+	/// The jump tables indexed by the protocol state.
+	static constexpr McIoPacketStateTable<handlerType> states[psNumStates] = {
+		McIoPacketStateOf<handlerType, psHandshake, tableTypes...>::value(),
+		McIoPacketStateOf<handlerType, psStatus, tableTypes...>::value(),
+		McIoPacketStateOf<handlerType, psLogin, tableTypes...>::value(),
+		McIoPacketStateOf<handlerType, psPlay, tableTypes...>::value() };
+
+	/**
+	 * @brief Decode the packet id and dispatch the packet to its route.
+	 *
+	 * @param[in] handler the handler of the packet.
+	 * @param[in] state the current protocol state.
+	 * @param[in] packetSize the size of the packet including the packet id.
+	 * @param[inout] inputStream the stream of the packet.
+	 * @throw std::runtime_error when the packet id is malformed or not
+	 * routed in the protocol state.
+	 */
+	static void dispatch(handlerType& handler, McIoProtocolState state,
+			size_t packetSize, McIoMarkableStream& inputStream) {
+		// Decode the packet id, which is almost always a single byte, so the
+		// size of it is counted while decoding. The last byte must not carry
+		// bits beyond 32-bit, as is checked by mc::var32::read().
+		uint32_t packetId = 0; size_t idSize = 0;
+		unsigned char current;
+		do {
+			if(idSize == McDtWireCodec<mc::var32>::maximumSize || idSize == packetSize)
+				throw std::runtime_error("Malformed packet id.");
+			inputStream.readFast((char*)&current, 1);
+			if(idSize == McDtWireCodec<mc::var32>::maximumSize - 1 && current > 0x0f)
+				throw std::runtime_error("Malformed packet id.");
+			packetId |= ((uint32_t)current & 0x07f) << (idSize * 7);
+			++ idSize;
+		} while((current & 0x080) != 0);
+
+		// Look up the jump table of current state.
+		if((size_t)state >= (size_t)psNumStates)
+			throw std::runtime_error("Invalid protocol state.");
+		const McIoPacketStateTable<handlerType>& table = states[state];
+		if(packetId >= table.size || table.entries[packetId] == nullptr)
+			throw std::runtime_error("The packet id is not routed in current protocol state.");
+		table.entries[packetId](handler, packetSize - idSize, inputStream);
+	}
+};
+
+template<typename HandlerType, McIoPacketDirection Direction, typename... tableTypes>
+constexpr McIoPacketStateTable<HandlerType> McIoPacketRegistry<
+	HandlerType, Direction, tableTypes...>::states[psNumStates];
+
+/**
+ * @brief The connection dispatching the inbound packets by the registry.
+ *
+ * The derived class must define the packetRegistry type, which is the
+ * McIoPacketRegistry whose handler is the derived class. Switching the
+ * protocol state is just updating the index of the jump tables.
+ */
+template<typename derivedType>
+class McIoProtocolConnection : public McIoConnection {
+	/// The current protocol state.
+	McIoProtocolState protocolState;
+
+	/// Dispatch the packet to the route of current protocol state.
+	virtual void handle(size_t packetSize, McIoMarkableStream& inputStream) override {
+		typedef typename derivedType::packetRegistry registryType;
+		static_assert(std::is_same<typename registryType::handlerType, derivedType>::value,
+			"The handler of the packet registry must be the connection.");
+		registryType::dispatch(static_cast<derivedType&>(*this),
+			protocolState, packetSize, inputStream);
+	}
+public:
+	/// @brief Construct the connection in the initial protocol state.
+	McIoProtocolConnection(int sockfd, McIoProtocolState initialState = psHandshake):
+		McIoConnection(sockfd), protocolState(initialState) {}
+
+	/**
+	 * @brief Switch the protocol state, which takes effect from the next
+	 * packet, even if it has been read along with current one.
+	 * @throw std::runtime_error when the state is invalid.
+	 */
+	void setProtocolState(McIoProtocolState state) {
+		if((size_t)state >= (size_t)psNumStates)
+			throw std::runtime_error("Invalid protocol state.");
+		protocolState = state;
+	}
+
+	/// @brief Retrieve current protocol state.
+	McIoProtocolState getProtocolState() const noexcept { return protocolState; }
+
+	// The packets written in the raw and framed forms.
+	using McIoConnection::writePacket;
+
+	/**
+	 * @brief Encode the packet by the schema following the packet id, and
+	 * write it to the connection.
+	 *
+	 * @param[in] packetId the id of the packet.
+	 * @param[in] packet the packet to encode.
+	 * @throw std::runtime_error when the packet is not encodable.
+	 */
+	template<typename schemaType>
+	void writePacket(int32_t packetId, const typename schemaType::classType& packet) {
+		McIoBufferOutputStream outputStream(McDtWireCodec<mc::var32>::maximumSize
+			+ (schemaType::isFixedSize? schemaType::minimumSize : 0));
+		outputStream << mc::var32(packetId);
+		schemaType::write(outputStream, packet);
+		McIoConnection::writePacket(std::move(outputStream));
+	}
+};
\ No newline at end of file
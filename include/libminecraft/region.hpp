@@ -0,0 +1,203 @@
+#pragma once
+/**
+ * @file libminecraft/region.hpp
+ * @brief The Anvil region file
+ * @author Haoran Luo
+ *
+ * Defines the reader of the Anvil region files (.mca), which store 32x32
+ * chunks of the world storage. The region file is made up of 4 KiB sectors,
+ * where the first sector is the chunk locations and the second sector is
+ * the chunk timestamps, and each chunk is stored as:
+ *
+ * '''
+ * chunk ::= length(u32) compression(u8) compressedNbt
+ * '''
+ *
+ * The region file is memory mapped and the chunk index is parsed on opening,
+ * while the chunks are only inflated and decoded when requested, either into
+ * the read-only view (see nbtview.hpp) or by SAX reading while inflating.
+ *
+ * The chunk packet cache stores fully serialized chunk data packets in a
+ * file (or an anonymous memory file), so the hot chunks could be sent to the
+ * joining players by McIoWritable::sendfile() without encoding per player.
+ *
+ * The classes in this file are NOT multi-thread safe, and never share
+ * instances of them among threads.
+ */
+#include "libminecraft/nbt.hpp"
+#include "libminecraft/nbtview.hpp"
+#include "libminecraft/writable.hpp"
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <cstdint>
+
+/// The compression scheme of the chunk inside the region file.
+enum McIoRegionCompression {
+	rcGzip = 1,		///< Compressed by gzip (RFC1952), rarely used.
+	rcZlib = 2,		///< Compressed by zlib (RFC1950), which is the default.
+	rcNone = 3		///< Not compressed.
+};
+
+/// @brief The memory mapped region file.
+class McIoRegionFile {
+public:
+	/// The size of the sectors in the region file.
+	static const size_t sectorSize = 4096;
+
+	/// The number of chunks along each axis of the region.
+	static const size_t regionWidth = 32;
+
+	/// The maximum size of the inflated chunk, which is 32 MiB. The larger
+	/// chunks are treated as malformed, so a crafted chunk could not inflate
+	/// into unbounded memory.
+	static const size_t maxInflatedSize = 32 * 1024 * 1024;
+
+	/**
+	 * @brief Open and map the region file, parsing the chunk index.
+	 * @param[in] path the path to the region file.
+	 * @throw std::runtime_error when the file cannot be mapped or the
+	 * header is malformed.
+	 */
+	McIoRegionFile(const char* path);
+
+	/// Unmap and close the region file.
+	~McIoRegionFile() noexcept;
+
+	// Copy sematics and move sematics are not allowed.
+	McIoRegionFile(const McIoRegionFile&) = delete;
+	McIoRegionFile& operator=(const McIoRegionFile&) = delete;
+
+	/// Whether the chunk at the local coordinate (0 to 31) is present.
+	bool hasChunk(int x, int z) const;
+
+	/// Retrieve the last modification time (in epoch seconds) of the chunk.
+	uint32_t timestamp(int x, int z) const;
+
+	/**
+	 * @brief Retrieve the compressed chunk inside the mapped file.
+	 * @return the (compression, size, data) tuple of the compressed nbt.
+	 * @throw std::runtime_error when the chunk is absent or malformed.
+	 */
+	std::tuple<McIoRegionCompression, size_t, const char*> rawChunk(int x, int z) const;
+
+	/**
+	 * @brief Inflate the chunk's nbt into the buffer, replacing its content.
+	 * @throw std::runtime_error when the chunk is absent or malformed, or it
+	 * is larger than maxInflatedSize once inflated.
+	 */
+	void inflateChunk(int x, int z, std::vector<char>& buffer) const;
+
+	/**
+	 * @brief Inflate the chunk and view its root compound lazily.
+	 * @param[out] buffer to store the inflated nbt, which must outlive the view.
+	 * @throw std::runtime_error when the chunk is absent or malformed.
+	 */
+	McDtNbtView viewChunk(int x, int z, std::vector<char>& buffer) const;
+
+	/**
+	 * @brief Perform SAX-style reading of the chunk's root compound while
+	 * inflating, without inflating the whole chunk into memory.
+	 *
+	 * See also McIoSaxNbtCompound() for the description of parameters.
+	 * @throw std::runtime_error when the chunk is absent or malformed.
+	 */
+	void saxChunk(int x, int z, void* data, void* ud,
+		int (*dictionary)(size_t tagLength, const char* tagName),
+		size_t numSaxActions, const McIoNbtCompoundSaxAction* const saxActions,
+		McDtNbtCompound* ignoredTag = nullptr) const;
+private:
+	/// The descriptor of the region file.
+	int fd;
+
+	/// The mapped region file.
+	const char* mapped;
+	size_t mappedSize;
+
+	/// The chunk index parsed from the header.
+	struct McIoRegionChunkEntry {
+		uint32_t sectorOffset;		///< The first sector, 0 if absent.
+		uint32_t sectorCount;		///< The number of sectors.
+		uint32_t timestamp;			///< The last modification time.
+	} entries[regionWidth * regionWidth];
+
+	/// Retrieve the entry of the local coordinate, throwing when out of range.
+	const McIoRegionChunkEntry& entry(int x, int z) const;
+};
+
+/**
+ * @brief The cache of serialized chunk data packets, stored in a file so
+ * that they could be sent by McIoWritable::sendfile().
+ *
+ * The packets must be framed (length prefixed, and compressed depending on
+ * the threshold) for the connections they are sent to, e.g. by storing the
+ * framed data of McIoBroadcastPacket. Erased packets are not reclaimed in
+ * the file until clear().
+ *
+ * The file is shared with the sendfile() queued in the writables, so that
+ * it stays open until they have been sent, even if the cache is destroyed.
+ * When clear() is called while there're queued sends, the packets are then
+ * stored into a new file instead of reclaiming the shared one.
+ */
+class McIoChunkPacketCache {
+public:
+	/**
+	 * @brief Create the cache in the specified file, which is truncated, or
+	 * in an anonymous memory file when the path is null.
+	 * @throw std::runtime_error when the file cannot be created.
+	 */
+	McIoChunkPacketCache(const char* path = nullptr);
+
+	/// Release the cache file, which is closed once the queued sends are done.
+	~McIoChunkPacketCache() noexcept;
+
+	// Copy sematics and move sematics are not allowed.
+	McIoChunkPacketCache(const McIoChunkPacketCache&) = delete;
+	McIoChunkPacketCache& operator=(const McIoChunkPacketCache&) = delete;
+
+	/// Retrieve the key of the chunk by its world chunk coordinate.
+	static uint64_t key(int32_t chunkX, int32_t chunkZ) noexcept
+		{	return ((uint64_t)(uint32_t)chunkX << 32) | (uint32_t)chunkZ;	}
+
+	/**
+	 * @brief Store the framed packet, replacing the previous one of the key.
+	 * @throw std::runtime_error when the packet cannot be written to the file.
+	 */
+	void store(uint64_t key, const char* framed, size_t size);
+
+	/// Whether the packet of the key is cached.
+	bool contains(uint64_t key) const { return index.count(key) > 0; }
+
+	/// Remove the packet of the key from the cache.
+	void erase(uint64_t key) { index.erase(key); }
+
+	/**
+	 * @brief Send the cached packet of the key to the writable. When the 
+	 * writable is encrypted, the packet is read from the file and written 
+	 * through the cipher instead, as sendfile() could not be used.
+	 *
+	 * @return whether the packet is cached and has been sent.
+	 * @throw std::runtime_error when the packet cannot be read from the file.
+	 */
+	bool send(McIoWritable& writable, uint64_t key) const;
+
+	/// Remove all packets and reclaim the file.
+	void clear();
+private:
+	/// The cache file, closed once released by the cache and the queued sends.
+	struct McIoChunkPacketFile;
+
+	/// The path of the cache file, empty for the anonymous memory file.
+	std::string path;
+
+	/// The cache file where new packets are stored.
+	std::shared_ptr<McIoChunkPacketFile> file;
+
+	/// The end of the cache file where new packets are appended.
+	size_t fileEnd;
+
+	/// The (offset, size) of the packets inside the cache file.
+	std::unordered_map<uint64_t, std::pair<size_t, size_t>> index;
+};
\ No newline at end of file
@@ -0,0 +1,327 @@
+#pragma once
+/**
+ * @file libminecraft/schema.hpp
+ * @brief The compile time packet schema
+ * @author Haoran Luo
+ *
+ * Defines the packet schema, which is a list of members (see member.hpp)
+ * and the wire types they are transmitted in. The encoding and decoding
+ * of the packet are generated from the list at compile time, so they are
+ * fully inlined without calling the virtual methods of the stream for
+ * each field.
+ *
+ * The bound of the encoded size is also known at compile time. When the
+ * packet is encoded, the exact size is computed first, then the packet
+ * is encoded into a buffer of that size and written to the stream at
+ * once, so the output buffer is sized and grown only once.
+ *
+ * A packet could be declared like:
+ *
+ * struct Handshake {
+ *     mc::var32 protocolVersion;
+ *     mc::ustring<255> serverAddress;
+ *     uint16_t serverPort;
+ *     int32_t nextState;
+ * };
+ *
+ * typedef McDtPacketSchema<
+ *     __mc_member(Handshake, protocolVersion),
+ *     __mc_member(Handshake, serverAddress),
+ *     McDtSchemaField<__mc_member(Handshake, serverPort), mc::u16>,
+ *     McDtSchemaField<__mc_member(Handshake, nextState), mc::var32>
+ * > HandshakeSchema;
+ *
+ * The members of mc:: data types are transmitted in their own types, while
+ * the members of plain types must specify their wire types explicitly.
+ */
+#include "libminecraft/iobase.hpp"
+#include "libminecraft/member.hpp"
+#include <climits>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/// The encoded size bound of the unbounded fields, e.g. unconstrained strings.
+static constexpr size_t McDtSchemaUnbounded = SIZE_MAX;
+
+/// Add the encoded size bounds, saturating to the unbounded.
+constexpr size_t McDtSchemaAddBound(size_t a, size_t b) {
+	return (a == McDtSchemaUnbounded || b == McDtSchemaUnbounded ||
+		a > McDtSchemaUnbounded - b)? McDtSchemaUnbounded : a + b;
+}
+
+/**
+ * @brief The codec that encodes the value of the wire type into raw bytes.
+ *
+ * Each specialization provides the compile time bound of the encoded size
+ * (minimumSize and maximumSize), the exact size of the encoded value
+ * (size()) and the encoding method (encode()), which writes exactly size()
+ * bytes and returns the end of the encoded bytes.
+ */
+template<typename wireType> struct McDtWireCodec {
+	static_assert(sizeof(wireType) == 0,
+		"The wire type is not supported by the packet schema.");
+};
+
+/// The codec of fixed length big endian primitives.
+template<typename T> struct McDtWireCodec<McDtDataType<T, McDtFlavourFixed>> {
+	typedef T valueType;
+	typedef typename McDtBulkTraits<McDtDataType<T, McDtFlavourFixed>>::wordType wordType;
+	static constexpr size_t minimumSize = sizeof(wordType);
+	static constexpr size_t maximumSize = sizeof(wordType);
+
+	static size_t size(const valueType&) { return sizeof(wordType); }
+
+	static char* encode(char* buffer, const valueType& value) {
+		wordType word; memcpy(&word, &value, sizeof(wordType));
+		return McIoStoreBigEndian<wordType>(buffer, word);
+	}
+};
+
+/// The codec of variant length integers, e.g. mc::var32 and mc::var64.
+template<typename T> struct McDtWireCodec<McDtDataType<T, McDtFlavourVariant>> {
+	typedef T valueType;
+	typedef typename std::make_unsigned<T>::type wordType;
+	static constexpr size_t minimumSize = 1;
+	static constexpr size_t maximumSize = (sizeof(T) * 8 + 6) / 7;
+
+	static size_t size(const valueType& value)
+		{	return McIoVariantSize<wordType>((wordType)value);	}
+
+	static char* encode(char* buffer, const valueType& value)
+		{	return McIoStoreVariant<wordType>(buffer, (wordType)value);	}
+};
+
+/// The codec of the var32 length prefixed utf-8 strings, e.g. mc::ustring.
+template<size_t maxLength>
+struct McDtWireCodec<McDtDataType<std::u16string, McDtFlavourString<maxLength>>> {
+	typedef std::u16string valueType;
+	static constexpr size_t minimumSize = 1;
+	static constexpr size_t maximumSize = maxLength == 0? McDtSchemaUnbounded :
+		McDtSchemaAddBound(McDtWireCodec<mc::var32>::maximumSize, maxLength * 3);
+
+	static size_t size(const valueType& value) {
+		if(maxLength != 0 && value.length() > maxLength) throw std::runtime_error(
+			std::string("The string is too long (must be shorter than ")
+				+ std::to_string(maxLength) + " code units).");
+		size_t byteLength = McIoUtf8Length(value.data(), value.length());
+		return McIoVariantSize<uint32_t>((uint32_t)byteLength) + byteLength;
+	}
+
+	static char* encode(char* buffer, const valueType& value) {
+		size_t byteLength = McIoUtf8Length(value.data(), value.length());
+		buffer = McIoStoreVariant<uint32_t>(buffer, (uint32_t)byteLength);
+		return buffer + McIoEncodeUtf8(value.data(), value.length(), buffer);
+	}
+};
+
+/// The codec of the big endian u16 length prefixed utf-8 strings, mc::jstring.
+template<> struct McDtWireCodec<mc::jstring> {
+	typedef std::u16string valueType;
+	static constexpr size_t minimumSize = 2;
+	static constexpr size_t maximumSize = 2 + USHRT_MAX;
+
+	static size_t size(const valueType& value) {
+		size_t byteLength = McIoUtf8Length(value.data(), value.length());
+		if(byteLength > USHRT_MAX) throw std::runtime_error(
+			"The length is too long for java string output.");
+		return 2 + byteLength;
+	}
+
+	static char* encode(char* buffer, const valueType& value) {
+		size_t byteLength = McIoUtf8Length(value.data(), value.length());
+		buffer = McIoStoreBigEndian<uint16_t>(buffer, (uint16_t)byteLength);
+		return buffer + McIoEncodeUtf8(value.data(), value.length(), buffer);
+	}
+};
+
+/// The codec of the length prefixed arrays, e.g. mc::array.
+template<typename V, typename L>
+struct McDtWireCodec<McDtDataType<std::vector<V>, McDtFlavourArray<L>>> {
+	typedef std::vector<V> valueType;
+	typedef McDtWireCodec<L> lengthCodec;
+	typedef McDtWireCodec<V> elementCodec;
+	typedef typename L::type lengthType;
+	static constexpr size_t minimumSize = lengthCodec::minimumSize;
+	static constexpr size_t maximumSize = McDtSchemaUnbounded;
+
+	static lengthType length(const valueType& value) {
+		lengthType lengthValue = value.size();
+		if((std::is_signed<lengthType>::value && lengthValue < 0)
+			|| (size_t)lengthValue != value.size()) throw std::runtime_error(
+			"The array is too large to be represented in the length type.");
+		return lengthValue;
+	}
+
+	static size_t size(const valueType& value) {
+		size_t result = lengthCodec::size(length(value));
+		if(elementCodec::minimumSize == elementCodec::maximumSize)
+			return result + value.size() * elementCodec::minimumSize;
+		for(auto iter = value.begin(); iter != value.end(); ++ iter)
+			result += elementCodec::size((const typename elementCodec::valueType&)*iter);
+		return result;
+	}
+
+	static char* encode(char* buffer, const valueType& value) {
+		buffer = lengthCodec::encode(buffer, length(value));
+		for(auto iter = value.begin(); iter != value.end(); ++ iter)
+			buffer = elementCodec::encode(buffer,
+				(const typename elementCodec::valueType&)*iter);
+		return buffer;
+	}
+};
+
+/**
+ * @brief The field of the packet schema, the member and the wire type in
+ * which the member is transmitted.
+ *
+ * When the member is an mc:: data type, the wire type defaults to it and
+ * the member is read in place. Otherwise the member of plain type is
+ * converted from and to the value type of the wire type.
+ */
+template<typename memberType, typename WireType = typename memberType::fieldType,
+	bool isWireMember = std::is_same<typename memberType::fieldType, WireType>::value>
+struct McDtSchemaField {
+	typedef typename memberType::classType classType;
+	typedef typename memberType::fieldType fieldType;
+	typedef WireType wireType;
+	typedef McDtWireCodec<wireType> codecType;
+	typedef typename codecType::valueType valueType;
+
+	/// Retrieve the value to encode.
+	static valueType get(const classType& object)
+		{	return static_cast<valueType>(object.*memberType::member);	}
+
+	/// Decode the member from the stream.
+	static void read(McIoInputStream& inputStream, classType& object) {
+		wireType value;
+		value.read(inputStream);
+		object.*memberType::member = static_cast<fieldType>((const valueType&)value);
+	}
+};
+
+template<typename memberType, typename WireType>
+struct McDtSchemaField<memberType, WireType, true> {
+	typedef typename memberType::classType classType;
+	typedef typename memberType::fieldType fieldType;
+	typedef WireType wireType;
+	typedef McDtWireCodec<wireType> codecType;
+	typedef typename codecType::valueType valueType;
+
+	static const valueType& get(const classType& object)
+		{	return (const valueType&)(object.*memberType::member);	}
+
+	static void read(McIoInputStream& inputStream, classType& object)
+		{	(object.*memberType::member).read(inputStream);	}
+};
+
+/// Convert the members to the schema fields, while the fields are kept.
+template<typename fieldType> struct McDtSchemaFieldOf { typedef fieldType type; };
+
+template<typename C, typename F, F C::*member>
+struct McDtSchemaFieldOf<McDtMemberType<C, F, member>>
+	{ typedef McDtSchemaField<McDtMemberType<C, F, member>> type; };
+
+/// The fold of the schema fields, see McDtPacketSchema for interface.
+template<typename classType, typename... fieldTypes> struct McDtSchemaFold {
+	static constexpr size_t minimumSize = 0;
+	static constexpr size_t maximumSize = 0;
+	static size_t size(const classType&) { return 0; }
+	static char* encode(char* buffer, const classType&) { return buffer; }
+	static void read(McIoInputStream&, classType&) {}
+};
+
+template<typename classType, typename fieldType, typename... fieldTypes>
+struct McDtSchemaFold<classType, fieldType, fieldTypes...> {
+	typedef typename fieldType::codecType codecType;
+	typedef McDtSchemaFold<classType, fieldTypes...> nextType;
+	static_assert(std::is_same<typename fieldType::classType, classType>::value,
+		"The fields of the packet schema must be members of the same class.");
+
+	static constexpr size_t minimumSize =
+		codecType::minimumSize + nextType::minimumSize;
+	static constexpr size_t maximumSize =
+		McDtSchemaAddBound(codecType::maximumSize, nextType::maximumSize);
+
+	static size_t size(const classType& object) {
+		return (codecType::minimumSize == codecType::maximumSize?
+			codecType::minimumSize : codecType::size(fieldType::get(object)))
+			+ nextType::size(object);
+	}
+
+	static char* encode(char* buffer, const classType& object) {
+		return nextType::encode(codecType::encode(
+			buffer, fieldType::get(object)), object);
+	}
+
+	static void read(McIoInputStream& inputStream, classType& object) {
+		fieldType::read(inputStream, object);
+		nextType::read(inputStream, object);
+	}
+};
+
+/**
+ * @brief The packet schema made up of the fields, which are either the
+ * members (McDtMemberType) of mc:: data types or the McDtSchemaField.
+ */
+template<typename firstField, typename... restFields> struct McDtPacketSchema {
+	/// The class of the packet.
+	typedef typename McDtSchemaFieldOf<firstField>::type::classType classType;
+
+	/// The fold of all fields.
+	typedef McDtSchemaFold<classType, typename McDtSchemaFieldOf<firstField>::type,
+		typename McDtSchemaFieldOf<restFields>::type...> foldType;
+
+	/// The minimum encoded size of the packet.
+	static constexpr size_t minimumSize = foldType::minimumSize;
+
+	/// The maximum encoded size, or McDtSchemaUnbounded if it is unbounded.
+	static constexpr size_t maximumSize = foldType::maximumSize;
+
+	/// Whether all fields are fixed length, so the packet is.
+	static constexpr bool isFixedSize = minimumSize == maximumSize;
+
+	/// The packets not larger than this size are encoded on the stack.
+	static constexpr size_t stackBufferSize = 256;
+
+	/**
+	 * @brief Retrieve the exact encoded size of the packet.
+	 * @throw std::runtime_error when the field is not encodable, e.g. the
+	 * string is too long.
+	 */
+	static size_t encodedSize(const classType& object) {
+		return isFixedSize? minimumSize : foldType::size(object);
+	}
+
+	/**
+	 * @brief Encode the packet into the buffer.
+	 *
+	 * The buffer must hold at least encodedSize() bytes, which must be
+	 * called once before encoding to validate the fields.
+	 *
+	 * @return the end of the encoded bytes.
+	 */
+	static char* encode(char* buffer, const classType& object) {
+		return foldType::encode(buffer, object);
+	}
+
+	/// Encode the packet and write to the stream at once.
+	static McIoOutputStream& write(McIoOutputStream& outputStream, const classType& object) {
+		size_t size = encodedSize(object);
+		if(size <= stackBufferSize) {
+			char buffer[stackBufferSize];
+			outputStream.write(buffer, encode(buffer, object) - buffer);
+		}
+		else {
+			std::vector<char> buffer(size);
+			outputStream.write(buffer.data(), encode(buffer.data(), object) - buffer.data());
+		}
+		return outputStream;
+	}
+
+	/// Decode the packet from the stream, using the read window if any.
+	static McIoInputStream& read(McIoInputStream& inputStream, classType& object) {
+		foldType::read(inputStream, object);
+		return inputStream;
+	}
+};
\ No newline at end of file
@@ -15,14 +15,52 @@
  *   the stream status will become undefined therefore and the 
  *   program should close the stream since it always indicates 
  *   failure of reading or writing more data.
+ *
+ * An input stream could also expose a window of contiguous data, like the
+ * get area of std::streambuf. Data inside the window could be decoded 
+ * directly by inline code, without invoking the virtual read() method.
  */
 #include <cstddef>
+#include <cstring>
  
 /// @brief Abstraction for the input stream.
 class McIoInputStream {
+protected:
+	/// The window of data that could be consumed without calling read(), 
+	/// which is maintained by the concrete stream and is empty by default. 
+	/// Data in the window always precedes the data returned by read().
+	const char *windowBegin, *windowEnd;
+	
+	/// The constructor of the input stream, with an empty window.
+	McIoInputStream(): windowBegin(nullptr), windowEnd(nullptr) {}
 public:
 	virtual ~McIoInputStream() {}
 	
+	/// @brief Retrieve the beginning of the window.
+	inline const char* window() const noexcept { return windowBegin; }
+	
+	/// @brief Retrieve the number of bytes in the window.
+	inline size_t windowSize() const noexcept { return windowEnd - windowBegin; }
+	
+	/// @brief Consume the data in the window, the consumed size must not 
+	/// exceed the window size.
+	inline void consume(size_t length) noexcept { windowBegin += length; }
+	
+	/**
+	 * @brief Receive data from the window when it has enough data, or 
+	 * from the read() method otherwise.
+	 *
+	 * @param[out] buffer the buffer to receive data from the stream.
+	 * @param[in] receiveLength the length of the data to receive.
+	 */
+	inline void readFast(char* buffer, size_t receiveLength) {
+		if(windowSize() >= receiveLength) {
+			memcpy(buffer, windowBegin, receiveLength);
+			windowBegin += receiveLength;
+		}
+		else read(buffer, receiveLength);
+	}
+	
 	/**
 	 * @brief the very interface for receiving data from stream.
 	 *
@@ -0,0 +1,112 @@
+#pragma once
+/**
+ * @file libminecraft/threadpool.hpp
+ * @brief Thread Pool Executor Service
+ * @author Haoran Luo
+ *
+ * Defines the executor service running the future tasks on worker threads,
+ * so that the CPU heavy tasks (compressing chunks, decoding regions or
+ * parsing large nbt) do not run on the threads of the multiplexers.
+ *
+ * Each worker owns a queue of tasks. Tasks enqueued by a worker (from inside
+ * a running task) go to its own queue, and the others are distributed in
+ * round-robin manner. The idle workers steal from the other workers' queues
+ * before sleeping.
+ *
+ * The task could be submitted along with a completion queue, which is the
+ * descriptor inserted into a multiplexer. When the task finishes, it is
+ * posted back to the completion queue, and its completion handler runs on
+ * the thread of that multiplexer, where the results could be written to
+ * the McIoWritable safely.
+ */
+#include "libminecraft/future.hpp"
+#include "libminecraft/multiplexer.hpp"
+#include <functional>
+#include <exception>
+#include <memory>
+#include <cstddef>
+
+// For pointer reference in the completion queue.
+struct McIoCompletionQueueState;
+
+/**
+ * @brief The descriptor receiving the tasks finished by the worker threads,
+ * which runs their completion handlers on the thread of its multiplexer.
+ *
+ * The completions posted after the descriptor has been removed from the
+ * multiplexer are dropped, with their tasks destroyed on the worker threads.
+ */
+class McIoCompletionQueue : public McIoDescriptor {
+	/// The state shared with the workers.
+	std::shared_ptr<McIoCompletionQueueState> state;
+
+	// The thread pool posts completions to the state.
+	friend class McOsThreadPoolExecutor;
+public:
+	/// The handler receiving the finished task, and the exception thrown by
+	/// the task (or null if the task has finished normally).
+	typedef std::function<void(std::unique_ptr<McOsFutureTask>& task,
+			std::exception_ptr exception)> completionHandlerType;
+
+	McIoCompletionQueue();
+	~McIoCompletionQueue() noexcept;
+
+	// Run the completion handlers of the posted tasks.
+	virtual McIoNextStatus handle(McIoEvent& eventFlag) override;
+};
+
+/**
+ * @brief The executor service running the tasks on the worker threads.
+ *
+ * The tasks' advance() is called repeatedly on a worker until the task
+ * finishes, and tasks of higher priority run first. All methods except
+ * the destructor are MT-Safe.
+ */
+class McOsThreadPoolExecutor : public McOsExecutorService {
+public:
+	/// The pool's pimpl block size.
+	static const size_t poolControlBlockSize = 192;
+
+	/**
+	 * @brief Construct the pool and start its worker threads.
+	 * @param[in] numThreads the number of workers, 0 for one worker per core.
+	 */
+	McOsThreadPoolExecutor(size_t numThreads = 0);
+
+	/// Stop and join the workers. The tasks that have not finished are
+	/// destroyed, without their completions posted.
+	~McOsThreadPoolExecutor() noexcept;
+
+	// Copy sematics and move sematics are not allowed.
+	McOsThreadPoolExecutor(const McOsThreadPoolExecutor&) = delete;
+	McOsThreadPoolExecutor& operator=(const McOsThreadPoolExecutor&) = delete;
+	McOsThreadPoolExecutor(McOsThreadPoolExecutor&&) = delete;
+	McOsThreadPoolExecutor& operator=(McOsThreadPoolExecutor&&) = delete;
+
+	/// @brief Retrieve the number of worker threads.
+	size_t size() const noexcept;
+
+	// The inherited executor interface, the task is of normal priority and
+	// destroyed on the worker thread when it finishes.
+	virtual void enqueue(std::unique_ptr<McOsFutureTask>& task) override;
+
+	// The inherited executor interface with priority.
+	virtual void enqueue(std::unique_ptr<McOsFutureTask>& task,
+			McOsFuturePriority priority) override;
+
+	/**
+	 * @brief Run the task on the workers, and post it back to the completion
+	 * queue when it finishes.
+	 *
+	 * @param[inout] task the task to run, which is always moved.
+	 * @param[in] completion the completion queue receiving the finished task.
+	 * @param[in] handler the handler run on the completion queue's thread.
+	 * @param[in] priority the priority of the task.
+	 */
+	void submit(std::unique_ptr<McOsFutureTask>& task, McIoCompletionQueue& completion,
+			McIoCompletionQueue::completionHandlerType handler,
+			McOsFuturePriority priority = McOsFuturePriority::fpNormal);
+private:
+	/// The pointer-to-impl of the pool.
+	char control[poolControlBlockSize];
+};
\ No newline at end of file
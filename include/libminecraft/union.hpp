@@ -401,6 +401,7 @@ public:
 				info.template byOrdinalNoThrow<McDtUnionAction::moveConstruct>
 					(type, valueValid, (char*)value, (char*)a.value);
 		}
+		return *this;
 	}
 	
 	/// Specially construction from another pointer with given ordinal.
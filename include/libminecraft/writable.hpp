@@ -17,8 +17,25 @@
  * descriptor's interface, to avoid DDoD multi-inheritance problem.
  */
 #include "libminecraft/multiplexer.hpp"
+#include "libminecraft/broadcast.hpp"
 #include <cstdint>
 
+/// The stream encryption state of a connection, see also McIoWritable::setWriteCipher().
+struct McIoCipherControl;
+
+/// The corking mode of the writable, see also McIoWritable::setCorkMode().
+enum McIoCorkMode {
+	/// Every write is attempted instantly, which is the default mode.
+	ckNone = 0,
+	
+	/// Writes are staged and written out on flush().
+	ckStaged,
+	
+	/// Like ckStaged, but also holds TCP_CORK on the socket while a flush 
+	/// takes more than one system call, so that partial segments are not sent.
+	ckStagedTcpCork
+};
+
 /**
  * @brief The writable interface that manages non-blocking write
  * to the file descriptor.
@@ -79,6 +96,17 @@ public:
 	void write(const std::shared_ptr<char>& buffer, 
 			size_t offset, size_t length);
 	
+	/**
+	 * @brief Writing the broadcast packet.
+	 *
+	 * The packet's buffer is enqueued by reference, so the same packet 
+	 * could be written to many writables without being copied, even if 
+	 * the write could only be partially completed.
+	 *
+	 * @param[in] packet the broadcast packet to send.
+	 */
+	void write(const McIoBroadcastPacket& packet);
+	
 	/**
 	 * @brief Send a file described by the descriptor.
 	 *
@@ -91,22 +119,163 @@ public:
 	 * @param[in] sendfd the file descriptor to send.
 	 * @param[in] offset offset of the file to send.
 	 * @param[in] size the size of the file to send.
+	 * @throw std::runtime_error when the written data is encrypted, as the 
+	 * file is sent by the kernel without passing through the cipher.
 	 */
 	void sendfile(int sendfd, ssize_t offset, size_t size);
 	
+	/**
+	 * @brief Send a file described by the descriptor, keeping the owner of
+	 * the descriptor until the file has been sent (or dropped), so that the
+	 * descriptor could be closed by the owner's destructor then.
+	 *
+	 * @param[in] sendfd the file descriptor to send.
+	 * @param[in] offset offset of the file to send.
+	 * @param[in] size the size of the file to send.
+	 * @param[in] owner the object holding the file descriptor open.
+	 * @throw std::runtime_error when the written data is encrypted.
+	 */
+	void sendfile(int sendfd, ssize_t offset, size_t size, 
+			const std::shared_ptr<void>& owner);
+	
+	/// @brief Retrieve whether the data written is encrypted, see also 
+	/// setWriteCipher(), so that sendfile() could not be used.
+	bool isWriteEncrypted() const noexcept;
+	
+	/**
+	 * @brief Change the corking mode of the writable.
+	 *
+	 * Under the corked modes, buffers passed to write() are appended to a 
+	 * staging buffer, and shared pointers and files are queued after it,
+	 * instead of being written instantly. The descriptor will be requested
+	 * to flush at the end of current multiplexer round, and the decorated 
+	 * descriptor's handleFlush() must invoke flush() then. So multiple 
+	 * packets written in single round are coalesced into few system calls.
+	 *
+	 * Switching back to ckNone flushes the staged data instantly.
+	 *
+	 * @param[in] corkMode the new corking mode.
+	 */
+	void setCorkMode(McIoCorkMode corkMode);
+	
+	/// @brief Retrieve current corking mode.
+	McIoCorkMode getCorkMode() const noexcept;
+	
+	/**
+	 * @brief Attempt to write out the staged and queued data.
+	 *
+	 * If the descriptor is already waiting for writability, the staged data
+	 * is just queued. And if data could not be fully written out, the rest 
+	 * will be written when the descriptor becomes writable.
+	 */
+	void flush();
+	
+	/// The statistics of the writable.
+	struct McIoWritableStats {
+		uint64_t bytesWritten;      ///< Bytes written to the descriptor.
+		uint64_t queuedSize;        ///< Bytes staged or queued but not written.
+		uint64_t queuedHighWater;   ///< The high-water mark of the queuedSize.
+	};
+	
+	/**
+	 * @brief Retrieve the statistics of the writable, which must be called 
+	 * on the thread of its multiplexer. Only the queuedSize is maintained 
+	 * when the metrics are disabled.
+	 */
+	McIoWritableStats writableStats() const noexcept;
+	
+	/**
+	 * @brief Retrieve the number of bytes staged or queued but not yet 
+	 * written, which is maintained regardless of the metrics.
+	 */
+	size_t getQueuedSize() const noexcept;
+	
+	/**
+	 * @brief Set the watermarks of the queued size.
+	 *
+	 * When the queued size reaches the high watermark, handleHighWatermark()
+	 * is invoked, and handleLowWatermark() is invoked when it drops back to 
+	 * the low watermark then. So the application could stop producing data 
+	 * (streaming chunks, etc.) for the slow consumer in between, and the 
+	 * memory held by its queue stays bounded.
+	 *
+	 * The handlers are invoked at the end of the write(), sendfile(), flush()
+	 * and handleWrite() which have made the queued size cross the watermark,
+	 * and the exceptions thrown by them are propagated.
+	 *
+	 * @param[in] lowWatermark the low watermark in bytes.
+	 * @param[in] highWatermark the high watermark in bytes, or 0 to disable 
+	 * the watermarks, which is the default.
+	 * @throw std::runtime_error when the low watermark is not below the high.
+	 */
+	void setWatermarks(size_t lowWatermark, size_t highWatermark);
+	
+	/// @brief Retrieve the low watermark.
+	size_t getLowWatermark() const noexcept;
+	
+	/// @brief Retrieve the high watermark, 0 if the watermarks are disabled.
+	size_t getHighWatermark() const noexcept;
+	
+	/// @brief Whether the high watermark has been reached, and the queued 
+	/// size has not dropped back to the low watermark since.
+	bool isAboveWatermark() const noexcept;
+	
 	/// The control block size of the underlying data.
-	static const size_t writableControlBlockSize = 260;
+	static const size_t writableControlBlockSize = 352;
 private:
 	/// The pimpl-style control field.
 	char control[writableControlBlockSize];
+	
+	/// Invoke the watermark handler if the queued size has crossed them.
+	void updateWatermark();
 protected:
+	/**
+	 * @brief Invoked when the queued size reaches the high watermark.
+	 * The default implementation does nothing.
+	 */
+	virtual void handleHighWatermark() {}
+	
+	/**
+	 * @brief Invoked when the queued size drops back to the low watermark
+	 * after reaching the high watermark, or the watermarks are disabled 
+	 * then. The default implementation does nothing.
+	 */
+	virtual void handleLowWatermark() {}
+	
+	/**
+	 * @brief Encrypt the data passed to write() since then with the cipher,
+	 * which must outlive the writable, and could not be unset then. 
+	 *
+	 * The buffers are encrypted into a scratch buffer shared by all the 
+	 * writables on the same thread, which is copied only when the write could
+	 * not complete (or under corked modes), so the shared pointers and the 
+	 * broadcast packets passed in are never modified.
+	 *
+	 * @param[in] cipher the outbound cipher of the stream.
+	 */
+	void setWriteCipher(McIoCipherControl* cipher) noexcept;
+	
+	/**
+	 * @brief Writing data described in the shared pointer, which is taken 
+	 * over by the writable, so that it is encrypted in place instead of 
+	 * being copied when the cipher is set.
+	 *
+	 * @param[in] buffer the data to send, which must not be referred to by
+	 * others then.
+	 * @param[in] offset of the data in the shared pointer.
+	 * @param[in] length the length of the data.
+	 */
+	void writeExclusive(const std::shared_ptr<char>& buffer, 
+			size_t offset, size_t length);
+
 	/**
 	 * @brief In the descriptor's handle method, perform writing
 	 * when the descriptor has been prepared to write.
 	 *
 	 * When the activeEvent & McIoEvent::evOut is zero, the 
 	 * activeEvent stays indifferent, and the result will be 
-	 * McIoNextStatus::nstPoll.
+	 * McIoNextStatus::nstPoll. (Under corked modes, the staged data
+	 * will be flushed first if indicateClose() has been called.)
 	 *
 	 * When data still can't be fully written out in this invocation
 	 * to handleWrite(), the activeEvent stays indifferent and the 
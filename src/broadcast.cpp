@@ -0,0 +1,36 @@
+/**
+ * @file broadcast.cpp
+ * @brief Implementation for broadcast.hpp.
+ * @author Haoran Luo
+ *
+ * For interface specification, please refer to the corresponding header.
+ * @see libminecraft/broadcast.hpp
+ */
+#include "libminecraft/broadcast.hpp"
+#include "compression.hpp"
+#include <cstring>
+
+// Implementation for McIoBroadcastPacket::McIoBroadcastPacket().
+McIoBroadcastPacket::McIoBroadcastPacket(const McIoBufferOutputStream& packet,
+	int compressionThreshold): buffer(), size(0), 
+	compressionThreshold(compressionThreshold < 0? -1 : compressionThreshold) {
+	
+	const char* framed;
+	if(compressionThreshold < 0) std::tie(size, framed) = packet.lengthPrefixedData();
+	else {
+		// The compression state is kept per thread, so that the zlib state
+		// is not initialized for every broadcast packet.
+		static thread_local std::unique_ptr<McIoCompressionControl> compression;
+		if(compression == nullptr) compression.reset(
+				new McIoCompressionControl((size_t)compressionThreshold));
+		else compression -> threshold = (size_t)compressionThreshold;
+		
+		const char* rawData; size_t rawSize;
+		std::tie(rawSize, rawData) = packet.rawData();
+		std::tie(size, framed) = compression -> deflate(rawData, rawSize);
+	}
+	
+	// Copy the framed data into the shared buffer, once for all receivers.
+	buffer = std::shared_ptr<char>(new char[size], std::default_delete<char[]>());
+	memcpy(buffer.get(), framed, size);
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+/**
+ * @file bufpool.cpp
+ * @brief Implementation for bufpool.hpp.
+ * @author Haoran Luo
+ *
+ * For interface specification, please refer to the corresponding header.
+ * @see libminecraft/bufpool.hpp
+ */
+#include "libminecraft/bufpool.hpp"
+#include <cstring>
+#include <new>
+
+// Retrieve the index of the size class, or numSizeClasses if too large.
+static inline size_t McIoBufferPoolSizeClass(size_t size) {
+	size_t sizeClass = 0;
+	size_t classSize = ((size_t)1) << McIoBufferPool::minSizeClassShift;
+	while(classSize < size && sizeClass < McIoBufferPool::numSizeClasses) {
+		classSize = classSize << 1;
+		++ sizeClass;
+	}
+	return sizeClass;
+}
+
+// Retrieve the size of the buffer in given size class.
+static inline size_t McIoBufferPoolClassSize(size_t sizeClass) {
+	return ((size_t)1) << (McIoBufferPool::minSizeClassShift + sizeClass);
+}
+
+// The next pointer of free buffers is stored at the head of the buffer.
+static inline char*& McIoBufferPoolNext(char* buffer) {
+	return *reinterpret_cast<char**>(buffer);
+}
+
+// Implementation for McIoBufferPool::McIoBufferPool().
+McIoBufferPool::McIoBufferPool(): maxRetainedSize(defaultMaximumRetainedSize) {
+	for(size_t i = 0; i < numSizeClasses; ++ i) freeLists[i] = nullptr;
+	memset(&statistics, 0, sizeof(statistics));
+}
+
+// Implementation for McIoBufferPool::~McIoBufferPool().
+McIoBufferPool::~McIoBufferPool() noexcept {
+	for(size_t i = 0; i < numSizeClasses; ++ i) {
+		while(freeLists[i] != nullptr) {
+			char* buffer = freeLists[i];
+			freeLists[i] = McIoBufferPoolNext(buffer);
+			delete[] buffer;
+		}
+	}
+}
+
+// Implementation for McIoBufferPool::acquire().
+char* McIoBufferPool::acquire(size_t size) {
+	size_t sizeClass = McIoBufferPoolSizeClass(size);
+	char* buffer = nullptr;
+	size_t bufferSize = size;
+
+	if(sizeClass < numSizeClasses) {
+		bufferSize = McIoBufferPoolClassSize(sizeClass);
+		if(freeLists[sizeClass] != nullptr) {
+			// Take the buffer from the free list.
+			buffer = freeLists[sizeClass];
+			freeLists[sizeClass] = McIoBufferPoolNext(buffer);
+			statistics.retainedSize -= bufferSize;
+			++ statistics.hit;
+		}
+		else buffer = new char[bufferSize];
+	}
+	else buffer = new char[bufferSize];
+
+	// Update the statistics.
+	++ statistics.acquired;
+	statistics.inUseSize += bufferSize;
+	if(statistics.inUseSize > statistics.inUseHighWater)
+		statistics.inUseHighWater = statistics.inUseSize;
+	return buffer;
+}
+
+// Implementation for McIoBufferPool::release().
+void McIoBufferPool::release(char* buffer, size_t size) noexcept {
+	if(buffer == nullptr) return;
+	size_t sizeClass = McIoBufferPoolSizeClass(size);
+	size_t bufferSize = sizeClass < numSizeClasses?
+			McIoBufferPoolClassSize(sizeClass) : size;
+	statistics.inUseSize -= bufferSize;
+
+	// Place it into the free list when there's still quota for it.
+	if(sizeClass < numSizeClasses &&
+		statistics.retainedSize + bufferSize <= maxRetainedSize) {
+		McIoBufferPoolNext(buffer) = freeLists[sizeClass];
+		freeLists[sizeClass] = buffer;
+		statistics.retainedSize += bufferSize;
+	}
+	else delete[] buffer;
+}
+
+// Implementation for McIoBufferPool::setMaximumRetainedSize().
+void McIoBufferPool::setMaximumRetainedSize(size_t newSize) noexcept {
+	maxRetainedSize = newSize;
+
+	// Free buffers in the largest size classes first.
+	for(size_t i = numSizeClasses; i > 0 &&
+			statistics.retainedSize > maxRetainedSize; -- i) {
+		while(freeLists[i - 1] != nullptr &&
+				statistics.retainedSize > maxRetainedSize) {
+			char* buffer = freeLists[i - 1];
+			freeLists[i - 1] = McIoBufferPoolNext(buffer);
+			statistics.retainedSize -= McIoBufferPoolClassSize(i - 1);
+			delete[] buffer;
+		}
+	}
+}
+
+// Implementation for McIoBufferPool::getMaximumRetainedSize().
+size_t McIoBufferPool::getMaximumRetainedSize() const noexcept {
+	return maxRetainedSize;
+}
+
+// Implementation for McIoBufferPool::stats().
+McIoBufferPool::McIoBufferPoolStats McIoBufferPool::stats() const noexcept {
+	return statistics;
+}
\ No newline at end of file
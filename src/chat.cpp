@@ -14,6 +14,11 @@
 #include <stdexcept>
 #include <stack>
 #include <memory>
+#include <vector>
+#include <cstring>
+
+// Write the length prefixed json of the chat, see below.
+static McIoOutputStream& McIoWriteChatJson(McIoOutputStream& outputStream, const std::string& json);
 
 // Implementation for the forwarded McDtDataType methods.
 template<>
@@ -30,19 +35,10 @@ McIoInputStream& mc::chat::read(McIoInputStream& inputStream) {
 
 template<>
 McIoOutputStream& mc::chat::write(McIoOutputStream& outputStream) const {
-	// Serialize the chat into a buffer.
-	McIoBufferOutputStream bufferStream;
-	McIoWriteChatCompound(bufferStream, data);
-	
-	// Retrieve and validate the chat data.
-	size_t chatLength; const char* chatData;
-	std::tie(chatLength, chatData) = bufferStream.rawData();
-	if(chatLength > 32767) throw std::runtime_error("Chat is too long.");
-	
-	// Write out the chat.
-	mc::s32 length = chatLength; outputStream << length;
-	outputStream.write(chatData, chatLength);
-	return outputStream;
+	// Serialize the chat into a string and write out at once.
+	std::string json;
+	McIoWriteChatCompound(json, data);
+	return McIoWriteChatJson(outputStream, json);
 }
 
 /// The event work data maintaining action and value for events composing
@@ -265,7 +261,6 @@ struct McDtClickEventFieldHandler {
 /// it determines this object could be merged with its left side.
 /// This avoids performing excessive new operation when it is not essential.
 struct McDtChatCompoundWorkData : public McDtJsonWorkData {
-	typedef std::list<McDtChatCompound> McDtChatCompoundList;
 	bool autoCompact, canPerformMerge;
 	McDtChatCompound thisCompound;
 	McDtChatCompoundList* parentCompound;
@@ -498,7 +493,7 @@ public:
 			case cpcExtra: {
 				octx.context = cpcChatCompound;
 				auto& compound = toCompound(ctx);
-				std::list<McDtChatCompound>* compoundList = ctx.context == cpcWith? 
+				McDtChatCompoundList* compoundList = ctx.context == cpcWith? 
 						&(compound.with) : &(compound.extra);
 				
 				// Add to parent's extra and begin parse of child structure.
@@ -560,9 +555,10 @@ public:
 	}
 };
 
-// Implementation for the chat parsing method.
-void McIoReadChatCompound(McIoInputStream& inputStream, McDtChatCompound& compound, 
-	size_t expectedSize, bool tolerant, bool autoCompact) {
+// Parse the chat compound from the json memory stream with the flags.
+template<unsigned parseFlags, typename StreamType>
+static void McIoParseChatCompound(StreamType& jinputStream, 
+	McDtChatCompound& compound, bool tolerant, bool autoCompact) {
 	
 	// Push the genesis state into the driver stack.
 	McDtJsonParseContext<> genesis;
@@ -575,24 +571,289 @@ void McIoReadChatCompound(McIoInputStream& inputStream, McDtChatCompound& compou
 	McDtChatParseHandler handler(autoCompact);
 	McDtJsonParseDriver<McDtChatParseHandler> driver(std::move(genesis), handler, tolerant);
 	rapidjson::Reader jreader;
-#if 0
-	// Don't force insitu parsing.
-	McIoJsonInputStream jinputStream(inputStream, expectedSize);
-#else
-	// Enforce insitu parsing.
-	std::vector<char> data(expectedSize);
-	inputStream.read(data.data(), expectedSize);
-	rapidjson::GenericInsituStringStream<rapidjson::UTF8<char>> jinputStream(data.data());
-#endif
 	
 	// Fire parse process.
-	if(!jreader.Parse(jinputStream, driver)) 
+	if(!jreader.Parse<parseFlags>(jinputStream, driver)) 
 		throw std::runtime_error(std::string("Error parsing json at index ")
 			+ std::to_string(jreader.GetErrorOffset()) + std::string("."));
 }
 
+// Implementation for the in situ chat parsing method.
+void McIoReadChatCompound(char* buffer, size_t size, 
+	McDtChatCompound& compound, bool tolerant, bool autoCompact) {
+	
+	McIoJsonMemoryStream<char> jinputStream(buffer, size);
+	McIoParseChatCompound<rapidjson::kParseInsituFlag>(
+		jinputStream, compound, tolerant, autoCompact);
+}
+
+// Implementation for the chat parsing method.
+void McIoReadChatCompound(McIoInputStream& inputStream, McDtChatCompound& compound, 
+	size_t expectedSize, bool tolerant, bool autoCompact) {
+	
+	// Parse directly from the window when it holds the whole json, where
+	// the strings are copied by rapidjson as the window is read-only.
+	if(inputStream.windowSize() >= expectedSize) {
+		McIoJsonMemoryStream<const char> jinputStream(inputStream.window(), expectedSize);
+		McIoParseChatCompound<rapidjson::kParseDefaultFlags>(
+			jinputStream, compound, tolerant, autoCompact);
+		inputStream.consume(expectedSize);
+		return;
+	}
+	
+	// Otherwise read the json at once and parse it in situ.
+	std::vector<char> data(expectedSize);
+	inputStream.read(data.data(), expectedSize);
+	McIoReadChatCompound(data.data(), expectedSize, compound, tolerant, autoCompact);
+}
+
+// Append the utf-8 string escaped for json, without the quotes.
+static void McIoAppendJsonEscaped(std::string& json, const char* utf8, size_t length) {
+	static const char hexDigits[] = "0123456789abcdef";
+	const char* flushed = utf8;
+	for(size_t i = 0; i < length; ++ i) {
+		unsigned char current = (unsigned char)utf8[i];
+		if(current >= 0x20 && current != '"' && current != '\\') continue;
+		
+		// Flush the preceding characters and escape the current one.
+		json.append(flushed, utf8 + i);
+		flushed = utf8 + i + 1;
+		switch(current) {
+			case '"':  json.append("\\\""); break;
+			case '\\': json.append("\\\\"); break;
+			case '\n': json.append("\\n"); break;
+			case '\r': json.append("\\r"); break;
+			case '\t': json.append("\\t"); break;
+			default: {
+				char escaped[] = { '\\', 'u', '0', '0', 
+					hexDigits[current >> 4], hexDigits[current & 0x0f] };
+				json.append(escaped, sizeof(escaped));
+			}
+		}
+	}
+	json.append(flushed, utf8 + length);
+}
+
+// Append the utf-16 string escaped for json, without the quotes.
+static void McIoAppendJsonEscaped(std::string& json, const std::u16string& value) {
+	std::vector<char> utf8(value.length() * 3);
+	size_t length = McIoEncodeUtf8(value.data(), value.length(), utf8.data());
+	McIoAppendJsonEscaped(json, utf8.data(), length);
+}
+
+/// The writer serializing the chat compound into json.
+struct McDtChatJsonWriter {
+	std::string& json;
+	
+	McDtChatJsonWriter(std::string& json): json(json) {}
+	
+	/// Append the key of the object, with the separator if not first.
+	void key(bool& first, const char* name) {
+		if(!first) json.push_back(',');
+		first = false;
+		json.push_back('"'); json.append(name); json.append("\":");
+	}
+	
+	/// Append the quoted string value.
+	void value(const std::u16string& string) {
+		json.push_back('"');
+		McIoAppendJsonEscaped(json, string);
+		json.push_back('"');
+	}
+	
+	void value(const std::string& string) {
+		json.push_back('"');
+		McIoAppendJsonEscaped(json, string.data(), string.size());
+		json.push_back('"');
+	}
+	
+	void value(const char* string) {
+		json.push_back('"');
+		McIoAppendJsonEscaped(json, string, strlen(string));
+		json.push_back('"');
+	}
+	
+	/// Append the decoration if it is overriden.
+	void decoration(bool& first, const char* name, McDtChatDecorationFlag flag) {
+		if(flag == dcInherit) return;
+		key(first, name);
+		json.append(flag == dcEnable? "true" : "false");
+	}
+	
+	/// Append the array of compounds.
+	void compounds(bool& first, const char* name, const McDtChatCompoundList& list) {
+		if(list.empty()) return;
+		key(first, name);
+		json.push_back('[');
+		for(auto iter = list.begin(); iter != list.end(); ++ iter) {
+			if(iter != list.begin()) json.push_back(',');
+			compound(*iter);
+		}
+		json.push_back(']');
+	}
+	
+	/// Append the event object made up of action and value.
+	template<typename ValueType>
+	void event(bool& first, const char* name, const char* action, const ValueType& eventValue) {
+		key(first, name);
+		bool eventFirst = true;
+		json.push_back('{');
+		key(eventFirst, "action"); value(action);
+		key(eventFirst, "value"); value(eventValue);
+		json.push_back('}');
+	}
+	
+	/// Append the chat compound.
+	void compound(const McDtChatCompound& compound) {
+		bool first = true;
+		json.push_back('{');
+		
+		// Write out the content of the compound.
+		if(compound.content.isNull()) { key(first, "text"); json.append("\"\""); }
+		else switch(compound.content.ordinal()) {
+			case McDtChatTraitInfo::ordinalOf<McDtChatTraitText>(): {
+				key(first, "text"); 
+				value(compound.content.asType<McDtChatTraitText>().text);
+			} break;
+			case McDtChatTraitInfo::ordinalOf<McDtChatTraitTranslate>(): {
+				key(first, "translate"); 
+				value(compound.content.asType<McDtChatTraitTranslate>().translate);
+			} break;
+			case McDtChatTraitInfo::ordinalOf<const McDtChatTraitKeybind*>(): {
+				key(first, "keybind");
+				value(compound.content.asType<const McDtChatTraitKeybind*>() -> name);
+			} break;
+			case McDtChatTraitInfo::ordinalOf<McDtChatTraitScore>(): {
+				const McDtChatTraitScore& score = compound.content.asType<McDtChatTraitScore>();
+				bool scoreFirst = true;
+				key(first, "score");
+				json.push_back('{');
+				key(scoreFirst, "name"); value(score.name);
+				key(scoreFirst, "objective"); value((const std::u16string&)score.objective);
+				key(scoreFirst, "value"); value(score.value);
+				json.push_back('}');
+			} break;
+			default: assert(false);
+		}
+		compounds(first, "with", compound.with);
+		
+		// Write out the modifiers.
+		decoration(first, "bold", compound.bold);
+		decoration(first, "italic", compound.italic);
+		decoration(first, "underlined", compound.underlined);
+		decoration(first, "strikethrough", compound.strikethrough);
+		decoration(first, "obfuscated", compound.obfuscated);
+		if(compound.color != nullptr) { key(first, "color"); value(compound.color -> name); }
+		if(!compound.insertion.isNull()) {
+			key(first, "insertion");
+			value(compound.insertion.asType<std::u16string>());
+		}
+		
+		// Write out the events.
+		if(!compound.clickEvent.isNull()) switch(compound.clickEvent.ordinal()) {
+			case McDtChatClickInfo::ordinalOf<McDtChatClickOpenUrl>(): event(first, "clickEvent",
+				"open_url", compound.clickEvent.asType<McDtChatClickOpenUrl>().url); break;
+			case McDtChatClickInfo::ordinalOf<McDtChatClickRunCommand>(): event(first, "clickEvent",
+				"run_command", compound.clickEvent.asType<McDtChatClickRunCommand>().command); break;
+			case McDtChatClickInfo::ordinalOf<McDtChatClickSuggestCommand>(): event(first, "clickEvent",
+				"suggest_command", compound.clickEvent.asType<McDtChatClickSuggestCommand>().command); break;
+			case McDtChatClickInfo::ordinalOf<McDtChatClickChangePage>(): {
+				bool eventFirst = true;
+				key(first, "clickEvent");
+				json.push_back('{');
+				key(eventFirst, "action"); value("change_page");
+				key(eventFirst, "value"); json.append(std::to_string(
+					compound.clickEvent.asType<McDtChatClickChangePage>().pageNo));
+				json.push_back('}');
+			} break;
+			default: assert(false);
+		}
+		if(!compound.hoverEvent.isNull()) switch(compound.hoverEvent.ordinal()) {
+			case McDtChatHoverInfo::ordinalOf<McDtChatHoverShowText>(): event(first, "hoverEvent",
+				"show_text", compound.hoverEvent.asType<McDtChatHoverShowText>().text); break;
+			case McDtChatHoverInfo::ordinalOf<McDtChatHoverShowItem>(): event(first, "hoverEvent",
+				"show_item", compound.hoverEvent.asType<McDtChatHoverShowItem>().item); break;
+			case McDtChatHoverInfo::ordinalOf<McDtChatHoverShowEntity>(): event(first, "hoverEvent",
+				"show_entity", compound.hoverEvent.asType<McDtChatHoverShowEntity>().entity); break;
+			case McDtChatHoverInfo::ordinalOf<McDtChatHoverShowAchievement>(): event(first, "hoverEvent",
+				"show_achievement", compound.hoverEvent.asType<McDtChatHoverShowAchievement>().achivement); break;
+			default: assert(false);
+		}
+		
+		// Write out the siblings.
+		compounds(first, "extra", compound.extra);
+		json.push_back('}');
+	}
+};
+
+// Implementation for the chat serializing method.
+void McIoWriteChatCompound(std::string& json, const McDtChatCompound& compound) {
+	McDtChatJsonWriter(json).compound(compound);
+}
+
 void McIoWriteChatCompound(McIoOutputStream& outputStream,
 			const McDtChatCompound& compound) {
-	
-	// Not implemented.
+	std::string json;
+	McIoWriteChatCompound(json, compound);
+	outputStream.write(json.data(), json.size());
+}
+
+// Write the length prefixed json of the chat.
+static McIoOutputStream& McIoWriteChatJson(McIoOutputStream& outputStream, const std::string& json) {
+	if(json.size() > 32767) throw std::runtime_error("Chat is too long.");
+	mc::var32 length = (int32_t)json.size(); outputStream << length;
+	outputStream.write(json.data(), json.size());
+	return outputStream;
+}
+
+// Implementation for McDtChatFrozen.
+McDtChatFrozen::McDtChatFrozen(): serialized("{\"text\":\"\"}") {}
+
+McDtChatFrozen::McDtChatFrozen(const McDtChatCompound& compound): serialized() {
+	McIoWriteChatCompound(serialized, compound);
+}
+
+McIoOutputStream& McDtChatFrozen::write(McIoOutputStream& outputStream) const {
+	return McIoWriteChatJson(outputStream, serialized);
+}
+
+// The slots are the noncharacters U+FDD0 to U+FDEF, encoded as EF B7 90 to EF B7 AF.
+static const char16_t slotCodeUnit = 0xFDD0;
+
+// Implementation for McDtChatTemplate.
+std::u16string McDtChatTemplate::slot(size_t index) {
+	if(index >= maxSlots) throw std::runtime_error("The chat template slot is out of range.");
+	return std::u16string(1, (char16_t)(slotCodeUnit + index));
+}
+
+McDtChatTemplate::McDtChatTemplate(const McDtChatCompound& compound): segments(1), slots() {
+	std::string json;
+	McIoWriteChatCompound(json, compound);
+	
+	// Split the json at the slots.
+	size_t flushed = 0;
+	for(size_t i = 0; i + 2 < json.size(); ++ i) {
+		if((unsigned char)json[i] != 0xEF || (unsigned char)json[i + 1] != 0xB7) continue;
+		unsigned char last = (unsigned char)json[i + 2];
+		if(last < 0x90 || last >= 0x90 + maxSlots) continue;
+		segments.back().append(json, flushed, i - flushed);
+		slots.push_back(last - 0x90);
+		segments.push_back(std::string());
+		flushed = i + 3;
+		i += 2;
+	}
+	segments.back().append(json, flushed, std::string::npos);
+}
+
+McDtChatFrozen McDtChatTemplate::render(const std::vector<std::u16string>& arguments) const {
+	McDtChatFrozen result;
+	std::string& json = result.serialized;
+	json = segments[0];
+	for(size_t i = 0; i < slots.size(); ++ i) {
+		if(slots[i] >= arguments.size()) throw std::runtime_error(
+			"The chat template argument is not specified.");
+		McIoAppendJsonEscaped(json, arguments[slots[i]]);
+		json.append(segments[i + 1]);
+	}
+	return result;
 }
\ No newline at end of file
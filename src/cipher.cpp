@@ -0,0 +1,306 @@
+/**
+ * @file cipher.cpp
+ * @brief Implementation for AES/CFB8 stream encryption.
+ * @author Haoran Luo
+ *
+ * For interface specification, please refer to the corresponding header.
+ * @see cipher.hpp
+ */
+#include "cipher.hpp"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define McIoCipherAesNi
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#include <arm_neon.h>
+#define McIoCipherArmv8
+#endif
+
+/// The number of blocks decrypted in a batch, which fills the AES pipeline.
+static const size_t cipherBatchSize = 8;
+
+/// The tables of the T-table implementation, and the S-box for the key
+/// expansion, which are generated on start up.
+struct McIoCipherTables {
+	uint8_t sbox[256];
+	uint32_t te[4][256];
+
+	McIoCipherTables() {
+		// Walk through the multiplicative group by the generator 3, so that
+		// the inverse of each element is known while walking.
+		uint8_t p = 1, q = 1;
+		do {
+			p = (uint8_t)(p ^ (p << 1) ^ ((p & 0x080) != 0? 0x01b : 0));
+			q = (uint8_t)(q ^ (q << 1));
+			q = (uint8_t)(q ^ (q << 2));
+			q = (uint8_t)(q ^ (q << 4));
+			if((q & 0x080) != 0) q = (uint8_t)(q ^ 0x009);
+			uint8_t affine = q;
+			for(int i = 1; i <= 4; ++ i) affine = (uint8_t)(affine ^
+				(uint8_t)((q << i) | (q >> (8 - i))));
+			sbox[p] = (uint8_t)(affine ^ 0x063);
+		} while(p != 1);
+		sbox[0] = 0x063;
+
+		// The column of the MixColumns over the substituted byte.
+		for(size_t i = 0; i < 256; ++ i) {
+			uint32_t s = sbox[i];
+			uint32_t s2 = (uint32_t)(uint8_t)((s << 1) ^ ((s & 0x080) != 0? 0x01b : 0));
+			uint32_t s3 = s2 ^ s;
+			te[0][i] = (s2 << 24) | (s << 16) | (s << 8) | s3;
+			for(size_t j = 1; j < 4; ++ j)
+				te[j][i] = (te[j - 1][i] >> 8) | (te[j - 1][i] << 24);
+		}
+	}
+};
+static const McIoCipherTables cipherTables;
+
+// Load and store the big endian words of the T-table implementation.
+static inline uint32_t McIoCipherLoad(const uint8_t* b) {
+	return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+static inline void McIoCipherStore(uint8_t* b, uint32_t w) {
+	b[0] = (uint8_t)(w >> 24); b[1] = (uint8_t)(w >> 16);
+	b[2] = (uint8_t)(w >> 8);  b[3] = (uint8_t)w;
+}
+
+/// The portable AES implementation with T-tables.
+struct McIoCipherPortable {
+	uint32_t rk[(McIoCipherControl::numRounds + 1) * 4];
+
+	McIoCipherPortable(const uint8_t* roundKeys) {
+		for(size_t i = 0; i < sizeof(rk) / sizeof(uint32_t); ++ i)
+			rk[i] = McIoCipherLoad(&roundKeys[i * 4]);
+	}
+
+	/// Encrypt the block, and retrieve the first byte of the output.
+	inline uint8_t encrypt(const uint8_t* block) const noexcept {
+		const uint32_t (&te)[4][256] = cipherTables.te;
+		uint32_t s0 = McIoCipherLoad(&block[0])  ^ rk[0];
+		uint32_t s1 = McIoCipherLoad(&block[4])  ^ rk[1];
+		uint32_t s2 = McIoCipherLoad(&block[8])  ^ rk[2];
+		uint32_t s3 = McIoCipherLoad(&block[12]) ^ rk[3];
+		for(size_t r = 1; r < McIoCipherControl::numRounds; ++ r) {
+			const uint32_t* k = &rk[r * 4];
+			uint32_t t0 = te[0][s0 >> 24] ^ te[1][(s1 >> 16) & 0x0ff]
+				^ te[2][(s2 >> 8) & 0x0ff] ^ te[3][s3 & 0x0ff] ^ k[0];
+			uint32_t t1 = te[0][s1 >> 24] ^ te[1][(s2 >> 16) & 0x0ff]
+				^ te[2][(s3 >> 8) & 0x0ff] ^ te[3][s0 & 0x0ff] ^ k[1];
+			uint32_t t2 = te[0][s2 >> 24] ^ te[1][(s3 >> 16) & 0x0ff]
+				^ te[2][(s0 >> 8) & 0x0ff] ^ te[3][s1 & 0x0ff] ^ k[2];
+			uint32_t t3 = te[0][s3 >> 24] ^ te[1][(s0 >> 16) & 0x0ff]
+				^ te[2][(s1 >> 8) & 0x0ff] ^ te[3][s2 & 0x0ff] ^ k[3];
+			s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+		}
+
+		// Only the first byte of the last round is required by CFB8.
+		return (uint8_t)(cipherTables.sbox[s0 >> 24] ^ (rk[McIoCipherControl::numRounds * 4] >> 24));
+	}
+
+	/// Encrypt the consecutive registers in the window, and retrieve the
+	/// first byte of each output.
+	inline void encryptBatch(const uint8_t* window, uint8_t* output) const noexcept {
+		for(size_t i = 0; i < cipherBatchSize; ++ i) output[i] = encrypt(&window[i]);
+	}
+};
+
+// The CFB8 encryption, where the register is shifted by the ciphertext.
+template<typename Aes>
+static inline void McIoCipherEncrypt(const Aes& aes, uint8_t* shiftRegister,
+		const uint8_t* data, uint8_t* output, size_t size) noexcept {
+	// The window holds the register followed by the new ciphertext.
+	uint8_t window[McIoCipherControl::blockSize * 2];
+	memcpy(window, shiftRegister, McIoCipherControl::blockSize);
+	while(size > 0) {
+		size_t batch = size < McIoCipherControl::blockSize? size : McIoCipherControl::blockSize;
+		for(size_t i = 0; i < batch; ++ i) {
+			uint8_t encrypted = (uint8_t)(data[i] ^ aes.encrypt(&window[i]));
+			window[McIoCipherControl::blockSize + i] = encrypted;
+			output[i] = encrypted;
+		}
+		memmove(window, &window[batch], McIoCipherControl::blockSize);
+		data += batch; output += batch; size -= batch;
+	}
+	memcpy(shiftRegister, window, McIoCipherControl::blockSize);
+}
+
+// The CFB8 decryption, where the ciphertext is copied into the window before
+// being overwritten, and the blocks of a batch are encrypted together.
+template<typename Aes>
+static inline void McIoCipherDecrypt(const Aes& aes, uint8_t* shiftRegister,
+		uint8_t* data, size_t size) noexcept {
+	uint8_t window[McIoCipherControl::blockSize + cipherBatchSize];
+	memcpy(window, shiftRegister, McIoCipherControl::blockSize);
+	for(; size >= cipherBatchSize; data += cipherBatchSize, size -= cipherBatchSize) {
+		uint8_t keyStream[cipherBatchSize];
+		memcpy(&window[McIoCipherControl::blockSize], data, cipherBatchSize);
+		aes.encryptBatch(window, keyStream);
+		for(size_t i = 0; i < cipherBatchSize; ++ i) data[i] = (uint8_t)(data[i] ^ keyStream[i]);
+		memmove(window, &window[cipherBatchSize], McIoCipherControl::blockSize);
+	}
+	for(size_t i = 0; i < size; ++ i) {
+		uint8_t encrypted = data[i];
+		data[i] = (uint8_t)(encrypted ^ aes.encrypt(window));
+		memmove(window, &window[1], McIoCipherControl::blockSize - 1);
+		window[McIoCipherControl::blockSize - 1] = encrypted;
+	}
+	memcpy(shiftRegister, window, McIoCipherControl::blockSize);
+}
+
+#if defined(McIoCipherAesNi)
+/// The AES implementation with AES-NI, whose methods are only called after
+/// the instructions are detected.
+struct McIoCipherAesNiRounds {
+	__m128i rk[McIoCipherControl::numRounds + 1];
+
+	__attribute__((target("aes,sse2")))
+	McIoCipherAesNiRounds(const uint8_t* roundKeys) {
+		for(size_t i = 0; i <= McIoCipherControl::numRounds; ++ i) rk[i] =
+			_mm_loadu_si128((const __m128i*)&roundKeys[i * McIoCipherControl::blockSize]);
+	}
+
+	__attribute__((target("aes,sse2")))
+	inline uint8_t encrypt(const uint8_t* block) const noexcept {
+		__m128i state = _mm_xor_si128(_mm_loadu_si128((const __m128i*)block), rk[0]);
+		for(size_t r = 1; r < McIoCipherControl::numRounds; ++ r)
+			state = _mm_aesenc_si128(state, rk[r]);
+		state = _mm_aesenclast_si128(state, rk[McIoCipherControl::numRounds]);
+		return (uint8_t)_mm_cvtsi128_si32(state);
+	}
+
+	__attribute__((target("aes,sse2")))
+	inline void encryptBatch(const uint8_t* window, uint8_t* output) const noexcept {
+		// The blocks are independent, interleave them to hide the latency.
+		__m128i state[cipherBatchSize];
+		for(size_t i = 0; i < cipherBatchSize; ++ i) state[i] = _mm_xor_si128(
+				_mm_loadu_si128((const __m128i*)&window[i]), rk[0]);
+		for(size_t r = 1; r < McIoCipherControl::numRounds; ++ r)
+			for(size_t i = 0; i < cipherBatchSize; ++ i)
+				state[i] = _mm_aesenc_si128(state[i], rk[r]);
+		for(size_t i = 0; i < cipherBatchSize; ++ i) output[i] = (uint8_t)_mm_cvtsi128_si32(
+				_mm_aesenclast_si128(state[i], rk[McIoCipherControl::numRounds]));
+	}
+};
+
+// The CFB8 encryption with AES-NI, where the register is kept in the vector.
+__attribute__((target("aes,sse2")))
+static void McIoCipherAesNiEncrypt(const uint8_t* roundKeys, uint8_t* shiftRegister,
+		const uint8_t* data, uint8_t* output, size_t size) noexcept {
+	McIoCipherAesNiRounds aes(roundKeys);
+	__m128i registerVector = _mm_loadu_si128((const __m128i*)shiftRegister);
+	for(size_t i = 0; i < size; ++ i) {
+		__m128i state = _mm_xor_si128(registerVector, aes.rk[0]);
+		for(size_t r = 1; r < McIoCipherControl::numRounds; ++ r)
+			state = _mm_aesenc_si128(state, aes.rk[r]);
+		state = _mm_aesenclast_si128(state, aes.rk[McIoCipherControl::numRounds]);
+		uint8_t encrypted = (uint8_t)(data[i] ^ (uint8_t)_mm_cvtsi128_si32(state));
+		output[i] = encrypted;
+		registerVector = _mm_or_si128(_mm_srli_si128(registerVector, 1),
+			_mm_slli_si128(_mm_cvtsi32_si128(encrypted), 15));
+	}
+	_mm_storeu_si128((__m128i*)shiftRegister, registerVector);
+}
+
+// The CFB8 decryption with AES-NI.
+__attribute__((target("aes,sse2")))
+static void McIoCipherAesNiDecrypt(const uint8_t* roundKeys, uint8_t* shiftRegister,
+		uint8_t* data, size_t size) noexcept {
+	McIoCipherAesNiRounds aes(roundKeys);
+	McIoCipherDecrypt(aes, shiftRegister, data, size);
+}
+
+// Detect the AES-NI instructions, which might run before the constructor
+// initializing the processor features.
+static bool McIoCipherDetectAesNi() {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("aes");
+}
+
+// Whether the AES-NI instructions are supported by the processor.
+static const bool cipherAesNiSupported = McIoCipherDetectAesNi();
+#elif defined(McIoCipherArmv8)
+/// The AES implementation with the ARMv8 crypto extension.
+struct McIoCipherArmv8Rounds {
+	uint8x16_t rk[McIoCipherControl::numRounds + 1];
+
+	McIoCipherArmv8Rounds(const uint8_t* roundKeys) {
+		for(size_t i = 0; i <= McIoCipherControl::numRounds; ++ i)
+			rk[i] = vld1q_u8(&roundKeys[i * McIoCipherControl::blockSize]);
+	}
+
+	inline uint8_t encrypt(const uint8_t* block) const noexcept {
+		uint8x16_t state = vld1q_u8(block);
+		for(size_t r = 0; r + 1 < McIoCipherControl::numRounds; ++ r)
+			state = vaesmcq_u8(vaeseq_u8(state, rk[r]));
+		state = vaeseq_u8(state, rk[McIoCipherControl::numRounds - 1]);
+		state = veorq_u8(state, rk[McIoCipherControl::numRounds]);
+		return vgetq_lane_u8(state, 0);
+	}
+
+	inline void encryptBatch(const uint8_t* window, uint8_t* output) const noexcept {
+		uint8x16_t state[cipherBatchSize];
+		for(size_t i = 0; i < cipherBatchSize; ++ i) state[i] = vld1q_u8(&window[i]);
+		for(size_t r = 0; r + 1 < McIoCipherControl::numRounds; ++ r)
+			for(size_t i = 0; i < cipherBatchSize; ++ i)
+				state[i] = vaesmcq_u8(vaeseq_u8(state[i], rk[r]));
+		for(size_t i = 0; i < cipherBatchSize; ++ i) output[i] = vgetq_lane_u8(veorq_u8(
+			vaeseq_u8(state[i], rk[McIoCipherControl::numRounds - 1]),
+			rk[McIoCipherControl::numRounds]), 0);
+	}
+};
+#endif
+
+// Implementation for McIoCipherControl::McIoCipherControl().
+McIoCipherControl::McIoCipherControl(const char* sharedSecret) noexcept {
+	memcpy(roundKeys, sharedSecret, blockSize);
+	memcpy(encryptRegister, sharedSecret, blockSize);
+	memcpy(decryptRegister, sharedSecret, blockSize);
+
+	// The AES-128 key expansion, one round key per iteration.
+	uint8_t roundConstant = 0x001;
+	for(size_t r = 1; r <= numRounds; ++ r) {
+		const uint8_t* previous = &roundKeys[(r - 1) * blockSize];
+		uint8_t* current = &roundKeys[r * blockSize];
+		const uint8_t* sbox = cipherTables.sbox;
+		current[0] = (uint8_t)(previous[0] ^ sbox[previous[13]] ^ roundConstant);
+		current[1] = (uint8_t)(previous[1] ^ sbox[previous[14]]);
+		current[2] = (uint8_t)(previous[2] ^ sbox[previous[15]]);
+		current[3] = (uint8_t)(previous[3] ^ sbox[previous[12]]);
+		for(size_t i = 4; i < blockSize; ++ i)
+			current[i] = (uint8_t)(previous[i] ^ current[i - 4]);
+		roundConstant = (uint8_t)((roundConstant << 1) ^ ((roundConstant & 0x080) != 0? 0x01b : 0));
+	}
+}
+
+// Implementation for McIoCipherControl::encrypt().
+void McIoCipherControl::encrypt(const char* data, char* output, size_t size) noexcept {
+#if defined(McIoCipherAesNi)
+	if(cipherAesNiSupported) {
+		McIoCipherAesNiEncrypt(roundKeys, encryptRegister,
+			(const uint8_t*)data, (uint8_t*)output, size);
+		return;
+	}
+#elif defined(McIoCipherArmv8)
+	McIoCipherEncrypt(McIoCipherArmv8Rounds(roundKeys), encryptRegister,
+		(const uint8_t*)data, (uint8_t*)output, size);
+	return;
+#endif
+	McIoCipherEncrypt(McIoCipherPortable(roundKeys), encryptRegister,
+		(const uint8_t*)data, (uint8_t*)output, size);
+}
+
+// Implementation for McIoCipherControl::decrypt().
+void McIoCipherControl::decrypt(char* data, size_t size) noexcept {
+#if defined(McIoCipherAesNi)
+	if(cipherAesNiSupported) {
+		McIoCipherAesNiDecrypt(roundKeys, decryptRegister, (uint8_t*)data, size);
+		return;
+	}
+#elif defined(McIoCipherArmv8)
+	McIoCipherDecrypt(McIoCipherArmv8Rounds(roundKeys), decryptRegister, (uint8_t*)data, size);
+	return;
+#endif
+	McIoCipherDecrypt(McIoCipherPortable(roundKeys), decryptRegister, (uint8_t*)data, size);
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+/**
+ * @file cipher.hpp
+ * @brief Headers for AES/CFB8 stream encryption related objects.
+ * @author Haoran Luo
+ *
+ * This file specifies the per-connection encryption state that is used
+ * after the "Encryption Response" packet has been exchanged. Under the
+ * encryption mode, the whole stream (below the length prefix and the
+ * compression) is encrypted with AES-128 in CFB8 mode, where the shared
+ * secret is used as both the key and the initial vector.
+ *
+ * CFB8 runs one AES block encryption per byte. The encryption is serial,
+ * as each block takes the previous ciphertext byte. The decryption is not,
+ * since the ciphertext is known beforehand, so the blocks are pipelined.
+ *
+ * The AES rounds run with AES-NI on x86 (detected on runtime) or the ARMv8
+ * crypto extension (when compiled in), and the T-table implementation is
+ * used otherwise.
+ */
+#include <cstdint>
+#include <cstddef>
+
+/// The per-connection AES/CFB8 encryption state.
+struct McIoCipherControl {
+	/// The size of the key, the initial vector and the AES block.
+	static const size_t blockSize = 16;
+
+	/// The number of rounds of AES-128.
+	static const size_t numRounds = 10;
+
+	/// The expanded round keys, in byte order.
+	alignas(16) uint8_t roundKeys[(numRounds + 1) * blockSize];
+
+	/// The shift register of the outbound stream.
+	uint8_t encryptRegister[blockSize];
+
+	/// The shift register of the inbound stream.
+	uint8_t decryptRegister[blockSize];
+
+	/**
+	 * @brief Expand the key and initialize both shift registers.
+	 * @param[in] sharedSecret the blockSize bytes key and initial vector.
+	 */
+	McIoCipherControl(const char* sharedSecret) noexcept;
+
+	/**
+	 * @brief Encrypt the outbound data, which could be done in place.
+	 * @param[in] data the plain data to encrypt.
+	 * @param[out] output the encrypted data, which could be the data.
+	 * @param[in] size the size of the data.
+	 */
+	void encrypt(const char* data, char* output, size_t size) noexcept;
+
+	/**
+	 * @brief Decrypt the inbound data in place.
+	 * @param[inout] data the data read from the stream.
+	 * @param[in] size the size of the data.
+	 */
+	void decrypt(char* data, size_t size) noexcept;
+};
\ No newline at end of file
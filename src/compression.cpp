@@ -0,0 +1,157 @@
+/**
+ * @file compression.cpp
+ * @brief Implementation for zlib packet compression.
+ * @author Haoran Luo
+ *
+ * For interface specification, please refer to the corresponding header.
+ * @see compression.hpp
+ */
+#include "compression.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+/// The size reserved before the deflated data, for two variant integers.
+static const size_t compressionHeaderSize = 10;
+
+/// The max allowed size of variant integer, see also stream.cpp.
+static const size_t maxCompressedVarint = 0x07ffffffful;
+
+/// The max uncompressed data length when the packet size is not limited,
+/// which is the limit of the vanilla protocol (2^23 bytes).
+static const size_t maxUncompressedLength = 8388608ul;
+
+/// The initial size of the inflate buffer, which then grows as inflation
+/// proceeds, so that the claimed data length is never allocated up front.
+static const size_t initialInflateSize = 4096;
+
+/// The exception message for malformed compressed packet.
+static const char* malformedCompressed = "Malformed compressed packet.";
+
+// Encode the variant integer into the buffer, returning the bytes used.
+static inline size_t McIoCompressionVarint(char* buffer, size_t value) {
+	size_t i = 0;
+	do {
+		buffer[i] = (char)(value & 0x07f);
+		value = value >> 7;
+		if(value != 0) buffer[i] = (char)(buffer[i] | 0x080);
+		++ i;
+	} while(value != 0);
+	return i;
+}
+
+// Implementation for McIoCompressionControl::McIoCompressionControl().
+McIoCompressionControl::McIoCompressionControl(size_t threshold):
+	inflateBuffer(), deflateBuffer(), threshold(threshold) {
+
+	memset(&inflater, 0, sizeof(inflater));
+	memset(&deflater, 0, sizeof(deflater));
+	if(inflateInit(&inflater) != Z_OK)
+		throw std::runtime_error("Cannot initialize packet inflater.");
+	if(deflateInit(&deflater, Z_DEFAULT_COMPRESSION) != Z_OK) {
+		inflateEnd(&inflater);
+		throw std::runtime_error("Cannot initialize packet deflater.");
+	}
+}
+
+// Implementation for McIoCompressionControl::~McIoCompressionControl().
+McIoCompressionControl::~McIoCompressionControl() noexcept {
+	inflateEnd(&inflater);
+	deflateEnd(&deflater);
+}
+
+// Implementation for McIoCompressionControl::inflate().
+std::tuple<size_t, const char*> McIoCompressionControl::inflate(
+		const char* packet, size_t packetSize, size_t maxPacketSize) {
+
+	// Parse the uncompressed data length first.
+	size_t dataLength = 0, i = 0;
+	for(; i < 5; ++ i) {
+		if(i >= packetSize) throw std::runtime_error(malformedCompressed);
+		dataLength |= (((size_t)packet[i]) & 0x07f) << (i * 7);
+		if((((int)packet[i]) & 0x080) == 0) break;
+	}
+	if(i == 5) throw std::runtime_error(malformedCompressed);
+	++ i;
+
+	// The data is not compressed, just forward it.
+	if(dataLength == 0) return std::make_tuple(packetSize - i, packet + i);
+	if(dataLength < threshold) throw std::runtime_error(
+		"The compressed packet is below the compression threshold.");
+	if(dataLength > (maxPacketSize > 0? std::min(maxPacketSize,
+		maxCompressedVarint) : maxUncompressedLength))
+		throw std::runtime_error("The compressed packet is too large.");
+
+	// Inflate the data into the inflate buffer, doubling the inflated part
+	// each time the buffer is filled up, until the data length is reached.
+	if(inflateReset(&inflater) != Z_OK)
+		throw std::runtime_error(malformedCompressed);
+	inflater.next_in = (Bytef*)(packet + i);
+	inflater.avail_in = (uInt)(packetSize - i);
+	size_t inflated = 0;
+	while(true) {
+		size_t target = std::min(dataLength, std::max(inflated * 2, initialInflateSize));
+		if(inflateBuffer.size() < target) inflateBuffer.resize(target);
+		inflater.next_out = (Bytef*)(inflateBuffer.data() + inflated);
+		inflater.avail_out = (uInt)(target - inflated);
+		int status = ::inflate(&inflater, Z_FINISH);
+		inflated = target - inflater.avail_out;
+		if(status == Z_STREAM_END) break;
+
+		// The stream must go on with more output, unless it is malformed.
+		if((status != Z_OK && status != Z_BUF_ERROR) ||
+			inflated < target || target == dataLength)
+			throw std::runtime_error(malformedCompressed);
+	}
+	if(inflated != dataLength || inflater.avail_in != 0)
+		throw std::runtime_error(malformedCompressed);
+	return std::make_tuple(dataLength, (const char*)inflateBuffer.data());
+}
+
+// Implementation for McIoCompressionControl::deflate().
+std::tuple<size_t, const char*> McIoCompressionControl::deflate(
+		const char* data, size_t dataSize) {
+
+	char dataLength[5]; size_t dataLengthSize;
+	size_t bodySize;
+
+	if(dataSize < threshold) {
+		// Below the threshold, just copy the data with zero data length.
+		dataLength[0] = 0; dataLengthSize = 1;
+		bodySize = dataSize;
+		if(deflateBuffer.size() < compressionHeaderSize + bodySize)
+			deflateBuffer.resize(compressionHeaderSize + bodySize);
+		if(dataSize > 0) memcpy(deflateBuffer.data()
+			+ compressionHeaderSize, data, dataSize);
+	}
+	else {
+		// Deflate the data right after the reserved header.
+		dataLengthSize = McIoCompressionVarint(dataLength, dataSize);
+		if(deflateReset(&deflater) != Z_OK) throw std::runtime_error(
+			"Cannot reset packet deflater.");
+		size_t bound = deflateBound(&deflater, (uLong)dataSize);
+		if(deflateBuffer.size() < compressionHeaderSize + bound)
+			deflateBuffer.resize(compressionHeaderSize + bound);
+
+		deflater.next_in = (Bytef*)data;
+		deflater.avail_in = (uInt)dataSize;
+		deflater.next_out = (Bytef*)(deflateBuffer.data() + compressionHeaderSize);
+		deflater.avail_out = (uInt)bound;
+		if(::deflate(&deflater, Z_FINISH) != Z_STREAM_END)
+			throw std::runtime_error("Cannot compress packet data.");
+		bodySize = deflater.total_out;
+	}
+
+	// Place the data length and packet length right before the body.
+	size_t packetSize = dataLengthSize + bodySize;
+	if(packetSize > maxCompressedVarint)
+		throw std::runtime_error("The data to send is too large.");
+	char packetLength[5];
+	size_t packetLengthSize = McIoCompressionVarint(packetLength, packetSize);
+
+	char* begin = deflateBuffer.data() + compressionHeaderSize - dataLengthSize;
+	memcpy(begin, dataLength, dataLengthSize);
+	begin -= packetLengthSize;
+	memcpy(begin, packetLength, packetLengthSize);
+	return std::make_tuple(packetLengthSize + packetSize, (const char*)begin);
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+/**
+ * @file compression.hpp
+ * @brief Headers for zlib packet compression related objects.
+ * @author Haoran Luo
+ *
+ * This file specifies the per-connection compression state that is
+ * used after the "Set Compression" packet has been exchanged. Under
+ * compression mode, the packet format is altered to:
+ *
+ * '''
+ * packet ::= packetLength(var32) dataLength(var32) data
+ * '''
+ *
+ * Where dataLength is 0 when the data is not compressed, or the
+ * length of the uncompressed data otherwise.
+ *
+ * The zlib streams are initialized once and reset for every packet,
+ * so that the cost of allocating zlib's internal state is not paid
+ * on each packet. So are the scratch buffers.
+ */
+#include <zlib.h>
+#include <vector>
+#include <tuple>
+#include <cstddef>
+
+/// The per-connection (or per-broadcaster) zlib compression state.
+struct McIoCompressionControl {
+	/// The zlib stream used for inflating inbound packets.
+	z_stream inflater;
+
+	/// The zlib stream used for deflating outbound packets.
+	z_stream deflater;
+
+	/// The buffer to store inflated inbound packets, only grows.
+	std::vector<char> inflateBuffer;
+
+	/// The buffer to store framed outbound packets, only grows.
+	std::vector<char> deflateBuffer;
+
+	/// The compression threshold, packets whose size is not less than
+	/// the threshold will be compressed.
+	size_t threshold;
+
+	/// @brief Initialize both zlib streams.
+	/// @throw std::runtime_error if zlib cannot be initialized.
+	McIoCompressionControl(size_t threshold);
+
+	/// Finalize both zlib streams.
+	~McIoCompressionControl() noexcept;
+
+	// Restrict copy and move semantics, as zlib state is self-referenced.
+	McIoCompressionControl(const McIoCompressionControl&) = delete;
+	McIoCompressionControl& operator=(const McIoCompressionControl&) = delete;
+
+	/**
+	 * @brief Decode a completely received packet in compression format.
+	 *
+	 * @param[in] packet the packet data after the packet length.
+	 * @param[in] packetSize the size of the packet data.
+	 * @param[in] maxPacketSize the maximum uncompressed size, 0 for the limit
+	 * of the vanilla protocol, which is 2^23 bytes.
+	 * @return the (size, data) pair of the uncompressed packet, which
+	 * is either inside the packet or the inflate buffer.
+	 * @throw std::runtime_error when the packet is malformed, or when it is
+	 * compressed while its data length is below the threshold.
+	 */
+	std::tuple<size_t, const char*> inflate(const char* packet,
+			size_t packetSize, size_t maxPacketSize);
+
+	/**
+	 * @brief Frame an uncompressed packet data into compression format, and
+	 * deflate the data when its size reaches the threshold.
+	 *
+	 * @param[in] data the raw packet data (without any length prefix).
+	 * @param[in] dataSize the size of the raw packet data.
+	 * @return the (size, data) pair of the framed packet, including
+	 * the packet length prefix, inside the deflate buffer.
+	 * @throw std::runtime_error when the data cannot be compressed.
+	 */
+	std::tuple<size_t, const char*> deflate(const char* data, size_t dataSize);
+};
\ No newline at end of file
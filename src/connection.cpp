@@ -8,11 +8,14 @@
  */
 #include "libminecraft/connection.hpp"
 #include "libminecraft/bufstream.hpp"
+#include "compression.hpp"
+#include "cipher.hpp"
 #include <memory>
 #include <vector>
 #include <queue>
 #include <cstring>
 #include <cassert>
+#include <algorithm>
 #include <unistd.h>
 
 /// Indicates the status of the connection state machine.
@@ -49,25 +52,112 @@ struct McIoConnectionControl {
 	
 	/// Stores the packet data inbound. Please notice that it may be not used 
 	/// while parsing a packet that does not cause the descriptor to sleep.
-	std::vector<char> inboundBuffer;
+	/// The buffer is acquired from the multiplexer's pool, uninitialized.
+	char* inboundBuffer;
+	
+	/// Stores the pool that the inbound buffer is acquired from.
+	McIoBufferPool* inboundPool;
 	
 	/// Marks whether disconnection is indicated.
 	bool disconnectIndicated;
 	
+	/// Stores the compression threshold, negative if disabled.
+	int compressionThreshold;
+	
+	/// Stores the zlib compression state. It is created when compression 
+	/// is first enabled, and kept until the connection is destroyed.
+	std::unique_ptr<McIoCompressionControl> compression;
+	
+	/// Stores the AES/CFB8 encryption state, null if encryption is disabled.
+	std::unique_ptr<McIoCipherControl> cipher;
+	
+	/// Stores the size of data to read at once, 0 if bulk reading is disabled.
+	size_t readChunkSize;
+	
+	/// Stores the statistics of the connection.
+	McIoConnection::McIoConnectionStats stats;
+	
 	/// The constructor of the control block.
 	McIoConnectionControl(int fd): fd(fd), status(cstPacketLengthOf(0)), 
 			packetSize(0), maxPacketSize(0), readSize(0),
-			inboundBuffer(), disconnectIndicated(false) {}
+			inboundBuffer(nullptr), inboundPool(nullptr), disconnectIndicated(false),
+			compressionThreshold(-1), compression(), cipher(),
+			readChunkSize(McIoConnection::defaultReadChunkSize), stats({ 0, 0, 0 }) {}
+	
+	/// Account the read() call, and the bytes read by it.
+	inline void countRead(McIoMultiplexerMetrics& metrics, int readStatus) noexcept {
+		metrics.syscalls.add();
+		if(McIoMetricsEnabled && readStatus > 0) {
+			stats.bytesRead += (uint64_t)readStatus;
+			metrics.bytesIn.add((uint64_t)readStatus);
+		}
+	}
+	
+	/// Read from the socket, and decrypt the data read if encryption is 
+	/// enabled, so that the state machine always handles the plain data.
+	inline int receive(McIoMultiplexerMetrics& metrics, char* buffer, size_t size) noexcept {
+		int readStatus = ::read(fd, buffer, size);
+		countRead(metrics, readStatus);
+		if(cipher != nullptr && readStatus > 0) cipher -> decrypt(buffer, (size_t)readStatus);
+		return readStatus;
+	}
+	
+	/// Account the packet written by writePacket().
+	inline void countWritten(McIoMultiplexerMetrics* metrics) noexcept {
+		if(!McIoMetricsEnabled) return;
+		++ stats.packetsWritten;
+		if(metrics != nullptr) metrics -> packetsOut.add();
+	}
+	
+	/// The destructor of the control block.
+	~McIoConnectionControl() noexcept { releaseInbound(); }
+	
+	/// Acquire the inbound buffer for current packet if not acquired.
+	inline void acquireInbound(McIoBufferPool& pool) {
+		if(inboundBuffer != nullptr) return;
+		inboundBuffer = pool.acquire(packetSize);
+		inboundPool = &pool;
+	}
+	
+	/// Return the inbound buffer to the pool, the packet size must not have
+	/// been changed since the buffer is acquired.
+	inline void releaseInbound() noexcept {
+		if(inboundBuffer == nullptr) return;
+		inboundPool -> release(inboundBuffer, packetSize);
+		inboundBuffer = nullptr;
+		inboundPool = nullptr;
+	}
+	
+	/// Reset fields and transit back to packet length.
+	inline void resetPacket() {
+		// Also return the buffer.
+		releaseInbound();
+		
+		readSize = 0;
+		packetSize = 0;
+		status = cstPacketLengthOf(0);
+	}
+	
+	/// Decompress the packet if required, and forward it to the handle method.
+	template<typename HandleData>
+	inline void dispatch(const char* packet, size_t size, HandleData& handleData) {
+		if(compressionThreshold >= 0) std::tie(size, packet) = 
+			compression -> inflate(packet, size, maxPacketSize);
+		McIoBufferInputStream stream(packet, size);
+		handleData(size, stream);
+	}
 	
 	/// Implements the handleRead method.
 	template<typename HandleData>
-	inline McIoNextStatus handleRead(McIoEvent& activeEvent, HandleData handleData) {
+	inline McIoNextStatus handleRead(McIoEvent& activeEvent, McIoBufferPool& pool, 
+			McIoMultiplexerMetrics& metrics, HandleData handleData) {
 		if(disconnectIndicated) {
 			// If disconnection has already indicated, always return final.
 			activeEvent = McIoEventBitClear(activeEvent, McIoEvent::evIn);
 			return McIoNextStatus::nstFinal;
 		}
 		else if((activeEvent & McIoEvent::evIn) == 0) return McIoNextStatus::nstPoll;
+		else if(readChunkSize > 0) return handleBulkRead(activeEvent, pool, metrics, handleData);
 		else {
 			int readStatus;
 			// Perform reading. The code is written in Duff's device style.
@@ -76,7 +166,7 @@ struct McIoConnectionControl {
 #define cstPacketLengthBlock(i)                                                     \
 				case cstPacketLengthOf(i): {                                        \
 					char thizByte;                                                  \
-					readStatus = ::read(fd, &thizByte, 1);                          \
+					readStatus = receive(metrics, &thizByte, 1);                    \
 					if(readStatus != 1) goto HandleReadStatus;                      \
 					else {                                                          \
 						packetSize |= (((int)thizByte) & 0x07f) << (i * 7);         \
@@ -117,18 +207,18 @@ struct McIoConnectionControl {
 					
 					// If there's remained data in the inbound buffer.
 					// Use that buffer instead.
-					if(!inboundBuffer.empty())
-						targetBuffer = inboundBuffer.data();
+					if(inboundBuffer != nullptr)
+						targetBuffer = inboundBuffer;
 					
 					// If the packet is too large, also use the inbound buffer.
 					else if(packetSize > BUFSIZ) {
-						inboundBuffer.resize(packetSize);
-						targetBuffer = inboundBuffer.data();
+						acquireInbound(pool);
+						targetBuffer = inboundBuffer;
 					}
 					
 					// Attempt to read data from the file.
 					size_t remainedSize = packetSize - readSize;
-					readStatus = ::read(fd, &targetBuffer[readSize], remainedSize);
+					readStatus = receive(metrics, &targetBuffer[readSize], remainedSize);
 					if(readStatus <= 0 || readStatus > remainedSize) 
 						goto HandleReadStatus;
 					else readSize += (size_t)readStatus;
@@ -137,26 +227,15 @@ struct McIoConnectionControl {
 					// or copying.
 					if(readSize == packetSize) {
 						// Construct the stream and call the handle method.
-						McIoBufferInputStream stream(targetBuffer, packetSize);
-						handleData(packetSize, stream);
-						
-						// Reset fields and transit back to packet length.
-						readSize = 0;
-						packetSize = 0;
-						status = cstPacketLengthOf(0);
-						
-						// Also clear the buffer.
-						{
-							std::vector<char> emptyBuffer;
-							inboundBuffer.swap(emptyBuffer);
-						};
+						dispatch(targetBuffer, packetSize, handleData);
+						resetPacket();
 						return McIoNextStatus::nstMore;
 					}
 					else {
 						// Data must be stored in the vector for further use.
 						if(targetBuffer == stackInboundBuffer) {
-							inboundBuffer.resize(packetSize);
-							memcpy(inboundBuffer.data(), stackInboundBuffer, readSize);
+							acquireInbound(pool);
+							memcpy(inboundBuffer, stackInboundBuffer, readSize);
 						}
 						
 						// Clear event flags and would poll.
@@ -180,6 +259,122 @@ struct McIoConnectionControl {
 			}
 		}
 	}
+	
+	/**
+	 * @brief Implements the handleRead method when bulk reading is enabled.
+	 *
+	 * A chunk of data is read at once, and every complete packet inside is 
+	 * dispatched directly from the chunk. The trailing incomplete packet is 
+	 * moved into the inbound buffer, so the chunk carries no state between 
+	 * invocations, and could be shared by all connections on the thread. 
+	 * The state machine is the same as the one read byte by byte, so the 
+	 * read chunk size could be updated at any time.
+	 */
+	template<typename HandleData>
+	inline McIoNextStatus handleBulkRead(McIoEvent& activeEvent, McIoBufferPool& pool, 
+			McIoMultiplexerMetrics& metrics, HandleData& handleData) {
+		static thread_local std::vector<char> chunkBuffer;
+		char* targetBuffer; size_t requestSize;
+		
+		// When the remaining of current packet is larger than a chunk, read 
+		// into the inbound buffer directly, to avoid copying twice.
+		if(status == cstPacketData && packetSize - readSize >= readChunkSize) {
+			acquireInbound(pool);
+			targetBuffer = &inboundBuffer[readSize];
+			requestSize = packetSize - readSize;
+		}
+		else {
+			if(chunkBuffer.size() < readChunkSize) chunkBuffer.resize(readChunkSize);
+			targetBuffer = chunkBuffer.data();
+			requestSize = readChunkSize;
+		}
+		
+		// Attempt to read data from the file. The data is read before the 
+		// encryption is enabled when the cipher is absent.
+		bool encrypted = cipher != nullptr;
+		int readStatus = receive(metrics, targetBuffer, requestSize);
+		if(readStatus == -1) {
+			if(errno == EWOULDBLOCK || errno == EAGAIN) {
+				activeEvent = McIoEventBitClear(activeEvent, McIoEvent::evIn);
+				return McIoNextStatus::nstPoll;	
+			} else throw std::runtime_error("The descriptor some "
+				"not allowed error with it.");
+		}
+		else if(readStatus <= 0 || (size_t)readStatus > requestSize) 
+			throw std::runtime_error("The descriptor has already "
+				"closed or exhibited undefined behaviors.");
+		
+		if(targetBuffer != chunkBuffer.data()) {
+			// The data has been read into the inbound buffer.
+			readSize += (size_t)readStatus;
+			if(readSize == packetSize) {
+				dispatch(inboundBuffer, packetSize, handleData);
+				resetPacket();
+			}
+		}
+		else {
+			// Parse as many packets as possible from the chunk.
+			const char* current = targetBuffer;
+			const char* end = targetBuffer + readStatus;
+			while(current < end && !disconnectIndicated) {
+				if(status < cstPacketLengthOverflow) {
+					// Parse the length field of the packet.
+					char thizByte = *current; ++ current;
+					packetSize |= (((size_t)thizByte) & 0x07f) << (status * 7);
+					if((((int)thizByte) & 0x080) != 0) {
+						status = cstPacketLengthOf(status + 1);
+						if(status == cstPacketLengthOverflow) {
+							activeEvent = McIoEventBitClear(activeEvent, McIoEvent::evIn);
+							return McIoNextStatus::nstFinal;
+						}
+					}
+					else if((packetSize == 0) || (maxPacketSize > 0 && packetSize > maxPacketSize)) {
+						status = cstPacketLengthOverflow;	// Make it an invalid status.
+						activeEvent = McIoEventBitClear(activeEvent, McIoEvent::evIn);
+						return McIoNextStatus::nstFinal;
+					}
+					else status = cstPacketData;
+				}
+				else if(readSize == 0 && (size_t)(end - current) >= packetSize) {
+					// The packet is completely inside the chunk.
+					dispatch(current, packetSize, handleData);
+					current += packetSize;
+					resetPacket();
+					
+					// The encryption is enabled by the packet, and the rest of
+					// the chunk is encrypted.
+					if(!encrypted && cipher != nullptr) {
+						cipher -> decrypt(const_cast<char*>(current), (size_t)(end - current));
+						encrypted = true;
+					}
+				}
+				else {
+					// The packet is split across chunks, gather it.
+					acquireInbound(pool);
+					size_t copySize = std::min((size_t)(end - current), packetSize - readSize);
+					memcpy(&inboundBuffer[readSize], current, copySize);
+					readSize += copySize;
+					current += copySize;
+					if(readSize == packetSize) {
+						dispatch(inboundBuffer, packetSize, handleData);
+						resetPacket();
+						if(!encrypted && cipher != nullptr) {
+							cipher -> decrypt(const_cast<char*>(current), (size_t)(end - current));
+							encrypted = true;
+						}
+					}
+				}
+			}
+		}
+		
+		// A short read means the socket has been drained, so poll for more data.
+		// Otherwise yield, and there might be more data to read.
+		if(disconnectIndicated || (size_t)readStatus < requestSize) {
+			activeEvent = McIoEventBitClear(activeEvent, McIoEvent::evIn);
+			return disconnectIndicated? McIoNextStatus::nstFinal : McIoNextStatus::nstPoll;
+		}
+		else return McIoNextStatus::nstMore;
+	}
 };
 static_assert(sizeof(McIoConnectionControl) < McIoConnection::socketControlBlockSize, 
 	"Insufficient space for the connection control block.");
@@ -205,18 +400,119 @@ size_t McIoConnection::getMaximumPacketSize() const {
 	return ((McIoConnectionControl*)control) -> maxPacketSize;
 }
 
+// Implementation for the McIoConnection::setReadChunkSize().
+void McIoConnection::setReadChunkSize(size_t newSize) {
+	((McIoConnectionControl*)control) -> readChunkSize = newSize;
+}
+
+// Implementation for the McIoConnection::getReadChunkSize().
+size_t McIoConnection::getReadChunkSize() const {
+	return ((McIoConnectionControl*)control) -> readChunkSize;
+}
+
+// Implementation for the McIoConnection::setCompressionThreshold().
+void McIoConnection::setCompressionThreshold(int newThreshold) {
+	McIoConnectionControl* controlBlock = (McIoConnectionControl*)control;
+	if(newThreshold >= 0) {
+		if(controlBlock -> compression == nullptr) controlBlock -> compression
+			.reset(new McIoCompressionControl((size_t)newThreshold));
+		else controlBlock -> compression -> threshold = (size_t)newThreshold;
+	}
+	controlBlock -> compressionThreshold = newThreshold < 0? -1 : newThreshold;
+}
+
+// Implementation for the McIoConnection::getCompressionThreshold().
+int McIoConnection::getCompressionThreshold() const {
+	return ((McIoConnectionControl*)control) -> compressionThreshold;
+}
+
+// Implementation for the McIoConnection::enableEncryption().
+void McIoConnection::enableEncryption(const char* sharedSecret, size_t size) {
+	McIoConnectionControl* controlBlock = (McIoConnectionControl*)control;
+	if(size != McIoCipherControl::blockSize)
+		throw std::runtime_error("The shared secret must be 16 bytes.");
+	if(controlBlock -> cipher != nullptr)
+		throw std::runtime_error("The encryption has already been enabled.");
+	controlBlock -> cipher.reset(new McIoCipherControl(sharedSecret));
+	setWriteCipher(controlBlock -> cipher.get());
+}
+
+// Implementation for the McIoConnection::isEncryptionEnabled().
+bool McIoConnection::isEncryptionEnabled() const {
+	return ((McIoConnectionControl*)control) -> cipher != nullptr;
+}
+
+// Implementation for the McIoConnection::writePacket().
+void McIoConnection::writePacket(const McIoBufferOutputStream& packet) {
+	McIoConnectionControl* controlBlock = (McIoConnectionControl*)control;
+	const char* buffer; size_t size;
+	if(controlBlock -> compressionThreshold < 0) 
+		std::tie(size, buffer) = packet.lengthPrefixedData();
+	else {
+		std::tie(size, buffer) = packet.rawData();
+		std::tie(size, buffer) = controlBlock -> compression -> deflate(buffer, size);
+	}
+	controlBlock -> countWritten(metrics());
+	write(buffer, size);
+}
+
+// Implementation for the McIoConnection::writePacket() with buffer taken over.
+void McIoConnection::writePacket(McIoBufferOutputStream&& packet) {
+	McIoConnectionControl* controlBlock = (McIoConnectionControl*)control;
+	if(controlBlock -> compressionThreshold >= 0) {
+		// The deflated data is never inside the packet buffer.
+		writePacket((const McIoBufferOutputStream&)packet);
+		packet.reset();
+		return;
+	}
+	
+	std::shared_ptr<char> buffer; size_t offset, size;
+	std::tie(buffer, offset, size) = packet.releaseLengthPrefixedData();
+	
+	// The buffer is taken over, so it is encrypted in place and still queued 
+	// without being copied.
+	controlBlock -> countWritten(metrics());
+	writeExclusive(buffer, offset, size);
+}
+
+// Implementation for the McIoConnection::writePacket() with broadcast packet.
+void McIoConnection::writePacket(const McIoBroadcastPacket& packet) {
+	McIoConnectionControl* controlBlock = (McIoConnectionControl*)control;
+	if(packet.getCompressionThreshold() != controlBlock -> compressionThreshold)
+		throw std::runtime_error("The broadcast packet is framed with "
+			"different compression threshold.");
+	controlBlock -> countWritten(metrics());
+	write(packet);
+}
+
+// Implementation for the McIoConnection::connectionStats().
+McIoConnection::McIoConnectionStats McIoConnection::connectionStats() const noexcept {
+	return ((const McIoConnectionControl*)control) -> stats;
+}
+
 // Implementation for the McIoConnection::indicateDisconnect().
 void McIoConnection::indicateDisconnect() noexcept {
 	indicateWriteClose();
 	((McIoConnectionControl*)control) -> disconnectIndicated = true;
 }
 
+// Implementation for the McIoConnection::handleFlush().
+void McIoConnection::handleFlush() {
+	McIoWritable::flush();
+}
+
 // Implementation for the McIoConnection::handle().
 McIoNextStatus McIoConnection::handle(McIoEvent& events) {
 	// Attempt to perform I/O first.
-	McIoNextStatus readNext = ((McIoConnectionControl*)control) -> handleRead(
-		events, [this](size_t packetSize, McIoMarkableStream& inputStream) 
-				{ handle(packetSize, inputStream); });
+	McIoConnectionControl* controlBlock = (McIoConnectionControl*)control;
+	McIoMultiplexer& multiplexer = getMultiplexer();
+	McIoMultiplexerMetrics& metrics = multiplexer.metrics();
+	McIoNextStatus readNext = controlBlock -> handleRead(events, multiplexer.bufferPool(), metrics,
+		[this, controlBlock, &metrics](size_t packetSize, McIoMarkableStream& inputStream) {
+			if(McIoMetricsEnabled) ++ controlBlock -> stats.packetsRead;
+			metrics.packetsIn.add();
+			handle(packetSize, inputStream);
+		});
 	McIoNextStatus writeNext = handleWrite(events);
 	
 	// If next state of writeNext would be McIoNextStatus::nstFinal, the 
@@ -0,0 +1,75 @@
+/**
+ * @file descriptorslab.cpp
+ * @brief Implementation for descriptorslab.hpp.
+ * @author Haoran Luo
+ *
+ * For interface specification, please refer to the corresponding header.
+ * @see descriptorslab.hpp
+ */
+#include "descriptorslab.hpp"
+#include "libminecraft/multiplexer.hpp"
+#include <algorithm>
+#include <new>
+
+// Definitions of the slab constants, as they are bound to references.
+const size_t McIoDescriptorSlab::granularity;
+const size_t McIoDescriptorSlab::numSizeClasses;
+const size_t McIoDescriptorSlab::chunkSize;
+const size_t McIoDescriptorSlab::maximumSize;
+
+// Implementation for McIoDescriptorSlab::allocate().
+void* McIoDescriptorSlab::allocate(size_t size) {
+	if(size > maximumSize) return ::operator new(size);
+	size_t sizeClass = (sizeof(McIoDescriptorHeader) + size 
+		+ granularity - 1) / granularity;
+	size_t blockSize = sizeClass * granularity;
+
+	// Carve a new chunk into blocks when the free list runs out.
+	if(freeLists[sizeClass] == nullptr) {
+		size_t numBlocks = std::max<size_t>(1, chunkSize / blockSize);
+		chunks.push_back(std::unique_ptr<char[]>(new char[numBlocks * blockSize]));
+		char* chunk = chunks.back().get();
+		for(size_t i = numBlocks; i > 0; -- i) {
+			void* block = &chunk[(i - 1) * blockSize];
+			*(void**)block = freeLists[sizeClass];
+			freeLists[sizeClass] = block;
+		}
+	}
+
+	// Take the block from the free list and fill in its header.
+	void* block = freeLists[sizeClass];
+	freeLists[sizeClass] = *(void**)block;
+	McIoDescriptorHeader* header = (McIoDescriptorHeader*)block;
+	header -> slab = this;
+	header -> sizeClass = sizeClass;
+	return header + 1;
+}
+
+// Implementation for McIoDescriptorSlab::release().
+void McIoDescriptorSlab::release(void* descriptor, size_t size) noexcept {
+	if(descriptor == nullptr) return;
+	if(size > maximumSize) { ::operator delete(descriptor); return; }
+	McIoDescriptorHeader* header = ((McIoDescriptorHeader*)descriptor) - 1;
+	McIoDescriptorSlab* slab = header -> slab;
+	if(slab == nullptr) ::operator delete(header);
+	else {
+		void* block = header;
+		*(void**)block = slab -> freeLists[header -> sizeClass];
+		slab -> freeLists[header -> sizeClass] = block;
+	}
+}
+
+// Implementation for McIoDescriptor::operator new().
+void* McIoDescriptor::operator new(size_t size) {
+	if(size > McIoDescriptorSlab::maximumSize) return ::operator new(size);
+	McIoDescriptorHeader* header = (McIoDescriptorHeader*)
+		::operator new(sizeof(McIoDescriptorHeader) + size);
+	header -> slab = nullptr;
+	header -> sizeClass = 0;
+	return header + 1;
+}
+
+// Implementation for McIoDescriptor::operator delete().
+void McIoDescriptor::operator delete(void* descriptor, size_t size) noexcept {
+	McIoDescriptorSlab::release(descriptor, size);
+}
\ No newline at end of file
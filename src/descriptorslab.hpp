@@ -0,0 +1,70 @@
+#pragma once
+/**
+ * @file descriptorslab.hpp
+ * @brief Slab allocator of the descriptors.
+ * @author Haoran Luo
+ *
+ * Each multiplexer owns a slab, from which McIoMultiplexer::emplace()
+ * allocates the descriptors. The slab keeps the freed blocks in the free
+ * list of their size class, so that the connections accepted and closed
+ * in a burst reuse the blocks instead of going to the heap.
+ *
+ * Every descriptor small enough for the slab is allocated with a header
+ * placed before it by the McIoDescriptor::operator new(), which records the
+ * slab the block comes from, or null if it comes from the heap. So these 
+ * descriptors are always deleted in the same way, regardless of how they 
+ * are allocated. The larger ones are allocated from the heap without header,
+ * as they are told apart by the size passed to operator delete().
+ */
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+// For pointer reference in the descriptor header.
+struct McIoDescriptorSlab;
+
+/// The header placed before each descriptor.
+struct alignas(alignof(std::max_align_t)) McIoDescriptorHeader {
+	/// The slab the descriptor is allocated from, or null if from the heap.
+	McIoDescriptorSlab* slab;
+
+	/// The size class of the block inside the slab.
+	size_t sizeClass;
+};
+
+/// The slab of descriptors, which is not MT-Safe just like the multiplexer.
+struct McIoDescriptorSlab {
+	/// The size difference between the size classes.
+	static const size_t granularity = 64;
+
+	/// The number of size classes, where larger blocks come from the heap.
+	static const size_t numSizeClasses = 32;
+
+	/// The size of the chunks which the blocks are carved from.
+	static const size_t chunkSize = 65536;
+
+	/// The size of the largest descriptor in the slab, where the larger 
+	/// ones are allocated from the heap without header.
+	static const size_t maximumSize = granularity * (numSizeClasses - 1)
+		- sizeof(McIoDescriptorHeader);
+
+	/// The first free block of each size class, where each free block
+	/// stores the next free block.
+	std::vector<void*> freeLists;
+
+	/// The chunks allocated, released along with the slab.
+	std::vector<std::unique_ptr<char[]>> chunks;
+
+	McIoDescriptorSlab(): freeLists(numSizeClasses, nullptr), chunks() {}
+
+	/**
+	 * @brief Allocate the block for the descriptor of certain size.
+	 * @return the address of the descriptor, after its header.
+	 * @throw std::bad_alloc when there's no memory.
+	 */
+	void* allocate(size_t size);
+
+	/// Release the block of the descriptor of certain size, either to its 
+	/// slab or the heap.
+	static void release(void* descriptor, size_t size) noexcept;
+};
\ No newline at end of file
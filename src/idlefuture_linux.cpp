@@ -9,6 +9,8 @@
 #include "libminecraft/idlefuture.hpp"
 #include <sys/eventfd.h>
 #include <stdexcept>
+#include <chrono>
+#include <algorithm>
 #include <unistd.h>
 
 // Define and ensure the size of the counter is valid.
@@ -22,46 +24,224 @@ int McOsCreateIdleFutureDescriptor() /*mayThrow*/ {
 	return iffd;
 }
 
+// Retrieve the monotonic timestamp for the runtime accounting.
+static inline uint64_t McOsIdleFutureClock() noexcept {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Definitions of the time constants, as they are bound to references.
+const unsigned long McIoIdleFuture::defaultTimeSlice;
+const unsigned long McIoIdleFuture::defaultTimeReserve;
+
 // The implementation for McIoIdleFuture::McIoIdleFuture().
 McIoIdleFuture::McIoIdleFuture(): McOsExecutorService(), 
-	McIoDescriptor(McOsCreateIdleFutureDescriptor(), McIoEvent::evIn), taskQueue() {}
+	McIoDescriptor(McOsCreateIdleFutureDescriptor(), McIoEvent::evIn), taskQueues(),
+	numTasks(0), timeSlice(defaultTimeSlice), timeReserve(defaultTimeReserve), 
+	deferred(false) {}
 
 // The implementation for McIoIdleFuture::~McIoIdleFuture().
 McIoIdleFuture::~McIoIdleFuture() {}
 
+// The implementation for McIoIdleFuture::notify().
+void McIoIdleFuture::notify() {
+	iffd_t v = 1; if(write(fd, &v, 8) != 8) 
+		throw std::runtime_error("Invalid future enqueuing state.");
+	if(metrics() != nullptr) metrics() -> syscalls.add();
+}
+
 // The implementation for McIoIdleFuture::enqueue().
 void McIoIdleFuture::enqueue(std::unique_ptr<McOsFutureTask>& task) {
-	if(taskQueue.empty()) {
-		iffd_t v = 1; if(write(fd, &v, 8) != 8) 
-			throw std::runtime_error("Invalid future enqueuing state.");
+	enqueue(task, McOsFuturePriority::fpNormal);
+}
+
+// The implementation for McIoIdleFuture::enqueue() with priority.
+void McIoIdleFuture::enqueue(std::unique_ptr<McOsFutureTask>& task, 
+		McOsFuturePriority priority) {
+	if((size_t)priority >= (size_t)fpNumPriorities) 
+		throw std::runtime_error("Invalid future task priority.");
+	
+	// The deferred executor is waken only for the foreground task.
+	if(numTasks == 0 || (deferred && priority == fpForeground)) notify();
+	taskQueues[priority].emplace(std::move(task));
+	++ numTasks;
+}
+
+// The implementation for McIoIdleFuture::handleTimeout().
+void McIoIdleFuture::handleTimeout() {
+	if(deferred) {
+		deferred = false;
+		notify();
 	}
-	taskQueue.push(std::move(task));
 }
 
 // The implementation for McIoIdleFuture::handle().
 McIoNextStatus McIoIdleFuture::handle(McIoEvent& eventFlag) {
 	if((eventFlag & McIoEvent::evIn) == McIoEvent::evIn) {
-		// Perform execution on each enqueued tasks.
-		for(size_t i = 0; i < numHandleExecute && !taskQueue.empty(); ++ i) {
+		// The tasks run until the time slice or the time left before the 
+		// time reserve of the tick, whichever is shorter, is used up.
+		McIoMultiplexerMetrics* loopMetrics = metrics();
+		unsigned long remaining = getMultiplexer().remainingTime();
+		uint64_t budget = remaining > timeReserve?
+			std::min<uint64_t>(remaining - timeReserve, timeSlice) : 0;
+		uint64_t begin = McOsIdleFutureClock(), elapsed = 0;
+		bool first = true;
+		while(numTasks > 0) {
+			size_t priority = 0;
+			while(taskQueues[priority].empty()) ++ priority;
+			
+			// Only the foreground task could exceed the budget, and only once.
+			if(elapsed >= budget && !(first && priority == fpForeground)) break;
+			first = false;
+			
+			// Attempt to advance the task, the task throwing exception will 
+			// be removed, with the exception preserved.
+			std::queue<McIoQueuedFutureTask>& taskQueue = taskQueues[priority];
+			uint64_t start = McOsIdleFutureClock();
+			bool unfinished = false;
 			try {
-				// Just attempt to advance the task.
-				if(!taskQueue.front()->advance())
+				unfinished = taskQueue.front().advance(loopMetrics);
+			}
+			catch(...) {}
+			uint64_t end = McOsIdleFutureClock();
+			taskQueue.front().runTime += end - start;
+			elapsed = end - begin;
+			
+			// The unfinished task is moved to the back of its class, while
+			// the finished task is removed.
+			if(unfinished) {
+				if(taskQueue.size() > 1) {
+					taskQueue.push(std::move(taskQueue.front()));
 					taskQueue.pop();
+				}
 			}
-			catch(const std::runtime_error& ex) {
+			else {
+				if(loopMetrics != nullptr) 
+					loopMetrics -> taskRunTime.record(taskQueue.front().runTime / 1000);
+				taskQueue.pop();
+				-- numTasks;
+			}
+		}
+		
+		// Yield to other descriptors if the tick has time left, otherwise 
+		// defer to the next tick, as there's no event to wait for.
+		if(numTasks > 0 && getMultiplexer().remainingTime() > timeReserve) 
+			return McIoNextStatus::nstMore;
+		iffd_t v; if(read(fd, &v, 8) != 8) 
+			throw std::runtime_error("Invalid future dequeuing state.");
+		if(loopMetrics != nullptr) loopMetrics -> syscalls.add();
+		if(numTasks > 0) {
+			if(loopMetrics != nullptr) loopMetrics -> taskDeferrals.add();
+			deferred = true;
+			scheduleTimeout(1);
+		}
+		else if(deferred) {
+			deferred = false;
+			cancelTimeout();
+		}
+		return McIoNextStatus::nstPoll;
+	}
+	else return McIoNextStatus::nstPoll;
+}
+
+// The implementation for McIoConcurrentFuture::McIoConcurrentFuture().
+McIoConcurrentFuture::McIoConcurrentFuture(): McOsExecutorService(), 
+	McIoDescriptor(McOsCreateIdleFutureDescriptor(), McIoEvent::evIn),
+	head(nullptr), tail(nullptr), sleeping(true), enqueuing(0), taskQueue() {
+	tail = new node();
+	tail -> next.store(nullptr, std::memory_order_relaxed);
+	head.store(tail, std::memory_order_relaxed);
+}
+
+// The implementation for McIoConcurrentFuture::~McIoConcurrentFuture().
+McIoConcurrentFuture::~McIoConcurrentFuture() {
+	while(tail != nullptr) {
+		node* next = tail -> next.load(std::memory_order_acquire);
+		delete tail;
+		tail = next;
+	}
+}
+
+// The implementation for McIoConcurrentFuture::enqueue().
+void McIoConcurrentFuture::enqueue(std::unique_ptr<McOsFutureTask>& task) {
+	std::unique_ptr<node> enqueued(new node());
+	enqueued -> next.store(nullptr, std::memory_order_relaxed);
+	
+	// Notify only when the consumer is waiting. The notification is done
+	// before the task is taken, so that the task is left to the caller
+	// when it fails, and the consumer woken before the node is linked will
+	// keep running until the producer has finished.
+	enqueuing.fetch_add(1, std::memory_order_acq_rel);
+	if(sleeping.exchange(false, std::memory_order_acq_rel)) {
+		iffd_t v = 1; if(write(fd, &v, 8) != 8) {
+			sleeping.store(true, std::memory_order_release);
+			enqueuing.fetch_sub(1, std::memory_order_release);
+			throw std::runtime_error("Invalid future enqueuing state.");
+		}
+	}
+	enqueued -> task = std::move(task);
+	enqueued -> enqueued = McIoMetricsClock();
+	
+	// Link the node after the previous head, the consumer will see the 
+	// node once the link has been done.
+	node* linked = enqueued.release();
+	node* previous = head.exchange(linked, std::memory_order_acq_rel);
+	previous -> next.store(linked, std::memory_order_release);
+	enqueuing.fetch_sub(1, std::memory_order_release);
+}
+
+// The implementation for McIoConcurrentFuture::take().
+void McIoConcurrentFuture::take() {
+	node* next;
+	while((next = tail -> next.load(std::memory_order_acquire)) != nullptr) {
+		taskQueue.emplace(std::move(next -> task));
+		taskQueue.back().enqueued = next -> enqueued;
+		delete tail;
+		tail = next;
+	}
+}
+
+// The implementation for McIoConcurrentFuture::handle().
+McIoNextStatus McIoConcurrentFuture::handle(McIoEvent& eventFlag) {
+	if((eventFlag & McIoEvent::evIn) == McIoEvent::evIn) {
+		// Consume the notification, which might not be there as the 
+		// notification could be consumed by previous handle.
+		McIoMultiplexerMetrics* loopMetrics = metrics();
+		iffd_t v; while(read(fd, &v, 8) == 8)
+			if(loopMetrics != nullptr) loopMetrics -> syscalls.add();
+		if(loopMetrics != nullptr) loopMetrics -> syscalls.add();
+		
+		// Perform execution on each enqueued tasks, the unfinished task is 
+		// moved to the back after each step.
+		take();
+		for(size_t i = 0; i < numHandleExecute && !taskQueue.empty(); ++ i) {
+			bool unfinished = false;
+			try {
+				unfinished = taskQueue.front().advance(loopMetrics);
+			}
+			catch(...) {
 				// The exception will be preserved, and the front task will be 
 				// therefore removed.
+			}
+			if(!unfinished) taskQueue.pop();
+			else if(taskQueue.size() > 1) {
+				taskQueue.push(std::move(taskQueue.front()));
 				taskQueue.pop();
 			}
 		}
-		
-		// Return depending on whether there's more tasks waiting to run.
 		if(!taskQueue.empty()) return McIoNextStatus::nstMore;
-		else {
-			iffd_t v; if(read(fd, &v, 8) != 8) 
-				throw std::runtime_error("Invalid future dequeuing state.");
-			return McIoNextStatus::nstPoll;
-		}
+		
+		// Mark as waiting and check again, since the producers might have
+		// seen the consumer as running, or are still linking their nodes.
+		sleeping.exchange(true, std::memory_order_acq_rel);
+		bool linking = enqueuing.load(std::memory_order_acquire) > 0;
+		take();
+		if((!taskQueue.empty() || linking) && 
+			sleeping.exchange(false, std::memory_order_acq_rel))
+			return McIoNextStatus::nstMore;
+		
+		// Or the producer has notified, so it is safe to poll.
+		return McIoNextStatus::nstPoll;
 	}
 	else return McIoNextStatus::nstPoll;
 }
\ No newline at end of file
@@ -7,13 +7,20 @@
  * @see libminecraft/iobase.hpp
  */
 #include "libminecraft/iobase.hpp"
-#include "libminecraft/bufstream.hpp"
 #include <netinet/in.h>
 #include <stdexcept>
 #include <vector>
+#include <tuple>
 #include <locale>
 #include <codecvt>
 #include <climits>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #ifdef _MSC_VER
 // The microsoft has already implemented ntohll() and htonll().
@@ -36,18 +43,6 @@ inline McIoOutputStream& out(McIoOutputStream& outputStream,
 	return outputStream;
 }
 
-// The general input function for fixed flavour data, including 
-// a host-network conversion and an input call.
-template<typename T, T (Ntoh)(T)>
-inline McIoInputStream& in(McIoInputStream& inputStream,
-	McDtDataType<T, McDtFlavourFixed>& data) {
-	
-	T networkData;
-	inputStream.read((char*)&networkData, sizeof(networkData));
-	data = Ntoh(networkData);
-	return inputStream;
-}
-
 // The host-network conversion that do nothing, suitable for single byte.
 template<typename T>
 inline T emptyconv(T v) { return v; }
@@ -58,22 +53,12 @@ mc::s8::write(McIoOutputStream& outputStream) const {
 	return out<int8_t, emptyconv<int8_t> >(outputStream, *this);
 }
 
-template<> McIoInputStream&
-mc::s8::read(McIoInputStream& inputStream) {
-	return in<int8_t, emptyconv<int8_t> >(inputStream, *this);
-}
-
 // Instantiation of mc::u8's I/O methods.
 template<> McIoOutputStream& 
 mc::u8::write(McIoOutputStream& outputStream) const {
 	return out<uint8_t, emptyconv<uint8_t> >(outputStream, *this);
 }
 
-template<> McIoInputStream& 
-mc::u8::read(McIoInputStream& inputStream) {
-	return in<uint8_t, emptyconv<uint8_t> >(inputStream, *this);
-}
-
 // The host-network conversion that involves a concrete function.
 template<typename T, typename V, V (nhconv)(V)> 
 inline T concreteconv(T v) {
@@ -88,107 +73,58 @@ mc::s16::write(McIoOutputStream& outputStream) const {
 	return out<int16_t, concreteconv<int16_t, uint16_t, htons> >(outputStream, *this);
 }
 
-template<> McIoInputStream& 
-mc::s16::read(McIoInputStream& inputStream) {
-	return in<int16_t, concreteconv<int16_t, uint16_t, ntohs> >(inputStream, *this);
-}
-
 // Instantiation of mc::u16's I/O methods.
 template<> McIoOutputStream& 
 mc::u16::write(McIoOutputStream& outputStream) const {
 	return out<uint16_t, concreteconv<uint16_t, uint16_t, htons> >(outputStream, *this);
 }
 
-template<> McIoInputStream& 
-mc::u16::read(McIoInputStream& inputStream) {
-	return in<uint16_t, concreteconv<uint16_t, uint16_t, ntohs> >(inputStream, *this);
-}
-
 // Instantiation of mc::s32's I/O methods.
 template<> McIoOutputStream& 
 mc::s32::write(McIoOutputStream& outputStream) const {
 	return out<int32_t, concreteconv<int32_t, uint32_t, htonl> >(outputStream, *this);
 }
 
-template<> McIoInputStream& 
-mc::s32::read(McIoInputStream& inputStream) {
-	return in<int32_t, concreteconv<int32_t, uint32_t, ntohl> >(inputStream, *this);
-}
-
 // Instantiation of mc::u32's I/O methods.
 template<> McIoOutputStream& 
 mc::u32::write(McIoOutputStream& outputStream) const {
 	return out<uint32_t, concreteconv<uint32_t, uint32_t, htonl> >(outputStream, *this);
 }
 
-template<> McIoInputStream& 
-mc::u32::read(McIoInputStream& inputStream) {
-	return in<uint32_t, concreteconv<uint32_t, uint32_t, ntohl> >(inputStream, *this);
-}
-
 // Instantiation of mc::s64's I/O methods.
 template<> McIoOutputStream& 
 mc::s64::write(McIoOutputStream& outputStream) const {
 	return out<int64_t, concreteconv<int64_t, uint64_t, htonll> >(outputStream, *this);
 }
 
-template<> McIoInputStream& 
-mc::s64::read(McIoInputStream& inputStream) {
-	return in<int64_t, concreteconv<int64_t, uint64_t, ntohll> >(inputStream, *this);
-}
-
 // Instantiation of mc::u64's I/O methods.
 template<> McIoOutputStream& 
 mc::u64::write(McIoOutputStream& outputStream) const {
 	return out<uint64_t, concreteconv<uint64_t, uint64_t, htonll> >(outputStream, *this);
 }
 
-template<> McIoInputStream& 
-mc::u64::read(McIoInputStream& inputStream) {
-	return in<uint64_t, concreteconv<uint64_t, uint64_t, ntohll> >(inputStream, *this);
-}
-
 // The variant length integer's output method.
 template<typename T, int maxLength, int msbmax>
 inline McIoOutputStream& out(McIoOutputStream& outputStream, 
 	const McDtDataType<T, McDtFlavourVariant>& data) {
 	
 	T value = data;
-	for(size_t i = 0; i < maxLength; ++ i) {
+	unsigned char encoded[maxLength]; size_t i;
+	for(i = 0; i < maxLength; ++ i) {
 		// Retrieve current byte.
 		unsigned char current = (char)(((int)value) & 0x07f);
 		value = value >> 7;
 		
-		// Analyze and write out.
+		// Analyze and place into the encoded buffer.
 		if(value != 0) current |= (char)0x080;
 		if(i == maxLength - 1) current &= msbmax;
-		outputStream.write((char*)&current, 1);
+		encoded[i] = current;
 		if(value == 0) break;
 	}
-	return outputStream;
-}
-
-// The variant length integer's output method.
-template<typename T, int maxLength, int msbmax>
-inline McIoInputStream& in(McIoInputStream& inputStream, 
-	McDtDataType<T, McDtFlavourVariant>& data) {
 	
-	T value = 0;
-	for(size_t i = 0; i < maxLength; ++ i) {
-		// Retrieve current byte.
-		unsigned char current;
-		inputStream.read((char*)&current, 1);
-		value |= ((int)current & 0x07f) << (i * 7);
-		
-		// Analyze and determine whether to continue.
-		if(i == maxLength - 1) {
-			if(current > msbmax) throw std::runtime_error(
-				"Malformed variant integer value.");
-		}
-		else if((current & 0x80) == 0) break;
-	}
-	data = value;
-	return inputStream;
+	// Write out all encoded bytes at once.
+	outputStream.write((char*)encoded, i < maxLength? i + 1 : maxLength);
+	return outputStream;
 }
 
 // Instantiation of mc::var32's I/O methods.
@@ -197,52 +133,231 @@ mc::var32::write(McIoOutputStream& outputStream) const {
 	return out<int32_t, 5, 15>(outputStream, *this);
 }
 
-template<> McIoInputStream& 
-mc::var32::read(McIoInputStream& inputStream) {
-	return in<int32_t, 5, 15>(inputStream, *this);
-}
-
 // Instantiation of mc::var64's I/O methods.
 template<> McIoOutputStream& 
 mc::var64::write(McIoOutputStream& outputStream) const {
 	return out<int64_t, 10, 1>(outputStream, *this);
 }
 
-template<> McIoInputStream& 
-mc::var64::read(McIoInputStream& inputStream) {
-	return in<int64_t, 10, 1>(inputStream, *this);
+// Swap the byte order of scalar elements, identity on big endian hosts.
+static inline uint16_t McIoSwapScalar(uint16_t v) { return ntohs(v); }
+static inline uint32_t McIoSwapScalar(uint32_t v) { return ntohl(v); }
+static inline uint64_t McIoSwapScalar(uint64_t v) { return ntohll(v); }
+
+// Swap the byte order inside every lane of the vector.
+#if defined(__AVX2__)
+static inline __m256i McIoSwapLanes(__m256i x, uint16_t) {
+	return _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+		1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+		1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
 }
 
-inline bool McIoIsNotFollowerByte(char c) {
-	return (c & 0xc0) != 0x80;
+static inline __m256i McIoSwapLanes(__m256i x, uint32_t) {
+	return _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+}
+
+static inline __m256i McIoSwapLanes(__m256i x, uint64_t) {
+	return _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+}
+#endif
+#if defined(__SSE2__)
+static inline __m128i McIoSwapLanes(__m128i x, uint16_t) {
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+static inline __m128i McIoSwapLanes(__m128i x, uint32_t) {
+	return McIoSwapLanes(_mm_shufflehi_epi16(
+		_mm_shufflelo_epi16(x, 0xb1), 0xb1), uint16_t());
+}
+
+static inline __m128i McIoSwapLanes(__m128i x, uint64_t) {
+	return McIoSwapLanes(_mm_shufflehi_epi16(
+		_mm_shufflelo_epi16(x, 0x1b), 0x1b), uint16_t());
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+static inline uint8x16_t McIoSwapLanes(uint8x16_t x, uint16_t) { return vrev16q_u8(x); }
+static inline uint8x16_t McIoSwapLanes(uint8x16_t x, uint32_t) { return vrev32q_u8(x); }
+static inline uint8x16_t McIoSwapLanes(uint8x16_t x, uint64_t) { return vrev64q_u8(x); }
+#endif
+
+// Swap the byte order of the elements in place, between network and host.
+template<typename U> static inline void McIoSwapElements(U* elements, size_t count) {
+	size_t i = 0;
+#if defined(__AVX2__)
+	for(; i + 32 / sizeof(U) <= count; i += 32 / sizeof(U)) {
+		__m256i* block = reinterpret_cast<__m256i*>(elements + i);
+		_mm256_storeu_si256(block, McIoSwapLanes(_mm256_loadu_si256(block), U()));
+	}
+#endif
+#if defined(__SSE2__)
+	for(; i + 16 / sizeof(U) <= count; i += 16 / sizeof(U)) {
+		__m128i* block = reinterpret_cast<__m128i*>(elements + i);
+		_mm_storeu_si128(block, McIoSwapLanes(_mm_loadu_si128(block), U()));
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	for(; i + 16 / sizeof(U) <= count; i += 16 / sizeof(U)) {
+		uint8_t* block = reinterpret_cast<uint8_t*>(elements + i);
+		vst1q_u8(block, McIoSwapLanes(vld1q_u8(block), U()));
+	}
+#endif
+	for(; i < count; ++ i) elements[i] = McIoSwapScalar(elements[i]);
+}
+
+// The single bytes have no byte order.
+template<> inline void McIoSwapElements<uint8_t>(uint8_t*, size_t) {}
+
+// Implementation for McIoReadFixedArray().
+template<typename U> void McIoReadFixedArray(
+		McIoInputStream& inputStream, U* elements, size_t count) {
+	
+	size_t size = count * sizeof(U);
+	if(inputStream.windowSize() >= size) {
+		memcpy(elements, inputStream.window(), size);
+		inputStream.consume(size);
+	}
+	else inputStream.read((char*)elements, size);
+	McIoSwapElements(elements, count);
+}
+
+/// The size of the chunk to convert the fixed length array for writing.
+static const size_t fixedArrayChunkSize = 4096;
+
+// Implementation for McIoWriteFixedArray().
+template<typename U> void McIoWriteFixedArray(
+		McIoOutputStream& outputStream, const U* elements, size_t count) {
+	
+	if(sizeof(U) == 1) {
+		outputStream.write((const char*)elements, count);
+		return;
+	}
+	
+	// Convert and write the elements chunk by chunk.
+	U chunk[fixedArrayChunkSize / sizeof(U)];
+	const size_t chunkLength = sizeof(chunk) / sizeof(U);
+	for(size_t i = 0; i < count;) {
+		size_t numElements = count - i < chunkLength? count - i : chunkLength;
+		memcpy(chunk, elements + i, numElements * sizeof(U));
+		McIoSwapElements(chunk, numElements);
+		outputStream.write((const char*)chunk, numElements * sizeof(U));
+		i += numElements;
+	}
 }
 
+// Instantiation of the fixed length array I/O methods.
+template void McIoReadFixedArray<uint8_t>(McIoInputStream&, uint8_t*, size_t);
+template void McIoReadFixedArray<uint16_t>(McIoInputStream&, uint16_t*, size_t);
+template void McIoReadFixedArray<uint32_t>(McIoInputStream&, uint32_t*, size_t);
+template void McIoReadFixedArray<uint64_t>(McIoInputStream&, uint64_t*, size_t);
+template void McIoWriteFixedArray<uint8_t>(McIoOutputStream&, const uint8_t*, size_t);
+template void McIoWriteFixedArray<uint16_t>(McIoOutputStream&, const uint16_t*, size_t);
+template void McIoWriteFixedArray<uint32_t>(McIoOutputStream&, const uint32_t*, size_t);
+template void McIoWriteFixedArray<uint64_t>(McIoOutputStream&, const uint64_t*, size_t);
+
 // The exception message for malformed string.
 static const char* malformedString = "Malformed utf-8 string.";
 
-// The utf-8 to utf-16 input converter.
-template<typename Appender>
-inline McIoInputStream& in(McIoInputStream& inputStream, 
-		Appender& appender, size_t byteLength) {
-
-	size_t i;
-	for(i = 0; i < byteLength;) {
-		int v = 0x080808080; 			// Filled with placeholder values.
-		unsigned char* c = reinterpret_cast<unsigned char*>(&v);
-		inputStream.read((char*)c, 1);	// Acquire leading byte.
-		++ i;
+// Widen the leading ascii bytes into utf-16 code units, returning the
+// number of bytes that has been widened.
+static inline size_t McIoWidenAscii(const unsigned char* source, 
+		size_t length, char16_t* destination) {
+	size_t i = 0;
+#if defined(__AVX2__)
+	for(; i + 32 <= length; i += 32) {
+		__m256i bytes = _mm256_loadu_si256((const __m256i*)(source + i));
+		if(_mm256_movemask_epi8(bytes) != 0) break;
+		_mm256_storeu_si256((__m256i*)(destination + i),
+			_mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+		_mm256_storeu_si256((__m256i*)(destination + i + 16),
+			_mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+	}
+#endif
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for(; i + 16 <= length; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(source + i));
+		if(_mm_movemask_epi8(bytes) != 0) break;
+		_mm_storeu_si128((__m128i*)(destination + i), _mm_unpacklo_epi8(bytes, zero));
+		_mm_storeu_si128((__m128i*)(destination + i + 8), _mm_unpackhi_epi8(bytes, zero));
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	for(; i + 16 <= length; i += 16) {
+		uint8x16_t bytes = vld1q_u8(source + i);
+		if(vmaxvq_u8(bytes) >= 0x080) break;
+		vst1q_u16((uint16_t*)(destination + i), vmovl_u8(vget_low_u8(bytes)));
+		vst1q_u16((uint16_t*)(destination + i + 8), vmovl_high_u8(bytes));
+	}
+#endif
+	for(; i < length && source[i] < 0x080; ++ i) destination[i] = source[i];
+	return i;
+}
+
+// Narrow the leading ascii code units into utf-8 bytes, returning the
+// number of code units that has been narrowed.
+static inline size_t McIoNarrowAscii(const char16_t* source,
+		size_t length, char* destination) {
+	size_t i = 0;
+#if defined(__AVX2__)
+	const __m256i wideNonAscii = _mm256_set1_epi16((short)0xff80);
+	for(; i + 32 <= length; i += 32) {
+		__m256i low  = _mm256_loadu_si256((const __m256i*)(source + i));
+		__m256i high = _mm256_loadu_si256((const __m256i*)(source + i + 16));
+		if(!_mm256_testz_si256(_mm256_or_si256(low, high), wideNonAscii)) break;
+		_mm256_storeu_si256((__m256i*)(destination + i), _mm256_permute4x64_epi64(
+			_mm256_packus_epi16(low, high), 0xd8));
+	}
+#endif
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i nonAscii = _mm_set1_epi16((short)0xff80);
+	for(; i + 16 <= length; i += 16) {
+		__m128i low  = _mm_loadu_si128((const __m128i*)(source + i));
+		__m128i high = _mm_loadu_si128((const __m128i*)(source + i + 8));
+		__m128i test = _mm_and_si128(_mm_or_si128(low, high), nonAscii);
+		if(_mm_movemask_epi8(_mm_cmpeq_epi16(test, zero)) != 0x0ffff) break;
+		_mm_storeu_si128((__m128i*)(destination + i), _mm_packus_epi16(low, high));
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	for(; i + 16 <= length; i += 16) {
+		uint16x8_t low  = vld1q_u16((const uint16_t*)(source + i));
+		uint16x8_t high = vld1q_u16((const uint16_t*)(source + i + 8));
+		if(vmaxvq_u16(vorrq_u16(low, high)) >= 0x080) break;
+		vst1q_u8((uint8_t*)(destination + i), vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+	}
+#endif
+	for(; i < length && source[i] < 0x080; ++ i) destination[i] = (char)source[i];
+	return i;
+}
+
+inline bool McIoIsNotFollowerByte(unsigned char c) {
+	return (c & 0xc0) != 0x80;
+}
+
+// The utf-8 to utf-16 decoder, the destination must be able to hold
+// byteLength code units. Returns the number of code units decoded.
+static size_t McIoDecodeUtf8(const unsigned char* source, 
+		size_t byteLength, char16_t* destination) {
+
+	size_t i = 0, numCodeUnits = 0;
+	while(i < byteLength) {
+		// Widen the ascii characters in batch.
+		if(source[i] < 0x080) {
+			size_t widened = McIoWidenAscii(&source[i], 
+				byteLength - i, &destination[numCodeUnits]);
+			i += widened; numCodeUnits += widened;
+			continue;
+		}
 		
 		// Judge how to acquire and handle followed bytes.
+		unsigned char c[4] = { source[i], 0x080, 0x080, 0x080 };
 		size_t followed = 0; 	// The number of bytes followed.
 		int mask = 0;			// The mask applied to leading value.
 		int offset = 0;			// The right-shifting offset.
 		
-		if(c[0] < 0x080) {
-			followed = 0;
-			mask = 0x7f;
-			offset = 18;
-		}
-		else if(c[0] >= 0x0c0 && c[0] < 0x0e0) {
+		if(c[0] >= 0x0c0 && c[0] < 0x0e0) {
 			followed = 1;
 			mask = 0x1f;
 			offset = 12;
@@ -260,10 +375,9 @@ inline McIoInputStream& in(McIoInputStream& inputStream,
 		else throw std::runtime_error(malformedString);
 		
 		// Convert it to a single character.
-		if(followed > 0) {
-			inputStream.read((char*)&c[1], followed);
-			i += followed;
-		}
+		if(byteLength - i <= followed) throw std::runtime_error(malformedString);
+		for(size_t j = 1; j <= followed; ++ j) c[j] = source[i + j];
+		i += followed + 1;
 		if(	McIoIsNotFollowerByte(c[1]) || 
 			McIoIsNotFollowerByte(c[2]) || 
 			McIoIsNotFollowerByte(c[3]))
@@ -275,144 +389,160 @@ inline McIoInputStream& in(McIoInputStream& inputStream,
 								
 		// Convert character value to utf-16 string.
 		if(characterValue < 0x010000) 
-			appender.append((char16_t)characterValue);
+			destination[numCodeUnits ++] = (char16_t)characterValue;
 		else {
 			// Convert to surrogate pair.
 			characterValue -= 0x010000;
 			int highSurrogate = (characterValue >> 10) & 0x03ff;
 			int lowSurrogate  = (characterValue >> 0)  & 0x03ff;
-			appender.append((char16_t)(0xD800 | highSurrogate));
-			appender.append((char16_t)(0xDC00 | lowSurrogate));
+			destination[numCodeUnits ++] = (char16_t)(0xD800 | highSurrogate);
+			destination[numCodeUnits ++] = (char16_t)(0xDC00 | lowSurrogate);
 		}
 	}
-	if(i != byteLength) throw std::runtime_error(malformedString);
-	return inputStream;
+	return numCodeUnits;
+}
+
+// Implementation for McIoReadUtf16Units().
+size_t McIoReadUtf16Units(McIoInputStream& inputStream, 
+		size_t byteLength, char16_t* destination) {
+	
+	// Decode directly from the window when the string is inside it.
+	size_t numCodeUnits;
+	if(inputStream.windowSize() >= byteLength) {
+		numCodeUnits = McIoDecodeUtf8((const unsigned char*)
+			inputStream.window(), byteLength, destination);
+		inputStream.consume(byteLength);
+	}
+	else {
+		std::vector<char> encoded(byteLength);
+		inputStream.read(encoded.data(), byteLength);
+		numCodeUnits = McIoDecodeUtf8((const unsigned char*)
+			encoded.data(), byteLength, destination);
+	}
+	return numCodeUnits;
 }
 
 // Implementation for the read utf-16 string (length known) function.
 McIoInputStream& McIoReadUtf16String(McIoInputStream& inputStream, 
 		size_t byteLength, std::u16string& resultString) {
-	struct McIoVectorAppender {
-		// Stores code points in the string.
-		std::vector<char16_t> stringBuilder;
-		
-		// Constructor for the builder, byteLength / 2 elements should be reserved.
-		// when all characters are 1-byte utf-8, the size will be byteLength.
-		// When all characters are 2-byte utf-8, the size will be byteLength / 2.
-		// when all characters are 3-byte utf-8, the size will be byteLength / 3.
-		// When all characters are 4-byte utf-8, the size will be byteLength.
-		McIoVectorAppender(size_t byteLength): stringBuilder() {
-			stringBuilder.reserve(byteLength / 2);
-		}
-		
-		// Append new code unit to the string.
-		void append(char16_t codeUnit) {
-			stringBuilder.push_back(codeUnit);
-		}
-		
-		// Retrieve the new string.
-		std::u16string toString() {
-			return std::u16string(stringBuilder.data(), stringBuilder.size());
-		}
-	};
 	
-	// Perform conversion.
-	McIoVectorAppender appender(byteLength);
-	McIoInputStream& resultStream = in<McIoVectorAppender>
-				(inputStream, appender, byteLength);
-	resultString = appender.toString();
-	return resultStream;
-}
-
-// The utf-16 to utf-8 output converter.
-template<typename Appender>
-void out(Appender& appender, const std::u16string& outputString) {
-	const mc::var32 length = outputString.length();
+	// Every byte decodes into at most one code unit, as 4-byte utf-8 
+	// characters are converted into surrogate pairs.
+	std::u16string decoded;
+	decoded.resize(byteLength);
+	decoded.resize(McIoReadUtf16Units(inputStream, byteLength, &decoded[0]));
+	resultString.swap(decoded);
+	return inputStream;
+}
+
+// Implementation for McIoUtf8Length().
+size_t McIoUtf8Length(const char16_t* source, size_t length) noexcept {
+	size_t numBytes = 0;
+	for(size_t i = 0; i < length; ++ i) {
+		char16_t codeUnit = source[i];
+		if(codeUnit < 0x080) numBytes += 1;
+		else if(codeUnit < 0x0800) numBytes += 2;
+		else if((codeUnit & 0xF800) == 0xD800) numBytes += 2;
+		else numBytes += 3;
+	}
+	return numBytes;
+}
+
+// Implementation for McIoEncodeUtf8().
+size_t McIoEncodeUtf8(const char16_t* source, 
+		size_t length, char* destination) {
 	
-	// Convert the string into utf-8 on writing out.
+	size_t numBytes = 0;
 	for(size_t i = 0; i < length;) {
+		// Narrow the ascii characters in batch.
+		if(source[i] < 0x080) {
+			size_t narrowed = McIoNarrowAscii(&source[i],
+				length - i, &destination[numBytes]);
+			i += narrowed; numBytes += narrowed;
+			continue;
+		}
+		
 		// Retrieve character values first.
 		int charValue = 0;
-		char16_t highBits = (outputString[i] & 0xFC00);
+		char16_t highBits = (source[i] & 0xFC00);
 		
 		// Judge whether it is a high surrogate.
 		if(highBits >= 0xD800 && highBits < 0xE000) {
 			// The followed byte must be a low surrogate.
-			if(i + 1 >= length || (outputString[i + 1] & 0xFC00) != 0xDC00)
-				throw std::string("The utf-16 string is malformed");
+			if(i + 1 >= length || (source[i + 1] & 0xFC00) != 0xDC00)
+				throw std::runtime_error("The utf-16 string is malformed");
 			
 			// Convert the surrogate pairs back to basic string.
-			charValue = (((outputString[i] & 0x03FF) << 10)| 
-						 ((outputString[i] & 0x03FF)  << 0)) + 0x10000;
+			charValue = (((source[i]     & 0x03FF) << 10)| 
+						 ((source[i + 1] & 0x03FF)  << 0)) + 0x10000;
 			i += 2;
 		}
 		else {
-			charValue = (outputString[i] & 0x0FFFF);
+			charValue = (source[i] & 0x0FFFF);
 			++ i;
 		}
 		
-		// Prepare the string for utf-8 conversion.
-		size_t numBytes = 4;
-		int mask = 0xF0;
-		
-		if(charValue < 0x080) {
-			numBytes = 1;
-			charValue <<= 18;
-			mask = 0;
+		// Convert and write out data.
+		char* c = &destination[numBytes];
+		if(charValue < 0x0800) {
+			c[0] = (char)(((charValue >>  6) & 0x1F) | 0xC0);
+			c[1] = (char)(((charValue >>  0) & 0x3F) | 0x80);
+			numBytes += 2;
 		}
-		else if(charValue >= 0x080 && charValue < 0x0800) {
-			numBytes = 2;
-			charValue <<= 12;
-			mask = 0xC0;
+		else if(charValue < 0x010000) {
+			c[0] = (char)(((charValue >> 12) & 0x0F) | 0xE0);
+			c[1] = (char)(((charValue >>  6) & 0x3F) | 0x80);
+			c[2] = (char)(((charValue >>  0) & 0x3F) | 0x80);
+			numBytes += 3;
 		}
-		else if(charValue >= 0x0800 && charValue < 0x010000) {
-			numBytes = 3;
-			charValue <<= 6;
-			mask = 0xE0;
+		else {
+			c[0] = (char)(((charValue >> 18) & 0x07) | 0xF0);
+			c[1] = (char)(((charValue >> 12) & 0x3F) | 0x80);
+			c[2] = (char)(((charValue >>  6) & 0x3F) | 0x80);
+			c[3] = (char)(((charValue >>  0) & 0x3F) | 0x80);
+			numBytes += 4;
 		}
-		
-		// Convert and write out data.
-		char c[4];
-		c[0] = ((charValue >> 18) & 0x7F) | mask;
-		c[1] = ((charValue >> 12) & 0x3F) | 0x80;
-		c[2] = ((charValue >>  6) & 0x3F) | 0x80;
-		c[3] = ((charValue >>  0) & 0x3F) | 0x80;
-		appender.append(c, numBytes);
 	}
+	return numBytes;
 }
 
-// Implementation for the write utf-16 string function.
-inline void McIoWriteUtf16StringBuffer(McIoBufferOutputStream& stream,
+/// The reserved size before the encoded string, for the variant length.
+static const size_t utf8LengthPrefixSize = 5;
+
+// Encode the utf-16 string into the per thread scratch buffer, leaving 
+// utf8LengthPrefixSize bytes before the encoded data.
+static inline std::tuple<size_t, char*> McIoEncodeUtf8Scratch(
 		const std::u16string& outputString) {
+	static thread_local std::vector<char> scratchBuffer;
+	size_t requiredSize = utf8LengthPrefixSize + 3 * outputString.length();
+	if(scratchBuffer.size() < requiredSize) scratchBuffer.resize(requiredSize);
 	
-	// Define the output appender.
-	struct McIoStreamAppender {
-		McIoBufferOutputStream& bufferStream;
-		
-		McIoStreamAppender(McIoBufferOutputStream& bufferStream):
-				bufferStream(bufferStream) {}
-		
-		void append(const char* c, size_t numBytes) {
-			bufferStream.write(c, numBytes);
-		}
-	};
-	
-	// Convert the utf-16 string.
-	McIoStreamAppender appender(stream);
-	out<McIoStreamAppender>(appender, outputString);
+	char* encoded = scratchBuffer.data() + utf8LengthPrefixSize;
+	size_t numBytes = McIoEncodeUtf8(outputString.data(), 
+		outputString.length(), encoded);
+	return std::make_tuple(numBytes, encoded);
 }
 
 McIoOutputStream& McIoWriteUtf16String(McIoOutputStream& outputStream,
 		const std::u16string& outputString) {
 	
 	// Convert string to utf-8 format.
-	McIoBufferOutputStream outputBuffer;
-	McIoWriteUtf16StringBuffer(outputBuffer, outputString);
+	size_t size; char* encoded;
+	std::tie(size, encoded) = McIoEncodeUtf8Scratch(outputString);
+	
+	// Place the variant length right before the data.
+	char lengthPrefix[utf8LengthPrefixSize]; size_t prefixSize = 0;
+	size_t remaining = size;
+	do {
+		lengthPrefix[prefixSize] = (char)(remaining & 0x07f);
+		remaining = remaining >> 7;
+		if(remaining != 0) lengthPrefix[prefixSize] |= (char)0x080;
+		++ prefixSize;
+	} while(remaining != 0 && prefixSize < utf8LengthPrefixSize);
+	memcpy(encoded - prefixSize, lengthPrefix, prefixSize);
 	
 	// Pipe the converted data to output stream.
-	const char* buffer; size_t size;
-	std::tie(size, buffer) = outputBuffer.lengthPrefixedData();
-	outputStream.write(buffer, size);
+	outputStream.write(encoded - prefixSize, prefixSize + size);
 	return outputStream;
 }
 
@@ -439,19 +569,16 @@ mc::jstring::read(McIoInputStream& inputStream) {
 template<> McIoOutputStream&
 mc::jstring::write(McIoOutputStream& outputStream) const {
 	// Convert string to utf-8 format.
-	McIoBufferOutputStream outputBuffer;
-	McIoWriteUtf16StringBuffer(outputBuffer, data);
-	
-	// Pipe the converted data to output stream.
-	const char* buffer; size_t size;
-	std::tie(size, buffer) = outputBuffer.rawData();
+	size_t size; char* encoded;
+	std::tie(size, encoded) = McIoEncodeUtf8Scratch(data);
 	if(size > USHRT_MAX) throw std::runtime_error(
 			"The length is too long for java string output.");
 	
-	mc::u16 utfLength = size;
-	McIoOutputStream& aOutputStream = outputStream << utfLength;
-	aOutputStream.write(buffer, size);
-	return aOutputStream;
+	// Place the big endian length right before the data.
+	encoded[-2] = (char)((size >> 8) & 0x0ff);
+	encoded[-1] = (char)((size >> 0) & 0x0ff);
+	outputStream.write(encoded - 2, size + 2);
+	return outputStream;
 }
 
 // Instantiation of mc::f32's I/O methods.
@@ -460,18 +587,8 @@ mc::f32::write(McIoOutputStream& outputStream) const {
 	return out<float, concreteconv<float, uint32_t, htonl> >(outputStream, *this);
 }
 
-template<> McIoInputStream&
-mc::f32::read(McIoInputStream& inputStream) {
-	return in<float, concreteconv<float, uint32_t, htonl> >(inputStream, *this);
-}
-
 // Instantiation of mc::f64's I/O methods.
 template<> McIoOutputStream& 
 mc::f64::write(McIoOutputStream& outputStream) const {
 	return out<double, concreteconv<double, uint64_t, htonll> >(outputStream, *this);
-}
-
-template<> McIoInputStream&
-mc::f64::read(McIoInputStream& inputStream) {
-	return in<double, concreteconv<double, uint64_t, htonll> >(inputStream, *this);
 }
\ No newline at end of file
@@ -386,4 +386,43 @@ public:
 	void Put(Ch) { throw std::logic_error("Not implemented."); }
 	void Flush() { throw std::logic_error("Not implemented."); }
 	size_t PutEnd(Ch* begin) { throw std::logic_error("Not implemented."); }
+};
+
+/**
+ * @brief Abstraction for contiguous memory stream (for rapidjson).
+ *
+ * Unlike the rapidjson string streams, the stream is bounded by its length
+ * rather than the null terminator, so it could be placed over the packet
+ * buffer or the window of an input stream directly. When the CharType is
+ * writable, the stream could also be parsed in situ, that the string 
+ * tokens are decoded in place and referenced by the handler.
+ */
+template<typename CharType> class McIoJsonMemoryStream {
+	/// The beginning, current and end position of the stream.
+	CharType *begin, *current, *end;
+	
+	/// The destination of in situ parsing.
+	CharType* destination;
+public:
+	// The default constructor.
+	McIoJsonMemoryStream(CharType* begin, size_t length): begin(begin),
+		current(begin), end(begin + length), destination(nullptr) {}
+	
+	/// Stream type of json memory stream.
+	typedef char Ch;
+	
+	/// Peek the current character from memory.
+	Ch Peek() const {	return current < end? *current : '\0';	}
+	
+	/// Take the first character from the memory.
+	Ch Take() {	return current < end? *current ++ : '\0';	}
+	
+	/// Tell the current position of the stream.
+	size_t Tell() const {	return current - begin;	}
+	
+	// The in situ methods, only available when the memory is writable.
+	CharType* PutBegin() { return destination = current; }
+	void Put(Ch c) { *destination ++ = c; }
+	void Flush() {}
+	size_t PutEnd(CharType* putBegin) { return destination - putBegin; }
 };
\ No newline at end of file
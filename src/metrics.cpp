@@ -0,0 +1,80 @@
+/**
+ * @file metrics.cpp
+ * @brief Implementation for metrics.hpp.
+ * @author Haoran Luo
+ *
+ * For interface specification, please refer to the corresponding header.
+ * @see libminecraft/metrics.hpp
+ */
+#include "libminecraft/metrics.hpp"
+#include <algorithm>
+
+// Implementation for McIoMetricHistogramSnapshot::merge().
+void McIoMetricHistogramSnapshot::merge(const McIoMetricHistogramSnapshot& other) noexcept {
+	count += other.count;
+	sum += other.sum;
+	for(size_t i = 0; i < McIoMetricHistogramBuckets; ++ i)
+		buckets[i] += other.buckets[i];
+}
+
+// Implementation for McIoMetricHistogram::snapshot().
+McIoMetricHistogramSnapshot McIoMetricHistogram::snapshot() const noexcept {
+	McIoMetricHistogramSnapshot result;
+	result.count = count.load();
+	result.sum = sum.load();
+	for(size_t i = 0; i < McIoMetricHistogramBuckets; ++ i)
+		result.buckets[i] = buckets[i].load();
+	return result;
+}
+
+// Implementation for McIoMultiplexerMetricsSnapshot::merge().
+void McIoMultiplexerMetricsSnapshot::merge(const McIoMultiplexerMetricsSnapshot& other) noexcept {
+	ticks += other.ticks;
+	tickOverruns += other.tickOverruns;
+	missedTicks += other.missedTicks;
+	tickBusyTime.merge(other.tickBusyTime);
+	tickSyscalls.merge(other.tickSyscalls);
+	rounds += other.rounds;
+	syscalls += other.syscalls;
+	events += other.events;
+	handles += other.handles;
+	flushes += other.flushes;
+	timeouts += other.timeouts;
+	descriptors += other.descriptors;
+	activeDescriptors += other.activeDescriptors;
+	bytesIn += other.bytesIn;
+	bytesOut += other.bytesOut;
+	packetsIn += other.packetsIn;
+	packetsOut += other.packetsOut;
+	writeQueueHighWater = std::max(writeQueueHighWater, other.writeQueueHighWater);
+	taskLatency.merge(other.taskLatency);
+	taskRunTime.merge(other.taskRunTime);
+	taskDeferrals += other.taskDeferrals;
+}
+
+// Implementation for McIoMultiplexerMetrics::snapshot().
+McIoMultiplexerMetricsSnapshot McIoMultiplexerMetrics::snapshot() const noexcept {
+	McIoMultiplexerMetricsSnapshot result;
+	result.ticks = ticks.load();
+	result.tickOverruns = tickOverruns.load();
+	result.missedTicks = missedTicks.load();
+	result.tickBusyTime = tickBusyTime.snapshot();
+	result.tickSyscalls = tickSyscalls.snapshot();
+	result.rounds = rounds.load();
+	result.syscalls = syscalls.load();
+	result.events = events.load();
+	result.handles = handles.load();
+	result.flushes = flushes.load();
+	result.timeouts = timeouts.load();
+	result.descriptors = descriptors.load();
+	result.activeDescriptors = activeDescriptors.load();
+	result.bytesIn = bytesIn.load();
+	result.bytesOut = bytesOut.load();
+	result.packetsIn = packetsIn.load();
+	result.packetsOut = packetsOut.load();
+	result.writeQueueHighWater = writeQueueHighWater.load();
+	result.taskLatency = taskLatency.snapshot();
+	result.taskRunTime = taskRunTime.snapshot();
+	result.taskDeferrals = taskDeferrals.load();
+	return result;
+}
\ No newline at end of file
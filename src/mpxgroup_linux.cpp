@@ -0,0 +1,300 @@
+/**
+ * @file mpxgroup_linux.cpp
+ * @brief Implementation for mpxgroup.hpp.
+ * @author Haoran Luo
+ *
+ * For interface specification, please refer to the corresponding header.
+ * @see libminecraft/mpxgroup.hpp
+ */
+#include "libminecraft/mpxgroup.hpp"
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+#include <cassert>
+#include <cstdint>
+
+/// The work handed off to a loop, either a descriptor or a task.
+struct McIoMultiplexerGroupWork {
+	std::unique_ptr<McIoDescriptor> descriptor;
+	McIoMultiplexerGroup::loopTaskType task;
+};
+
+/// The loop of the group, which is never moved once created.
+struct McIoMultiplexerGroupLoop {
+	/// The multiplexer run by the loop.
+	McIoMultiplexer multiplexer;
+	
+	/// The eventfd notifying the loop of handed off work.
+	int inboxfd;
+	
+	/// The mutex guarding the pending works.
+	std::mutex pendingMutex;
+	
+	/// The works handed off but not yet taken by the loop.
+	std::vector<McIoMultiplexerGroupWork> pending;
+	
+	/// The thread running the loop.
+	std::thread thread;
+	
+	/// The exception that has stopped the loop.
+	std::exception_ptr exception;
+	
+	/// Create the multiplexer and the inbox descriptor of the loop.
+	McIoMultiplexerGroupLoop();
+	
+	/// Hand off the work, the loop is only notified when there's no
+	/// pending works before. The work is left intact if it throws.
+	void post(McIoMultiplexerGroupWork&& work);
+	
+	/// Take and run the pending works, on the loop thread.
+	void drain();
+};
+
+/// The descriptor which drains the handed off works when notified.
+class McIoMultiplexerGroupInbox : public McIoDescriptor {
+	McIoMultiplexerGroupLoop& loop;
+public:
+	McIoMultiplexerGroupInbox(int inboxfd, McIoMultiplexerGroupLoop& loop):
+		McIoDescriptor(inboxfd, McIoEvent::evIn), loop(loop) {}
+	
+	virtual McIoNextStatus handle(McIoEvent& eventFlag) override {
+		if((eventFlag & McIoEvent::evIn) != 0) {
+			// Reset the counter before taking the works, so that works handed
+			// off after taking will notify again.
+			uint64_t counter;
+			while(read(fd, &counter, sizeof(counter)) == sizeof(counter));
+			loop.drain();
+		}
+		return McIoNextStatus::nstPoll;
+	}
+};
+
+// Implementation for McIoMultiplexerGroupLoop::McIoMultiplexerGroupLoop().
+McIoMultiplexerGroupLoop::McIoMultiplexerGroupLoop(): multiplexer(), 
+	inboxfd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), pendingMutex(), pending() {
+	
+	if(inboxfd < 0) throw std::runtime_error("Cannot create loop inbox descriptor.");
+	std::unique_ptr<McIoDescriptor> inbox;
+	try {
+		inbox.reset(new McIoMultiplexerGroupInbox(inboxfd, *this));
+	} catch(...) {
+		close(inboxfd);
+		throw;
+	}
+	multiplexer.insert(inbox);
+}
+
+// Implementation for McIoMultiplexerGroupLoop::post().
+void McIoMultiplexerGroupLoop::post(McIoMultiplexerGroupWork&& work) {
+	// Notify before enqueuing, so the work is never left pending without
+	// notification, which would also suppress the notifications after. The
+	// lock is held, so the loop could not drain in between.
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	if(pending.empty()) {
+		uint64_t counter = 1;
+		if(write(inboxfd, &counter, sizeof(counter)) != sizeof(counter))
+			throw std::runtime_error("Cannot notify the loop inbox.");
+	}
+	pending.push_back(std::move(work));
+}
+
+// Implementation for McIoMultiplexerGroupLoop::drain().
+void McIoMultiplexerGroupLoop::drain() {
+	std::vector<McIoMultiplexerGroupWork> works;
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		works.swap(pending);
+	}
+	for(McIoMultiplexerGroupWork& work : works) {
+		try {
+			if(work.descriptor != nullptr) multiplexer.insert(work.descriptor);
+			else if(work.task) work.task(multiplexer);
+		} catch(...) {
+			// The descriptor that cannot be inserted is destroyed with the
+			// work, and the task failure is ignored.
+		}
+	}
+}
+
+/// The underlying data of the McIoMultiplexerGroup.
+struct McIoMultiplexerGroupControl {
+	/// The loops of the group.
+	std::vector<std::unique_ptr<McIoMultiplexerGroupLoop>> loops;
+	
+	/// The callback invoked after each tick.
+	McIoMultiplexerGroup::tickHandlerType onTick;
+	
+	/// The loop to hand off the next descriptor.
+	std::atomic<size_t> nextLoop;
+	
+	/// Whether the loops should keep running.
+	std::atomic<bool> running;
+	
+	/// Whether the loop threads have been started.
+	bool started;
+	
+	/// The control block constructor.
+	McIoMultiplexerGroupControl(McIoMultiplexerGroup::tickHandlerType onTick):
+		loops(), onTick(std::move(onTick)), nextLoop(0), 
+		running(false), started(false) {}
+	
+	/// Retrieve the loop by index, or throw when out of range.
+	McIoMultiplexerGroupLoop& loopAt(size_t index) {
+		if(index >= loops.size()) throw std::runtime_error(
+				"The loop index is out of range.");
+		return *loops[index];
+	}
+	
+	/// The procedure of the loop threads.
+	void run(size_t index) {
+		McIoMultiplexerGroupLoop& loop = *loops[index];
+		try {
+			while(running.load(std::memory_order_acquire)) {
+				loop.multiplexer.execute();
+				if(onTick) onTick(index, loop.multiplexer);
+			}
+		} catch(...) {
+			loop.exception = std::current_exception();
+		}
+	}
+	
+	/// Stop and join the loop threads.
+	void stop() {
+		running.store(false, std::memory_order_release);
+		for(std::unique_ptr<McIoMultiplexerGroupLoop>& loop : loops)
+			if(loop -> thread.joinable()) loop -> thread.join();
+		started = false;
+	}
+};
+static_assert(sizeof(McIoMultiplexerGroupControl) < 
+		McIoMultiplexerGroup::groupControlBlockSize,
+		"Insufficient space for the group control block.");
+
+// Implementation for McIoMultiplexerGroup::McIoMultiplexerGroup().
+McIoMultiplexerGroup::McIoMultiplexerGroup(size_t numLoops, tickHandlerType onTick) {
+	McIoMultiplexerGroupControl* controlBlock = new (control) 
+			McIoMultiplexerGroupControl(std::move(onTick));
+	if(numLoops == 0) numLoops = std::thread::hardware_concurrency();
+	if(numLoops == 0) numLoops = 1;
+	try {
+		for(size_t i = 0; i < numLoops; ++ i) controlBlock -> loops.push_back(
+				std::unique_ptr<McIoMultiplexerGroupLoop>(new McIoMultiplexerGroupLoop()));
+	} catch(...) {
+		controlBlock -> ~McIoMultiplexerGroupControl();
+		throw;
+	}
+}
+
+// Implementation for McIoMultiplexerGroup::~McIoMultiplexerGroup().
+McIoMultiplexerGroup::~McIoMultiplexerGroup() noexcept {
+	McIoMultiplexerGroupControl* controlBlock = (McIoMultiplexerGroupControl*)control;
+	controlBlock -> stop();
+	controlBlock -> ~McIoMultiplexerGroupControl();
+}
+
+// Implementation for McIoMultiplexerGroup::size().
+size_t McIoMultiplexerGroup::size() const noexcept {
+	return ((const McIoMultiplexerGroupControl*)control) -> loops.size();
+}
+
+// Implementation for McIoMultiplexerGroup::multiplexer().
+McIoMultiplexer& McIoMultiplexerGroup::multiplexer(size_t index) {
+	return ((McIoMultiplexerGroupControl*)control) -> loopAt(index).multiplexer;
+}
+
+// Implementation for McIoMultiplexerGroup::metrics().
+McIoMultiplexerMetricsSnapshot McIoMultiplexerGroup::metrics() const noexcept {
+	const McIoMultiplexerGroupControl* controlBlock = 
+		(const McIoMultiplexerGroupControl*)control;
+	McIoMultiplexerMetricsSnapshot result = McIoMultiplexerMetricsSnapshot();
+	for(const std::unique_ptr<McIoMultiplexerGroupLoop>& loop : controlBlock -> loops)
+		result.merge(loop -> multiplexer.metrics().snapshot());
+	return result;
+}
+
+// Implementation for McIoMultiplexerGroup::start().
+void McIoMultiplexerGroup::start() {
+	McIoMultiplexerGroupControl* controlBlock = (McIoMultiplexerGroupControl*)control;
+	if(controlBlock -> started) throw std::runtime_error(
+			"The multiplexer group is already running.");
+	controlBlock -> started = true;
+	controlBlock -> running.store(true, std::memory_order_release);
+	try {
+		for(size_t i = 0; i < controlBlock -> loops.size(); ++ i) {
+			controlBlock -> loops[i] -> exception = nullptr;
+			controlBlock -> loops[i] -> thread = std::thread(
+				&McIoMultiplexerGroupControl::run, controlBlock, i);
+		}
+	} catch(...) {
+		controlBlock -> stop();
+		throw;
+	}
+}
+
+// Implementation for McIoMultiplexerGroup::stop().
+void McIoMultiplexerGroup::stop() {
+	McIoMultiplexerGroupControl* controlBlock = (McIoMultiplexerGroupControl*)control;
+	controlBlock -> stop();
+	for(std::unique_ptr<McIoMultiplexerGroupLoop>& loop : controlBlock -> loops)
+		if(loop -> exception != nullptr) {
+			std::exception_ptr exception = loop -> exception;
+			loop -> exception = nullptr;
+			std::rethrow_exception(exception);
+		}
+}
+
+// Implementation for McIoMultiplexerGroup::insert().
+void McIoMultiplexerGroup::insert(std::unique_ptr<McIoDescriptor>& descriptor) {
+	McIoMultiplexerGroupControl* controlBlock = (McIoMultiplexerGroupControl*)control;
+	size_t index = controlBlock -> nextLoop.fetch_add(1, 
+			std::memory_order_relaxed) % controlBlock -> loops.size();
+	insert(index, descriptor);
+}
+
+// Implementation for McIoMultiplexerGroup::insert() with loop index.
+void McIoMultiplexerGroup::insert(size_t index, 
+		std::unique_ptr<McIoDescriptor>& descriptor) {
+	assert(descriptor != nullptr);
+	McIoMultiplexerGroupLoop& loop = ((McIoMultiplexerGroupControl*)control) -> loopAt(index);
+	McIoMultiplexerGroupWork work;
+	work.descriptor = std::move(descriptor);
+	try {
+		loop.post(std::move(work));
+	} catch(...) {
+		descriptor = std::move(work.descriptor);
+		throw;
+	}
+}
+
+// Implementation for McIoMultiplexerGroup::execute().
+void McIoMultiplexerGroup::execute(size_t index, loopTaskType task) {
+	McIoMultiplexerGroupLoop& loop = ((McIoMultiplexerGroupControl*)control) -> loopAt(index);
+	McIoMultiplexerGroupWork work;
+	work.task = std::move(task);
+	loop.post(std::move(work));
+}
+
+// Implementation for McIoMultiplexerGroup::createReusePortListener().
+int McIoMultiplexerGroup::createReusePortListener(
+		const struct sockaddr* address, size_t addressLength, int backlog) {
+	int listenfd = socket(address -> sa_family, 
+			SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(listenfd < 0) throw std::runtime_error("Cannot create listening socket.");
+	
+	int enabled = 1;
+	if(setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled)) < 0 ||
+		setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &enabled, sizeof(enabled)) < 0 ||
+		bind(listenfd, address, (socklen_t)addressLength) < 0 ||
+		listen(listenfd, backlog) < 0) {
+		close(listenfd);
+		throw std::runtime_error("Cannot listen on the address with SO_REUSEPORT.");
+	}
+	return listenfd;
+}
\ No newline at end of file
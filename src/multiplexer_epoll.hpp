@@ -0,0 +1,161 @@
+#pragma once
+/**
+ * @file multiplexer_epoll.hpp
+ * @brief The epoll poller of the multiplexer under linux.
+ * @author Haoran Luo
+ *
+ * The poller registers the descriptors and the timer of the multiplexer in
+ * an epoll descriptor, and reports their readiness to multiplexer_linux.cpp.
+ * This is the default poller, while multiplexer_uring.hpp is selected by the
+ * LIBMC_IO_URING option instead.
+ *
+ * The descriptors are registered with EPOLLONESHOT and re-armed after being
+ * handled, unless they are registered persistently.
+ */
+#include <libminecraft/multiplexer.hpp>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+
+// For the user data of the registered descriptors.
+struct McIoDescriptorControl;
+
+/// The registration of a descriptor in the epoll poller.
+struct McIoPollerEntry {
+	/// The event flags last registered to the epollfd.
+	McIoEvent registeredEvent;
+
+	/// Whether the descriptor is registered without EPOLLONESHOT, so that
+	/// it needs not to be re-armed unless the listening events change.
+	bool persistent;
+
+	McIoPollerEntry(): registeredEvent(McIoEvent::evNone), persistent(false) {}
+};
+
+/// The epoll poller of the multiplexer.
+struct McIoPoller {
+	/// The epoll's file descriptor.
+	int epollfd;
+
+	/// The metrics of the multiplexer, counting the system calls.
+	McIoMultiplexerMetrics& metrics;
+
+	/// The buffer receiving events from epoll_wait(), which grows when it is
+	/// filled up and shrinks when it is mostly idle.
+	std::vector<struct epoll_event> eventBuffer;
+
+	/// The number of events received by the last wait().
+	size_t numEvents;
+
+	/// Create the epoll descriptor.
+	McIoPoller(McIoMultiplexerMetrics& metrics): epollfd(-1), metrics(metrics),
+			eventBuffer(McIoMultiplexer::minimumEventBatch), numEvents(0) {
+		epollfd = epoll_create1(0);
+		if(epollfd == -1) throw std::runtime_error("Cannot create epoll descriptor.");
+	}
+
+	/// Close the epoll descriptor.
+	~McIoPoller() noexcept { close(epollfd); }
+
+	/// Control the timer descriptor, whose user data is always NULL, which
+	/// distinguishes it from other descriptors.
+	template<int action>
+	void controlTimer(int timerfd) {
+		struct epoll_event timerfdEvent;
+		timerfdEvent.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
+		timerfdEvent.data.ptr = nullptr;
+		metrics.syscalls.add();
+		if(epoll_ctl(epollfd, action, timerfd, &timerfdEvent) < 0)
+			throw std::runtime_error("Error while controlling timer descriptor.");
+	}
+
+	/// Place the timer descriptor into the epoll queue.
+	void addTimer(int timerfd) { controlTimer<EPOLL_CTL_ADD>(timerfd); }
+
+	/// Re-arm the timer descriptor after it has been read.
+	void rearmTimer(int timerfd) { controlTimer<EPOLL_CTL_MOD>(timerfd); }
+
+	/// Control the descriptor with the listening events.
+	template<int action>
+	void controlDescriptor(McIoPollerEntry& entry, int fd,
+			McIoEvent events, McIoDescriptorControl* owner) {
+		struct epoll_event event;
+		event.events = EPOLLET | (entry.persistent? 0u : (uint32_t)EPOLLONESHOT) |
+			((events & McIoEvent::evIn)?  (uint32_t)EPOLLIN  : 0u)|
+			((events & McIoEvent::evOut)? (uint32_t)EPOLLOUT : 0u);
+		event.data.ptr = owner;
+		metrics.syscalls.add();
+		if(epoll_ctl(epollfd, action, fd, &event) < 0)
+			throw std::runtime_error("Error while controlling descriptor.");
+		entry.registeredEvent = events;
+	}
+
+	/// Register the descriptor, persistently if specified.
+	void add(McIoPollerEntry& entry, int fd, McIoEvent events,
+			McIoDescriptorControl* owner, bool persistent) {
+		entry.persistent = persistent;
+		controlDescriptor<EPOLL_CTL_ADD>(entry, fd, events, owner);
+	}
+
+	/// Update the listening events of the descriptor, arming it again.
+	void modify(McIoPollerEntry& entry, int fd, McIoEvent events,
+			McIoDescriptorControl* owner) {
+		controlDescriptor<EPOLL_CTL_MOD>(entry, fd, events, owner);
+	}
+
+	/// Re-arm the descriptor after it has been handled, which could be
+	/// omitted when it is registered persistently with the same events.
+	void rearm(McIoPollerEntry& entry, int fd, McIoEvent events,
+			McIoDescriptorControl* owner) {
+		if(!entry.persistent || entry.registeredEvent != events)
+			controlDescriptor<EPOLL_CTL_MOD>(entry, fd, events, owner);
+	}
+
+	/// Unregister the descriptor.
+	void remove(McIoPollerEntry& entry, int fd) noexcept {
+		try {
+			controlDescriptor<EPOLL_CTL_DEL>(entry, fd, McIoEvent::evNone, nullptr);
+		} catch(const std::exception&)
+		{ /* Do nothing, just ignore. */ }
+	}
+
+	/// Wait for the events, for at most maxEventBatch of them, blocking
+	/// only if specified. Returns immediately when interrupted by signal.
+	void wait(bool block, size_t maxEventBatch) {
+		if(eventBuffer.size() > maxEventBatch) eventBuffer.resize(maxEventBatch);
+		int numReceived = epoll_wait(epollfd, eventBuffer.data(),
+				(int)eventBuffer.size(), block? -1 : 0);
+
+		// Except the case of returning -1 due to handled signal must we throw exception.
+		if(numReceived < 0 && errno != EINTR) throw std::runtime_error("Error while polling events.");
+		numEvents = numReceived > 0? (size_t)numReceived : 0;
+		if(numReceived < 0) return;
+
+		// Adapt the event buffer size by the number of events received.
+		size_t size = eventBuffer.size();
+		if(numEvents == size && size < maxEventBatch)
+			eventBuffer.resize(std::min(size * 2, maxEventBatch));
+		else if(numEvents < size / 4 && size > McIoMultiplexer::minimumEventBatch)
+			eventBuffer.resize(std::max(size / 2, McIoMultiplexer::minimumEventBatch));
+	}
+
+	/// Report each event received by the last wait() to the visitor, as
+	/// visitor(owner, events, failed) where owner is nullptr for the timer.
+	/// The hang up is reported as readable, so that the reader sees the end.
+	template<typename Visitor>
+	void dispatch(Visitor&& visitor) {
+		for(size_t i = 0; i < numEvents; ++ i) {
+			uint32_t events = eventBuffer[i].events;
+			visitor((McIoDescriptorControl*)eventBuffer[i].data.ptr, (McIoEvent)(
+				((events & (EPOLLIN | EPOLLHUP))? McIoEvent::evIn  : 0)|
+				((events & EPOLLOUT)?             McIoEvent::evOut : 0)),
+				(events & EPOLLERR) != 0);
+		}
+		numEvents = 0;
+	}
+};
\ No newline at end of file
@@ -3,21 +3,32 @@
  * @brief Implementation for multiplexer.hpp under linux platform.
  * @author Haoran Luo
  *
- * For interface specification, please refer to the corresponding header. The multiplexing 
- * implementation is based on epoll and timerfd under linux.
+ * For interface specification, please refer to the corresponding header. The multiplexing
+ * implementation is based on timerfd under linux, with the descriptors and the timer
+ * polled by the poller of multiplexer_epoll.hpp, or multiplexer_uring.hpp when the
+ * LIBMC_IO_URING option is on.
  *
  * @see libminecraft/multiplexer.hpp
  */
- 
+
 #include <libminecraft/multiplexer.hpp>
-#include <unordered_map>
+#include "timerwheel.hpp"
+#include "descriptorslab.hpp"
+#ifdef LIBMC_IO_URING
+#include "multiplexer_uring.hpp"
+#else
+#include "multiplexer_epoll.hpp"
+#endif
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
 #include <cassert>
 #include <cstdint>
+#include <cerrno>
 
 #include <unistd.h>
 #include <fcntl.h>
 
-#include <sys/epoll.h>
 #include <sys/timerfd.h>
 
 // The nanoseconds that one second contains.
@@ -26,30 +37,34 @@ static const unsigned long nanosecondUpperBound = 1e9;
 // The lowerbound for nanoseconds that would not disable the timer.
 static const unsigned long nanosecondLowerBound = 1e6;
 
+// For pointer reference in descriptor control block.
+struct McIoMultiplexerControl;
+
 // The descriptor control block under linux.
 // Assigned responsibilities:
 // - Trace whether the descriptor is associated with a multiplexer.
 // - Trace the active events and listening events for handle().
 // - Trace whether the object is inside the body of handle() or not.
-// - Epoll-controling the descriptor on request and according to the 
-//   object's life time.
+// - Registering the descriptor into the poller on request and according
+//   to the object's life time.
 // - Controlling the queue on request and according to the the object's
 //   life time.
+// - Holding the timeout in the multiplexer's timer wheel on request.
 struct McIoDescriptorControl {
 	/// The multiplexer managing this descriptor.
 	McIoMultiplexer* multiplexer;
-	int epollfd;
-	
+	McIoMultiplexerControl* multiplexerControl;
+
 	/// The corresponding descriptor.
 	McIoDescriptor* const descriptor;
 	const int fd;
-	
+
 	/// The registered event flags for polling().
 	McIoEvent listeningEvent;
-	
+
 	/// The remaining event flags for executing handle().
 	McIoEvent activeEvent;
-	
+
 	/// Whether it is inside the descriptor's handle() block.
 	/// Could affect the behavior of maintaining the block in container.
 	bool executing;
@@ -57,143 +72,224 @@ struct McIoDescriptorControl {
 	/// Whether it is marked to be destructed.
 	/// Could affect the behavior of maintaining the block in container.
 	bool markedRemoval;
-	
+
+	/// Whether flush has been requested before being associated.
+	bool flushDeferred;
+
+	/// The registration in the poller of the associated multiplexer.
+	McIoPollerEntry pollerEntry;
+
 	/// The linked list pointers, used to hold descriptors in different queues.
 	McIoDescriptorControl **prevNext, *next;
-	
-	/// Move control block between queues.
-	void moveQueue(McIoDescriptorControl** newQueue) noexcept {
+
+	/// The linked list pointers, used to hold descriptors requesting flush.
+	/// The flushPrevNext is not null if and only if flush has been requested.
+	McIoDescriptorControl **flushPrevNext, *flushNext;
+
+	/// The linked list pointers, used to hold descriptors in the timer wheel.
+	/// The timerPrevNext is not null if and only if a timeout is pending.
+	McIoDescriptorControl **timerPrevNext, *timerNext;
+
+	/// The tick when the timeout expires, or before being associated, the
+	/// number of ticks of the deferred timeout (0 if there's none).
+	uint64_t timerExpiry;
+
+	/// Move control block between linked lists, specified by the link pointers.
+	template<McIoDescriptorControl** McIoDescriptorControl::*Prev,
+		McIoDescriptorControl* McIoDescriptorControl::*Next>
+	void moveList(McIoDescriptorControl** newQueue) noexcept {
 		// Remove the node from the previous queue.
-		if(prevNext != nullptr) {
-			*prevNext = next;
-			if(next != nullptr)
-				next -> prevNext = prevNext;
+		if(this->*Prev != nullptr) {
+			*(this->*Prev) = this->*Next;
+			if(this->*Next != nullptr)
+				(this->*Next) ->* Prev = this->*Prev;
 		}
-		
+
 		// Reset the queue status.
 		if(newQueue != nullptr) {
-			prevNext = newQueue;
-			next = *newQueue;
+			this->*Prev = newQueue;
+			this->*Next = *newQueue;
+			if(*newQueue != nullptr) (*newQueue) ->* Prev = &(this->*Next);
 			*newQueue = this;
 		}
 		else {
-			prevNext = nullptr;
-			next = nullptr;
+			this->*Prev = nullptr;
+			this->*Next = nullptr;
 		}
 	}
-	
-	/// Control the file descriptor's action with epollfd, regardless of 
-	/// whether it is executing.
-	template<int action> inline void controlPoll();
-	
+
+	/// Move control block between queues.
+	void moveQueue(McIoDescriptorControl** newQueue) noexcept {
+		moveList<&McIoDescriptorControl::prevNext,
+			&McIoDescriptorControl::next>(newQueue);
+	}
+
+	/// Move control block into or out of the flush queue.
+	void moveFlushQueue(McIoDescriptorControl** newQueue) noexcept {
+		moveList<&McIoDescriptorControl::flushPrevNext,
+			&McIoDescriptorControl::flushNext>(newQueue);
+	}
+
+	/// Move control block into or out of the timer wheel's lists.
+	void moveTimerList(McIoDescriptorControl** newList) noexcept {
+		moveList<&McIoDescriptorControl::timerPrevNext,
+			&McIoDescriptorControl::timerNext>(newList);
+	}
+
+	/// Update the listening events in the poller, regardless of whether it
+	/// is executing.
+	inline void updatePoll();
+
+	/// Re-arm the file descriptor after it has been handled, which could be
+	/// omitted by the poller when it is not necessary.
+	inline void rearmPoll();
+
+	/// Remove the file descriptor from the poller.
+	inline void removePoll() noexcept;
+
 	/// Construct the control block.
-	McIoDescriptorControl(McIoDescriptor* thiz, McIoEvent initialEvent): 
-		multiplexer(nullptr), epollfd(-1), descriptor(thiz), fd(descriptor -> fd),
-		listeningEvent(initialEvent), activeEvent(McIoEvent::evNone), 
-		executing(false), markedRemoval(false),
-		prevNext(nullptr), next(nullptr) {}
-	
+	McIoDescriptorControl(McIoDescriptor* thiz, McIoEvent initialEvent):
+		multiplexer(nullptr), multiplexerControl(nullptr), descriptor(thiz),
+		fd(descriptor -> fd), listeningEvent(initialEvent),
+		activeEvent(McIoEvent::evNone), executing(false), markedRemoval(false),
+		flushDeferred(false), pollerEntry(), prevNext(nullptr), next(nullptr),
+		flushPrevNext(nullptr), flushNext(nullptr),
+		timerPrevNext(nullptr), timerNext(nullptr), timerExpiry(0) {}
+
 	/// Destruct the control block.
 	~McIoDescriptorControl() noexcept {
-		if(multiplexer != nullptr) try {
+		if(multiplexer != nullptr) {
 			moveQueue(nullptr);	// Remove from current queue.
-			controlPoll<EPOLL_CTL_DEL>();
-		} catch(const std::exception&) 
-		{ /* Do nothing, just ignore. */ }
+			moveFlushQueue(nullptr);
+			moveTimerList(nullptr);
+			removePoll();
+		}
 	}
-	
+
 	/// Associate the file descriptor with a multiplexer.
 	/// @throw std::runtime_error when the descriptor cannot be registered.
-	void associate(McIoMultiplexer* newMultiplexer, int newEpollfd) {
-		assert(multiplexer == nullptr);                         // Not associated.
-		assert(newMultiplexer != nullptr && newEpollfd != -1);  // Valid parameters.
-		
-		// Attempt to add to the list, and perform association.
-		try {
-			multiplexer = newMultiplexer;
-			epollfd = newEpollfd;
-			controlPoll<EPOLL_CTL_ADD>();
-		}
-		catch(const std::exception& ex) {
-			multiplexer = nullptr;
-			epollfd = -1;
-			throw ex;
-		}
-	}
+	inline void associate(McIoMultiplexer* newMultiplexer,
+			McIoMultiplexerControl* newMultiplexerControl);
 };
 static_assert(sizeof(McIoDescriptorControl) < McIoDescriptor::descriptorControlBlockSize,
 		"Insufficient space for the descriptor control block.");
-		
+
 // The multiplexer control block under linux.
 struct McIoMultiplexerControl {
-	/// The epoll's file descriptor.
-	int epollfd;
-	
 	/// The timer's file descriptor.
-	/// The userdata for timerfd is always NULL, which distinguishes it from other 
-	/// descriptors.
 	int timerfd;
-	
-	/// The managed file descriptors.
-	std::unordered_map<int, std::unique_ptr<McIoDescriptor> > descriptors;
-	
+
+	/// The timeout of the timer, which is the busy time budget of a tick.
+	unsigned long timeout;
+
+	/// The monotonic time when the timer expires next, in nanoseconds.
+	uint64_t tickDeadline;
+
+	/// The metrics of the multiplexer, which is never moved once created,
+	/// so that it could be read from other threads.
+	std::unique_ptr<McIoMultiplexerMetrics> metrics;
+
+	/// The poller of the descriptors and the timer, which must be declared
+	/// before the descriptors, so that they could remove themselves.
+	McIoPoller poller;
+
+	/// The buffer pool shared among descriptors, which must be declared
+	/// before the descriptors, so that they return buffers before it is gone.
+	McIoBufferPool bufferPool;
+
+	/// The timer wheel advanced by the timer, which must be declared before
+	/// the descriptors, so that they leave the wheel before it is gone.
+	McIoTimerWheel<McIoDescriptorControl> timerWheel;
+
+	/// The slab of the emplaced descriptors, which must be declared before
+	/// the descriptors, so that they return their blocks before it is gone.
+	McIoDescriptorSlab descriptorSlab;
+
+	/// The managed file descriptors, indexed by the file descriptors.
+	std::vector<std::unique_ptr<McIoDescriptor> > descriptors;
+
+	/// The number of managed file descriptors.
+	size_t numDescriptors;
+
 	/// The queue of descriptors that could call handle method.
 	McIoDescriptorControl *activeQueue;
-	
+
+	/// The queue of descriptors that have requested flush.
+	McIoDescriptorControl *flushQueue;
+
+	/// The maximum number of events received by one polling.
+	size_t maxEventBatch;
+
+	/// Whether descriptors inserted are registered persistently.
+	bool persistent;
+
 	// Create the multiplexer's control block.
-	McIoMultiplexerControl(unsigned long initialTimeout): epollfd(-1), timerfd(-1),
-			descriptors(), activeQueue(nullptr) {
+	McIoMultiplexerControl(unsigned long initialTimeout): timerfd(-1),
+			timeout(initialTimeout), tickDeadline(0), metrics(new McIoMultiplexerMetrics()),
+			poller(*metrics), bufferPool(), timerWheel(), descriptorSlab(), descriptors(),
+			numDescriptors(0), activeQueue(nullptr), flushQueue(nullptr),
+			maxEventBatch(McIoMultiplexer::defaultMaximumEventBatch), persistent(false) {
+		// Create the timer descriptor and initialize the timer.
+		timerfd = timerfd_create(CLOCK_MONOTONIC, O_NONBLOCK);
+		if(timerfd == -1) throw std::runtime_error("Cannot create timer descriptor.");
 		try {
-			// Create the epoll descriptor.
-			epollfd = epoll_create1(0);
-			if(epollfd == -1) throw std::runtime_error("Cannot create epoll descriptor.");
-			
-			// Create the timer descriptor and initialize the timer.
-			timerfd = timerfd_create(CLOCK_MONOTONIC, O_NONBLOCK);
-			if(timerfd == -1) throw std::runtime_error("Cannot create timer descriptor.");
 			updateTimeout(initialTimeout);
-			
-			// Place the timer descriptor into the epoll queue.
-			controlTimer<EPOLL_CTL_ADD>();
+
+			// Place the timer descriptor into the poller.
+			poller.addTimer(timerfd);
 		}
 		catch(const std::exception& ex) {
 			// Close essential file handlers.
-			if(epollfd != -1) close(epollfd);
-			if(timerfd != -1) close(timerfd);
-			
+			close(timerfd);
+
 			// Rethrow exception.
-			throw ex;
+			throw;
 		}
 	}
-	
+
+	// Ensure the slot of the file descriptor is in the descriptor table.
+	inline void reserveSlot(int fd) {
+		assert(fd >= 0);
+		if((size_t)fd >= descriptors.size()) descriptors.resize(
+			std::max<size_t>((size_t)fd + 1, descriptors.size() * 2));
+	}
+
 	// Remove the block from the descriptors.
 	inline void erase(McIoDescriptorControl* descriptor) {
 		assert(descriptor != nullptr);
-		assert(descriptors.count(descriptor -> fd) > 0);
-		descriptors.erase(descriptor -> fd);
+		assert((size_t)descriptor -> fd < descriptors.size());
+		assert(descriptors[descriptor -> fd] != nullptr);
+		-- numDescriptors;
+		metrics -> descriptors.set(numDescriptors);
+		descriptors[descriptor -> fd].reset();
 	}
-	
-	// Control the timerfd's status relative to the epoll fd.
-	template<int action>
-	inline void controlTimer() {
-		struct epoll_event timerfdEvent;
-		timerfdEvent.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
-		timerfdEvent.data.ptr = nullptr;
-		if(epoll_ctl(epollfd, action, timerfd, &timerfdEvent) < 0)
-			throw std::runtime_error("Error while controlling timer descriptor.");
+
+	// Read until there's no more content in the timer descriptor, and
+	// advance the timer wheel by the elapsed ticks.
+	void readTimer() {
+		uint64_t expiration; ssize_t timerStatus;
+		while((timerStatus = read(timerfd, &expiration, sizeof(expiration)))
+				== (ssize_t)sizeof(expiration)) {
+			metrics -> syscalls.add();
+			metrics -> missedTicks.add(expiration - 1);
+			tickDeadline += expiration * timeout;
+			for(uint64_t j = 0; j < expiration; ++ j) timerWheel.advance();
+		}
+		metrics -> syscalls.add();
+		if(timerStatus != -1 || (errno != EWOULDBLOCK && errno != EAGAIN))
+			throw std::runtime_error("The timer descriptor has error.");
 	}
-	
+
 	// Destruct the multiplexer control block.
 	~McIoMultiplexerControl() noexcept {
-		if(epollfd != -1) close(epollfd);
 		if(timerfd != -1) close(timerfd);
 	}
-	
+
 	// Update current timeout.
 	void updateTimeout(unsigned long timeout) {
 		assert(timeout > nanosecondLowerBound); // Timeout should be big enough to avoid disabling timer.
 		itimerspec timerSpecification;
-		
+
 		// Calculate timeout interval.
 		if(timeout < nanosecondUpperBound) {
 			timerSpecification.it_interval.tv_sec = 0;
@@ -202,22 +298,25 @@ struct McIoMultiplexerControl {
 			timerSpecification.it_interval.tv_sec = timeout / nanosecondUpperBound;
 			timerSpecification.it_interval.tv_nsec = timeout % nanosecondUpperBound;
 		}
-		
+
 		// Retrieve the current timestamp and forward it by one interval.
-		if(clock_gettime(CLOCK_MONOTONIC, &timerSpecification.it_value) < 0) 
+		if(clock_gettime(CLOCK_MONOTONIC, &timerSpecification.it_value) < 0)
 			throw std::runtime_error("Cannot get current timestamp.");
 		timerSpecification.it_value.tv_sec += timerSpecification.it_interval.tv_sec;
 		timerSpecification.it_value.tv_nsec += timerSpecification.it_interval.tv_nsec;
-		if(timerSpecification.it_value.tv_nsec > nanosecondUpperBound) {
+		if((unsigned long)timerSpecification.it_value.tv_nsec >= nanosecondUpperBound) {
 			timerSpecification.it_value.tv_sec += 1;
-			timerSpecification.it_value.tv_nsec -= nanosecondLowerBound;
+			timerSpecification.it_value.tv_nsec -= nanosecondUpperBound;
 		}
-		
+
 		// Update the timer by with new value.
 		if(timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &timerSpecification, NULL) < 0)
 			throw std::runtime_error("Cannot update timer descriptor.");
+		this -> timeout = timeout;
+		tickDeadline = (uint64_t)timerSpecification.it_value.tv_sec * nanosecondUpperBound
+			+ timerSpecification.it_value.tv_nsec;
 	}
-	
+
 	// Retrieve current timeout.
 	unsigned long currentTimeout() {
 		itimerspec timerSpecification;
@@ -225,88 +324,104 @@ struct McIoMultiplexerControl {
 			throw std::runtime_error("Cannot get current timer specification.");
 		if(timerSpecification.it_interval.tv_sec == 0)
 			return timerSpecification.it_interval.tv_nsec;
-		else return timerSpecification.it_interval.tv_sec * nanosecondUpperBound 
+		else return timerSpecification.it_interval.tv_sec * nanosecondUpperBound
 			+ timerSpecification.it_interval.tv_nsec;
 	}
 };
 static_assert(sizeof(McIoMultiplexerControl) < McIoMultiplexer::multiplexerControlBlockSize,
 		"Insufficient space for the multiplexer control block.");
-		
-// The implementation of McIoDescriptorControl::controlPoll.
-template<int action>
-inline void McIoDescriptorControl::controlPoll(){
-	assert(epollfd != -1 && fd != -1);
-	
-	// Control the events.
-	struct epoll_event event;
-	event.events = EPOLLET | EPOLLONESHOT | 
-		((listeningEvent & McIoEvent::evIn)?  EPOLLIN  : 0)|
-		((listeningEvent & McIoEvent::evOut)? EPOLLOUT : 0);
-	event.data.ptr = this;
-	if(epoll_ctl(epollfd, action, fd, &event) < 0)
-		throw std::runtime_error("Error while controlling descriptor.");
+
+// The implementation of McIoDescriptorControl::updatePoll.
+inline void McIoDescriptorControl::updatePoll() {
+	assert(multiplexerControl != nullptr && fd != -1);
+	multiplexerControl -> poller.modify(pollerEntry, fd, listeningEvent, this);
+}
+
+// The implementation of McIoDescriptorControl::rearmPoll.
+inline void McIoDescriptorControl::rearmPoll() {
+	assert(multiplexerControl != nullptr && fd != -1);
+	multiplexerControl -> poller.rearm(pollerEntry, fd, listeningEvent, this);
 }
 
+// The implementation of McIoDescriptorControl::removePoll.
+inline void McIoDescriptorControl::removePoll() noexcept {
+	multiplexerControl -> poller.remove(pollerEntry, fd);
+}
+
+// The implementation of McIoDescriptorControl::associate.
+inline void McIoDescriptorControl::associate(McIoMultiplexer* newMultiplexer,
+		McIoMultiplexerControl* newMultiplexerControl) {
+	assert(multiplexer == nullptr);                         // Not associated.
+	assert(newMultiplexer != nullptr && newMultiplexerControl != nullptr);
+
+	// Attempt to add to the poller, and perform association.
+	newMultiplexerControl -> poller.add(pollerEntry, fd, listeningEvent,
+			this, newMultiplexerControl -> persistent);
+	multiplexer = newMultiplexer;
+	multiplexerControl = newMultiplexerControl;
+}
+
+// Definitions of the event batch constants, as they are bound to references.
+const size_t McIoMultiplexer::minimumEventBatch;
+const size_t McIoMultiplexer::defaultMaximumEventBatch;
+
 // The implementation of McIoMultiplexer::execute().
-static const size_t numEventEpoll = 16;
 void McIoMultiplexer::execute() {
 	McIoMultiplexerControl& controlBlock = *((McIoMultiplexerControl*)control);
-	struct epoll_event eventEpoll[numEventEpoll];
-	
+	McIoMultiplexerMetrics& metrics = *controlBlock.metrics;
+	uint64_t tickSyscalls = metrics.syscalls.load();
+	uint64_t busyTime = 0, resumeTime = McIoMetricsClock();
+
 	// Run the loop, until the timer descriptor has become readable.
-	bool epollRunning = true;
-	while(epollRunning) {
-		int numEvents = epoll_wait(controlBlock.epollfd, eventEpoll, numEventEpoll,
-				(controlBlock.activeQueue != nullptr)? 0 : -1);
-		// Except the case of returning -1 due to handled signal must we throw exception.
-		if(numEvents < 0 && errno != EINTR) throw std::runtime_error("Error while polling events.");
-		
+	bool pollRunning = true;
+	while(pollRunning) {
+		busyTime += McIoMetricsClock() - resumeTime;
+		controlBlock.poller.wait(controlBlock.activeQueue == nullptr &&
+				controlBlock.flushQueue == nullptr, controlBlock.maxEventBatch);
+		resumeTime = McIoMetricsClock();
+		metrics.rounds.add();
+		metrics.syscalls.add();
+
 		// Interpret each events.
-		if(numEvents > 0) for(size_t i = 0; i < numEvents; ++ i) {
-			if(eventEpoll[i].data.ptr != nullptr) {
-				// The file descriptor is a normal file descriptor.
-				McIoDescriptorControl* descriptorControl = 
-					((McIoDescriptorControl*)eventEpoll[i].data.ptr);
-				if((eventEpoll[i].events & EPOLLERR) != 0) {
-					// If there's error with the descriptor, just destroy it.
-					controlBlock.erase(descriptorControl);
-				}
-				else {
-					// Or interpert the occured events and move it to the active queue.
-					descriptorControl -> activeEvent = (McIoEvent)(
-						((eventEpoll[i].events & EPOLLIN)?  McIoEvent::evIn  : 0)|
-						((eventEpoll[i].events & EPOLLOUT)? McIoEvent::evOut : 0));
-					descriptorControl -> moveQueue(&controlBlock.activeQueue);
-				}
+		controlBlock.poller.dispatch([&](McIoDescriptorControl* descriptorControl,
+				McIoEvent occuredEvent, bool failed) {
+			metrics.events.add();
+			if(descriptorControl == nullptr) {
+				// The file descriptor is a timer descriptor.
+				if(failed) throw std::runtime_error("The timer descriptor has error.");
+				controlBlock.readTimer();
+
+				// Reactive the descriptor and mark the polling loop would exit.
+				pollRunning = false;
+				controlBlock.poller.rearmTimer(controlBlock.timerfd);
+			}
+			else if(failed) {
+				// If there's error with the descriptor, just destroy it.
+				controlBlock.erase(descriptorControl);
 			}
 			else {
-				// The file descriptor is a timer descriptor.
-				if((eventEpoll[i].events & EPOLLERR) != 0) 
-					throw std::runtime_error("The timer descriptor has error.");
+				// Or move it to the active queue with the occured events.
+				// Persistently registered descriptors might be notified while
+				// they are still active, whose active events are accumulated.
+				if(descriptorControl -> prevNext != nullptr)
+					descriptorControl -> activeEvent = (McIoEvent)(
+						descriptorControl -> activeEvent | occuredEvent);
 				else {
-					// Read until there's no more content in the timer descriptor.
-					uint64_t expiration; int timerStatus;
-					size_t expirationSize = sizeof(expiration);
-					while((timerStatus = read(controlBlock.timerfd, 
-							&expiration, expirationSize)) == expirationSize);
-					
-					// Reactive the descriptor and mark the polling loop would exit.					
-					if(timerStatus == -1 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
-						epollRunning = false;
-						controlBlock.controlTimer<EPOLL_CTL_MOD>();
-					}
-					else throw std::runtime_error("The timer descriptor has error.");
+					descriptorControl -> activeEvent = occuredEvent;
+					descriptorControl -> moveQueue(&controlBlock.activeQueue);
 				}
 			}
-		}
-		
+		});
+
 		// Run each handled events.
 		// As descriptors might be removed while executing handle(), we need to update
 		// the pointer according to conditions.
 		// This approach does not work under multithread circumstance, as the multiplexer
 		// is defined NOT to be shared among threads, this approach is currently safe.
+		size_t numActive = 0;
 		for(McIoDescriptorControl* current = controlBlock.activeQueue; current != nullptr;) {
 			// Run the handle() method first.
+			metrics.handles.add();
 			current -> executing = true;
 			McIoNextStatus nextStatus = McIoNextStatus::nstFinal;
 			try {
@@ -317,7 +432,7 @@ void McIoMultiplexer::execute() {
 			}
 			current -> executing = false;
 			if(current -> markedRemoval) nextStatus = McIoNextStatus::nstFinal;
-			
+
 			// Work on the object and see what to do next.
 			McIoDescriptorControl* next = current -> next;
 			switch(nextStatus) {
@@ -326,48 +441,133 @@ void McIoMultiplexer::execute() {
 					current -> moveQueue(nullptr);
 					controlBlock.erase(current);
 				} break;
-				
+
 				case McIoNextStatus::nstPoll: {
 					// Return the object back to the polling queue.
 					// If it cannot be returned to the polling queue, then remove it.
 					current -> moveQueue(nullptr);
 					try {
-						current -> controlPoll<EPOLL_CTL_MOD>();
+						current -> rearmPoll();
 					} catch(...) {
 						controlBlock.erase(current);
 					}
 				} break;
-				
-				default: break;
+
+				default: ++ numActive; break;
 			}
 			current = next;
 		}
+		metrics.activeDescriptors.set(numActive);
+
+		// Handle the timeouts expired in this round, which are taken one by
+		// one, since the handlers might cancel the other expired timeouts.
+		McIoDescriptorControl* expiring;
+		while((expiring = controlBlock.timerWheel.takeExpired()) != nullptr) {
+			McIoEvent oldEventFlag = expiring -> listeningEvent;
+			metrics.timeouts.add();
+			expiring -> executing = true;
+			bool timeoutFailed = false;
+			try {
+				expiring -> descriptor -> handleTimeout();
+			} catch(...) {
+				timeoutFailed = true;
+			}
+			expiring -> executing = false;
+			if(expiring -> markedRemoval || timeoutFailed) {
+				controlBlock.erase(expiring);
+				continue;
+			}
+
+			// The descriptor that is polling should update its registration.
+			if(expiring -> prevNext == nullptr &&
+				expiring -> listeningEvent != oldEventFlag) try {
+				expiring -> rearmPoll();
+			} catch(...) {
+				controlBlock.erase(expiring);
+			}
+		}
+
+		// Flush the descriptors requesting flush in this round. The queue is
+		// detached first, descriptors requesting flush while being flushed
+		// will be flushed in the next round.
+		McIoDescriptorControl* flushing = controlBlock.flushQueue;
+		controlBlock.flushQueue = nullptr;
+		if(flushing != nullptr) flushing -> flushPrevNext = &flushing;
+		while(flushing != nullptr) {
+			McIoDescriptorControl* current = flushing;
+			current -> moveFlushQueue(nullptr);
+			McIoEvent oldEventFlag = current -> listeningEvent;
+			metrics.flushes.add();
+			current -> executing = true;
+			bool flushFailed = false;
+			try {
+				current -> descriptor -> handleFlush();
+			} catch(...) {
+				flushFailed = true;
+			}
+			current -> executing = false;
+			if(current -> markedRemoval || flushFailed) {
+				controlBlock.erase(current);
+				continue;
+			}
+
+			// The descriptor that is polling should update its registration.
+			if(current -> prevNext == nullptr &&
+				current -> listeningEvent != oldEventFlag) try {
+				current -> rearmPoll();
+			} catch(...) {
+				controlBlock.erase(current);
+			}
+		}
 	}
+
+	// Record the metrics of the tick.
+	busyTime += McIoMetricsClock() - resumeTime;
+	metrics.ticks.add();
+	metrics.tickBusyTime.record(busyTime / 1000);
+	if(busyTime > controlBlock.timeout) metrics.tickOverruns.add();
+	metrics.tickSyscalls.record(metrics.syscalls.load() - tickSyscalls);
 }
 
 // Implementation for McIoMultiplexer::insert().
 void McIoMultiplexer::insert(std::unique_ptr<McIoDescriptor>& descriptor) {
 	McIoMultiplexerControl* multiplexerControl = (McIoMultiplexerControl*)control;
-	
+
 	// Precondition checking.
 	assert(descriptor.get() != nullptr);
 	McIoDescriptorControl* descriptorControl = (McIoDescriptorControl*)(descriptor -> control);
 	assert((descriptorControl -> multiplexer) == nullptr);
-	
-	// Attempt to associate and transfer ownership.
-	descriptorControl -> associate(this, multiplexerControl -> epollfd);
+
+	// Attempt to associate and transfer ownership, where the slot is reserved
+	// first, so that the association never needs to be reverted.
+	multiplexerControl -> reserveSlot(descriptor -> fd);
+	assert(multiplexerControl -> descriptors[descriptor -> fd] == nullptr);
+	descriptorControl -> associate(this, multiplexerControl);
 	multiplexerControl -> descriptors[descriptor -> fd] = std::move(descriptor);
+	++ multiplexerControl -> numDescriptors;
+	multiplexerControl -> metrics -> descriptors.set(multiplexerControl -> numDescriptors);
+	if(descriptorControl -> flushDeferred) {
+		descriptorControl -> flushDeferred = false;
+		descriptorControl -> moveFlushQueue(&(multiplexerControl -> flushQueue));
+	}
+	if(descriptorControl -> timerExpiry != 0) multiplexerControl ->
+		timerWheel.schedule(descriptorControl, descriptorControl -> timerExpiry);
+}
+
+// Implementation for McIoMultiplexer::allocateDescriptor().
+void* McIoMultiplexer::allocateDescriptor(size_t size) {
+	return ((McIoMultiplexerControl*)control) -> descriptorSlab.allocate(size);
 }
 
 // Implementation for McIoMultiplexer::erase().
 void McIoMultiplexer::erase(McIoDescriptor* descriptor) {
 	McIoMultiplexerControl* multiplexerControl = (McIoMultiplexerControl*)control;
-	
+
 	// Precondition checking.
 	assert(descriptor != nullptr);
 	McIoDescriptorControl* descriptorControl = (McIoDescriptorControl*)(descriptor -> control);
 	assert((descriptorControl -> multiplexer) == this);
-	
+
 	// Judge by condition, to either remove it directly, or remove it after handle().
 	if(descriptorControl -> executing) descriptorControl -> markedRemoval = true;
 	else multiplexerControl -> erase(descriptorControl);
@@ -378,11 +578,57 @@ unsigned long McIoMultiplexer::currentTimeout() const {
 	return ((McIoMultiplexerControl*)control) -> currentTimeout();
 }
 
+// Implementation for McIoMultiplexer::remainingTime().
+unsigned long McIoMultiplexer::remainingTime() const noexcept {
+	const McIoMultiplexerControl* controlBlock = (const McIoMultiplexerControl*)control;
+	struct timespec now;
+	if(clock_gettime(CLOCK_MONOTONIC, &now) < 0) return 0;
+	uint64_t current = (uint64_t)now.tv_sec * nanosecondUpperBound + now.tv_nsec;
+	return current < controlBlock -> tickDeadline?
+		(unsigned long)(controlBlock -> tickDeadline - current) : 0;
+}
+
 // Implementation for McIoDescriptor::updateTimeout().
 void McIoMultiplexer::updateTimeout(unsigned long newTimeout) {
 	((McIoMultiplexerControl*)control) -> updateTimeout(newTimeout);
 }
 
+// Implementation for McIoMultiplexer::setMaximumEventBatch().
+void McIoMultiplexer::setMaximumEventBatch(size_t newSize) {
+	((McIoMultiplexerControl*)control) -> maxEventBatch =
+			std::max(newSize, minimumEventBatch);
+}
+
+// Implementation for McIoMultiplexer::getMaximumEventBatch().
+size_t McIoMultiplexer::getMaximumEventBatch() const {
+	return ((const McIoMultiplexerControl*)control) -> maxEventBatch;
+}
+
+// Implementation for McIoMultiplexer::setPersistentRegistration().
+void McIoMultiplexer::setPersistentRegistration(bool persistent) {
+	((McIoMultiplexerControl*)control) -> persistent = persistent;
+}
+
+// Implementation for McIoMultiplexer::getPersistentRegistration().
+bool McIoMultiplexer::getPersistentRegistration() const {
+	return ((const McIoMultiplexerControl*)control) -> persistent;
+}
+
+// Implementation for McIoMultiplexer::bufferPool().
+McIoBufferPool& McIoMultiplexer::bufferPool() {
+	return ((McIoMultiplexerControl*)control) -> bufferPool;
+}
+
+// Implementation for McIoMultiplexer::metrics().
+McIoMultiplexerMetrics& McIoMultiplexer::metrics() noexcept {
+	return *((McIoMultiplexerControl*)control) -> metrics;
+}
+
+// Implementation for McIoMultiplexer::metrics() const.
+const McIoMultiplexerMetrics& McIoMultiplexer::metrics() const noexcept {
+	return *((const McIoMultiplexerControl*)control) -> metrics;
+}
+
 // Implementation for McIoMultiplexer::McIoMultiplexer().
 McIoMultiplexer::McIoMultiplexer() {
 	// Placement-new the object in the hidden field.
@@ -402,6 +648,13 @@ McIoMultiplexer& McIoDescriptor::getMultiplexer() const {
 	return *(controlBlock -> multiplexer);
 }
 
+// Implementation for McIoDescriptor::metrics().
+McIoMultiplexerMetrics* McIoDescriptor::metrics() const noexcept {
+	McIoDescriptorControl* controlBlock = (McIoDescriptorControl*)control;
+	if(controlBlock -> multiplexer == nullptr) return nullptr;
+	return &controlBlock -> multiplexer -> metrics();
+}
+
 // Implementation for McIoDescriptor::currentEventFlag().
 McIoEvent McIoDescriptor::currentEventFlag() const {
 	McIoDescriptorControl* controlBlock = (McIoDescriptorControl*)control;
@@ -413,22 +666,55 @@ McIoEvent McIoDescriptor::currentEventFlag() const {
 void McIoDescriptor::updateEventFlag(McIoEvent newEventFlag) {
 	McIoDescriptorControl* controlBlock = (McIoDescriptorControl*)control;
 	assert((controlBlock -> multiplexer) != nullptr);
-	
-	if(controlBlock -> executing) 
+
+	if(controlBlock -> executing)
 		controlBlock -> listeningEvent = newEventFlag;
 	else {
 		McIoEvent oldEventFlag = controlBlock -> listeningEvent;
 		try {
 			controlBlock -> listeningEvent = newEventFlag;
-			controlBlock -> controlPoll<EPOLL_CTL_MOD>();
+			controlBlock -> updatePoll();
 		}
 		catch(const std::exception& ex) {
 			controlBlock -> listeningEvent = oldEventFlag;
-			throw ex;
+			throw;
 		}
 	}
 }
 
+// Implementation for McIoDescriptor::requestFlush().
+void McIoDescriptor::requestFlush() noexcept {
+	McIoDescriptorControl* controlBlock = (McIoDescriptorControl*)control;
+	if(controlBlock -> multiplexer == nullptr)
+		controlBlock -> flushDeferred = true;
+	else if(controlBlock -> flushPrevNext == nullptr)
+		controlBlock -> moveFlushQueue(&controlBlock -> multiplexerControl -> flushQueue);
+}
+
+// Implementation for McIoDescriptor::scheduleTimeout().
+void McIoDescriptor::scheduleTimeout(uint64_t ticks) noexcept {
+	McIoDescriptorControl* controlBlock = (McIoDescriptorControl*)control;
+	if(controlBlock -> multiplexer == nullptr)
+		controlBlock -> timerExpiry = ticks > 0? ticks : 1;
+	else controlBlock -> multiplexerControl -> timerWheel.schedule(controlBlock, ticks);
+}
+
+// Implementation for McIoDescriptor::cancelTimeout().
+void McIoDescriptor::cancelTimeout() noexcept {
+	McIoDescriptorControl* controlBlock = (McIoDescriptorControl*)control;
+	if(controlBlock -> multiplexer == nullptr) controlBlock -> timerExpiry = 0;
+	else McIoTimerWheel<McIoDescriptorControl>::cancel(controlBlock);
+}
+
+// Implementation for McIoDescriptor::hasTimeout(), where the timeout that has
+// expired but not yet been handled stays in the wheel's expired list.
+bool McIoDescriptor::hasTimeout() const noexcept {
+	const McIoDescriptorControl* controlBlock = (const McIoDescriptorControl*)control;
+	if(controlBlock -> multiplexer == nullptr) return controlBlock -> timerExpiry != 0;
+	else return controlBlock -> timerPrevNext != nullptr && controlBlock -> timerExpiry >
+		controlBlock -> multiplexerControl -> timerWheel.now();
+}
+
 // Implementation for McIoDescriptor::McIoDescriptor().
 McIoDescriptor::McIoDescriptor(int fd, McIoEvent initEventFlag): fd(fd) {
 	assert(fd != -1 && initEventFlag != McIoEvent::evNone);
@@ -0,0 +1,343 @@
+#pragma once
+/**
+ * @file multiplexer_uring.hpp
+ * @brief The io_uring poller of the multiplexer under linux.
+ * @author Haoran Luo
+ *
+ * This is the alternative of multiplexer_epoll.hpp, selected by the LIBMC_IO_URING
+ * option, which requires a kernel no older than 5.1.
+ *
+ * The descriptors are still readiness based, but armed with one-shot poll requests
+ * queued in the submission ring, which are submitted along with the waiting for
+ * completions in a single io_uring_enter() call. So re-arming the descriptors after
+ * handle() costs no system call. As there's no re-arming cost, the persistent
+ * registration setting has no effect, and the event batch is bounded by the ring.
+ *
+ * The timer is polled like other descriptors.
+ */
+#include <libminecraft/multiplexer.hpp>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <poll.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// For the owners of the poll requests.
+struct McIoDescriptorControl;
+
+// The number of submission queue entries of the ring.
+static const unsigned ringSubmissionEntries = 4096;
+
+// The number of completion queue entries of the ring.
+static const unsigned ringCompletionEntries = 16384;
+
+// The user data of the timer's poll request.
+static const uint64_t timerUserData = 0;
+
+// The user data of requests whose completions are ignored.
+static const uint64_t ignoredUserData = 1;
+
+// The submission and completion rings of the io_uring.
+struct McIoUringQueue {
+	/// The io_uring's file descriptor.
+	int ringfd;
+
+	/// The mapped rings and submission entries.
+	void *submissionRing, *completionRing;
+	size_t submissionRingSize, completionRingSize;
+	struct io_uring_sqe* submissions;
+	size_t submissionsSize;
+
+	/// The pointers into the submission ring.
+	unsigned *submissionHead, *submissionTail, *submissionMask, *submissionArray;
+	unsigned submissionEntries;
+
+	/// The pointers into the completion ring.
+	unsigned *completionHead, *completionTail, *completionMask;
+	struct io_uring_cqe* completions;
+
+	/// The number of entries prepared but not submitted.
+	unsigned numPrepared;
+
+	/// The completions reaped from the completion ring to make room for the
+	/// submission, which are reported before the ones still in the ring.
+	std::vector<struct io_uring_cqe> backlog;
+
+	/// Setup the io_uring and map its rings.
+	McIoUringQueue(): ringfd(-1), submissionRing(MAP_FAILED), completionRing(MAP_FAILED),
+		submissionRingSize(0), completionRingSize(0), submissions((io_uring_sqe*)MAP_FAILED),
+		submissionsSize(0), numPrepared(0), backlog() {
+
+		struct io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		params.flags = IORING_SETUP_CQSIZE;
+		params.cq_entries = ringCompletionEntries;
+		ringfd = (int)syscall(__NR_io_uring_setup, ringSubmissionEntries, &params);
+		if(ringfd < 0) throw std::runtime_error("Cannot create io_uring descriptor.");
+
+		// Map the rings, which might be just one mapping.
+		submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if(singleMap) submissionRingSize = completionRingSize =
+				std::max(submissionRingSize, completionRingSize);
+		submissionRing = mmap(nullptr, submissionRingSize, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+		if(submissionRing != MAP_FAILED) completionRing = singleMap? submissionRing :
+			mmap(nullptr, completionRingSize, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+		submissionsSize = params.sq_entries * sizeof(io_uring_sqe);
+		if(completionRing != MAP_FAILED) submissions = (io_uring_sqe*)mmap(nullptr,
+			submissionsSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+		if(submissions == MAP_FAILED) {
+			release();
+			throw std::runtime_error("Cannot map io_uring rings.");
+		}
+
+		// Locate the fields inside the rings.
+		char* sq = (char*)submissionRing;
+		submissionHead = (unsigned*)(sq + params.sq_off.head);
+		submissionTail = (unsigned*)(sq + params.sq_off.tail);
+		submissionMask = (unsigned*)(sq + params.sq_off.ring_mask);
+		submissionArray = (unsigned*)(sq + params.sq_off.array);
+		submissionEntries = params.sq_entries;
+		char* cq = (char*)completionRing;
+		completionHead = (unsigned*)(cq + params.cq_off.head);
+		completionTail = (unsigned*)(cq + params.cq_off.tail);
+		completionMask = (unsigned*)(cq + params.cq_off.ring_mask);
+		completions = (io_uring_cqe*)(cq + params.cq_off.cqes);
+	}
+
+	/// Unmap the rings and close the io_uring.
+	void release() noexcept {
+		if(submissions != MAP_FAILED) munmap(submissions, submissionsSize);
+		if(completionRing != MAP_FAILED && completionRing != submissionRing)
+			munmap(completionRing, completionRingSize);
+		if(submissionRing != MAP_FAILED) munmap(submissionRing, submissionRingSize);
+		if(ringfd != -1) close(ringfd);
+	}
+
+	~McIoUringQueue() noexcept { release(); }
+
+	/// Move the completions in the completion ring into the backlog.
+	void reap() {
+		unsigned head = *completionHead;
+		unsigned tail = __atomic_load_n(completionTail, __ATOMIC_ACQUIRE);
+		for(; head != tail; ++ head)
+			backlog.push_back(completions[head & *completionMask]);
+		__atomic_store_n(completionHead, head, __ATOMIC_RELEASE);
+	}
+
+	/// Submit the prepared entries, and wait for certain number of completions,
+	/// which is not waited when there're reaped completions. When the completion
+	/// ring is too full to accept the submission, it is reaped and retried.
+	/// @return false if interrupted while waiting.
+	bool enter(unsigned minComplete) {
+		while(true) {
+			if(!backlog.empty()) minComplete = 0;
+			int numSubmitted = (int)syscall(__NR_io_uring_enter, ringfd, numPrepared,
+				minComplete, minComplete > 0? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+			if(numSubmitted >= 0) {
+				numPrepared -= std::min((unsigned)numSubmitted, numPrepared);
+				return true;
+			}
+			else if(errno == EINTR) return false;
+			else if(errno == EAGAIN) continue;
+			else if(errno == EBUSY) reap();
+			else throw std::runtime_error("Error while entering io_uring.");
+		}
+	}
+
+	/// Retrieve a cleared submission entry, submitting the prepared entries when
+	/// the submission ring is full. The entry is not visible to the kernel until
+	/// it is filled and published.
+	struct io_uring_sqe* prepare() {
+		unsigned tail = *submissionTail;
+		if(tail - __atomic_load_n(submissionHead, __ATOMIC_ACQUIRE) >= submissionEntries) {
+			enter(0);
+			if(tail - __atomic_load_n(submissionHead, __ATOMIC_ACQUIRE) >= submissionEntries)
+				throw std::runtime_error("The io_uring submission ring is full.");
+		}
+		unsigned index = tail & *submissionMask;
+		struct io_uring_sqe* entry = &submissions[index];
+		memset(entry, 0, sizeof(*entry));
+		submissionArray[index] = index;
+		return entry;
+	}
+
+	/// Publish the entry filled after prepare(), by advancing the tail with
+	/// release order, so that the kernel never sees a partially filled entry.
+	void publish() noexcept {
+		__atomic_store_n(submissionTail, *submissionTail + 1, __ATOMIC_RELEASE);
+		++ numPrepared;
+	}
+
+	/// Prepare a one-shot poll request.
+	void preparePoll(int fd, unsigned events, uint64_t userData) {
+		struct io_uring_sqe* entry = prepare();
+		entry -> opcode = IORING_OP_POLL_ADD;
+		entry -> fd = fd;
+		entry -> poll32_events = events;
+		entry -> user_data = userData;
+		publish();
+	}
+
+	/// Prepare the cancellation of a poll request.
+	void preparePollRemove(uint64_t removedUserData) {
+		struct io_uring_sqe* entry = prepare();
+		entry -> opcode = IORING_OP_POLL_REMOVE;
+		entry -> fd = -1;
+		entry -> addr = removedUserData;
+		entry -> user_data = ignoredUserData;
+		publish();
+	}
+};
+
+/// The registration of a descriptor in the io_uring poller, which is empty
+/// as the pending poll requests are traced in the poller's slots.
+struct McIoPollerEntry {};
+
+/// The io_uring poller of the multiplexer.
+struct McIoPoller {
+	/// The io_uring's rings.
+	McIoUringQueue ring;
+
+	/// The pending poll request of a file descriptor, whose user data is made
+	/// of the file descriptor and the generation. The generation advances on
+	/// each arming and cancellation, so the stale completions are ignored.
+	struct Slot {
+		McIoDescriptorControl* owner;
+		uint32_t generation;
+	};
+
+	/// The slots of poll requests, indexed by the file descriptors.
+	std::vector<Slot> slots;
+
+	/// The reaped completions being reported, swapped with the ring's backlog.
+	std::vector<struct io_uring_cqe> reported;
+
+	/// Setup the io_uring, where the metrics are not used, as the requests are
+	/// submitted along with the waiting.
+	McIoPoller(McIoMultiplexerMetrics&): ring(), slots(), reported() {}
+
+	/// Retrieve the user data of the poll request in the slot, which is never
+	/// one of the timer's or the ignored ones.
+	static uint64_t userData(int fd, const Slot& slot) noexcept {
+		return (((uint64_t)fd + 1) << 32) | slot.generation;
+	}
+
+	/// Place the timer descriptor into the ring.
+	void addTimer(int timerfd) { ring.preparePoll(timerfd, POLLIN, timerUserData); }
+
+	/// Re-arm the timer descriptor after it has been read.
+	void rearmTimer(int timerfd) { addTimer(timerfd); }
+
+	/// Arm the descriptor with the listening events, cancelling the pending
+	/// poll request if there's one.
+	void arm(int fd, McIoEvent events, McIoDescriptorControl* owner) {
+		if((size_t)fd >= slots.size()) slots.resize(
+			std::max<size_t>((size_t)fd + 1, slots.size() * 2), Slot{nullptr, 0});
+		Slot& slot = slots[fd];
+		if(slot.owner != nullptr) disarm(fd);
+
+		// Queue the poll request, which will be submitted on next polling.
+		struct io_uring_sqe* entry = ring.prepare();
+		++ slot.generation;
+		slot.owner = owner;
+		entry -> opcode = IORING_OP_POLL_ADD;
+		entry -> fd = fd;
+		entry -> poll32_events =
+			((events & McIoEvent::evIn)?  POLLIN  : 0)|
+			((events & McIoEvent::evOut)? POLLOUT : 0);
+		entry -> user_data = userData(fd, slot);
+		ring.publish();
+	}
+
+	/// Cancel the pending poll request of the descriptor.
+	void disarm(int fd) noexcept {
+		Slot& slot = slots[fd];
+		try {
+			ring.preparePollRemove(userData(fd, slot));
+		} catch(const std::exception&)
+		{ /* Do nothing, the completion will be ignored anyway. */ }
+		slot.owner = nullptr;
+		++ slot.generation;
+	}
+
+	/// Arm the descriptor, as there's no registration.
+	void add(McIoPollerEntry&, int fd, McIoEvent events,
+			McIoDescriptorControl* owner, bool) { arm(fd, events, owner); }
+
+	/// Update the listening events of the descriptor, arming it again.
+	void modify(McIoPollerEntry&, int fd, McIoEvent events,
+			McIoDescriptorControl* owner) { arm(fd, events, owner); }
+
+	/// Re-arm the descriptor after it has been handled.
+	void rearm(McIoPollerEntry&, int fd, McIoEvent events,
+			McIoDescriptorControl* owner) { arm(fd, events, owner); }
+
+	/// Cancel the pending poll request of the descriptor if there's one.
+	void remove(McIoPollerEntry&, int fd) noexcept {
+		if((size_t)fd < slots.size() && slots[fd].owner != nullptr) disarm(fd);
+	}
+
+	/// Submit the queued requests and wait for completions, blocking only if
+	/// specified, where the event batch is bounded by the ring instead.
+	void wait(bool block, size_t) { ring.enter(block? 1 : 0); }
+
+	/// Report the completion to the visitor, unless it is ignored or stale.
+	template<typename Visitor>
+	void report(const struct io_uring_cqe& completion, Visitor& visitor) {
+		uint64_t data = completion.user_data;
+		if(data == ignoredUserData) return;
+
+		// The completion might be stale, as the descriptor has been disarmed.
+		McIoDescriptorControl* owner = nullptr;
+		if(data != timerUserData) {
+			size_t fd = (size_t)(data >> 32) - 1;
+			if(fd >= slots.size()) return;
+			Slot& slot = slots[fd];
+			if(slot.owner == nullptr || slot.generation != (uint32_t)data) return;
+			owner = slot.owner;
+			slot.owner = nullptr;
+		}
+
+		// Interpret the occured events, where the negative result is an error.
+		unsigned result = completion.res < 0? (unsigned)POLLERR : (unsigned)completion.res;
+		visitor(owner, (McIoEvent)(
+			((result & (POLLIN | POLLHUP))? McIoEvent::evIn  : 0)|
+			((result & POLLOUT)?            McIoEvent::evOut : 0)),
+			(result & (POLLERR | POLLNVAL)) != 0);
+	}
+
+	/// Report each completion to the visitor, as visitor(owner, events, failed)
+	/// where owner is nullptr for the timer. The hang up is reported as readable,
+	/// so that the reader sees the end, instead of being polled forever.
+	///
+	/// The reaped completions are reported first, as they have completed earlier.
+	/// Each completion is consumed before being reported, since the visitor might
+	/// enter the ring and reap the remaining ones, which are reported next time.
+	template<typename Visitor>
+	void dispatch(Visitor&& visitor) {
+		reported.clear();
+		reported.swap(ring.backlog);
+		for(const struct io_uring_cqe& completion : reported) report(completion, visitor);
+
+		unsigned head;
+		while((head = *ring.completionHead) !=
+				__atomic_load_n(ring.completionTail, __ATOMIC_ACQUIRE)) {
+			struct io_uring_cqe completion = ring.completions[head & *ring.completionMask];
+			__atomic_store_n(ring.completionHead, head + 1, __ATOMIC_RELEASE);
+			report(completion, visitor);
+		}
+	}
+};
\ No newline at end of file
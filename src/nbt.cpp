@@ -9,49 +9,118 @@
 #include "libminecraft/nbt.hpp"
 #include "libminecraft/iobase.hpp"
 #include "libminecraft/stream.hpp"
+#include "libminecraft/bufstream.hpp"
 #include <cassert>
 #include <type_traits>
 #include <codecvt>
 #include <locale>
 #include <list>
+#include <vector>
+#include <algorithm>
+#include <climits>
 
 // The invalid nbt tag type message.
 static const char* invalidNbtTagType = "Expected invalid nbt tag type.";
 
-// Implementation for McIoReadNbtCompound.
-void McIoReadNbtCompound(McIoInputStream& inputStream, mc::nbtcompound& compound) {
-	// Just perform reading until an empty item occurs.
-	while(true) {
-		mc::nbtitem ioItem; inputStream >> ioItem;
-		auto& item = (McDtNbtItem&)ioItem;
-		auto itemKey = (const std::u16string&)item.first;
-		
-		// Append to the compound list.
-		if(item.second.isNull()) break;
-		else (McDtNbtPayload&)(compound[itemKey]) = std::move(item.second);
+// The payload type that the tag of V is read into inside an arena, which
+// is the arena variant for the strings and arrays.
+template<typename V> struct McIoNbtArenaPayload { typedef V type; };
+
+template<> struct McIoNbtArenaPayload<mc::jstring> 
+{	typedef mc::nbtarenastring type;	};
+
+template<typename I> struct McIoNbtArenaPayload<mc::nbtintarray<I>> 
+{	typedef mc::nbtarenaintarray<I> type;	};
+
+// Create the empty payload, whose storage is inside the arena.
+template<typename V> struct McIoNbtPayloadCreate {
+	static inline V create(McDtNbtArena*) { return V(); }
+};
+
+template<> struct McIoNbtPayloadCreate<mc::nbtarenastring> {
+	static inline mc::nbtarenastring create(McDtNbtArena* arena) 
+	{	return mc::nbtarenastring(McDtNbtString(McDtNbtAllocator<char16_t>(arena)));	}
+};
+
+template<typename I> struct McIoNbtPayloadCreate<mc::nbtarenaintarray<I>> {
+	static inline mc::nbtarenaintarray<I> create(McDtNbtArena* arena) {
+		return mc::nbtarenaintarray<I>(typename mc::nbtarenaintarray<I>::type(
+			McDtNbtAllocator<I>(arena)));
+	}
+};
+
+// Implementation for mc::nbtarenastring's I/O methods.
+template<> McIoInputStream&
+mc::nbtarenastring::read(McIoInputStream& inputStream) {
+	mc::u16 utfLength; inputStream >> utfLength;
+	
+	// Every byte decodes into at most one code unit, and the string is 
+	// decoded in place so it stays inside the arena.
+	size_t byteLength = (size_t)(uint16_t)utfLength;
+	data.resize(byteLength);
+	data.resize(McIoReadUtf16Units(inputStream, byteLength, &data[0]));
+	return inputStream;
+}
+
+template<> McIoOutputStream&
+mc::nbtarenastring::write(McIoOutputStream& outputStream) const {
+	// Convert string to utf-8 format, after the big endian length.
+	std::vector<char> encoded(2 + 3 * data.size());
+	size_t size = McIoEncodeUtf8(data.data(), data.size(), &encoded[2]);
+	if(size > USHRT_MAX) throw std::runtime_error(
+			"The length is too long for java string output.");
+	
+	encoded[0] = (char)((size >> 8) & 0x0ff);
+	encoded[1] = (char)((size >> 0) & 0x0ff);
+	outputStream.write(encoded.data(), size + 2);
+	return outputStream;
+}
+
+// Read the list elements of fixed length primitives in bulk.
+template<typename V> inline void McIoReadNbtListElements(McIoInputStream& inputStream,
+		mc::nbtlist& list, size_t listLength, std::true_type) {
+	typedef typename McDtBulkTraits<V>::wordType wordType;
+	mc::nbttypedlist<V> elements = list.asType<V>();
+	elements.resize(listLength);
+	McIoReadFixedArray<wordType>(inputStream, 
+		reinterpret_cast<wordType*>(elements.begin()), listLength);
+}
+
+// Read the list elements one by one, in place of the list.
+template<typename V> inline void McIoReadNbtListElements(McIoInputStream& inputStream,
+		mc::nbtlist& list, size_t listLength, std::false_type) {
+	mc::nbttypedlist<V> elements = list.asType<V>();
+	elements.reserve(listLength);
+	for(size_t i = 0; i < listLength; ++ i) {
+		V value = McIoNbtPayloadCreate<V>::create(list.arena());
+		inputStream >> value;
+		elements.push_back(std::move(value));
 	}
 }
 
 // To be used in McIoReadNbtList to eliminate switch and #define.
 struct McIoNbtTagListItemRead {
 	/**
-	 * @brief The normal read parser for nbt list types.
+	 * @brief The normal read parser for nbt list types, the lists of 
+	 * primitives are read in bulk, and the elements are read into the 
+	 * items of the list inside its arena.
 	 * @param[inout] inputStream the target input stream for reading.
 	 * @param[out] list the element to read data into.
 	 * @param[in] listLength the previously known length of list.
 	 */
 	template<typename V> static inline void perform(
 		McIoInputStream& inputStream, McDtNbtList& list, int listLength) {
-		std::vector<V> listVector;
-		
-		if(listLength > 0) {
-			listVector.reserve(listLength);
-			for(size_t i = 0; i < listLength; ++ i) {
-				V data; inputStream >> data;
-				listVector.push_back(data);
-			}
-		}
-		mc::nbtlist dataList(listVector);
+		if(list.arena() == nullptr) readList<V>(inputStream, list, listLength);
+		else readList<typename McIoNbtArenaPayload<V>::type>(
+			inputStream, list, listLength);
+	}
+	
+	// Read the elements into the list of the payload type P.
+	template<typename P> static inline void readList(
+		McIoInputStream& inputStream, McDtNbtList& list, int listLength) {
+		mc::nbtlist dataList = mc::nbtlist::of<P>(list.arena());
+		if(listLength > 0) McIoReadNbtListElements<P>(inputStream, 
+			dataList, (size_t)listLength, McDtBulkTraits<P>());
 		list.swap(dataList);
 	}
 };
@@ -60,16 +129,16 @@ struct McIoNbtTagListItemRead {
 template<> inline void 
 McIoNbtTagListItemRead::perform<McDtNbtList>(
 	McIoInputStream& inputStream, McDtNbtList& list, int listLength) {
-	std::vector<mc::nbtlist> listVector;
+	mc::nbtlist aggregateList = mc::nbtlist::of<mc::nbtlist>(list.arena());
 	if(listLength > 0) {
-		listVector.reserve(listLength);
-		for(size_t i = 0; i < listLength; ++ i) {
-			mc::nbtlist sublist; 
+		mc::nbttypedlist<mc::nbtlist> elements = aggregateList.asType<mc::nbtlist>();
+		elements.reserve(listLength);
+		for(size_t i = 0; i < (size_t)listLength; ++ i) {
+			mc::nbtlist sublist(list.arena()); 
 			McIoReadNbtList(inputStream, sublist);
-			listVector.push_back(std::move(sublist));
+			elements.push_back(std::move(sublist));
 		}
 	}
-	mc::nbtlist aggregateList(listVector);
 	list.swap(aggregateList);
 }
 
@@ -77,16 +146,16 @@ McIoNbtTagListItemRead::perform<McDtNbtList>(
 template<> inline void 
 McIoNbtTagListItemRead::perform<McDtNbtCompound>(
 	McIoInputStream& inputStream, McDtNbtList& list, int listLength) {
-	std::vector<mc::nbtcompound> listVector;
+	mc::nbtlist compoundList = mc::nbtlist::of<mc::nbtcompound>(list.arena());
 	if(listLength > 0) {
-		listVector.reserve(listLength);
-		for(size_t i = 0; i < listLength; ++ i) {
-			mc::nbtcompound compound;
+		mc::nbttypedlist<mc::nbtcompound> elements = compoundList.asType<mc::nbtcompound>();
+		elements.reserve(listLength);
+		for(size_t i = 0; i < (size_t)listLength; ++ i) {
+			mc::nbtcompound compound(list.arena());
 			McIoReadNbtCompound(inputStream, compound);
-			listVector.push_back(std::move(compound));
+			elements.push_back(std::move(compound));
 		}
 	}
-	mc::nbtlist compoundList(listVector);
 	list.swap(compoundList);
 }
 
@@ -114,28 +183,38 @@ struct McIoNbtTagItemRead {
 	 * @brief The normal read parser for nbt types.
 	 * @param[inout] inputStream the target input stream for reading.
 	 * @param[out] payload the union to write read data to.
+	 * @param[in] arena the arena of the read data, may be null.
 	 */
-	template<typename V> static inline void perform(
-		McIoInputStream& inputStream, McDtNbtPayload& payload) {
-		V dataObject; inputStream >> dataObject;
+	template<typename V> static inline void perform(McIoInputStream& inputStream, 
+		McDtNbtPayload& payload, McDtNbtArena* arena) {
+		if(arena == nullptr) readPayload<V>(inputStream, payload, arena);
+		else readPayload<typename McIoNbtArenaPayload<V>::type>(
+			inputStream, payload, arena);
+	}
+	
+	// Read the payload of the payload type P.
+	template<typename P> static inline void readPayload(
+		McIoInputStream& inputStream, McDtNbtPayload& payload, McDtNbtArena* arena) {
+		P dataObject = McIoNbtPayloadCreate<P>::create(arena); 
+		inputStream >> dataObject;
 		payload = std::move(dataObject);
 	}
 };
 
 /// Specialization for McDtNbtList.
 template<> inline void 
-McIoNbtTagItemRead::perform<McDtNbtList>(
-	McIoInputStream& inputStream, McDtNbtPayload& payload) {
-	mc::nbtlist list;
+McIoNbtTagItemRead::perform<McDtNbtList>(McIoInputStream& inputStream, 
+	McDtNbtPayload& payload, McDtNbtArena* arena) {
+	mc::nbtlist list(arena);
 	McIoReadNbtList(inputStream, list);
 	payload = std::move(list);
 }
 
 /// Specialization for McDtNbtCompound.
 template<> inline void 
-McIoNbtTagItemRead::perform<McDtNbtCompound>(
-	McIoInputStream& inputStream, McDtNbtPayload& payload) {
-	mc::nbtcompound compound;
+McIoNbtTagItemRead::perform<McDtNbtCompound>(McIoInputStream& inputStream, 
+	McDtNbtPayload& payload, McDtNbtArena* arena) {
+	mc::nbtcompound compound(arena);
 	McIoReadNbtCompound(inputStream, compound);
 	payload = std::move(compound);
 }
@@ -160,10 +239,33 @@ mc::nbtitem::read(McIoInputStream& inputStream) {
 	
 	// Depending on the tag type, perform reading or deeper processing of the data.
 	mc::nbtinfo.userByOrdinal<McIoNbtTagItemRead, McIoInputStream&, 
-			McDtNbtPayload&>(tagType, inputStream, data.second);
+			McDtNbtPayload&, McDtNbtArena*>(tagType, inputStream, data.second, nullptr);
 	return inputStream;
 }
 
+// Implementation for McIoReadNbtCompound.
+void McIoReadNbtCompound(McIoInputStream& inputStream, mc::nbtcompound& compound) {
+	// Just perform reading until an empty item occurs.
+	while(true) {
+		mc::s8 tagType; inputStream >> tagType;
+		if(tagType == 0) break;
+		else if(tagType < 0 || tagType > 12)
+			throw std::runtime_error(invalidNbtTagType);
+		
+		// Read the tag name and the payload inside the arena.
+		mc::nbtarenastring tagName = McIoNbtPayloadCreate<mc::nbtarenastring>
+			::create(compound.arena());
+		inputStream >> tagName;
+		McDtNbtPayload payload;
+		mc::nbtinfo.userByOrdinal<McIoNbtTagItemRead, McIoInputStream&, 
+			McDtNbtPayload&, McDtNbtArena*>(tagType - 1, inputStream, 
+			payload, compound.arena());
+		
+		// Append to the compound list.
+		(McDtNbtPayload&)(compound[(McDtNbtString&&)tagName]) = std::move(payload);
+	}
+}
+
 // Skip normal elements in McIoSkipElement.
 struct McIoNbtTagItemSkip {
 	/**
@@ -198,12 +300,20 @@ template<> inline void McIoNbtTagItemSkip
 ::perform<mc::array<mc::s64, mc::s32>>(McIoInputStream& inputStream) 
 {	McIoNbtArraySkip<mc::s64>(inputStream);	}
 	
+// Skip the list whose element type has been read, see below.
+static void McIoSkipNbtListBody(McIoInputStream& inputStream, mc::s8 tagType);
+
 // The specialization for skipping mc::nbtlist.
 template<> inline void McIoNbtTagItemSkip
 ::perform<mc::nbtlist>(McIoInputStream& inputStream) {
 
 	// Retrieve the the list essentials.
 	mc::s8 tagType; inputStream >> tagType;
+	McIoSkipNbtListBody(inputStream, tagType);
+}
+
+// Implementation for skipping the list after its element type.
+void McIoSkipNbtListBody(McIoInputStream& inputStream, mc::s8 tagType) {
 	mc::s32 listLength; inputStream >> listLength;
 	if(tagType == 0 && listLength > 0) 
 		throw std::runtime_error(invalidNbtTagType);
@@ -236,7 +346,9 @@ template<> inline void McIoNbtTagItemSkip
 			throw std::runtime_error(invalidNbtTagType);
 		else tagType = tagType - 1;
 		
-		// Skip according to the tag.
+		// Skip the tag name, then skip according to the tag.
+		mc::u16 nameLength; inputStream >> nameLength;
+		if(nameLength > 0) inputStream.skip(nameLength);
 		McIoSkipNbtElement(inputStream, tagType);
 	}
 }
@@ -251,6 +363,23 @@ template<> inline void McIoNbtTagItemSkip
 	if(stringLength > 0) inputStream.skip(stringLength);
 }
 
+// The arena variants are skipped as their counterparts of the same tag.
+template<> inline void McIoNbtTagItemSkip
+::perform<mc::nbtarenastring>(McIoInputStream& inputStream) 
+{	perform<mc::jstring>(inputStream);	}
+
+template<> inline void McIoNbtTagItemSkip
+::perform<mc::nbtarenaintarray<mc::s8>>(McIoInputStream& inputStream) 
+{	McIoNbtArraySkip<mc::s8>(inputStream);	}
+
+template<> inline void McIoNbtTagItemSkip
+::perform<mc::nbtarenaintarray<mc::s32>>(McIoInputStream& inputStream) 
+{	McIoNbtArraySkip<mc::s32>(inputStream);	}
+
+template<> inline void McIoNbtTagItemSkip
+::perform<mc::nbtarenaintarray<mc::s64>>(McIoInputStream& inputStream) 
+{	McIoNbtArraySkip<mc::s64>(inputStream);	}
+
 // Implementation for the skipping method.
 void McIoSkipNbtElement(McIoInputStream& inputStream, mc::s8 tag) {
 	mc::nbtinfo.userByOrdinal<McIoNbtTagItemSkip, McIoInputStream&>
@@ -281,7 +410,8 @@ inline void McIoSaxNbtCompoundPlaceIgnored(McDtNbtCompound* ignoredTag,
 		// Read and place the payload behind.
 		McDtNbtPayload payload;
 		mc::nbtinfo.userByOrdinal<McIoNbtTagItemRead, McIoInputStream&, 
-			McDtNbtPayload&>(tagType, inputStream, payload);
+			McDtNbtPayload&, McDtNbtArena*>(tagType, inputStream, 
+			payload, ignoredTag -> arena());
 		(*ignoredTag)[tagName] = std::move(payload);
 	}
 	else {
@@ -358,14 +488,14 @@ void McIoSaxNbtCompound(McIoMarkableStream& inputStream, void* data, void* ud,
 		}
 		
 		// If mismatched (typed list), also place it outside.
+		mc::s8 componentType = 0;
 		if(saxAction.expectedType > 12) {
-			std::unique_ptr<McIoStreamMark> mark;
-			if(ignoredTag != nullptr) mark = inputStream.mark();
+			std::unique_ptr<McIoStreamMark> mark = inputStream.mark();
 			
-			mc::s8 componentType; inputStream >> componentType;
+			inputStream >> componentType;
 			if(componentType > 0) {	// Except for nbt end could match any type.
 				if(componentType + 12 != saxActions[entry].expectedType) {
-					mark.reset();
+					mark -> reset();
 					McIoSaxNbtCompoundPlaceIgnored(ignoredTag, 
 						type, tagLength, nameBuffer, inputStream);
 					continue;
@@ -386,6 +516,11 @@ void McIoSaxNbtCompound(McIoMarkableStream& inputStream, void* data, void* ud,
 			item.action = entry; 
 			item.mark.swap(mark);
 			marks.push_back(std::move(item));
+			
+			// Skip the payload until it is resolved.
+			if(saxAction.expectedType > 12) 
+				McIoSkipNbtListBody(inputStream, componentType);
+			else McIoSkipNbtElement(inputStream, type);
 		}
 	}
 	
@@ -417,6 +552,7 @@ void McIoSaxNbtCompound(McIoMarkableStream& inputStream, void* data, void* ud,
 		if(!marks.empty()) {
 			for(auto iter = marks.begin(); iter != marks.end(); ++ iter) {
 				if(saxActions[iter -> action].tagFailedResolve != nullptr) {
+					iter -> mark -> reset();
 					saxActions[iter -> action].tagFailedResolve
 						(inputStream, data, ud);
 					present[iter -> action] = true; ++ numPresents;
@@ -425,7 +561,210 @@ void McIoSaxNbtCompound(McIoMarkableStream& inputStream, void* data, void* ud,
 		}
 		
 		// Reset the mark to the last of the stream.
-		endCompoundMark = 0;
+		endCompoundMark -> reset();
+	}
+	
+	// Invoke those who have their not present method registered.
+	if(numPresents < numSaxActions) for(size_t i = 0; i < numSaxActions; ++ i)
+		if((!present[i]) && (saxActions[i].tagAbsent != nullptr))
+			saxActions[i].tagAbsent(data, ud);
+}
+
+/**
+ * The forward-only stream adapting an input stream to the markable stream, 
+ * for the streaming SAX reading. 
+ *
+ * While there're marks alive, the bytes read from the wrapped stream are 
+ * recorded and replayed once the marks are reset, so the memory is bounded 
+ * by the data read since the earliest living mark. The bytes could also be 
+ * spilled into a side buffer while skipping a tag.
+ */
+class McIoSaxSpillStream : public McIoMarkableStream {
+	/// The wrapped forward-only stream.
+	McIoInputStream& wrapped;
+	
+	/// The bytes recorded since the earliest living mark, and the position
+	/// of replaying inside it.
+	std::vector<char> recorded;
+	size_t replay;
+	
+	/// The number of living marks.
+	size_t liveMarks;
+	
+	/// The side buffer to spill bytes into, may be null.
+	std::vector<char>* spilled;
+	
+	/// Drop the recorded bytes once they are neither replayed nor marked.
+	void collect() {
+		if(liveMarks == 0 && replay == recorded.size()) 
+			{	recorded.clear(); replay = 0;	}
+	}
+public:
+	McIoSaxSpillStream(McIoInputStream& wrapped): wrapped(wrapped), 
+		recorded(), replay(0), liveMarks(0), spilled(nullptr) {}
+	
+	/// Begin spilling into the buffer, or stop spilling if it is null.
+	void spillTo(std::vector<char>* buffer) { spilled = buffer; }
+	
+	virtual void read(char* buffer, size_t receiveLength) override {
+		if(receiveLength == 0) return;
+		
+		// Replay the recorded bytes first.
+		size_t replayed = std::min(receiveLength, recorded.size() - replay);
+		if(replayed > 0) memcpy(buffer, recorded.data() + replay, replayed);
+		replay += replayed;
+		
+		// Read the rest from the wrapped stream, recording if marked.
+		if(replayed < receiveLength) {
+			wrapped.read(buffer + replayed, receiveLength - replayed);
+			if(liveMarks > 0) {
+				recorded.insert(recorded.end(), buffer + replayed, buffer + receiveLength);
+				replay = recorded.size();
+			}
+		}
+		if(spilled != nullptr) spilled -> insert(spilled -> end(), buffer, buffer + receiveLength);
+		collect();
+	}
+	
+	virtual void skip(size_t skipLength) override {
+		// Skip the wrapped stream directly when nothing is recorded.
+		if(liveMarks == 0 && spilled == nullptr) {
+			size_t replayed = std::min(skipLength, recorded.size() - replay);
+			replay += replayed;
+			collect();
+			if(replayed < skipLength) wrapped.skip(skipLength - replayed);
+			return;
+		}
+		
+		// Otherwise read through the skipped bytes.
+		char skipBuffer[4096];
+		while(skipLength > 0) {
+			size_t current = std::min(skipLength, sizeof(skipBuffer));
+			read(skipBuffer, current);
+			skipLength -= current;
+		}
+	}
+	
+	virtual std::unique_ptr<McIoStreamMark> mark() override {
+		struct McIoSaxSpillStreamMark : public McIoStreamMark {
+			McIoSaxSpillStream& stream;
+			size_t position;
+			McIoSaxSpillStreamMark(McIoSaxSpillStream& stream): 
+				stream(stream), position(stream.replay) { ++ stream.liveMarks; }
+			~McIoSaxSpillStreamMark() { -- stream.liveMarks; stream.collect(); }
+			virtual void reset() override { stream.replay = position; }
+		};
+		return std::unique_ptr<McIoStreamMark>(new McIoSaxSpillStreamMark(*this));
+	}
+};
+
+// Implementation for McIoSaxNbtCompound() over the forward-only stream.
+void McIoSaxNbtCompound(McIoInputStream& wrappedStream, void* data, void* ud,
+	int (*dictionary)(size_t tagLength, const char* tagName), size_t numSaxActions, 
+	const McIoNbtCompoundSaxAction* const saxActions, McDtNbtCompound* ignoredTag) {
+	
+	McIoSaxSpillStream inputStream(wrappedStream);
+	std::vector<bool> present(numSaxActions);
+	size_t numPresents = 0;
+	struct McIoSaxTagSpillItem {
+		size_t action;					///< The index of the action.
+		std::vector<char> payload;		///< The spilled data of the tag.
+	};
+	std::list<McIoSaxTagSpillItem> spills;
+	
+	// Loop until has encountered a tag end.
+	while(true) {
+		// Parse the type and tag name first.
+		mc::s8 type; inputStream >> type;
+		if(type == 0) break;	// Tag end encounters.
+		else if(type < 0 || type > 12) 
+			throw std::runtime_error(invalidNbtTagType);
+		else type = type - 1;
+		mc::u16 tagLength; inputStream >> tagLength;
+		
+		// The tag will never be matched.
+		if(tagLength >= McIoSaxMaxNbtTagNameLength) {
+			McIoSaxNbtCompoundPlaceIgnored(ignoredTag, type, 
+				tagLength, nullptr, inputStream);
+			continue;
+		}
+		
+		// Read the name and look up the dictionary.
+		char nameBuffer[McIoSaxMaxNbtTagNameLength + 1];
+		inputStream.read(nameBuffer, tagLength);
+		int entry = dictionary(tagLength, nameBuffer);
+		if(entry < 0 || (size_t)entry >= numSaxActions) {
+			McIoSaxNbtCompoundPlaceIgnored(ignoredTag, 
+				type, tagLength, nameBuffer, inputStream);
+			continue;
+		}
+		const McIoNbtCompoundSaxAction& saxAction = saxActions[entry];
+		assert(saxAction.expectedType <= 25);
+		if(saxAction.expectedType <= 12 && saxAction.expectedType != (size_t)type) {
+			McIoSaxNbtCompoundPlaceIgnored(ignoredTag, 
+				type, tagLength, nameBuffer, inputStream);
+			continue;
+		}
+		
+		// Check the element type of typed list, which could not be read again.
+		mc::s8 componentType = 0;
+		if(saxAction.expectedType > 12) {
+			inputStream >> componentType;
+			if(componentType > 0 && (size_t)(componentType + 12) != saxAction.expectedType) {
+				std::vector<char> listData(1, (char)componentType);
+				inputStream.spillTo(&listData);
+				McIoSkipNbtListBody(inputStream, componentType);
+				inputStream.spillTo(nullptr);
+				McIoBufferInputStream listStream(listData.data(), listData.size());
+				McIoSaxNbtCompoundPlaceIgnored(ignoredTag, 
+					type, tagLength, nameBuffer, listStream);
+				continue;
+			}
+		}
+		
+		// Process it directly, or spill the payload until it could be resolved.
+		if(McIoSaxActionAllMet(present, saxAction)) {
+			present[entry] = true; ++ numPresents;
+			assert(saxAction.tagPresent != nullptr);
+			saxAction.tagPresent(inputStream, data, ud);
+		}
+		else {
+			McIoSaxTagSpillItem item;
+			item.action = entry;
+			inputStream.spillTo(&item.payload);
+			if(saxAction.expectedType > 12) 
+				McIoSkipNbtListBody(inputStream, componentType);
+			else McIoSkipNbtElement(inputStream, type);
+			inputStream.spillTo(nullptr);
+			spills.push_back(std::move(item));
+		}
+	}
+	
+	// Resolve the spilled entries, at most N passes for N entries.
+	size_t maxPass = spills.size();
+	for(size_t pass = 0; pass < maxPass && !spills.empty(); ++ pass) {
+		for(auto iter = spills.begin(); iter != spills.end(); ) {
+			const McIoNbtCompoundSaxAction& saxAction = saxActions[iter -> action];
+			if(McIoSaxActionAllMet(present, saxAction)) {
+				McIoBufferInputStream payloadStream(
+					iter -> payload.data(), iter -> payload.size());
+				assert(saxAction.tagPresent != nullptr);
+				saxAction.tagPresent(payloadStream, data, ud);
+				present[iter -> action] = true; ++ numPresents;
+				iter = spills.erase(iter);
+			}
+			else ++ iter;
+		}
+	}
+	
+	// Invoke the cannot resolve methods for those who fails to resolve.
+	for(auto iter = spills.begin(); iter != spills.end(); ++ iter) {
+		if(saxActions[iter -> action].tagFailedResolve != nullptr) {
+			McIoBufferInputStream payloadStream(
+				iter -> payload.data(), iter -> payload.size());
+			saxActions[iter -> action].tagFailedResolve(payloadStream, data, ud);
+			present[iter -> action] = true; ++ numPresents;
+		}
 	}
 	
 	// Invoke those who have their not present method registered.
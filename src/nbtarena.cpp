@@ -0,0 +1,75 @@
+/**
+ * @file nbtarena.cpp
+ * @brief Implementation for nbtarena.hpp.
+ * @author Haoran Luo
+ *
+ * For interface specification, please refer to the corresponding header.
+ * @see libminecraft/nbtarena.hpp
+ */
+#include "libminecraft/nbtarena.hpp"
+
+/// The size reserved for the chunk header, keeping the maximum alignment.
+static const size_t chunkHeaderSize = (sizeof(void*) + sizeof(size_t)
+	+ alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+// Implementation for McDtNbtArena::McDtNbtArena().
+McDtNbtArena::McDtNbtArena(size_t chunkSize) noexcept: chunks(nullptr),
+	current(nullptr), limit(nullptr), chunkSize(chunkSize), allocatedSize(0) {}
+
+// Implementation for McDtNbtArena::~McDtNbtArena().
+McDtNbtArena::~McDtNbtArena() noexcept {
+	while(chunks != nullptr) {
+		McDtNbtArenaChunk* chunk = chunks;
+		chunks = chunk -> next;
+		delete[] reinterpret_cast<char*>(chunk);
+	}
+}
+
+// Implementation for McDtNbtArena::allocateSlow().
+void* McDtNbtArena::allocateSlow(size_t size, size_t alignment) {
+	// The oversized allocations get a dedicated chunk.
+	size_t newChunkSize = chunkSize;
+	if(chunkHeaderSize + size + alignment > chunkSize)
+		newChunkSize = chunkHeaderSize + size + alignment;
+
+	McDtNbtArenaChunk* chunk = reinterpret_cast<McDtNbtArenaChunk*>(new char[newChunkSize]);
+	chunk -> size = newChunkSize;
+	char* chunkBegin = reinterpret_cast<char*>(chunk) + chunkHeaderSize;
+	char* chunkEnd = reinterpret_cast<char*>(chunk) + newChunkSize;
+
+	// Keep the free range of current chunk if the new chunk is dedicated.
+	if(chunks != nullptr && newChunkSize != chunkSize) {
+		chunk -> next = chunks -> next;
+		chunks -> next = chunk;
+		size_t offset = (alignment - ((size_t)chunkBegin & (alignment - 1))) & (alignment - 1);
+		allocatedSize += size;
+		return chunkBegin + offset;
+	}
+
+	chunk -> next = chunks;
+	chunks = chunk;
+	current = chunkBegin;
+	limit = chunkEnd;
+	return allocate(size, alignment);
+}
+
+// Implementation for McDtNbtArena::reset().
+void McDtNbtArena::reset() noexcept {
+	// Keep the newest chunk of the standard size, free the others.
+	McDtNbtArenaChunk* kept = nullptr;
+	while(chunks != nullptr) {
+		McDtNbtArenaChunk* chunk = chunks;
+		chunks = chunk -> next;
+		if(kept == nullptr && chunk -> size == chunkSize) kept = chunk;
+		else delete[] reinterpret_cast<char*>(chunk);
+	}
+
+	chunks = kept;
+	if(kept != nullptr) {
+		kept -> next = nullptr;
+		current = reinterpret_cast<char*>(kept) + chunkHeaderSize;
+		limit = reinterpret_cast<char*>(kept) + chunkSize;
+	}
+	else current = limit = nullptr;
+	allocatedSize = 0;
+}
\ No newline at end of file
@@ -0,0 +1,431 @@
+/**
+ * @file nbtview.cpp
+ * @brief Implementation for the read-only nbt view.
+ * @author Haoran Luo
+ *
+ * For interface specification, please refer to the corresponding header.
+ * @see libminecraft/nbtview.hpp
+ */
+#include "libminecraft/nbtview.hpp"
+#include "libminecraft/bufstream.hpp"
+#include <vector>
+#include <stdexcept>
+#include <cstring>
+
+// The nbt tag types that are referred by the view.
+static const int8_t nbtTagEnd       = 0;
+static const int8_t nbtTagByte      = 1;
+static const int8_t nbtTagShort     = 2;
+static const int8_t nbtTagInt       = 3;
+static const int8_t nbtTagLong      = 4;
+static const int8_t nbtTagFloat     = 5;
+static const int8_t nbtTagDouble    = 6;
+static const int8_t nbtTagByteArray = 7;
+static const int8_t nbtTagString    = 8;
+static const int8_t nbtTagList      = 9;
+static const int8_t nbtTagCompound  = 10;
+static const int8_t nbtTagIntArray  = 11;
+static const int8_t nbtTagLongArray = 12;
+
+/// The maximum nesting depth of compounds and lists while scanning.
+static const size_t maxNbtViewDepth = 512;
+
+// The exception messages of the nbt view.
+static const char* malformedNbtView = "Malformed nbt data.";
+static const char* invalidNbtViewTagType = "Expected invalid nbt tag type.";
+static const char* mismatchNbtViewType = "The nbt tag is not of specified type.";
+
+/// The index of the tags inside a compound, or the elements inside a
+/// list of variable length elements, which is scanned as far as the
+/// accesses need, and shared by the views of the same payload.
+struct McDtNbtViewIndex {
+	/// The scanned tag or element, whose key is null for list elements.
+	struct McDtNbtViewEntry {
+		const char* key;
+		size_t keyLength;
+		int8_t tagType;
+		const char *begin, *end;
+
+		/// The index of the nested compound or list, whose end is null
+		/// until the nested index has been completely scanned.
+		std::shared_ptr<McDtNbtViewIndex> nested;
+	};
+
+	/// The nbt tag type, either compound or list.
+	int8_t tagType;
+
+	/// The element type and length of the list.
+	int8_t elementType;
+	size_t length;
+
+	/// The nesting depth of the compound or list.
+	size_t depth;
+
+	/// The bound of the enclosing buffer.
+	const char* bound;
+
+	/// Where the scanning resumes, after the last scanned entry.
+	const char* current;
+
+	/// The end of the payload, or null until completely scanned.
+	const char* end;
+
+	/// The entries scanned so far, in the order they are stored.
+	std::vector<McDtNbtViewEntry> entries;
+};
+
+// Ensure there're at least size bytes after the pointer.
+static inline void McDtNbtRequire(const char* pointer, const char* end, size_t size) {
+	if((size_t)(end - pointer) < size) throw std::runtime_error(malformedNbtView);
+}
+
+// Retrieve the size of the fixed length primitives, or 0 otherwise.
+static inline size_t McDtNbtFixedSize(int8_t tagType) {
+	static const size_t fixedSizes[] = { 0, 1, 2, 4, 8, 4, 8 };
+	return (tagType > nbtTagEnd && tagType <= nbtTagDouble)? fixedSizes[tagType] : 0;
+}
+
+// Retrieve the element type of the arrays, or nbtTagEnd otherwise.
+static inline int8_t McDtNbtArrayElementType(int8_t tagType) {
+	if(tagType == nbtTagByteArray) return nbtTagByte;
+	else if(tagType == nbtTagIntArray) return nbtTagInt;
+	else if(tagType == nbtTagLongArray) return nbtTagLong;
+	else return nbtTagEnd;
+}
+
+// Parse the (element type, length) header of the list.
+static inline std::tuple<int8_t, size_t> McDtNbtListHeader(
+		const char* begin, const char* end) {
+	McDtNbtRequire(begin, end, 5);
+	int8_t elementType = (int8_t)begin[0];
+	int32_t length = (int32_t)McIoLoadBigEndian<uint32_t>(begin + 1);
+	if(elementType < nbtTagEnd || elementType > nbtTagLongArray)
+		throw std::runtime_error(invalidNbtViewTagType);
+	else if(elementType == nbtTagEnd && length > 0)
+		throw std::runtime_error(invalidNbtViewTagType);
+	return std::make_tuple(elementType, length > 0? (size_t)length : (size_t)0);
+}
+
+// Parse the length of the array, ensuring the elements are inside buffer.
+static inline size_t McDtNbtArrayLength(int8_t tagType,
+		const char* begin, const char* end) {
+	McDtNbtRequire(begin, end, 4);
+	int32_t length = (int32_t)McIoLoadBigEndian<uint32_t>(begin);
+	if(length < 0) throw std::runtime_error("The array length has negative length.");
+	size_t elementSize = McDtNbtFixedSize(McDtNbtArrayElementType(tagType));
+	if((size_t)(end - begin - 4) / elementSize < (size_t)length)
+		throw std::runtime_error(malformedNbtView);
+	return (size_t)length;
+}
+
+// Retrieve the end of the payload of given type, or null for compounds and
+// lists of variable length elements, which must be scanned by an index.
+static const char* McDtNbtPayloadEnd(int8_t tagType,
+		const char* begin, const char* end) {
+
+	// The fixed length primitives.
+	size_t fixedSize = McDtNbtFixedSize(tagType);
+	if(fixedSize > 0) {
+		McDtNbtRequire(begin, end, fixedSize);
+		return begin + fixedSize;
+	}
+
+	switch(tagType) {
+		case nbtTagByteArray:
+		case nbtTagIntArray:
+		case nbtTagLongArray: {
+			size_t length = McDtNbtArrayLength(tagType, begin, end);
+			return begin + 4 + length *
+				McDtNbtFixedSize(McDtNbtArrayElementType(tagType));
+		}
+
+		case nbtTagString: {
+			McDtNbtRequire(begin, end, 2);
+			size_t length = McIoLoadBigEndian<uint16_t>(begin);
+			McDtNbtRequire(begin + 2, end, length);
+			return begin + 2 + length;
+		}
+
+		case nbtTagList: {
+			int8_t elementType; size_t length;
+			std::tie(elementType, length) = McDtNbtListHeader(begin, end);
+			const char* elements = begin + 5;
+
+			// Only the fixed length elements could be located at once.
+			size_t elementSize = McDtNbtFixedSize(elementType);
+			if(elementSize == 0) return length > 0? nullptr : elements;
+			if((size_t)(end - elements) / elementSize < length)
+				throw std::runtime_error(malformedNbtView);
+			return elements + length * elementSize;
+		}
+
+		case nbtTagCompound: return nullptr;
+
+		default: throw std::runtime_error(invalidNbtViewTagType);
+	}
+}
+
+// Create the index of the compound or list whose end is unknown.
+static std::shared_ptr<McDtNbtViewIndex> McDtNbtCreateIndex(int8_t tagType,
+		const char* begin, const char* end, size_t depth) {
+
+	if(depth > maxNbtViewDepth) throw std::runtime_error(
+		"The nbt data is nested too deep.");
+
+	std::shared_ptr<McDtNbtViewIndex> index(new McDtNbtViewIndex);
+	index -> tagType = tagType;
+	index -> elementType = nbtTagEnd;
+	index -> length = 0;
+	index -> depth = depth;
+	index -> bound = end;
+	index -> current = begin;
+	index -> end = nullptr;
+	if(tagType == nbtTagList) {
+		std::tie(index -> elementType, index -> length) = McDtNbtListHeader(begin, end);
+		index -> current = begin + 5;
+	}
+	return index;
+}
+
+static const char* McDtNbtCompleteIndex(McDtNbtViewIndex& index);
+
+// Scan the next entry of the index, returning false when the index has
+// been completely scanned. A failed scan leaves no entry behind, so the
+// next access fails again at the same place.
+static bool McDtNbtScanIndex(McDtNbtViewIndex& index) {
+	if(index.end != nullptr) return false;
+
+	// The next entry begins after the end of the last nested entry.
+	if(!index.entries.empty() && index.entries.back().end == nullptr) {
+		McDtNbtViewIndex::McDtNbtViewEntry& last = index.entries.back();
+		last.end = McDtNbtCompleteIndex(*last.nested);
+		index.current = last.end;
+	}
+
+	const char* current = index.current;
+	McDtNbtViewIndex::McDtNbtViewEntry entry;
+	if(index.tagType == nbtTagCompound) {
+		McDtNbtRequire(current, index.bound, 1);
+		entry.tagType = (int8_t)*current; ++ current;
+		if(entry.tagType == nbtTagEnd) {
+			index.end = current;
+			return false;
+		}
+		else if(entry.tagType < nbtTagEnd || entry.tagType > nbtTagLongArray)
+			throw std::runtime_error(invalidNbtViewTagType);
+
+		// Locate the tag name.
+		entry.begin = McDtNbtPayloadEnd(nbtTagString, current, index.bound);
+		entry.keyLength = (size_t)(entry.begin - current - 2);
+		entry.key = current + 2;
+	}
+	else {
+		if(index.entries.size() == index.length) {
+			index.end = current;
+			return false;
+		}
+		entry.key = nullptr; entry.keyLength = 0;
+		entry.tagType = index.elementType;
+		entry.begin = current;
+	}
+
+	// Locate the payload, or create the nested index to scan on demand.
+	entry.end = McDtNbtPayloadEnd(entry.tagType, entry.begin, index.bound);
+	if(entry.end == nullptr) entry.nested = McDtNbtCreateIndex(
+		entry.tagType, entry.begin, index.bound, index.depth + 1);
+	index.entries.push_back(std::move(entry));
+	if(index.entries.back().end != nullptr)
+		index.current = index.entries.back().end;
+	return true;
+}
+
+// Scan the index completely, returning the end of the payload.
+static const char* McDtNbtCompleteIndex(McDtNbtViewIndex& index) {
+	while(McDtNbtScanIndex(index));
+	return index.end;
+}
+
+// Implementation for McDtNbtView::McDtNbtView().
+McDtNbtView::McDtNbtView() noexcept: tagType(nbtTagEnd),
+	payloadBegin(nullptr), payloadEnd(nullptr), index() {}
+
+McDtNbtView::McDtNbtView(int8_t tagType, const char* begin, const char* end,
+	std::shared_ptr<McDtNbtViewIndex> index) noexcept: tagType(tagType), 
+	payloadBegin(begin), payloadEnd(end), index(std::move(index)) {}
+
+// Implementation for McDtNbtView::fromRoot().
+McDtNbtView McDtNbtView::fromRoot(const char* buffer, size_t size) {
+	const char* end = buffer + size;
+	McDtNbtRequire(buffer, end, 1);
+	int8_t rootType = (int8_t)buffer[0];
+	if(rootType == nbtTagEnd) return McDtNbtView();
+	else if(rootType < nbtTagEnd || rootType > nbtTagLongArray)
+		throw std::runtime_error(invalidNbtViewTagType);
+
+	// Skip the name of the root tag.
+	const char* payload = McDtNbtPayloadEnd(nbtTagString, buffer + 1, end);
+	return fromPayload(rootType, payload, (size_t)(end - payload));
+}
+
+// Implementation for McDtNbtView::fromPayload().
+McDtNbtView McDtNbtView::fromPayload(int8_t tagType, const char* buffer, size_t size) {
+	if(tagType <= nbtTagEnd || tagType > nbtTagLongArray)
+		throw std::runtime_error(invalidNbtViewTagType);
+
+	// Only the payloads of known length are validated here, the compounds
+	// and lists are validated by their index while being scanned.
+	const char* end = McDtNbtPayloadEnd(tagType, buffer, buffer + size);
+	if(end != nullptr) return McDtNbtView(tagType, buffer, end, nullptr);
+	return McDtNbtView(tagType, buffer, buffer + size, 
+		McDtNbtCreateIndex(tagType, buffer, buffer + size, 0));
+}
+
+// Implementation for McDtNbtView::entryView().
+McDtNbtView McDtNbtView::entryView(size_t i) const {
+	const auto& entry = index -> entries[i];
+	return McDtNbtView(entry.tagType, entry.begin, 
+		entry.end != nullptr? entry.end : index -> bound, entry.nested);
+}
+
+// Implementation for McDtNbtView::scanned().
+bool McDtNbtView::scanned(size_t i) const {
+	while(index -> entries.size() <= i)
+		if(!McDtNbtScanIndex(*index)) return false;
+	return true;
+}
+
+// Implementation for McDtNbtView::ensureType().
+void McDtNbtView::ensureType(int8_t expectedType) const {
+	if(tagType != expectedType) throw std::runtime_error(mismatchNbtViewType);
+}
+
+// Implementation for McDtNbtView::rawPayload().
+std::tuple<size_t, const char*> McDtNbtView::rawPayload() const {
+	const char* end = index != nullptr? McDtNbtCompleteIndex(*index) : payloadEnd;
+	return std::make_tuple((size_t)(end - payloadBegin), payloadBegin);
+}
+
+// Implementation for McDtNbtView::size().
+size_t McDtNbtView::size() const {
+	if(tagType == nbtTagCompound) {
+		McDtNbtCompleteIndex(*index);
+		return index -> entries.size();
+	}
+	else if(tagType == nbtTagList)
+		return std::get<1>(McDtNbtListHeader(payloadBegin, payloadEnd));
+	else if(McDtNbtArrayElementType(tagType) != nbtTagEnd)
+		return McDtNbtArrayLength(tagType, payloadBegin, payloadEnd);
+	else return 0;
+}
+
+// Implementation for McDtNbtView::elementType().
+int8_t McDtNbtView::elementType() const {
+	if(tagType == nbtTagList)
+		return std::get<0>(McDtNbtListHeader(payloadBegin, payloadEnd));
+	int8_t arrayElementType = McDtNbtArrayElementType(tagType);
+	if(arrayElementType == nbtTagEnd) throw std::runtime_error(mismatchNbtViewType);
+	return arrayElementType;
+}
+
+// Implementation for McDtNbtView::find().
+McDtNbtView McDtNbtView::find(const char* key, size_t keyLength) const {
+	ensureType(nbtTagCompound);
+
+	// Look up the scanned tags first, then scan for the rest.
+	for(size_t i = 0; scanned(i); ++ i) {
+		const auto& entry = index -> entries[i];
+		if(entry.keyLength == keyLength && memcmp(entry.key, key, keyLength) == 0)
+			return entryView(i);
+	}
+	return McDtNbtView();
+}
+
+// Implementation for McDtNbtView::keyAt().
+std::tuple<size_t, const char*> McDtNbtView::keyAt(size_t i) const {
+	ensureType(nbtTagCompound);
+	if(!scanned(i)) throw std::runtime_error("The nbt tag index is out of range.");
+	return std::make_tuple(index -> entries[i].keyLength, index -> entries[i].key);
+}
+
+// Implementation for McDtNbtView::valueAt().
+McDtNbtView McDtNbtView::valueAt(size_t i) const {
+	// The tags and elements of variable length are scanned by the index.
+	if(index != nullptr) {
+		if(!scanned(i)) throw std::runtime_error("The nbt tag index is out of range.");
+		return entryView(i);
+	}
+
+	// The elements of fixed length are directly located.
+	if(i >= size()) throw std::runtime_error("The nbt tag index is out of range.");
+	int8_t fixedType = elementType();
+	const char* elements = payloadBegin + (tagType == nbtTagList? 5 : 4);
+	size_t fixedSize = McDtNbtFixedSize(fixedType);
+	return McDtNbtView(fixedType, elements + i * fixedSize, 
+		elements + (i + 1) * fixedSize, nullptr);
+}
+
+// Implementation for the primitive accessors.
+int8_t McDtNbtView::asByte() const {
+	ensureType(nbtTagByte);
+	return (int8_t)payloadBegin[0];
+}
+
+int16_t McDtNbtView::asShort() const {
+	ensureType(nbtTagShort);
+	return (int16_t)McIoLoadBigEndian<uint16_t>(payloadBegin);
+}
+
+int32_t McDtNbtView::asInt() const {
+	ensureType(nbtTagInt);
+	return (int32_t)McIoLoadBigEndian<uint32_t>(payloadBegin);
+}
+
+int64_t McDtNbtView::asLong() const {
+	ensureType(nbtTagLong);
+	return (int64_t)McIoLoadBigEndian<uint64_t>(payloadBegin);
+}
+
+float McDtNbtView::asFloat() const {
+	ensureType(nbtTagFloat);
+	uint32_t value = McIoLoadBigEndian<uint32_t>(payloadBegin);
+	float result; memcpy(&result, &value, sizeof(result));
+	return result;
+}
+
+double McDtNbtView::asDouble() const {
+	ensureType(nbtTagDouble);
+	uint64_t value = McIoLoadBigEndian<uint64_t>(payloadBegin);
+	double result; memcpy(&result, &value, sizeof(result));
+	return result;
+}
+
+// Implementation for McDtNbtView::asRawString().
+std::tuple<size_t, const char*> McDtNbtView::asRawString() const {
+	ensureType(nbtTagString);
+	return std::make_tuple((size_t)McIoLoadBigEndian<uint16_t>(payloadBegin),
+		payloadBegin + 2);
+}
+
+// Implementation for McDtNbtView::asString().
+std::u16string McDtNbtView::asString() const {
+	size_t length; const char* data;
+	std::tie(length, data) = asRawString();
+
+	std::u16string result;
+	McIoBufferInputStream inputStream(data, length);
+	McIoReadUtf16String(inputStream, length, result);
+	return result;
+}
+
+// Implementation for McDtNbtView::materialize().
+void McDtNbtView::materialize(mc::nbtcompound& compound) const {
+	ensureType(nbtTagCompound);
+	McIoBufferInputStream inputStream(payloadBegin, (size_t)(payloadEnd - payloadBegin));
+	McIoReadNbtCompound(inputStream, compound);
+}
+
+void McDtNbtView::materialize(mc::nbtlist& list) const {
+	ensureType(nbtTagList);
+	McIoBufferInputStream inputStream(payloadBegin, (size_t)(payloadEnd - payloadBegin));
+	McIoReadNbtList(inputStream, list);
+}
\ No newline at end of file
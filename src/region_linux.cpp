@@ -0,0 +1,359 @@
+/**
+ * @file region_linux.cpp
+ * @brief Implementation for region.hpp under linux platform.
+ * @author Haoran Luo
+ *
+ * For interface specification, please refer to the corresponding header. The region
+ * file is mapped by mmap(), and the chunk packet cache is stored in the memfd.
+ *
+ * @see libminecraft/region.hpp
+ */
+#include "libminecraft/region.hpp"
+#include "libminecraft/bufstream.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <zlib.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The error messages of the region file.
+static const char* malformedRegion = "The region file is malformed.";
+static const char* malformedChunk = "The chunk in the region file is malformed.";
+
+/// Decode the big endian unsigned integer of the bytes.
+static inline uint32_t McIoRegionLoad(const char* bytes, size_t size) {
+	uint32_t value = 0;
+	for(size_t i = 0; i < size; ++ i) value = (value << 8) | (unsigned char)bytes[i];
+	return value;
+}
+
+// Definition of the inflated size limit, as it is bound to references.
+const size_t McIoRegionFile::maxInflatedSize;
+
+// Implementation for McIoRegionFile::McIoRegionFile().
+McIoRegionFile::McIoRegionFile(const char* path): fd(-1), mapped(nullptr), mappedSize(0) {
+	memset(entries, 0, sizeof(entries));
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd < 0) throw std::runtime_error(std::string("Cannot open the region file ") + path + ".");
+
+	// Map the file, while the empty file is considered to be an empty region.
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) < 0) {
+		close(fd);
+		throw std::runtime_error("Cannot retrieve the size of the region file.");
+	}
+	mappedSize = (size_t)fileStat.st_size;
+	if(mappedSize == 0) return;
+	if(mappedSize < 2 * sectorSize) {
+		close(fd);
+		throw std::runtime_error(malformedRegion);
+	}
+	void* address = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+	if(address == MAP_FAILED) {
+		close(fd);
+		throw std::runtime_error("Cannot map the region file.");
+	}
+	mapped = (const char*)address;
+
+	// Parse the locations and timestamps into the chunk index.
+	for(size_t i = 0; i < regionWidth * regionWidth; ++ i) {
+		uint32_t location = McIoRegionLoad(mapped + 4 * i, 4);
+		entries[i].sectorOffset = location >> 8;
+		entries[i].sectorCount = location & 0x0ff;
+		entries[i].timestamp = McIoRegionLoad(mapped + sectorSize + 4 * i, 4);
+
+		// The chunk outside the file or inside the header is treated as absent.
+		if(entries[i].sectorOffset < 2 || entries[i].sectorCount == 0 ||
+			((size_t)entries[i].sectorOffset + entries[i].sectorCount)
+				* sectorSize > mappedSize + sectorSize - 1)
+			entries[i].sectorOffset = entries[i].sectorCount = 0;
+	}
+}
+
+// Implementation for McIoRegionFile::~McIoRegionFile().
+McIoRegionFile::~McIoRegionFile() noexcept {
+	if(mapped != nullptr) munmap((void*)mapped, mappedSize);
+	if(fd >= 0) close(fd);
+}
+
+// Implementation for McIoRegionFile::entry().
+const McIoRegionFile::McIoRegionChunkEntry& McIoRegionFile::entry(int x, int z) const {
+	if(x < 0 || z < 0 || (size_t)x >= regionWidth || (size_t)z >= regionWidth)
+		throw std::runtime_error("The chunk is outside the region.");
+	return entries[(size_t)z * regionWidth + (size_t)x];
+}
+
+// Implementation for McIoRegionFile::hasChunk().
+bool McIoRegionFile::hasChunk(int x, int z) const {
+	return entry(x, z).sectorOffset != 0;
+}
+
+// Implementation for McIoRegionFile::timestamp().
+uint32_t McIoRegionFile::timestamp(int x, int z) const {
+	return entry(x, z).timestamp;
+}
+
+// Implementation for McIoRegionFile::rawChunk().
+std::tuple<McIoRegionCompression, size_t, const char*>
+McIoRegionFile::rawChunk(int x, int z) const {
+	const McIoRegionChunkEntry& chunk = entry(x, z);
+	if(chunk.sectorOffset == 0) throw std::runtime_error("The chunk is absent.");
+
+	// Parse and validate the chunk header.
+	size_t begin = (size_t)chunk.sectorOffset * sectorSize;
+	size_t limit = std::min(mappedSize, begin + (size_t)chunk.sectorCount * sectorSize);
+	if(begin + 5 > limit) throw std::runtime_error(malformedChunk);
+	size_t length = McIoRegionLoad(mapped + begin, 4);
+	if(length == 0 || begin + 4 + length > limit) throw std::runtime_error(malformedChunk);
+	int compression = (unsigned char)mapped[begin + 4];
+	if(compression < rcGzip || compression > rcNone) throw std::runtime_error(
+		"The chunk compression is not supported.");
+	return std::make_tuple((McIoRegionCompression)compression, length - 1, mapped + begin + 5);
+}
+
+/**
+ * The input stream inflating the gzip or zlib data, whose window is the
+ * inflated chunk of data, so the primitives are decoded inline.
+ */
+class McIoInflateInputStream : public McIoInputStream {
+	/// The zlib stream inflating the data.
+	z_stream inflater;
+
+	/// The inflated chunk of data.
+	char inflated[16384];
+
+	/// Inflate into the buffer, returning the number of bytes inflated.
+	size_t inflate(char* buffer, size_t size) {
+		inflater.next_out = (Bytef*)buffer;
+		inflater.avail_out = (uInt)size;
+		while(inflater.avail_out > 0) {
+			uInt before = inflater.avail_out;
+			int status = ::inflate(&inflater, Z_NO_FLUSH);
+			if(inflater.total_out > McIoRegionFile::maxInflatedSize)
+				throw std::runtime_error(malformedChunk);
+			if(status == Z_STREAM_END) break;
+			if(status != Z_OK || before == inflater.avail_out)
+				throw std::runtime_error(malformedChunk);
+		}
+		return size - inflater.avail_out;
+	}
+
+	/// Receive the data that is not in the window.
+	void receive(char* buffer, size_t size) {
+		// Take the remaining window first.
+		size_t windowed = std::min(size, windowSize());
+		if(windowed > 0) {
+			memcpy(buffer, windowBegin, windowed);
+			windowBegin += windowed;
+			buffer += windowed; size -= windowed;
+		}
+
+		// Inflate the large data directly, or refill the window otherwise.
+		if(size >= sizeof(inflated)) {
+			if(inflate(buffer, size) != size)
+				throw std::runtime_error(malformedChunk);
+		}
+		else if(size > 0) {
+			size_t refilled = inflate(inflated, sizeof(inflated));
+			if(refilled < size) throw std::runtime_error(malformedChunk);
+			memcpy(buffer, inflated, size);
+			windowBegin = inflated + size;
+			windowEnd = inflated + refilled;
+		}
+	}
+public:
+	McIoInflateInputStream(const char* data, size_t size) {
+		memset(&inflater, 0, sizeof(inflater));
+		if(inflateInit2(&inflater, 15 + 32) != Z_OK)
+			throw std::runtime_error("Cannot initialize chunk inflater.");
+		inflater.next_in = (Bytef*)data;
+		inflater.avail_in = (uInt)size;
+	}
+
+	~McIoInflateInputStream() noexcept { inflateEnd(&inflater); }
+
+	virtual void read(char* buffer, size_t receiveLength) override {
+		receive(buffer, receiveLength);
+	}
+
+	virtual void skip(size_t skipLength) override {
+		char skipBuffer[4096];
+		while(skipLength > 0) {
+			size_t current = std::min(skipLength, sizeof(skipBuffer));
+			receive(skipBuffer, current);
+			skipLength -= current;
+		}
+	}
+};
+
+// Implementation for McIoRegionFile::inflateChunk().
+void McIoRegionFile::inflateChunk(int x, int z, std::vector<char>& buffer) const {
+	McIoRegionCompression compression; size_t size; const char* data;
+	std::tie(compression, size, data) = rawChunk(x, z);
+	if(compression == rcNone) { buffer.assign(data, data + size); return; }
+
+	// Inflate the chunk, growing the buffer geometrically up to the maximum.
+	z_stream inflater;
+	memset(&inflater, 0, sizeof(inflater));
+	if(inflateInit2(&inflater, 15 + 32) != Z_OK)
+		throw std::runtime_error("Cannot initialize chunk inflater.");
+	inflater.next_in = (Bytef*)data;
+	inflater.avail_in = (uInt)size;
+	buffer.resize(std::min(std::max(size * 4, (size_t)sectorSize), maxInflatedSize));
+	size_t inflated = 0;
+	while(true) {
+		if(inflated == buffer.size()) {
+			if(buffer.size() == maxInflatedSize) {
+				inflateEnd(&inflater);
+				throw std::runtime_error(malformedChunk);
+			}
+			buffer.resize(std::min(buffer.size() * 2, maxInflatedSize));
+		}
+		inflater.next_out = (Bytef*)(buffer.data() + inflated);
+		inflater.avail_out = (uInt)(buffer.size() - inflated);
+		int status = ::inflate(&inflater, Z_NO_FLUSH);
+		inflated = buffer.size() - inflater.avail_out;
+		if(status == Z_STREAM_END) break;
+		if(status != Z_OK && !(status == Z_BUF_ERROR && inflater.avail_out == 0)) {
+			inflateEnd(&inflater);
+			throw std::runtime_error(malformedChunk);
+		}
+	}
+	inflateEnd(&inflater);
+	buffer.resize(inflated);
+}
+
+// Implementation for McIoRegionFile::viewChunk().
+McDtNbtView McIoRegionFile::viewChunk(int x, int z, std::vector<char>& buffer) const {
+	inflateChunk(x, z, buffer);
+	return McDtNbtView::fromRoot(buffer.data(), buffer.size());
+}
+
+// Read the root compound's tag type and name of the chunk.
+static void McIoRegionReadRoot(McIoInputStream& inputStream) {
+	mc::s8 tagType; inputStream >> tagType;
+	if((int8_t)tagType != 10) throw std::runtime_error(malformedChunk);
+	mc::u16 nameLength; inputStream >> nameLength;
+	if(nameLength > 0) inputStream.skip(nameLength);
+}
+
+// Implementation for McIoRegionFile::saxChunk().
+void McIoRegionFile::saxChunk(int x, int z, void* data, void* ud,
+	int (*dictionary)(size_t tagLength, const char* tagName),
+	size_t numSaxActions, const McIoNbtCompoundSaxAction* const saxActions,
+	McDtNbtCompound* ignoredTag) const {
+
+	McIoRegionCompression compression; size_t size; const char* chunkData;
+	std::tie(compression, size, chunkData) = rawChunk(x, z);
+	if(compression == rcNone) {
+		// The uncompressed chunk is inside the mapped file.
+		McIoBufferInputStream inputStream(chunkData, size);
+		McIoRegionReadRoot(inputStream);
+		McIoSaxNbtCompound(inputStream, data, ud, dictionary,
+			numSaxActions, saxActions, ignoredTag);
+	}
+	else {
+		// Read the compressed chunk while inflating.
+		McIoInflateInputStream inputStream(chunkData, size);
+		McIoRegionReadRoot(inputStream);
+		McIoSaxNbtCompound(inputStream, data, ud, dictionary,
+			numSaxActions, saxActions, ignoredTag);
+	}
+}
+
+/// The cache file shared with the queued sendfile() nodes.
+struct McIoChunkPacketCache::McIoChunkPacketFile {
+	/// The descriptor of the cache file.
+	const int fd;
+
+	McIoChunkPacketFile(int fd): fd(fd) {}
+	~McIoChunkPacketFile() noexcept { close(fd); }
+};
+
+// Create the cache file, or the anonymous memory file when the path is empty.
+// The file in the path is unlinked rather than truncated, as its previous
+// content might still be sent.
+static int McIoChunkPacketCreate(const std::string& path) /*mayThrow*/ {
+	int fd;
+	if(!path.empty()) {
+		unlink(path.c_str());
+		fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	}
+	else {
+#ifdef MFD_CLOEXEC
+		fd = memfd_create("libminecraft-chunk-cache", MFD_CLOEXEC);
+#else
+		char pathTemplate[] = "/tmp/libminecraft-chunk-cache-XXXXXX";
+		fd = mkstemp(pathTemplate);
+		if(fd >= 0) unlink(pathTemplate);
+#endif
+	}
+	if(fd < 0) throw std::runtime_error("Cannot create the chunk packet cache.");
+	return fd;
+}
+
+// Implementation for McIoChunkPacketCache::McIoChunkPacketCache().
+McIoChunkPacketCache::McIoChunkPacketCache(const char* path):
+	path(path != nullptr? path : ""), file(), fileEnd(0), index() {
+	file = std::make_shared<McIoChunkPacketFile>(McIoChunkPacketCreate(this -> path));
+}
+
+// Implementation for McIoChunkPacketCache::~McIoChunkPacketCache().
+McIoChunkPacketCache::~McIoChunkPacketCache() noexcept {}
+
+// Implementation for McIoChunkPacketCache::store().
+void McIoChunkPacketCache::store(uint64_t key, const char* framed, size_t size) {
+	size_t written = 0;
+	while(written < size) {
+		ssize_t result = pwrite(file -> fd, framed + written, size - written, fileEnd + written);
+		if(result < 0 && errno == EINTR) continue;
+		if(result <= 0) throw std::runtime_error(
+			"Cannot write the packet into the chunk packet cache.");
+		written += (size_t)result;
+	}
+	index[key] = std::make_pair(fileEnd, size);
+	fileEnd += size;
+}
+
+// Implementation for McIoChunkPacketCache::send().
+bool McIoChunkPacketCache::send(McIoWritable& writable, uint64_t key) const {
+	auto iter = index.find(key);
+	if(iter == index.end()) return false;
+	size_t offset = iter -> second.first, size = iter -> second.second;
+	if(!writable.isWriteEncrypted()) {
+		writable.sendfile(file -> fd, (ssize_t)offset, size, file);
+		return true;
+	}
+
+	// The file sent by the kernel is not encrypted, so the packet is read
+	// into the buffer shared on the thread and written through the cipher.
+	static thread_local std::vector<char> packetBuffer;
+	if(packetBuffer.size() < size) packetBuffer.resize(size);
+	size_t numRead = 0;
+	while(numRead < size) {
+		ssize_t result = pread(file -> fd, packetBuffer.data() + numRead,
+			size - numRead, offset + numRead);
+		if(result < 0 && errno == EINTR) continue;
+		if(result <= 0) throw std::runtime_error(
+			"Cannot read the packet from the chunk packet cache.");
+		numRead += (size_t)result;
+	}
+	writable.write(packetBuffer.data(), size);
+	return true;
+}
+
+// Implementation for McIoChunkPacketCache::clear().
+void McIoChunkPacketCache::clear() {
+	// The file still referred to by the queued sends is left to them.
+	if(file.use_count() > 1) file = std::make_shared<McIoChunkPacketFile>(
+		McIoChunkPacketCreate(path));
+	else if(ftruncate(file -> fd, 0) < 0) throw std::runtime_error(
+		"Cannot reclaim the chunk packet cache.");
+	index.clear();
+	fileEnd = 0;
+}
\ No newline at end of file
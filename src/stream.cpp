@@ -15,25 +15,23 @@
 void McIoBufferInputStream::read(char* outBuffer, size_t receiveLength) {
 	/// Make sure that enough data can be read from the buffer.
 	if(receiveLength == 0) return;
-	if(receiveLength > size) throw std::runtime_error(
+	if(receiveLength > windowSize()) throw std::runtime_error(
 			"Requested data has exceeded the available data.");
 	
 	// Perform reading and advance status.
-	memcpy(outBuffer, buffer, receiveLength);
-	buffer += receiveLength;
-	size -= receiveLength;
+	memcpy(outBuffer, windowBegin, receiveLength);
+	windowBegin += receiveLength;
 }
 
 /// Implementation for the McIoBufferInputStream::skip().
 void McIoBufferInputStream::skip(size_t skipLength) {
 	/// Make sure that enough data can be skipped from the buffer.
 	if(skipLength == 0) return;
-	if(skipLength > size) throw std::runtime_error(
+	if(skipLength > windowSize()) throw std::runtime_error(
 			"Requested data has exceeded the available data.");
 	
 	// Perform skipping and advance status.
-	buffer += skipLength;
-	size -= skipLength;
+	windowBegin += skipLength;
 }
 
 /// Implementation for the McIoInputStream::mark().
@@ -43,25 +41,23 @@ std::unique_ptr<McIoStreamMark> McIoBufferInputStream::mark() {
 		// The reference to the stream.
 		McIoBufferInputStream& stream;
 		
-		// Captured state of the stream marking.
-		size_t size;
+		// Captured state of the stream marking, as the window end 
+		// never changes, only the window beginning is captured.
 		const char* buffer;
 		
 		// The constructor and destructor.
 		McIoBufferStreamMark(McIoBufferInputStream& stream, 
-			size_t size, const char* buffer):
-			stream(stream), size(size), buffer(buffer) {}
+			const char* buffer): stream(stream), buffer(buffer) {}
 		~McIoBufferStreamMark() {}
 		
 		// The reset marking method.
 		virtual void reset() override {
-			stream.size = size;
-			stream.buffer = buffer;
+			stream.windowBegin = buffer;
 		}
 	};
 	
 	return std::unique_ptr<McIoStreamMark>(
-			new McIoBufferStreamMark(*this, size, buffer));
+			new McIoBufferStreamMark(*this, windowBegin));
 }
 
 /// The max allowed size of variant integer, which is 32-bit integer with most 
@@ -77,8 +73,22 @@ void McIoBufferOutputStream::write(const char* inBuffer, size_t sendLength) {
 	size_t newSize = originSize + sendLength;
 	if((unsigned long)newSize > maxVarintValue) 
 		throw std::runtime_error("The data to send is too large.");
-	buffer.resize(originSize + sendLength);
-	memcpy(buffer.data() + originSize, inBuffer, sendLength);
+	buffer.insert(buffer.end(), inBuffer, inBuffer + sendLength);
+}
+
+/// Implementation for the McIoBufferOutputStream::releaseLengthPrefixedData().
+std::tuple<std::shared_ptr<char>, size_t, size_t> 
+McIoBufferOutputStream::releaseLengthPrefixedData() {
+	size_t length; const char* data;
+	std::tie(length, data) = lengthPrefixedData();
+	size_t offset = data - buffer.data();
+	
+	// Move the buffer into the shared owner, which is aliased by the result.
+	std::shared_ptr<std::vector<char>> owner = 
+		std::make_shared<std::vector<char>>(std::move(buffer));
+	std::shared_ptr<char> result(owner, owner -> data());
+	buffer.clear(); buffer.resize(5);
+	return std::make_tuple(std::move(result), offset, length);
 }
 
 /// Implementation for the McIoBufferOutputStream::lengthPrefixedData().
@@ -0,0 +1,326 @@
+/**
+ * @file threadpool_linux.cpp
+ * @brief Implementation for threadpool.hpp.
+ * @author Haoran Luo
+ *
+ * For interface specification, please refer to the corresponding header.
+ * @see libminecraft/threadpool.hpp
+ */
+#include "libminecraft/threadpool.hpp"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <stdexcept>
+#include <cstdint>
+
+/// The finished task posted back to the completion queue.
+struct McIoCompletion {
+	std::unique_ptr<McOsFutureTask> task;
+	std::exception_ptr exception;
+	McIoCompletionQueue::completionHandlerType handler;
+};
+
+/// The state of the completion queue shared with the workers.
+struct McIoCompletionQueueState {
+	/// The mutex guarding the state.
+	std::mutex pendingMutex;
+
+	/// The eventfd of the completion queue, or -1 after it has been removed.
+	int notifyfd;
+
+	/// The completions posted but not yet handled.
+	std::vector<McIoCompletion> pending;
+
+	McIoCompletionQueueState(int notifyfd): pendingMutex(), notifyfd(notifyfd), pending() {}
+
+	/// Post the completion, the loop is only notified when there's no pending
+	/// completions before. The completion is dropped if the queue is removed.
+	void post(McIoCompletion&& completion) {
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		if(notifyfd < 0) return;
+		pending.push_back(std::move(completion));
+		if(pending.size() == 1) {
+			uint64_t counter = 1;
+			if(write(notifyfd, &counter, sizeof(counter)) != sizeof(counter))
+				throw std::runtime_error("Cannot notify the completion queue.");
+		}
+	}
+};
+
+// Os specific method for creating completion queue descriptor.
+static int McOsCreateCompletionDescriptor() /*mayThrow*/ {
+	int completionfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(completionfd < 0) throw std::runtime_error("Cannot create completion queue descriptor.");
+	return completionfd;
+}
+
+// Implementation for McIoCompletionQueue::McIoCompletionQueue().
+McIoCompletionQueue::McIoCompletionQueue():
+	McIoDescriptor(McOsCreateCompletionDescriptor(), McIoEvent::evIn),
+	state(new McIoCompletionQueueState(fd)) {}
+
+// Implementation for McIoCompletionQueue::~McIoCompletionQueue().
+McIoCompletionQueue::~McIoCompletionQueue() noexcept {
+	std::vector<McIoCompletion> dropped;
+	{
+		std::lock_guard<std::mutex> lock(state -> pendingMutex);
+		state -> notifyfd = -1;
+		dropped.swap(state -> pending);
+	}
+}
+
+// Implementation for McIoCompletionQueue::handle().
+McIoNextStatus McIoCompletionQueue::handle(McIoEvent& eventFlag) {
+	if((eventFlag & McIoEvent::evIn) != 0) {
+		// Reset the counter before taking the completions, so that the
+		// completions posted after taking will notify again.
+		McIoMultiplexerMetrics* loopMetrics = metrics();
+		uint64_t counter;
+		while(read(fd, &counter, sizeof(counter)) == sizeof(counter))
+			if(loopMetrics != nullptr) loopMetrics -> syscalls.add();
+		if(loopMetrics != nullptr) loopMetrics -> syscalls.add();
+
+		std::vector<McIoCompletion> completions;
+		{
+			std::lock_guard<std::mutex> lock(state -> pendingMutex);
+			completions.swap(state -> pending);
+		}
+		for(McIoCompletion& completion : completions) {
+			try {
+				if(completion.handler) completion.handler(completion.task, completion.exception);
+			} catch(...) {
+				// The handler failure is ignored, just like the loop tasks.
+			}
+		}
+	}
+	return McIoNextStatus::nstPoll;
+}
+
+/// The task queued in the pool.
+struct McOsThreadPoolJob {
+	std::unique_ptr<McOsFutureTask> task;
+	McOsFuturePriority priority;
+
+	/// The completion queue to post the task, or null if not submitted.
+	std::shared_ptr<McIoCompletionQueueState> completion;
+	McIoCompletionQueue::completionHandlerType handler;
+};
+
+/// The worker of the pool, which is never moved once created.
+struct McOsThreadPoolWorker {
+	/// The mutex guarding the jobs.
+	std::mutex jobsMutex;
+
+	/// The jobs of each priority class.
+	std::deque<McOsThreadPoolJob> jobs[fpNumPriorities];
+
+	/// The thread running the worker.
+	std::thread thread;
+
+	/// Queue the job at the back of its priority class.
+	void push(McOsThreadPoolJob&& job) {
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		jobs[job.priority].push_back(std::move(job));
+	}
+
+	/// Take the job of the highest priority, from the front by the owner, so
+	/// that the resumed jobs queued at the back take turns with the others of
+	/// the same priority, or from the back by the thieves.
+	bool take(McOsThreadPoolJob& job, bool stealing) {
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		for(std::deque<McOsThreadPoolJob>& queue : jobs) {
+			if(queue.empty()) continue;
+			if(stealing) {
+				job = std::move(queue.back());
+				queue.pop_back();
+			} else {
+				job = std::move(queue.front());
+				queue.pop_front();
+			}
+			return true;
+		}
+		return false;
+	}
+};
+
+// For worker identification in the pool control block.
+struct McOsThreadPoolControl;
+
+/// The pool and the index of the worker running on the current thread.
+static thread_local McOsThreadPoolControl* currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+/// The underlying data of the McOsThreadPoolExecutor.
+struct McOsThreadPoolControl {
+	/// The workers of the pool.
+	std::vector<std::unique_ptr<McOsThreadPoolWorker>> workers;
+
+	/// The worker to queue the next job enqueued outside the pool.
+	std::atomic<size_t> nextWorker;
+
+	/// The number of jobs queued but not taken, which is increased before
+	/// the job is queued.
+	std::atomic<size_t> numPending;
+
+	/// The number of workers that are about to sleep or sleeping.
+	std::atomic<size_t> numSleeping;
+
+	/// Whether the workers should keep running.
+	std::atomic<bool> running;
+
+	/// The condition where the sleeping workers wait.
+	std::mutex sleepMutex;
+	std::condition_variable wakeup;
+
+	/// The control block constructor.
+	McOsThreadPoolControl(): workers(), nextWorker(0), numPending(0),
+		numSleeping(0), running(true), sleepMutex(), wakeup() {}
+
+	/// Queue the job, to the current worker if it is enqueued by a worker.
+	void push(McOsThreadPoolJob&& job) {
+		size_t index = currentPool == this? currentWorker :
+			nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+		numPending.fetch_add(1);
+		workers[index] -> push(std::move(job));
+
+		// The sleeping worker must have seen the job, or would be seen here.
+		if(numSleeping.load() > 0) {
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			wakeup.notify_one();
+		}
+	}
+
+	/// Take the job from the worker's own queue, or steal from others.
+	bool take(size_t index, McOsThreadPoolJob& job) {
+		bool taken = workers[index] -> take(job, false);
+		for(size_t i = 1; !taken && i < workers.size(); ++ i)
+			taken = workers[(index + i) % workers.size()] -> take(job, true);
+		if(taken) numPending.fetch_sub(1);
+		return taken;
+	}
+
+	/// Advance the job, and queue it again if it has not finished, so that
+	/// the jobs of higher or the same priority and the thieves could cut in.
+	void execute(McOsThreadPoolJob& job) {
+		std::exception_ptr exception;
+		try {
+			if(job.task -> advance()) {
+				push(std::move(job));
+				return;
+			}
+		} catch(...) {
+			exception = std::current_exception();
+		}
+
+		// Post the finished task back, or destroy it here.
+		if(job.completion != nullptr) try {
+			McIoCompletion completion;
+			completion.task = std::move(job.task);
+			completion.exception = exception;
+			completion.handler = std::move(job.handler);
+			job.completion -> post(std::move(completion));
+		} catch(...) {
+			// The completion that cannot be posted is destroyed.
+		}
+		job = McOsThreadPoolJob();
+	}
+
+	/// The procedure of the worker threads.
+	void run(size_t index) {
+		currentPool = this;
+		currentWorker = index;
+		McOsThreadPoolJob job;
+		while(running.load(std::memory_order_acquire)) {
+			if(take(index, job)) {
+				execute(job);
+				continue;
+			}
+
+			// Sleep until there's job to take, the number of sleeping workers
+			// is increased before checking the jobs, see push().
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			numSleeping.fetch_add(1);
+			wakeup.wait(lock, [this] { return numPending.load() > 0 ||
+				!running.load(std::memory_order_acquire); });
+			numSleeping.fetch_sub(1);
+		}
+	}
+
+	/// Stop and join the worker threads.
+	void stop() noexcept {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			running.store(false, std::memory_order_release);
+			wakeup.notify_all();
+		}
+		for(std::unique_ptr<McOsThreadPoolWorker>& worker : workers)
+			if(worker -> thread.joinable()) worker -> thread.join();
+	}
+};
+static_assert(sizeof(McOsThreadPoolControl) < McOsThreadPoolExecutor::poolControlBlockSize,
+		"Insufficient space for the pool control block.");
+
+// Implementation for McOsThreadPoolExecutor::McOsThreadPoolExecutor().
+McOsThreadPoolExecutor::McOsThreadPoolExecutor(size_t numThreads) {
+	McOsThreadPoolControl* controlBlock = new (control) McOsThreadPoolControl();
+	if(numThreads == 0) numThreads = std::thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 1;
+	try {
+		// All workers are created before running, as they steal from each other.
+		for(size_t i = 0; i < numThreads; ++ i) controlBlock -> workers.push_back(
+				std::unique_ptr<McOsThreadPoolWorker>(new McOsThreadPoolWorker()));
+		for(size_t i = 0; i < numThreads; ++ i) controlBlock -> workers[i] -> thread =
+				std::thread(&McOsThreadPoolControl::run, controlBlock, i);
+	} catch(...) {
+		controlBlock -> stop();
+		controlBlock -> ~McOsThreadPoolControl();
+		throw;
+	}
+}
+
+// Implementation for McOsThreadPoolExecutor::~McOsThreadPoolExecutor().
+McOsThreadPoolExecutor::~McOsThreadPoolExecutor() noexcept {
+	McOsThreadPoolControl* controlBlock = (McOsThreadPoolControl*)control;
+	controlBlock -> stop();
+	controlBlock -> ~McOsThreadPoolControl();
+}
+
+// Implementation for McOsThreadPoolExecutor::size().
+size_t McOsThreadPoolExecutor::size() const noexcept {
+	return ((const McOsThreadPoolControl*)control) -> workers.size();
+}
+
+// Implementation for McOsThreadPoolExecutor::enqueue().
+void McOsThreadPoolExecutor::enqueue(std::unique_ptr<McOsFutureTask>& task) {
+	enqueue(task, McOsFuturePriority::fpNormal);
+}
+
+// Implementation for McOsThreadPoolExecutor::enqueue() with priority.
+void McOsThreadPoolExecutor::enqueue(std::unique_ptr<McOsFutureTask>& task,
+		McOsFuturePriority priority) {
+	if((size_t)priority >= (size_t)fpNumPriorities)
+		throw std::runtime_error("Invalid future task priority.");
+	McOsThreadPoolJob job;
+	job.task = std::move(task);
+	job.priority = priority;
+	((McOsThreadPoolControl*)control) -> push(std::move(job));
+}
+
+// Implementation for McOsThreadPoolExecutor::submit().
+void McOsThreadPoolExecutor::submit(std::unique_ptr<McOsFutureTask>& task,
+		McIoCompletionQueue& completion, McIoCompletionQueue::completionHandlerType handler,
+		McOsFuturePriority priority) {
+	if((size_t)priority >= (size_t)fpNumPriorities)
+		throw std::runtime_error("Invalid future task priority.");
+	McOsThreadPoolJob job;
+	job.task = std::move(task);
+	job.priority = priority;
+	job.completion = completion.state;
+	job.handler = std::move(handler);
+	((McOsThreadPoolControl*)control) -> push(std::move(job));
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+/**
+ * @file timerwheel.hpp
+ * @brief Hierarchical timer wheel of the multiplexers.
+ * @author Haoran Luo
+ *
+ * The wheel counts the ticks of the multiplexer, and holds the timeouts of
+ * the descriptors in the slots of its levels. Each level has numSlots slots,
+ * where a slot of level L spans numSlots^L ticks. A timeout is placed at the
+ * highest level where its expiry differs from the current tick, so that it
+ * moves to a lower level (cascades) when the current tick enters its slot,
+ * and expires when it reaches the lowest level's slot.
+ *
+ * Both scheduling and cancelling are O(1), as the timeouts are chained by
+ * the intrusive lists of the nodes, and advancing a tick costs only the
+ * timeouts cascaded or expired in that tick.
+ *
+ * The node type must provide the timerPrevNext and timerNext list pointers,
+ * the timerExpiry field, and the moveTimerList() method, which moves the
+ * node into the specified list (or out of any list when nullptr).
+ */
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+template<typename Node>
+class McIoTimerWheel {
+public:
+	/// The number of bits of the slot index in each level.
+	static const size_t slotBits = 6;
+
+	/// The number of slots in each level.
+	static const size_t numSlots = (size_t)1 << slotBits;
+
+	/// The number of levels, which spans numSlots^numLevels ticks. The
+	/// timeouts beyond are parked in the top level and placed again.
+	static const size_t numLevels = 4;
+private:
+	/// The number of ticks that have elapsed.
+	uint64_t current;
+
+	/// The slots of all levels, the level L starting at L * numSlots.
+	std::vector<Node*> slots;
+
+	/// The timeouts that have expired but not yet been taken.
+	Node* expired;
+
+	/// Place the node by its expiry, relative to the current tick.
+	void place(Node* node) noexcept {
+		uint64_t expiry = node -> timerExpiry;
+		if(expiry <= current) {
+			node -> moveTimerList(&expired);
+			return;
+		}
+
+		// Find the highest level where the expiry differs from the current tick.
+		uint64_t difference = expiry ^ current;
+		size_t level = 0;
+		while(level + 1 < numLevels && (difference >> (slotBits * (level + 1))) != 0) ++ level;
+
+		// The timeout beyond the wheel is parked in the slot of top level
+		// which cascades next, so that it is placed again then.
+		size_t slot;
+		if((difference >> (slotBits * numLevels)) == 0)
+			slot = (size_t)(expiry >> (slotBits * level)) & (numSlots - 1);
+		else slot = (size_t)((current >> (slotBits * level)) + 1) & (numSlots - 1);
+		node -> moveTimerList(&slots[level * numSlots + slot]);
+	}
+public:
+	McIoTimerWheel(): current(0), slots(numLevels * numSlots, nullptr), expired(nullptr) {}
+
+	/// Retrieve the number of ticks that have elapsed.
+	uint64_t now() const noexcept { return current; }
+
+	/**
+	 * @brief Schedule the node to expire after certain number of ticks,
+	 * replacing its previous timeout.
+	 *
+	 * @param[in] node the node to schedule.
+	 * @param[in] ticks the number of ticks, where 0 is regarded as 1, as
+	 * the current tick has been advanced.
+	 */
+	void schedule(Node* node, uint64_t ticks) noexcept {
+		node -> timerExpiry = current + (ticks > 0? ticks : 1);
+		place(node);
+	}
+
+	/// Cancel the timeout of the node, which might not be scheduled.
+	static void cancel(Node* node) noexcept { node -> moveTimerList(nullptr); }
+
+	/// Advance the wheel by one tick, moving the timeouts expire at the
+	/// tick into the expired list.
+	void advance() noexcept {
+		++ current;
+
+		// Cascade the slots entered from the highest level.
+		size_t level = 0;
+		while(level + 1 < numLevels && (current &
+			(((uint64_t)1 << (slotBits * (level + 1))) - 1)) == 0) ++ level;
+		for(; level > 0; -- level) {
+			Node** slot = &slots[level * numSlots +
+				((size_t)(current >> (slotBits * level)) & (numSlots - 1))];
+			while(*slot != nullptr) place(*slot);
+		}
+
+		// Expire the slot of the lowest level.
+		Node** slot = &slots[(size_t)current & (numSlots - 1)];
+		while(*slot != nullptr) (*slot) -> moveTimerList(&expired);
+	}
+
+	/// Take one of the expired timeouts, or nullptr if there's none.
+	Node* takeExpired() noexcept {
+		Node* node = expired;
+		if(node != nullptr) node -> moveTimerList(nullptr);
+		return node;
+	}
+};
\ No newline at end of file
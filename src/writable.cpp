@@ -7,8 +7,16 @@
  * @see libminecraft/writable.hpp
  */
 #include "libminecraft/writable.hpp"
+#include "cipher.hpp"
 #include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <vector>
 #include <deque>
+#include <algorithm>
+#include <climits>
 #include <unistd.h>
 #include <cassert>
 #include <cstring>
@@ -53,7 +61,7 @@ struct McIoWritableWriteNode {
 	/// Perform write() on the specified file descriptor.
 	int write(int fd) {
 		int numWritten = ::write(fd, buffer.get() + offset, size);
-		assert(numWritten < size);
+		assert(numWritten <= (ssize_t)size);
 		if(numWritten > 0) {
 			offset += numWritten;
 			size -= numWritten;
@@ -75,12 +83,16 @@ struct McIoWritableSendfile64Node {
 	/// The offset and size monitored by this write node.
 	ssize_t offset; size_t size;
 	
+	/// The object keeping the file descriptor open, could be null.
+	std::shared_ptr<void> owner;
+	
 	/// Forward template definition.
 	static constexpr McIoWritableNodeType nodeType = wrnodeSendfile64;
 	
 	/// The constructor of sendfile64() node.
-	McIoWritableSendfile64Node(int sendfd, ssize_t offset, size_t size):
-		sendfd(sendfd), offset(offset), size(size) {}
+	McIoWritableSendfile64Node(int sendfd, ssize_t offset, size_t size,
+		const std::shared_ptr<void>& owner): sendfd(sendfd), 
+		offset(offset), size(size), owner(owner) {}
 	
 	/// Whether the transmission has completed.
 	bool empty() const { return size == 0; }
@@ -88,7 +100,7 @@ struct McIoWritableSendfile64Node {
 	/// Perform sendfile64() on the specified file descriptor.
 	int write(int fd) {
 		int numWritten = ::sendfile64(fd, sendfd, &offset, size);
-		assert(numWritten < size);
+		assert(numWritten <= (ssize_t)size);
 		if(numWritten > 0) size -= numWritten;	// Offset is updated by the call.
 		return numWritten;
 	}
@@ -121,9 +133,64 @@ struct McIoWritableControl {
 	/// Whether indicateClose() has been called.
 	bool closeIndicated;
 	
+	/// The current corking mode.
+	McIoCorkMode corkMode;
+	
+	/// The buffer to append data written under corked modes, will be null
+	/// when there's no data staged.
+	std::shared_ptr<std::vector<char>> staging;
+	
+	/// The last committed staging buffer, which will be reused once all the 
+	/// write() nodes referring to it have been written out.
+	std::shared_ptr<std::vector<char>> recycle;
+	
+	/// The statistics of the writable.
+	McIoWritable::McIoWritableStats stats;
+	
+	/// The watermarks of the queued size, disabled when the high is 0.
+	size_t lowWatermark, highWatermark;
+	
+	/// Whether the high watermark has been reached and the low has not.
+	bool aboveWatermark;
+	
+	/// The cipher to encrypt the data written, null if not encrypted.
+	McIoCipherControl* cipher;
+	
 	/// The control block constructor.
 	McIoWritableControl(McIoDescriptor* decorated): writeQueue(), queue(), 
-		decorated(decorated), closeIndicated(false) {}
+		decorated(decorated), closeIndicated(false), corkMode(ckNone),
+		staging(), recycle(), stats({ 0, 0, 0 }), lowWatermark(0),
+		highWatermark(0), aboveWatermark(false), cipher(nullptr) {}
+	
+	/// Encrypt the outbound data into the scratch buffer shared by all 
+	/// writables on the same thread, which is reused without allocation.
+	inline const char* encrypt(const char* buffer, size_t size) {
+		static thread_local std::vector<char> scratchBuffer;
+		if(scratchBuffer.size() < size) scratchBuffer.resize(size);
+		cipher -> encrypt(buffer, scratchBuffer.data(), size);
+		return scratchBuffer.data();
+	}
+	
+	/// Account the system call made on the descriptor, and the bytes 
+	/// written by it if it is a writing one.
+	inline void countSyscall(ssize_t numWritten = 0) noexcept {
+		if(!McIoMetricsEnabled) return;
+		if(numWritten > 0) stats.bytesWritten += (uint64_t)numWritten;
+		McIoMultiplexerMetrics* metrics = decorated -> metrics();
+		if(metrics == nullptr) return;
+		metrics -> syscalls.add();
+		if(numWritten > 0) metrics -> bytesOut.add((uint64_t)numWritten);
+	}
+	
+	/// Account the bytes that are staged or queued.
+	inline void enqueued(size_t size) noexcept {
+		stats.queuedSize += size;
+		if(McIoMetricsEnabled && stats.queuedSize > stats.queuedHighWater) {
+			stats.queuedHighWater = stats.queuedSize;
+			McIoMultiplexerMetrics* metrics = decorated -> metrics();
+			if(metrics != nullptr) metrics -> writeQueueHighWater.raise(stats.queuedSize);
+		}
+	}
 	
 	/// Push a node to the back of a typed queue, and update certain amount.
 	template <typename N> inline void push(N&& n) {
@@ -139,6 +206,8 @@ struct McIoWritableControl {
 		auto& currentQueue = queueOf<N>();
 		N& front = currentQueue.front();
 		int numWritten = front.write(decorated -> fd);
+		countSyscall(numWritten);
+		if(numWritten > 0) stats.queuedSize -= (size_t)numWritten;
 		
 		// Judge and update by event flags.
 		if(numWritten == 0 || numWritten < -1) 
@@ -165,6 +234,55 @@ struct McIoWritableControl {
 		}
 	}
 	
+	/// Perform a batched writev() on the consecutive write() nodes at the front 
+	/// of the queue, and return whether it should break now.
+	inline bool batchHandleWrite() {
+		// Gather the front write() nodes into the io vector.
+		struct iovec ioVector[IOV_MAX];
+		size_t numNodes = std::min(queue.front().count, (size_t)IOV_MAX);
+		size_t requestSize = 0;
+		for(size_t i = 0; i < numNodes; ++ i) {
+			McIoWritableWriteNode& node = writeQueue[i];
+			ioVector[i].iov_base = node.buffer.get() + node.offset;
+			ioVector[i].iov_len = node.size;
+			requestSize += node.size;
+		}
+		ssize_t numWritten = ::writev(decorated -> fd, ioVector, (int)numNodes);
+		countSyscall(numWritten);
+		if(numWritten > 0) stats.queuedSize -= (size_t)numWritten;
+		
+		// Judge and update by event flags.
+		if(numWritten == 0 || numWritten < -1) 
+			// The descriptor has closed or has undefined behavior.
+			throw std::runtime_error("The descriptor has already "
+				"closed or exhibited undefined behaviors.");
+		else if(numWritten == -1) {
+			// The descriptor should be blocked.
+			if((errno == EWOULDBLOCK) || (errno == EAGAIN)) return true;
+			// The descriptor has other fatal error.
+			else throw std::runtime_error("The descriptor has "
+				"some not-allowed error with it.");
+		}
+		
+		// Data has been written out, remove the completed nodes and 
+		// advance the partially written node.
+		size_t remainedSize = (size_t)numWritten;
+		while(remainedSize > 0) {
+			McIoWritableWriteNode& front = writeQueue.front();
+			if(front.size > remainedSize) {
+				front.offset += remainedSize;
+				front.size -= remainedSize;
+				break;
+			}
+			remainedSize -= front.size;
+			writeQueue.pop_front();
+			-- queue.front().count;
+			if(queue.front().count == 0) 
+				queue.pop_front();
+		}
+		return (size_t)numWritten < requestSize;
+	}
+	
 	/// The prototype for the write method.
 	template <typename Cn, typename... Args>
 	inline void prototypeWrite(const Cn& castNode, size_t size, Args&& ...args) {
@@ -173,6 +291,7 @@ struct McIoWritableControl {
 		if(size == 0 || closeIndicated) return;
 		if(queue.empty()) {
 			int numWritten = T::castWrite(decorated -> fd, size, args...);
+			countSyscall(numWritten);
 			if(numWritten == 0) return; // The stream has already closed.
 			else if(numWritten != size) {
 				if(numWritten == -1) {
@@ -181,6 +300,7 @@ struct McIoWritableControl {
 					else return;        // Error while writing.
 				}
 				push<T>(castNode(numWritten));
+				enqueued(size - numWritten);
 				try {
 					decorated -> updateEventFlag(McIoEvent(
 						decorated -> currentEventFlag() | McIoEvent::evOut));
@@ -188,14 +308,115 @@ struct McIoWritableControl {
 					// Don't throw, however claer the queue, as the content
 					// could never be sent.
 					queue.clear();
+					writeQueue.clear();
+					sendfile64Queue.clear();
+					stats.queuedSize = 0;
 				}
 			}
 		}
-		else push<T>(castNode(0));
+		else {
+			push<T>(castNode(0));
+			enqueued(size);
+		}
+	}
+	
+	/// Append the data to the staging buffer, and request for flushing.
+	inline void stage(const char* buffer, size_t size) {
+		if(size == 0 || closeIndicated) return;
+		if(staging == nullptr) {
+			if(recycle != nullptr && recycle.use_count() == 1) {
+				staging = std::move(recycle);
+				staging -> clear();
+			}
+			else staging = std::make_shared<std::vector<char>>();
+			decorated -> requestFlush();
+		}
+		staging -> insert(staging -> end(), buffer, buffer + size);
+		enqueued(size);
+	}
+	
+	/// Move the staged data into the write() queue.
+	inline void commitStaging() {
+		if(staging == nullptr) return;
+		std::shared_ptr<char> buffer(staging, staging -> data());
+		push(McIoWritableWriteNode(buffer, 0, staging -> size()));
+		recycle = std::move(staging);
+	}
+	
+	/// Queue the node after the staged data, and request for flushing.
+	template <typename N> inline void stageNode(N&& n) {
+		if(n.empty() || closeIndicated) return;
+		commitStaging();
+		enqueued(n.size);
+		push(std::move(n));
+		decorated -> requestFlush();
+	}
+	
+	/// Write out the queue until it is empty or the descriptor blocks.
+	inline void drainQueue() {
+		while(!queue.empty()) {
+			bool shouldBreak = false;
+			switch(queue.front().type) {
+				// The underlying type is write(), batched with writev().
+				case wrnodeWrite: {
+					shouldBreak = batchHandleWrite();
+				} break;
+				
+				// The underlying type is sendfile64().
+				case wrnodeSendfile64: {
+					shouldBreak = typedHandleWrite<McIoWritableSendfile64Node>();
+				} break;
+				
+				// Unknown or unimplemened type.
+				default: assert(false);
+			}
+			if(shouldBreak) break;
+		}
+	}
+	
+	/// Set or clear the TCP_CORK option, errors are ignored as the 
+	/// descriptor might not be a TCP socket.
+	inline void tcpCork(int corked) noexcept {
+		::setsockopt(decorated -> fd, IPPROTO_TCP, TCP_CORK, 
+				&corked, sizeof(corked));
+		countSyscall();
+	}
+	
+	/// Implements the flush method.
+	void flush() {
+		commitStaging();
+		if(queue.empty()) return;
+		
+		// The queue will be written out when the descriptor is writable.
+		if((decorated -> currentEventFlag() & McIoEvent::evOut) != 0) return;
+		
+		// Only cork when the flush would take more than one system call.
+		bool corked = (corkMode == ckStagedTcpCork) && (queue.size() > 1 
+				|| (queue.front().type == wrnodeWrite 
+					&& queue.front().count > (size_t)IOV_MAX));
+		if(corked) tcpCork(1);
+		try {
+			drainQueue();
+			if(!queue.empty()) decorated -> updateEventFlag(McIoEvent(
+				decorated -> currentEventFlag() | McIoEvent::evOut));
+		} catch(const std::runtime_error&) {
+			// Don't throw, however clear the queue, as the content
+			// could never be sent.
+			queue.clear();
+			writeQueue.clear();
+			sendfile64Queue.clear();
+			stats.queuedSize = 0;
+		}
+		if(corked) tcpCork(0);
 	}
 	
 	/// Implements the handleWrite method.
 	McIoNextStatus handleWrite(McIoEvent& activeEvents) {
+		// Staged data must be written before the descriptor closes, and 
+		// must be queued before writing when the descriptor is writable.
+		if(corkMode != ckNone && (closeIndicated || 
+			(activeEvents & McIoEvent::evOut) != 0)) flush();
+		
 		if((activeEvents & McIoEvent::evOut) == 0) {
 			// Currently the the writing is not active.
 			if(closeIndicated && queue.empty()) 
@@ -208,24 +429,7 @@ struct McIoWritableControl {
 			assert((decorated -> currentEventFlag() & McIoEvent::evOut) != 0);
 			
 			// Attempt to write data out if the queue is not empty.
-			while(!queue.empty()) {
-				bool shouldBreak = false;
-				switch(queue.front().type) {
-					// The underlying type is write().
-					case wrnodeWrite: {
-						shouldBreak = typedHandleWrite<McIoWritableWriteNode>();
-					} break;
-					
-					// The underlying type is sendfile64().
-					case wrnodeSendfile64: {
-						shouldBreak = typedHandleWrite<McIoWritableSendfile64Node>();
-					} break;
-					
-					// Unknown or unimplemened type.
-					default: assert(false);
-				}
-				if(shouldBreak) break;
-			}
+			drainQueue();
 			
 			// Currently write events are enabled.
 			if(queue.empty()) {
@@ -274,7 +478,7 @@ struct McIoCastNodeBuffer {
 		assert(numWritten < size);
 		McIoWritableWriteNode node(std::shared_ptr<char>(
 			new char[size - numWritten], std::default_delete<char[]>()),
-			0, size);
+			0, size - numWritten);
 		memcpy(node.buffer.get(), buffer + numWritten, size - numWritten);
 		return node;
 	}
@@ -282,9 +486,17 @@ struct McIoCastNodeBuffer {
 
 // Implementation for McIoWritable::write() with buffer.
 void McIoWritable::write(const char* buffer, size_t length) {
-	McIoCastNodeBuffer castBuffer(buffer, length);
-	((McIoWritableControl*)control) -> 
-			prototypeWrite(castBuffer, length, buffer);
+	McIoWritableControl* controlBlock = (McIoWritableControl*)control;
+	if(controlBlock -> cipher != nullptr) 
+		buffer = controlBlock -> encrypt(buffer, length);
+	if(controlBlock -> corkMode != ckNone) {
+		controlBlock -> stage(buffer, length);
+	}
+	else {
+		McIoCastNodeBuffer castBuffer(buffer, length);
+		controlBlock -> prototypeWrite(castBuffer, length, buffer);
+	}
+	updateWatermark();
 }
 
 // Cast node for a shared pointer.
@@ -304,36 +516,177 @@ struct McIoCastNodeSharedPointer {
 	}
 };
 
+// Write or queue the shared pointer without encrypting it.
+static void McIoWriteSharedPointer(McIoWritableControl* controlBlock,
+		const std::shared_ptr<char>& sharedPointer, size_t offset, size_t length) {
+	
+	if(controlBlock -> corkMode != ckNone) {
+		controlBlock -> stageNode(McIoWritableWriteNode(
+				sharedPointer, offset, length));
+	}
+	else {
+		McIoCastNodeSharedPointer castPointer(sharedPointer, offset, length);
+		controlBlock -> prototypeWrite(
+				castPointer, length, sharedPointer.get() + offset);
+	}
+}
+
 // Implementation for McIoWritable::write() with shared pointer.
 void McIoWritable::write(const std::shared_ptr<char>& sharedPointer, 
 		size_t offset, size_t length) {
 	
-	McIoCastNodeSharedPointer castPointer(sharedPointer, offset, length);
-	((McIoWritableControl*)control) -> prototypeWrite(
-			castPointer, length, sharedPointer.get() + offset);
+	// The shared buffer must not be modified, so it is encrypted with the
+	// buffer variant instead.
+	McIoWritableControl* controlBlock = (McIoWritableControl*)control;
+	if(controlBlock -> cipher != nullptr) {
+		write(sharedPointer.get() + offset, length);
+		return;
+	}
+	McIoWriteSharedPointer(controlBlock, sharedPointer, offset, length);
+	updateWatermark();
+}
+
+// Implementation for McIoWritable::writeExclusive().
+void McIoWritable::writeExclusive(const std::shared_ptr<char>& sharedPointer, 
+		size_t offset, size_t length) {
+	
+	McIoWritableControl* controlBlock = (McIoWritableControl*)control;
+	if(controlBlock -> cipher != nullptr) controlBlock -> cipher -> encrypt(
+		sharedPointer.get() + offset, sharedPointer.get() + offset, length);
+	McIoWriteSharedPointer(controlBlock, sharedPointer, offset, length);
+	updateWatermark();
+}
+
+// Implementation for McIoWritable::setWriteCipher().
+void McIoWritable::setWriteCipher(McIoCipherControl* cipher) noexcept {
+	((McIoWritableControl*)control) -> cipher = cipher;
+}
+
+// Implementation for McIoWritable::write() with broadcast packet.
+void McIoWritable::write(const McIoBroadcastPacket& packet) {
+	write(packet.buffer, 0, packet.size);
 }
 
 /// Cast node for the sendfile, nothing special.
 struct McIoCastNodeSendfile64 {
 	typedef McIoWritableSendfile64Node castNodeType;
 	int sendfd; ssize_t offset; size_t size;
+	const std::shared_ptr<void>& owner;
 	
-	McIoCastNodeSendfile64(int sendfd, ssize_t offset, size_t size):
-		sendfd(sendfd), offset(offset), size(size) {}
+	McIoCastNodeSendfile64(int sendfd, ssize_t offset, size_t size,
+		const std::shared_ptr<void>& owner): sendfd(sendfd), 
+		offset(offset), size(size), owner(owner) {}
 	
 	McIoWritableSendfile64Node operator()(size_t numWritten) const {
 		assert(numWritten < size);
 		return McIoWritableSendfile64Node(sendfd, 
-			offset + numWritten, size - numWritten);
+			offset + numWritten, size - numWritten, owner);
 	}
 };
 
 // Implementation for McIoWritable::sendfile().
 void McIoWritable::sendfile(int sendfd, ssize_t offset, size_t size) {
+	sendfile(sendfd, offset, size, std::shared_ptr<void>());
+}
+
+// Implementation for McIoWritable::sendfile() with owner.
+void McIoWritable::sendfile(int sendfd, ssize_t offset, size_t size,
+		const std::shared_ptr<void>& owner) {
 	
-	McIoCastNodeSendfile64 castSendfile(sendfd, offset, size);
-	((McIoWritableControl*)control) -> prototypeWrite(
-			castSendfile, size, sendfd, offset);
+	McIoWritableControl* controlBlock = (McIoWritableControl*)control;
+	if(controlBlock -> cipher != nullptr) throw std::runtime_error(
+		"The file could not be sent over the encrypted stream.");
+	if(controlBlock -> corkMode != ckNone) {
+		controlBlock -> stageNode(McIoWritableSendfile64Node(
+				sendfd, offset, size, owner));
+	}
+	else {
+		McIoCastNodeSendfile64 castSendfile(sendfd, offset, size, owner);
+		controlBlock -> prototypeWrite(
+				castSendfile, size, sendfd, offset);
+	}
+	updateWatermark();
+}
+
+// Implementation for McIoWritable::isWriteEncrypted().
+bool McIoWritable::isWriteEncrypted() const noexcept {
+	return ((const McIoWritableControl*)control) -> cipher != nullptr;
+}
+
+// Implementation for McIoWritable::setCorkMode().
+void McIoWritable::setCorkMode(McIoCorkMode corkMode) {
+	McIoWritableControl* controlBlock = (McIoWritableControl*)control;
+	controlBlock -> corkMode = corkMode;
+	if(corkMode == ckNone) {
+		controlBlock -> flush();
+		updateWatermark();
+	}
+}
+
+// Implementation for McIoWritable::getCorkMode().
+McIoCorkMode McIoWritable::getCorkMode() const noexcept {
+	return ((const McIoWritableControl*)control) -> corkMode;
+}
+
+// Implementation for McIoWritable::writableStats().
+McIoWritable::McIoWritableStats McIoWritable::writableStats() const noexcept {
+	return ((const McIoWritableControl*)control) -> stats;
+}
+
+// Implementation for McIoWritable::getQueuedSize().
+size_t McIoWritable::getQueuedSize() const noexcept {
+	return (size_t)((const McIoWritableControl*)control) -> stats.queuedSize;
+}
+
+// Implementation for McIoWritable::setWatermarks().
+void McIoWritable::setWatermarks(size_t lowWatermark, size_t highWatermark) {
+	if(highWatermark != 0 && lowWatermark >= highWatermark)
+		throw std::runtime_error("The low watermark must be below the high watermark.");
+	McIoWritableControl* controlBlock = (McIoWritableControl*)control;
+	controlBlock -> lowWatermark = lowWatermark;
+	controlBlock -> highWatermark = highWatermark;
+	updateWatermark();
+}
+
+// Implementation for McIoWritable::getLowWatermark().
+size_t McIoWritable::getLowWatermark() const noexcept {
+	return ((const McIoWritableControl*)control) -> lowWatermark;
+}
+
+// Implementation for McIoWritable::getHighWatermark().
+size_t McIoWritable::getHighWatermark() const noexcept {
+	return ((const McIoWritableControl*)control) -> highWatermark;
+}
+
+// Implementation for McIoWritable::isAboveWatermark().
+bool McIoWritable::isAboveWatermark() const noexcept {
+	return ((const McIoWritableControl*)control) -> aboveWatermark;
+}
+
+// Implementation for McIoWritable::updateWatermark().
+void McIoWritable::updateWatermark() {
+	// The state is updated before invoking the handlers, so that writing 
+	// inside the handlers would not invoke them again.
+	McIoWritableControl* controlBlock = (McIoWritableControl*)control;
+	size_t queuedSize = (size_t)controlBlock -> stats.queuedSize;
+	if(!controlBlock -> aboveWatermark) {
+		if(controlBlock -> highWatermark == 0) return;
+		if(queuedSize < controlBlock -> highWatermark) return;
+		controlBlock -> aboveWatermark = true;
+		handleHighWatermark();
+	}
+	else {
+		if(controlBlock -> highWatermark != 0 && 
+			queuedSize > controlBlock -> lowWatermark) return;
+		controlBlock -> aboveWatermark = false;
+		handleLowWatermark();
+	}
+}
+
+// Implementation for McIoWritable::flush().
+void McIoWritable::flush() {
+	((McIoWritableControl*)control) -> flush();
+	updateWatermark();
 }
 
 // Implementation for McIoWritable::indicateClose().
@@ -343,5 +696,7 @@ void McIoWritable::indicateWriteClose() noexcept {
 
 // Implementation for McIoWritable::handleWrite().
 McIoNextStatus McIoWritable::handleWrite(McIoEvent& activeEvent) {
-	return ((McIoWritableControl*)control) -> handleWrite(activeEvent);
+	McIoNextStatus status = ((McIoWritableControl*)control) -> handleWrite(activeEvent);
+	updateWatermark();
+	return status;
 }
\ No newline at end of file
@@ -0,0 +1,171 @@
+/**
+ * @file test/codec.cpp
+ * @brief The regression tests of the primitive codecs.
+ * @author Haoran Luo
+ *
+ * Round-trips mc::var32, mc::var64, mc::ustring, mc::jstring and mc::array
+ * over the buffer streams, checking the encoded bytes where they are
+ * specified.
+ */
+#include "testcase.hpp"
+#include "libminecraft/iobase.hpp"
+#include <cstdint>
+#include <limits>
+#include <cstring>
+
+/// The values at the boundary of each encoded length.
+template<typename T> static std::vector<T> McTestVariantValues() {
+	std::vector<T> values = { 0, 1, -1, std::numeric_limits<T>::min(),
+		std::numeric_limits<T>::max() };
+	for(size_t bits = 7; bits < sizeof(T) * 8; bits += 7) {
+		values.push_back((T)(((uint64_t)1 << bits) - 1));
+		values.push_back((T)((uint64_t)1 << bits));
+	}
+	return values;
+}
+
+template<typename V, typename T> static void testVariantRoundTrip() {
+	// Decode each value alone, where the window is shorter than a word.
+	for(T value : McTestVariantValues<T>()) {
+		std::string bytes;
+		McTestExpect((T)McTestRoundTrip(V(value), &bytes) == value);
+		McTestExpect(bytes.size() == McIoVariantSize((typename 
+			std::make_unsigned<T>::type)value));
+	}
+	
+	// Decode the values in sequence, where the window holds a word.
+	McIoBufferOutputStream outputStream;
+	for(T value : McTestVariantValues<T>()) outputStream << V(value);
+	for(size_t i = 0; i < 8; ++ i) outputStream << mc::u8(0);
+	std::string bytes = McTestBytes(outputStream);
+	McIoBufferInputStream inputStream(bytes.data(), bytes.size());
+	for(T value : McTestVariantValues<T>()) {
+		V result; inputStream >> result;
+		McTestExpect((T)result == value);
+	}
+	McTestExpect(inputStream.windowSize() == 8);
+}
+
+static void testVariantBytes() {
+	std::string bytes;
+	McTestRoundTrip(mc::var32(300), &bytes);
+	McTestExpect(bytes == std::string("\xac\x02", 2));
+	McTestRoundTrip(mc::var32(-1), &bytes);
+	McTestExpect(bytes == std::string("\xff\xff\xff\xff\x0f", 5));
+}
+
+static void testVariantMalformed() {
+	// The fifth byte of mc::var32 must not exceed 0x0f, whether or not the
+	// window holds a complete word.
+	for(size_t padding : { 0, 8 }) {
+		std::string bytes("\x80\x80\x80\x80\x10", 5);
+		bytes.append(padding, '\0');
+		McIoBufferInputStream inputStream(bytes.data(), bytes.size());
+		mc::var32 value;
+		McTestExpectThrow(inputStream >> value);
+	}
+	
+	// The tenth byte of mc::var64 must not exceed 0x01.
+	std::string bytes("\xff\xff\xff\xff\xff\xff\xff\xff\xff\x02", 10);
+	McIoBufferInputStream inputStream(bytes.data(), bytes.size());
+	mc::var64 value;
+	McTestExpectThrow(inputStream >> value);
+}
+
+static void testStringRoundTrip() {
+	// The ascii, two and three byte characters and a surrogate pair.
+	std::u16string text = u"ascii é中 \U0001F600.";
+	std::string bytes;
+	McTestExpect((const std::u16string&)McTestRoundTrip(
+		mc::ustring<>(text), &bytes) == text);
+	McTestExpect(bytes == std::string("\x11" "ascii \xc3\xa9\xe4\xb8\xad "
+		"\xf0\x9f\x98\x80.", 18));
+	McTestExpect((const std::u16string&)McTestRoundTrip(
+		mc::jstring(text), &bytes) == text);
+	McTestExpect(bytes.substr(0, 2) == std::string("\x00\x11", 2));
+	
+	// The unpaired surrogate could not be encoded.
+	McIoBufferOutputStream outputStream;
+	McTestExpectThrow(outputStream << mc::ustring<>(std::u16string(1, u'\xd83d')));
+}
+
+static void testStringLengthPrefix() {
+	// The length prefix is a variant integer, least significant group first.
+	for(size_t length : { 127, 128, 200, 16383, 16384, 32767 }) {
+		std::u16string text(length, u'a');
+		std::string bytes;
+		McTestExpect((const std::u16string&)McTestRoundTrip(
+			mc::ustring<>(text), &bytes) == text);
+		size_t prefixSize = McIoVariantSize(length);
+		McTestExpect(bytes.size() == prefixSize + length);
+		std::string prefix(5, '\0');
+		prefix.resize(McIoStoreVariant(&prefix[0], length) - prefix.data());
+		McTestExpect(bytes.substr(0, prefixSize) == prefix);
+	}
+	
+	// The surrogate pair long enough to have multiple bytes of prefix.
+	std::u16string text;
+	for(size_t i = 0; i < 64; ++ i) text += u"\U0001F600";
+	std::string bytes;
+	McTestExpect((const std::u16string&)McTestRoundTrip(
+		mc::ustring<>(text), &bytes) == text);
+	McTestExpect(bytes.substr(0, 3) == std::string("\x80\x02\xf0", 3));
+}
+
+/// Round-trip the array of fixed length elements, which are in bulk.
+template<typename V, typename T> static void testFixedArrayRoundTrip() {
+	for(size_t length : { 0, 1, 7, 4099 }) {
+		std::vector<V> elements;
+		for(size_t i = 0; i < length; ++ i)
+			elements.push_back(V((T)(0x0123456789abcdefull * (i + 1))));
+		std::string bytes;
+		std::vector<V> result = McTestRoundTrip(mc::array<V, mc::var32>(elements), &bytes);
+		McTestExpect(result.size() == length);
+		for(size_t i = 0; i < length; ++ i)
+			McTestExpect((T)result[i] == (T)elements[i]);
+		
+		// The elements are big endian after the length.
+		size_t prefixSize = McIoVariantSize(length);
+		McTestExpect(bytes.size() == prefixSize + length * sizeof(T));
+		for(size_t i = 0; i < length; ++ i) {
+			typedef typename McDtBulkTraits<V>::wordType wordType;
+			wordType word; T value = elements[i];
+			memcpy(&word, &value, sizeof(T));
+			McTestExpect(McIoLoadBigEndian<wordType>(
+				&bytes[prefixSize + i * sizeof(T)]) == word);
+		}
+	}
+}
+
+static void testArrayRoundTrip() {
+	// The elements which are not fixed length are read one by one.
+	std::vector<mc::var32> elements = { 0, 300, -1 };
+	std::string bytes;
+	std::vector<mc::var32> result = McTestRoundTrip(
+		mc::array<mc::var32, mc::s16>(elements), &bytes);
+	McTestExpect(result.size() == 3 && result[1] == 300 && result[2] == -1);
+	McTestExpect(bytes == std::string("\x00\x03\x00\xac\x02"
+		"\xff\xff\xff\xff\x0f", 10));
+	
+	// The negative length is rejected.
+	std::string negative("\xff\xff", 2);
+	McIoBufferInputStream inputStream(negative.data(), negative.size());
+	mc::array<mc::s8, mc::s16> array;
+	McTestExpectThrow(inputStream >> array);
+}
+
+static McTestRegistrar registrar[] = {
+	McTestRegistrar("codec/var32", testVariantRoundTrip<mc::var32, int32_t>),
+	McTestRegistrar("codec/var64", testVariantRoundTrip<mc::var64, int64_t>),
+	McTestRegistrar("codec/variant-bytes", testVariantBytes),
+	McTestRegistrar("codec/variant-malformed", testVariantMalformed),
+	McTestRegistrar("codec/string", testStringRoundTrip),
+	McTestRegistrar("codec/string-prefix", testStringLengthPrefix),
+	McTestRegistrar("codec/array-s8", testFixedArrayRoundTrip<mc::s8, int8_t>),
+	McTestRegistrar("codec/array-u16", testFixedArrayRoundTrip<mc::u16, uint16_t>),
+	McTestRegistrar("codec/array-s32", testFixedArrayRoundTrip<mc::s32, int32_t>),
+	McTestRegistrar("codec/array-s64", testFixedArrayRoundTrip<mc::s64, int64_t>),
+	McTestRegistrar("codec/array-f32", testFixedArrayRoundTrip<mc::f32, float>),
+	McTestRegistrar("codec/array-f64", testFixedArrayRoundTrip<mc::f64, double>),
+	McTestRegistrar("codec/array", testArrayRoundTrip),
+};
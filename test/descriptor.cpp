@@ -0,0 +1,70 @@
+/**
+ * @file test/descriptor.cpp
+ * @brief The regression tests of the descriptor allocation.
+ * @author Haoran Luo
+ *
+ * Allocates the descriptors of various sizes and alignments by both the
+ * new expression and McIoMultiplexer::emplace(), and destroys them through
+ * the base class, which is checked by the address sanitizer if enabled.
+ */
+#include "testcase.hpp"
+#include "libminecraft/multiplexer.hpp"
+#include <cstdint>
+#include <sys/eventfd.h>
+
+/// The descriptor padded to certain size and alignment.
+template<size_t size, size_t alignment = alignof(std::max_align_t)>
+class alignas(alignment) McTestDescriptor : public McIoDescriptor {
+	char padding[size];
+	
+	virtual McIoNextStatus handle(McIoEvent&) override {
+		return McIoNextStatus::nstPoll;
+	}
+public:
+	McTestDescriptor(): McIoDescriptor(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC),
+		McIoEvent::evIn), padding() {}
+};
+
+/// Allocate by the new expression, checking the alignment.
+template<typename descriptorType> static void McTestNewDescriptor(
+	McIoMultiplexer& multiplexer) {
+	descriptorType* descriptor = new descriptorType();
+	McTestExpect((uintptr_t)descriptor % alignof(descriptorType) == 0);
+	std::unique_ptr<McIoDescriptor> managed(descriptor);
+	multiplexer.insert(managed);
+	multiplexer.erase(descriptor);
+	delete new descriptorType();
+}
+
+static void testDescriptorNew() {
+	McIoMultiplexer multiplexer;
+	McTestNewDescriptor<McTestDescriptor<8>>(multiplexer);
+	McTestNewDescriptor<McTestDescriptor<4096>>(multiplexer);
+	McTestNewDescriptor<McTestDescriptor<8, 256>>(multiplexer);
+	McTestNewDescriptor<McTestDescriptor<4096, 4096>>(multiplexer);
+}
+
+static void testDescriptorEmplace() {
+	McIoMultiplexer multiplexer;
+	for(size_t round = 0; round < 2; ++ round) {
+		std::vector<McIoDescriptor*> descriptors;
+		for(size_t i = 0; i < 64; ++ i) {
+			descriptors.push_back(&multiplexer.emplace<McTestDescriptor<8>>());
+			descriptors.push_back(&multiplexer.emplace<McTestDescriptor<1900>>());
+			descriptors.push_back(&multiplexer.emplace<McTestDescriptor<4096>>());
+		}
+		for(McIoDescriptor* descriptor : descriptors) {
+			McTestExpect((uintptr_t)descriptor % alignof(std::max_align_t) == 0);
+			multiplexer.erase(descriptor);
+		}
+	}
+	
+	// The descriptors left are destroyed with the multiplexer.
+	multiplexer.emplace<McTestDescriptor<8>>();
+	multiplexer.emplace<McTestDescriptor<4096>>();
+}
+
+static McTestRegistrar registrar[] = {
+	McTestRegistrar("descriptor/new", testDescriptorNew),
+	McTestRegistrar("descriptor/emplace", testDescriptorEmplace),
+};
@@ -0,0 +1,62 @@
+/**
+ * @file test/main.cpp
+ * @brief The entry of libminecraft_test.
+ * @author Haoran Luo
+ *
+ * Runs the registered test cases whose names contain the filter, and exits
+ * with failure if any of them has failed, the usage is:
+ *
+ * '''
+ * libminecraft_test [--filter <substring>]
+ * '''
+ *
+ * @see test/testcase.hpp
+ */
+#include "testcase.hpp"
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+/// The registered test case.
+struct McTestCase {
+	std::string name;
+	McTestFunction function;
+};
+
+/// The registry of the test cases, constructed on first use.
+static std::vector<McTestCase>& McTestCases() {
+	static std::vector<McTestCase> cases;
+	return cases;
+}
+
+// Implementation for McTestRegistrar::McTestRegistrar().
+McTestRegistrar::McTestRegistrar(const char* name, McTestFunction function) {
+	McTestCases().push_back(McTestCase{ name, function });
+}
+
+// Implementation for McTestFail().
+void McTestFail(const char* expression, const char* file, int line) {
+	throw std::runtime_error(std::string(file) + ":"
+		+ std::to_string(line) + ": expected " + expression);
+}
+
+int main(int argc, char** argv) {
+	const char* filter = "";
+	for(int i = 1; i < argc; ++ i)
+		if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++ i];
+
+	size_t numPassed = 0, numFailed = 0;
+	for(const McTestCase& testCase : McTestCases()) {
+		if(strstr(testCase.name.c_str(), filter) == nullptr) continue;
+		try {
+			testCase.function();
+			printf("[ OK ] %s\n", testCase.name.c_str());
+			++ numPassed;
+		} catch(const std::exception& e) {
+			printf("[FAIL] %s: %s\n", testCase.name.c_str(), e.what());
+			++ numFailed;
+		}
+	}
+	printf("%zu passed, %zu failed\n", numPassed, numFailed);
+	return numFailed == 0? 0 : 1;
+}
@@ -0,0 +1,235 @@
+/**
+ * @file test/nbt.cpp
+ * @brief The regression tests of the nbt trees.
+ * @author Haoran Luo
+ *
+ * Reads the trees into an arena and copies them out, checking the copies
+ * are heap trees holding the heap payload types, and are still usable after
+ * the arena is reset. Views the trees lazily, checking the data is only
+ * validated as far as the accesses reach.
+ */
+#include "testcase.hpp"
+#include "libminecraft/nbt.hpp"
+#include "libminecraft/nbtview.hpp"
+
+/// Append the tag and its name of the compound entry.
+static void McTestNbtTag(std::string& document, char tag, const std::string& name) {
+	document += tag;
+	document += (char)(name.size() >> 8);
+	document += (char)(name.size() & 0xff);
+	document += name;
+}
+
+/// Append the big endian 32-bit integer.
+static void McTestNbtInt(std::string& document, int32_t value) {
+	for(int i = 3; i >= 0; -- i) document += (char)((value >> (8 * i)) & 0xff);
+}
+
+/// Append the string of the java modified utf-8.
+static void McTestNbtString(std::string& document, const std::string& value) {
+	document += (char)(value.size() >> 8);
+	document += (char)(value.size() & 0xff);
+	document += value;
+}
+
+/// The compound holding every string and array payload, directly and
+/// inside the nested lists and compounds.
+static std::string McTestNbtDocument() {
+	std::string document;
+	McTestNbtTag(document, 8, "name");
+	McTestNbtString(document, "a string long enough to be allocated");
+
+	McTestNbtTag(document, 7, "bytes");
+	McTestNbtInt(document, 3);
+	document += "\x01\x02\x03";
+
+	McTestNbtTag(document, 11, "ints");
+	McTestNbtInt(document, 2);
+	McTestNbtInt(document, 1);
+	McTestNbtInt(document, -2);
+
+	McTestNbtTag(document, 12, "longs");
+	McTestNbtInt(document, 1);
+	McTestNbtInt(document, 0x01234567);
+	McTestNbtInt(document, 0x09abcdef);
+
+	McTestNbtTag(document, 9, "names");
+	document += (char)8;
+	McTestNbtInt(document, 2);
+	McTestNbtString(document, "one");
+	McTestNbtString(document, "the second name, long enough to be allocated");
+
+	McTestNbtTag(document, 9, "arrays");
+	document += (char)11;
+	McTestNbtInt(document, 2);
+	McTestNbtInt(document, 1);
+	McTestNbtInt(document, 5);
+	McTestNbtInt(document, 0);
+
+	McTestNbtTag(document, 10, "sub");
+	McTestNbtTag(document, 8, "key");
+	McTestNbtString(document, "value");
+	document += (char)0;
+
+	document += (char)0;
+	return document;
+}
+
+/// Check the tree read from McTestNbtDocument() is a heap tree.
+static void McTestNbtExpectHeap(mc::nbtcompound& compound) {
+	McTestExpect(compound.arena() == nullptr);
+	McTestExpect(compound[u"name"]->isType<mc::jstring>());
+	McTestExpect((const std::u16string&)compound[u"name"]->asType<mc::jstring>()
+		== u"a string long enough to be allocated");
+
+	McTestExpect(compound[u"bytes"]->isType<mc::nbtintarray<mc::s8>>());
+	const std::vector<mc::s8>& bytes = compound[u"bytes"]->asType<mc::nbtintarray<mc::s8>>();
+	McTestExpect(bytes.size() == 3 && bytes[2] == 3);
+
+	McTestExpect(compound[u"ints"]->isType<mc::nbtintarray<mc::s32>>());
+	const std::vector<mc::s32>& ints = compound[u"ints"]->asType<mc::nbtintarray<mc::s32>>();
+	McTestExpect(ints.size() == 2 && ints[0] == 1 && ints[1] == -2);
+
+	McTestExpect(compound[u"longs"]->isType<mc::nbtintarray<mc::s64>>());
+	const std::vector<mc::s64>& longs = compound[u"longs"]->asType<mc::nbtintarray<mc::s64>>();
+	McTestExpect(longs.size() == 1 && longs[0] == 0x0123456709abcdefll);
+
+	mc::nbtlist& nameList = compound[u"names"]->asType<mc::nbtlist>();
+	McTestExpect(nameList.arena() == nullptr);
+	mc::nbttypedlist<mc::jstring> names = nameList.asType<mc::jstring>();
+	McTestExpect(names.size() == 2);
+	McTestExpect((const std::u16string&)names[0] == u"one");
+	McTestExpect((const std::u16string&)names[1]
+		== u"the second name, long enough to be allocated");
+
+	mc::nbtlist& arrayList = compound[u"arrays"]->asType<mc::nbtlist>();
+	mc::nbttypedlist<mc::nbtintarray<mc::s32>> arrays =
+		arrayList.asType<mc::nbtintarray<mc::s32>>();
+	McTestExpect(arrays.size() == 2);
+	McTestExpect(((const std::vector<mc::s32>&)arrays[0]).size() == 1);
+	McTestExpect(((const std::vector<mc::s32>&)arrays[1]).size() == 0);
+
+	mc::nbtcompound& sub = compound[u"sub"]->asType<mc::nbtcompound>();
+	McTestExpect(sub.arena() == nullptr);
+	McTestExpect((const std::u16string&)sub[u"key"]->asType<mc::jstring>() == u"value");
+}
+
+/// Copying a tree inside the arena copies it into the heap payload types.
+static void testArenaCopy() {
+	std::string document = McTestNbtDocument();
+
+	// The tree read without arena is the reference.
+	mc::nbtcompound heap;
+	McIoBufferInputStream heapInput(document.data(), document.size());
+	McIoReadNbtCompound(heapInput, heap);
+	McTestNbtExpectHeap(heap);
+
+	// The tree read into the arena holds the arena variants.
+	McDtNbtArena arena;
+	std::unique_ptr<mc::nbtcompound> copy; {
+		mc::nbtcompound compound(&arena);
+		McIoBufferInputStream arenaInput(document.data(), document.size());
+		McIoReadNbtCompound(arenaInput, compound);
+		McTestExpect(compound[u"name"]->isType<mc::nbtarenastring>());
+		McTestExpect(compound[u"ints"]->isType<mc::nbtarenaintarray<mc::s32>>());
+		McTestExpect(compound[u"names"]->asType<mc::nbtlist>().arena() == &arena);
+
+		// The copies of the tree and of its list are heap ones.
+		copy.reset(new mc::nbtcompound(compound));
+		mc::nbtlist names(compound[u"names"]->asType<mc::nbtlist>());
+		McTestExpect(names.arena() == nullptr);
+		McTestExpect(names.asType<mc::jstring>().size() == 2);
+	}
+
+	// The copy does not refer to the arena.
+	arena.reset();
+	McTestNbtExpectHeap(*copy);
+	mc::nbtcompound again(*copy);
+	McTestNbtExpectHeap(again);
+}
+
+/// The root compound of McTestNbtDocument().
+static std::string McTestNbtRoot() {
+	std::string root;
+	McTestNbtTag(root, 10, "");
+	return root + McTestNbtDocument();
+}
+
+/// The view reads the same tags as the materialized tree.
+static void testView() {
+	std::string root = McTestNbtRoot();
+	McDtNbtView view = McDtNbtView::fromRoot(root.data(), root.size());
+	McTestExpect(view.type() == 10);
+
+	// Access the nested tags before the tags of the root are all scanned.
+	McDtNbtView sub = view["sub"];
+	McTestExpect(sub.type() == 10 && sub.size() == 1);
+	McTestExpect(sub["key"].asString() == u"value");
+	McTestExpect(view["sub"]["key"].asString() == u"value");
+	McTestExpect(view["absent"].isNull());
+	McTestExpect(view.size() == 7);
+
+	size_t keyLength; const char* key;
+	std::tie(keyLength, key) = view.keyAt(4);
+	McTestExpect(std::string(key, keyLength) == "names");
+	McDtNbtView names = view.valueAt(4);
+	McTestExpect(names.size() == 2 && names.elementType() == 8);
+	McTestExpect(names.valueAt(1).asString()
+		== u"the second name, long enough to be allocated");
+	McTestExpectThrow(names.valueAt(2));
+
+	McDtNbtView arrays = view["arrays"];
+	McTestExpect(arrays.valueAt(0).valueAt(0).asInt() == 5);
+	McTestExpect(arrays.valueAt(1).size() == 0);
+	McTestExpect(view["longs"].valueAt(0).asLong() == 0x0123456709abcdefll);
+
+	// The raw payload spans the whole compound, excluding the root header.
+	size_t payloadSize; const char* payload;
+	std::tie(payloadSize, payload) = view.rawPayload();
+	McTestExpect(payload == root.data() + 3 && payloadSize == root.size() - 3);
+
+	mc::nbtcompound compound;
+	view.materialize(compound);
+	McTestNbtExpectHeap(compound);
+}
+
+/// The malformed data is only reported by the accesses reaching it.
+static void testViewLazy() {
+	// The nested compound runs into an invalid tag type after its first tag.
+	std::string root;
+	McTestNbtTag(root, 10, "");
+	McTestNbtTag(root, 3, "first");
+	McTestNbtInt(root, 42);
+	McTestNbtTag(root, 10, "nested");
+	McTestNbtTag(root, 1, "byte");
+	root += (char)7;
+	root += (char)0x7f;
+
+	McDtNbtView view = McDtNbtView::fromRoot(root.data(), root.size());
+	McTestExpect(view["first"].asInt() == 42);
+	McTestExpect(view["nested"]["byte"].asByte() == 7);
+	McTestExpectThrow(view["nested"]["absent"]);
+	McTestExpectThrow(view["absent"]);
+	McTestExpectThrow(view.size());
+	McTestExpectThrow(view.rawPayload());
+
+	// The truncated compound is bounded by the enclosing buffer.
+	std::string truncated = McTestNbtRoot();
+	truncated.resize(truncated.size() - 2);
+	view = McDtNbtView::fromRoot(truncated.data(), truncated.size());
+	McTestExpect(view["name"].type() == 8);
+	McTestExpectThrow(view["absent"]);
+	McTestExpect(view.valueAt(6)["key"].asString() == u"value");
+	McTestExpectThrow(view.valueAt(6)["absent"]);
+	McTestExpectThrow(view.size());
+
+	// The tag headers are still validated on construction.
+	McTestExpectThrow(McDtNbtView::fromRoot(root.data(), 2));
+	McTestExpectThrow(McDtNbtView::fromPayload(8, "\x00\x05" "abc", 5));
+}
+
+static McTestRegistrar registrar[] = {
+	McTestRegistrar("nbt/arenacopy", testArenaCopy),
+	McTestRegistrar("nbt/view", testView),
+	McTestRegistrar("nbt/viewlazy", testViewLazy),
+};
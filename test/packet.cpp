@@ -0,0 +1,78 @@
+/**
+ * @file test/packet.cpp
+ * @brief The regression tests of the packet dispatch.
+ * @author Haoran Luo
+ *
+ * Dispatches the packets through McIoPacketRegistry to a plain handler,
+ * checking the packet ids are decoded and validated as mc::var32.
+ */
+#include "testcase.hpp"
+#include "libminecraft/packet.hpp"
+
+/// The packet routed by the schema.
+struct McTestPing {
+	mc::s64 payload;
+};
+
+typedef McDtPacketSchema<__mc_member(McTestPing, payload)> McTestPingSchema;
+
+/// The handler recording the packets dispatched to it.
+struct McTestHandler {
+	size_t numRequests = 0, requestSize = 0;
+	int64_t pingPayload = 0;
+	
+	void request(size_t size, McIoMarkableStream& inputStream) {
+		++ numRequests; requestSize = size;
+		inputStream.skip(size);
+	}
+	
+	void ping(McTestPing& packet) { pingPayload = packet.payload; }
+	
+	typedef McIoPacketRegistry<McTestHandler, pdServerbound,
+		McIoPacketTable<psStatus, pdServerbound,
+			__mc_packet_stream(0x00, McTestHandler, request),
+			__mc_packet(0x01, McTestPingSchema, McTestHandler, ping)>
+	> packetRegistry;
+};
+
+/// Dispatch the whole packet in the protocol state.
+static void McTestDispatch(McTestHandler& handler,
+	McIoProtocolState state, const std::string& packet) {
+	McIoBufferInputStream inputStream(packet.data(), packet.size());
+	McTestHandler::packetRegistry::dispatch(handler, state, packet.size(), inputStream);
+	McTestExpect(inputStream.windowSize() == 0);
+}
+
+static void testDispatch() {
+	McTestHandler handler;
+	McTestDispatch(handler, psStatus, std::string("\x00\x01\x02", 3));
+	McTestExpect(handler.numRequests == 1 && handler.requestSize == 2);
+	McTestDispatch(handler, psStatus, std::string("\x01\x01\x23\x45\x67\x89\xab\xcd\xef", 9));
+	McTestExpect(handler.pingPayload == 0x0123456789abcdefll);
+	
+	// The padded packet id is still decoded as the variant integer.
+	McTestDispatch(handler, psStatus, std::string("\x80\x80\x80\x80\x00", 5));
+	McTestExpect(handler.numRequests == 2 && handler.requestSize == 0);
+}
+
+static void testDispatchMalformed() {
+	McTestHandler handler;
+	for(const std::string& packet : {
+		// The fifth byte carries bits beyond 32-bit, or is not the last.
+		std::string("\x80\x80\x80\x80\x10", 5),
+		std::string("\x80\x80\x80\x80\x70\x00", 6),
+		std::string("\x80\x80\x80\x80\x80\x00", 6),
+		
+		// The packet id exceeds the packet, or is not routed.
+		std::string("\x80", 1),
+		std::string("\x02", 1),
+		std::string("\xff\x07", 2),
+	}) McTestExpectThrow(McTestDispatch(handler, psStatus, packet));
+	McTestExpectThrow(McTestDispatch(handler, psPlay, std::string("\x00", 1)));
+	McTestExpect(handler.numRequests == 0);
+}
+
+static McTestRegistrar registrar[] = {
+	McTestRegistrar("packet/dispatch", testDispatch),
+	McTestRegistrar("packet/dispatch-malformed", testDispatchMalformed),
+};
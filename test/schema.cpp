@@ -0,0 +1,157 @@
+/**
+ * @file test/schema.cpp
+ * @brief The regression tests of the packet schema codec.
+ * @author Haoran Luo
+ *
+ * Round-trips the packets through McDtPacketSchema, checking the encoded 
+ * bytes are identical to writing the fields one by one through the stream.
+ */
+#include "testcase.hpp"
+#include "libminecraft/schema.hpp"
+
+/// The packet mixing the mc:: members and the plain members.
+struct McTestHandshake {
+	mc::var32 protocolVersion;
+	mc::ustring<255> serverAddress;
+	uint16_t serverPort;
+	int32_t nextState;
+};
+
+typedef McDtPacketSchema<
+	__mc_member(McTestHandshake, protocolVersion),
+	__mc_member(McTestHandshake, serverAddress),
+	McDtSchemaField<__mc_member(McTestHandshake, serverPort), mc::u16>,
+	McDtSchemaField<__mc_member(McTestHandshake, nextState), mc::var32>
+> McTestHandshakeSchema;
+
+static_assert(McTestHandshakeSchema::minimumSize == 1 + 1 + 2 + 1, 
+	"The minimum size of the handshake is mismatched.");
+static_assert(McTestHandshakeSchema::maximumSize == 5 + (5 + 255 * 3) + 2 + 5, 
+	"The maximum size of the handshake is mismatched.");
+
+/// The packet of fixed length members only.
+struct McTestPosition {
+	mc::f64 x, y, z;
+	mc::f32 yaw, pitch;
+	mc::u8 flags;
+};
+
+typedef McDtPacketSchema<
+	__mc_member(McTestPosition, x), __mc_member(McTestPosition, y),
+	__mc_member(McTestPosition, z), __mc_member(McTestPosition, yaw),
+	__mc_member(McTestPosition, pitch), __mc_member(McTestPosition, flags)
+> McTestPositionSchema;
+
+static_assert(McTestPositionSchema::isFixedSize && 
+	McTestPositionSchema::minimumSize == 8 * 3 + 4 * 2 + 1, 
+	"The position should be fixed size.");
+
+/// The packet of arrays and unbounded strings.
+struct McTestArrays {
+	mc::array<mc::s64, mc::var32> longs;
+	mc::array<mc::var32, mc::u16> variants;
+	mc::array<mc::s8, mc::u8> bytes;
+	mc::jstring name;
+	mc::ustring<0> text;
+};
+
+typedef McDtPacketSchema<
+	__mc_member(McTestArrays, longs), __mc_member(McTestArrays, variants),
+	__mc_member(McTestArrays, bytes), __mc_member(McTestArrays, name),
+	__mc_member(McTestArrays, text)
+> McTestArraysSchema;
+
+static_assert(McTestArraysSchema::maximumSize == McDtSchemaUnbounded,
+	"The arrays should be unbounded.");
+
+/// Encode the packet through the schema, expecting the reference bytes.
+template<typename S> static std::string McTestSchemaWrite(
+	const typename S::classType& object, const std::string& reference) {
+	McIoBufferOutputStream outputStream;
+	S::write(outputStream, object);
+	std::string bytes = McTestBytes(outputStream);
+	McTestExpect(bytes == reference);
+	McTestExpect(bytes.size() == S::encodedSize(object));
+	return bytes;
+}
+
+/// Decode the packet through the schema, expecting the bytes to be consumed.
+template<typename S> static typename S::classType McTestSchemaRead(const std::string& bytes) {
+	McIoBufferInputStream inputStream(bytes.data(), bytes.size());
+	typename S::classType object;
+	S::read(inputStream, object);
+	McTestExpect(inputStream.windowSize() == 0);
+	return object;
+}
+
+static void testHandshake() {
+	McTestHandshake handshake;
+	handshake.protocolVersion = mc::var32(340);
+	handshake.serverAddress = mc::ustring<255>(u"localhost\U0001F600");
+	handshake.serverPort = 25565;
+	handshake.nextState = 2;
+	
+	McIoBufferOutputStream reference;
+	reference << handshake.protocolVersion << handshake.serverAddress
+		<< mc::u16(handshake.serverPort) << mc::var32(handshake.nextState);
+	McTestHandshake result = McTestSchemaRead<McTestHandshakeSchema>(
+		McTestSchemaWrite<McTestHandshakeSchema>(handshake, McTestBytes(reference)));
+	McTestExpect(result.protocolVersion == 340);
+	McTestExpect((const std::u16string&)result.serverAddress == u"localhost\U0001F600");
+	McTestExpect(result.serverPort == 25565 && result.nextState == 2);
+	
+	// The string exceeding the constraint is not encodable.
+	handshake.nextState = -1;
+	McTestExpect(McTestHandshakeSchema::encodedSize(handshake) == 2 + 14 + 2 + 5);
+	std::string longAddress(256, 'a');
+	McTestExpectThrow(handshake.serverAddress = mc::ustring<255>(longAddress));
+}
+
+static void testPosition() {
+	McTestPosition position;
+	position.x = 1.5; position.y = -64.0; position.z = 1e10;
+	position.yaw = 90.0f; position.pitch = -0.5f;
+	position.flags = 0x1f;
+	
+	McIoBufferOutputStream reference;
+	reference << position.x << position.y << position.z 
+		<< position.yaw << position.pitch << position.flags;
+	McTestPosition result = McTestSchemaRead<McTestPositionSchema>(
+		McTestSchemaWrite<McTestPositionSchema>(position, McTestBytes(reference)));
+	McTestExpect(result.x == 1.5 && result.y == -64.0 && result.z == 1e10);
+	McTestExpect(result.yaw == 90.0f && result.pitch == -0.5f);
+	McTestExpect(result.flags == 0x1f);
+}
+
+static void testArrays() {
+	McTestArrays arrays;
+	arrays.longs = std::vector<mc::s64>{ 1, -1, 0x0123456789abcdefll };
+	arrays.variants = std::vector<mc::var32>{ 0, 300, -1 };
+	arrays.bytes = std::vector<mc::s8>(255, mc::s8(-2));
+	arrays.name = mc::jstring(std::u16string(u"name"));
+	arrays.text = mc::ustring<0>(std::u16string(1000, u'\x4e2d'));
+	
+	// The arrays and strings larger than the stack buffer.
+	McIoBufferOutputStream reference;
+	reference << arrays.longs << arrays.variants << arrays.bytes 
+		<< arrays.name << arrays.text;
+	McTestArrays result = McTestSchemaRead<McTestArraysSchema>(
+		McTestSchemaWrite<McTestArraysSchema>(arrays, McTestBytes(reference)));
+	McTestExpect(((const std::vector<mc::s64>&)result.longs).size() == 3);
+	McTestExpect(result.longs[2] == 0x0123456789abcdefll);
+	McTestExpect(((const std::vector<mc::var32>&)result.variants).size() == 3);
+	McTestExpect(result.variants[1] == 300 && result.variants[2] == -1);
+	McTestExpect(((const std::vector<mc::s8>&)result.bytes).size() == 255);
+	McTestExpect((const std::u16string&)result.name == u"name");
+	McTestExpect(((const std::u16string&)result.text).size() == 1000);
+	
+	// The array exceeding the unsigned length type is not encodable.
+	arrays.bytes = std::vector<mc::s8>(256);
+	McTestExpectThrow(McTestArraysSchema::encodedSize(arrays));
+}
+
+static McTestRegistrar registrar[] = {
+	McTestRegistrar("schema/handshake", testHandshake),
+	McTestRegistrar("schema/position", testPosition),
+	McTestRegistrar("schema/arrays", testArrays),
+};
@@ -0,0 +1,65 @@
+#pragma once
+/**
+ * @file test/testcase.hpp
+ * @brief The regression test harness
+ * @author Haoran Luo
+ *
+ * Defines the minimal harness of libminecraft_test, which has no dependency
+ * other than the library itself. Each test case is a function which fails by
+ * throwing, usually from a failed McTestExpect().
+ *
+ * '''
+ * static void testSomething() {
+ *     McTestExpect(something() == expected);
+ * }
+ * static McTestRegistrar registrar[] = {
+ *     McTestRegistrar("something", testSomething),
+ * };
+ * '''
+ */
+#include "libminecraft/stream.hpp"
+#include "libminecraft/bufstream.hpp"
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+/// The function of the test case.
+typedef void (*McTestFunction)();
+
+/// Register the test case at static initialization.
+struct McTestRegistrar {
+	McTestRegistrar(const char* name, McTestFunction function);
+};
+
+/// Throw with the failed expression and its location.
+[[noreturn]] void McTestFail(const char* expression, const char* file, int line);
+
+/// Fail the test case when the condition does not hold.
+#define McTestExpect(condition) do { if(!(condition))\
+	McTestFail(#condition, __FILE__, __LINE__); } while(0)
+
+/// Fail the test case when the statement does not throw std::exception.
+#define McTestExpectThrow(statement) do { bool thrown = false;\
+	try { statement; } catch(const std::exception&) { thrown = true; }\
+	if(!thrown) McTestFail(#statement " throws", __FILE__, __LINE__); } while(0)
+
+/// Retrieve the bytes written to the buffer output stream.
+inline std::string McTestBytes(const McIoBufferOutputStream& outputStream) {
+	size_t size; const char* data;
+	std::tie(size, data) = outputStream.rawData();
+	return std::string(data, size);
+}
+
+/// Write the value and read it back, expecting the bytes to be consumed.
+template<typename V> inline V McTestRoundTrip(const V& value,
+	std::string* bytes = nullptr) {
+	McIoBufferOutputStream outputStream;
+	outputStream << value;
+	std::string written = McTestBytes(outputStream);
+	if(bytes != nullptr) *bytes = written;
+
+	McIoBufferInputStream inputStream(written.data(), written.size());
+	V result; inputStream >> result;
+	McTestExpect(inputStream.windowSize() == 0);
+	return result;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file test/writable.cpp
+ * @brief The regression tests of the writable queue.
+ * @author Haoran Luo
+ *
+ * Writes interleaved buffers, shared pointers and files through McIoWritable
+ * into a socketpair() with small buffers, so that the writes are partially
+ * completed and queued, then drains the peer while the multiplexer writes
+ * the queue out, checking the bytes arrive complete and in order.
+ */
+#include "testcase.hpp"
+#include "libminecraft/writable.hpp"
+#include <cstdio>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/// The descriptor writing the queue out when it is writable.
+class McTestWriter : public McIoDescriptor, public McIoWritable {
+	virtual McIoNextStatus handle(McIoEvent& events) override {
+		return handleWrite(events);
+	}
+	
+	virtual void handleFlush() override { flush(); }
+public:
+	McTestWriter(int fd): McIoDescriptor(fd, McIoEvent::evIn), McIoWritable(this) {}
+};
+
+/// Write the chunks of distinct bytes, returning the bytes to receive.
+static std::string McTestWriteChunks(McTestWriter& writer, FILE* file) {
+	std::string expected;
+	for(size_t i = 0; i < 256; ++ i) {
+		std::string chunk((i * 131) % 3001 + 1, (char)i);
+		switch(i % 4) {
+			case 0: case 1: {
+				writer.write(chunk.data(), chunk.size());
+			} break;
+			case 2: {
+				std::shared_ptr<char> buffer(new char[chunk.size() + 3],
+					std::default_delete<char[]>());
+				memcpy(buffer.get() + 3, chunk.data(), chunk.size());
+				writer.write(buffer, 3, chunk.size());
+			} break;
+			case 3: {
+				long offset = ftell(file);
+				fwrite(chunk.data(), 1, chunk.size(), file);
+				fflush(file);
+				writer.sendfile(fileno(file), offset, chunk.size());
+			} break;
+		}
+		expected += chunk;
+	}
+	return expected;
+}
+
+/// Drain the peer while the multiplexer writes the queue out.
+template<McIoCorkMode corkMode> static void testWriteOrdering() {
+	int sockets[2];
+	McTestExpect(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sockets) == 0);
+	int bufferSize = 4096;
+	setsockopt(sockets[0], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+	setsockopt(sockets[1], SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+	std::unique_ptr<FILE, int(*)(FILE*)> file(tmpfile(), fclose);
+	McTestExpect(file != nullptr);
+	
+	McIoMultiplexer multiplexer;
+	multiplexer.updateTimeout(10000000);
+	McTestWriter* writer = new McTestWriter(sockets[0]);
+	std::unique_ptr<McIoDescriptor> descriptor(writer);
+	multiplexer.insert(descriptor);
+	writer -> setCorkMode(corkMode);
+	std::string expected = McTestWriteChunks(*writer, file.get());
+	McTestExpect(writer -> getQueuedSize() > 0);
+	
+	std::string received;
+	char buffer[4096];
+	for(size_t round = 0; round < 100000 && received.size() < expected.size(); ++ round) {
+		ssize_t numRead;
+		while((numRead = ::read(sockets[1], buffer, sizeof(buffer))) > 0)
+			received.append(buffer, numRead);
+		multiplexer.execute();
+	}
+	McTestExpect(received.size() == expected.size());
+	McTestExpect(received == expected);
+	McTestExpect(writer -> getQueuedSize() == 0);
+	close(sockets[1]);
+}
+
+static McTestRegistrar registrar[] = {
+	McTestRegistrar("writable/ordering", testWriteOrdering<ckNone>),
+	McTestRegistrar("writable/ordering-staged", testWriteOrdering<ckStaged>),
+};